@@ -40,7 +40,8 @@ LOCAL_SHARED_LIBRARIES := \
     libminijail \
     libutils \
     libwifi-system \
-    libwifi-system-iface
+    libwifi-system-iface \
+    libz
 LOCAL_STATIC_LIBRARIES := \
     libwificond
 include $(BUILD_EXECUTABLE)
@@ -55,14 +56,19 @@ LOCAL_C_INCLUDES := $(wificond_includes)
 LOCAL_SRC_FILES := \
     ap_interface_binder.cpp \
     ap_interface_impl.cpp \
+    async_sequence.cpp \
     client_interface_binder.cpp \
     client_interface_impl.cpp \
-    logging_utils.cpp \
+    event_history.cpp \
+    event_history_recorder.cpp \
     looper_backed_event_loop.cpp \
+    regulatory_model.cpp \
+    scanning/bss_cache.cpp \
     scanning/channel_settings.cpp \
     scanning/hidden_network.cpp \
     scanning/offload_scan_callback_interface_impl.cpp \
     scanning/pno_network.cpp \
+    scanning/pno_network_matcher.cpp \
     scanning/pno_settings.cpp \
     scanning/scan_result.cpp \
     scanning/offload/scan_stats.cpp \
@@ -82,7 +88,8 @@ LOCAL_SHARED_LIBRARIES := \
     libhwbinder \
     libhidltransport \
     libwifi-system \
-    libwifi-system-iface
+    libwifi-system-iface \
+    libz
 LOCAL_WHOLE_STATIC_LIBRARIES := \
     libwificond_ipc \
     libwificond_nl
@@ -96,15 +103,53 @@ LOCAL_MODULE := libwificond_nl
 LOCAL_CPPFLAGS := $(wificond_cpp_flags)
 LOCAL_C_INCLUDES := $(wificond_includes)
 LOCAL_SRC_FILES := \
+    net/event_latency_tracker.cpp \
+    net/mac_address.cpp \
     net/mlme_event.cpp \
     net/netlink_manager.cpp \
+    net/netlink_rate_limiter.cpp \
     net/netlink_utils.cpp \
     net/nl80211_attribute.cpp \
-    net/nl80211_packet.cpp
+    net/nl80211_event_dispatcher.cpp \
+    net/nl80211_packet.cpp \
+    net/nl80211_request_cache.cpp \
+    net/ssid.cpp
+LOCAL_SHARED_LIBRARIES := \
+    libbase
+LOCAL_WHOLE_STATIC_LIBRARIES := \
+    libwificond_metrics
+include $(BUILD_STATIC_LIBRARY)
+
+###
+### wificond metrics library
+###
+include $(CLEAR_VARS)
+LOCAL_MODULE := libwificond_metrics
+LOCAL_CPPFLAGS := $(wificond_cpp_flags)
+LOCAL_C_INCLUDES := $(wificond_includes)
+LOCAL_SRC_FILES := \
+    metrics_registry.cpp
 LOCAL_SHARED_LIBRARIES := \
     libbase
 include $(BUILD_STATIC_LIBRARY)
 
+###
+### wificond event history decoder, which runs on host.
+###
+include $(CLEAR_VARS)
+LOCAL_MODULE := wificond_event_history_decoder
+LOCAL_CPPFLAGS := $(wificond_cpp_flags)
+LOCAL_C_INCLUDES := $(wificond_includes)
+LOCAL_SRC_FILES := \
+    event_history.cpp \
+    tools/event_history_decoder.cpp
+LOCAL_STATIC_LIBRARIES := \
+    libbase \
+    liblog \
+    libutils \
+    libz
+include $(BUILD_HOST_EXECUTABLE)
+
 ###
 ### wificond IPC interface library
 ###
@@ -119,10 +164,14 @@ LOCAL_SRC_FILES := \
     aidl/android/net/wifi/IANQPDoneCallback.aidl \
     aidl/android/net/wifi/IClientInterface.aidl \
     aidl/android/net/wifi/IInterfaceEventCallback.aidl \
+    aidl/android/net/wifi/ILinkQualityEvent.aidl \
     aidl/android/net/wifi/IPnoScanEvent.aidl \
+    aidl/android/net/wifi/IRegulatoryEvent.aidl \
     aidl/android/net/wifi/IScanEvent.aidl \
     aidl/android/net/wifi/IWificond.aidl \
     aidl/android/net/wifi/IWifiScannerImpl.aidl \
+    net/mac_address.cpp \
+    net/ssid.cpp \
     scanning/channel_settings.cpp \
     scanning/hidden_network.cpp \
     scanning/pno_network.cpp \
@@ -148,7 +197,8 @@ LOCAL_SRC_FILES := \
 LOCAL_SHARED_LIBRARIES := \
     libbase
 LOCAL_WHOLE_STATIC_LIBRARIES := \
-    libwificond_ipc
+    libwificond_ipc \
+    libwificond_metrics
 include $(BUILD_STATIC_LIBRARY)
 
 ###
@@ -161,10 +211,21 @@ LOCAL_CPPFLAGS := $(wificond_cpp_flags)
 LOCAL_C_INCLUDES := $(wificond_includes)
 LOCAL_SRC_FILES := \
     tests/ap_interface_impl_unittest.cpp \
+    tests/async_sequence_unittest.cpp \
+    tests/bss_cache_unittest.cpp \
     tests/client_interface_impl_unittest.cpp \
+    tests/event_history_unittest.cpp \
+    tests/event_latency_tracker_unittest.cpp \
+    tests/fake_event_loop.cpp \
+    tests/fake_event_loop_unittest.cpp \
+    tests/fake_kernel.cpp \
     tests/looper_backed_event_loop_unittest.cpp \
+    tests/mac_address_unittest.cpp \
     tests/main.cpp \
+    tests/metrics_registry_unittest.cpp \
     tests/mock_client_interface_impl.cpp \
+    tests/mock_event_loop.cpp \
+    tests/mock_link_quality_event.cpp \
     tests/mock_netlink_manager.cpp \
     tests/mock_netlink_utils.cpp \
     tests/mock_offload.cpp \
@@ -173,22 +234,30 @@ LOCAL_SRC_FILES := \
     tests/mock_offload_scan_callback_interface_impl.cpp \
     tests/mock_offload_scan_manager.cpp \
     tests/mock_offload_service_utils.cpp \
+    tests/mock_pno_scan_event.cpp \
+    tests/mock_scan_event.cpp \
     tests/mock_scan_utils.cpp \
     tests/netlink_manager_unittest.cpp \
+    tests/netlink_rate_limiter_unittest.cpp \
     tests/netlink_utils_unittest.cpp \
     tests/nl80211_attribute_unittest.cpp \
+    tests/nl80211_event_dispatcher_unittest.cpp \
     tests/nl80211_packet_unittest.cpp \
+    tests/nl80211_request_cache_unittest.cpp \
     tests/offload_callback_test.cpp \
     tests/offload_hal_test_constants.cpp \
     tests/offload_scan_manager_test.cpp \
     tests/offload_scan_utils_test.cpp \
     tests/offload_test_utils.cpp \
+    tests/pno_network_matcher_unittest.cpp \
+    tests/regulatory_model_unittest.cpp \
     tests/scanner_unittest.cpp \
     tests/scan_result_unittest.cpp \
     tests/scan_settings_unittest.cpp \
     tests/scan_stats_unittest.cpp \
     tests/scan_utils_unittest.cpp \
-    tests/server_unittest.cpp
+    tests/server_unittest.cpp \
+    tests/ssid_unittest.cpp
 LOCAL_STATIC_LIBRARIES := \
     libgmock \
     libgtest \
@@ -207,9 +276,45 @@ LOCAL_SHARED_LIBRARIES := \
     liblog \
     libutils \
     libwifi-system \
-    libwifi-system-iface
+    libwifi-system-iface \
+    libz
 include $(BUILD_NATIVE_TEST)
 
+###
+### wificond benchmarks.
+###
+include $(CLEAR_VARS)
+LOCAL_MODULE := wificond_benchmark
+LOCAL_CPPFLAGS := $(wificond_cpp_flags)
+LOCAL_C_INCLUDES := $(wificond_includes)
+LOCAL_SRC_FILES := \
+    tests/benchmark/allocation_counter.cpp \
+    tests/benchmark/binder_concurrency_benchmark.cpp \
+    tests/benchmark/mac_address_benchmark.cpp \
+    tests/benchmark/main.cpp \
+    tests/benchmark/metrics_benchmark.cpp \
+    tests/benchmark/nl80211_event_dispatcher_benchmark.cpp \
+    tests/benchmark/pno_request_benchmark.cpp \
+    tests/benchmark/scan_results_benchmark.cpp \
+    tests/benchmark/station_request_benchmark.cpp
+LOCAL_STATIC_LIBRARIES := \
+    libwificond \
+    libwificond_nl
+LOCAL_SHARED_LIBRARIES := \
+    android.hardware.wifi.offload@1.0 \
+    libbase \
+    libbinder \
+    libcutils \
+    libhidltransport \
+    libhidlbase \
+    libhwbinder \
+    liblog \
+    libutils \
+    libwifi-system \
+    libwifi-system-iface \
+    libz
+include $(BUILD_NATIVE_BENCHMARK)
+
 ###
 ### wificond device integration tests.
 ###
@@ -26,13 +26,17 @@ using android::wifi_system::HostapdManager;
 namespace android {
 namespace wificond {
 
-ApInterfaceBinder::ApInterfaceBinder(ApInterfaceImpl* impl) : impl_{impl} {
+ApInterfaceBinder::ApInterfaceBinder(ApInterfaceImpl* impl,
+                                     std::recursive_mutex* interface_lock)
+    : impl_{impl},
+      interface_lock_{interface_lock} {
 }
 
 ApInterfaceBinder::~ApInterfaceBinder() {
 }
 
 binder::Status ApInterfaceBinder::startHostapd(bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   *out_success = false;
   if (!impl_) {
     LOG(WARNING) << "Cannot start hostapd on dead ApInterface.";
@@ -43,6 +47,7 @@ binder::Status ApInterfaceBinder::startHostapd(bool* out_success) {
 }
 
 binder::Status ApInterfaceBinder::stopHostapd(bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   *out_success = false;
   if (!impl_) {
     LOG(WARNING) << "Cannot stop hostapd on dead ApInterface.";
@@ -59,6 +64,7 @@ binder::Status ApInterfaceBinder::writeHostapdConfig(
     int32_t binder_encryption_type,
     const std::vector<uint8_t>& passphrase,
     bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   *out_success = false;
   if (!impl_) {
     LOG(WARNING) << "Cannot set config on dead ApInterface.";
@@ -88,6 +94,7 @@ binder::Status ApInterfaceBinder::writeHostapdConfig(
 }
 
 binder::Status ApInterfaceBinder::getInterfaceName(std::string* out_name) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (!impl_) {
     LOG(WARNING) << "Cannot get interface name from dead ApInterface";
     return binder::Status::ok();
@@ -98,6 +105,7 @@ binder::Status ApInterfaceBinder::getInterfaceName(std::string* out_name) {
 
 binder::Status ApInterfaceBinder::getNumberOfAssociatedStations(
     int* out_num_of_stations) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (!impl_) {
     LOG(WARNING) << "Cannot get number of associated stations "
                  << "from dead ApInterface";
@@ -17,6 +17,8 @@
 #ifndef WIFICOND_AP_INTERFACE_BINDER_H_
 #define WIFICOND_AP_INTERFACE_BINDER_H_
 
+#include <mutex>
+
 #include <android-base/macros.h>
 
 #include "android/net/wifi/BnApInterface.h"
@@ -28,10 +30,12 @@ class ApInterfaceImpl;
 
 class ApInterfaceBinder : public android::net::wifi::BnApInterface {
  public:
-  explicit ApInterfaceBinder(ApInterfaceImpl* impl);
+  // Calls into |impl| are made with |*interface_lock| held.
+  ApInterfaceBinder(ApInterfaceImpl* impl,
+                    std::recursive_mutex* interface_lock);
   ~ApInterfaceBinder() override;
 
-  // Called by |impl_| its destruction.
+  // Called by |impl_| its destruction, with the interface lock held.
   // This informs the binder proxy that no future manipulations of |impl_|
   // by remote processes are possible.
   void NotifyImplDead() { impl_ = nullptr; }
@@ -50,6 +54,7 @@ class ApInterfaceBinder : public android::net::wifi::BnApInterface {
 
  private:
   ApInterfaceImpl* impl_;
+  std::recursive_mutex* const interface_lock_;
 
   DISALLOW_COPY_AND_ASSIGN(ApInterfaceBinder);
 };
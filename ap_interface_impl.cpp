@@ -21,7 +21,7 @@
 #include "wificond/net/netlink_utils.h"
 
 #include "wificond/ap_interface_binder.h"
-#include "wificond/logging_utils.h"
+#include "wificond/metrics_registry.h"
 
 using android::net::wifi::IApInterface;
 using android::wifi_system::HostapdManager;
@@ -38,6 +38,12 @@ using namespace std::placeholders;
 namespace android {
 namespace wificond {
 
+namespace {
+
+GaugeMetric num_ap_interfaces("interfaces.ap");
+
+}  // namespace
+
 ApInterfaceImpl::ApInterfaceImpl(const string& interface_name,
                                  uint32_t interface_index,
                                  NetlinkUtils* netlink_utils,
@@ -48,7 +54,8 @@ ApInterfaceImpl::ApInterfaceImpl(const string& interface_name,
       netlink_utils_(netlink_utils),
       if_tool_(if_tool),
       hostapd_manager_(hostapd_manager),
-      binder_(new ApInterfaceBinder(this)),
+      binder_(new ApInterfaceBinder(
+          this, &netlink_utils->GetInterfaceLock(interface_index))),
       number_of_associated_stations_(0) {
   // This log keeps compiler happy.
   LOG(DEBUG) << "Created ap interface " << interface_name_
@@ -59,12 +66,17 @@ ApInterfaceImpl::ApInterfaceImpl(const string& interface_name,
       std::bind(&ApInterfaceImpl::OnStationEvent,
                 this,
                 _1, _2));
+  num_ap_interfaces.Add(1);
 }
 
 ApInterfaceImpl::~ApInterfaceImpl() {
+  // Waits for the binder calls in progress on other threads.
+  std::lock_guard<std::recursive_mutex> lock(
+      netlink_utils_->GetInterfaceLock(interface_index_));
   binder_->NotifyImplDead();
   if_tool_->SetUpState(interface_name_.c_str(), false);
   netlink_utils_->UnsubscribeStationEvent(interface_index_);
+  num_ap_interfaces.Add(-1);
 }
 
 sp<IApInterface> ApInterfaceImpl::GetBinder() const {
@@ -72,6 +84,8 @@ sp<IApInterface> ApInterfaceImpl::GetBinder() const {
 }
 
 void ApInterfaceImpl::Dump(std::stringstream* ss) const {
+  std::lock_guard<std::recursive_mutex> lock(
+      netlink_utils_->GetInterfaceLock(interface_index_));
   *ss << "------- Dump of AP interface with index: "
       << interface_index_ << " and name: " << interface_name_
       << "-------" << endl;
@@ -126,15 +140,15 @@ bool ApInterfaceImpl::WriteHostapdConfig(const vector<uint8_t>& ssid,
 }
 
 void ApInterfaceImpl::OnStationEvent(StationEvent event,
-                                     const vector<uint8_t>& mac_address) {
+                                     const MacAddress& mac_address) {
   if (event == NEW_STATION) {
     LOG(INFO) << "New station "
-              << LoggingUtils::GetMacString(mac_address)
+              << mac_address.ToString()
               << " associated with hotspot";
     number_of_associated_stations_++;
   } else if (event == DEL_STATION) {
     LOG(INFO) << "Station "
-              << LoggingUtils::GetMacString(mac_address)
+              << mac_address.ToString()
               << " disassociated from hotspot";
     if (number_of_associated_stations_ <= 0) {
       LOG(ERROR) << "Received DEL_STATION event when station counter is: "
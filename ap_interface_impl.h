@@ -24,6 +24,7 @@
 #include <wifi_system/hostapd_manager.h>
 #include <wifi_system/interface_tool.h>
 
+#include "wificond/net/mac_address.h"
 #include "wificond/net/netlink_manager.h"
 
 #include "android/net/wifi/IApInterface.h"
@@ -74,7 +75,7 @@ class ApInterfaceImpl {
   int number_of_associated_stations_;
 
   void OnStationEvent(StationEvent event,
-                      const std::vector<uint8_t>& mac_address);
+                      const MacAddress& mac_address);
 
   DISALLOW_COPY_AND_ASSIGN(ApInterfaceImpl);
 };
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/async_sequence.h"
+
+#include <android-base/logging.h>
+
+#include "wificond/event_loop.h"
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::endl;
+using std::string;
+using std::weak_ptr;
+
+namespace android {
+namespace wificond {
+
+AsyncSequence::AsyncSequence(const string& name, EventLoop* event_loop)
+    : name_(name),
+      event_loop_(event_loop),
+      stages_(1),
+      current_stage_(0),
+      num_running_workers_(0),
+      started_(false),
+      done_(false),
+      duration_us_(0),
+      weak_this_owner_(new AsyncSequence*(this)) {
+}
+
+AsyncSequence::~AsyncSequence() {
+  Wait();
+}
+
+void AsyncSequence::AddStage() {
+  CHECK(!started_) << "Cannot add stages to a started sequence";
+  stages_.emplace_back();
+}
+
+void AsyncSequence::AddWorkerStep(const string& name, const Step& step) {
+  CHECK(!started_) << "Cannot add steps to a started sequence";
+  stages_.back().steps.push_back({name, step, true, 0});
+}
+
+void AsyncSequence::AddLoopStep(const string& name, const Step& step) {
+  CHECK(!started_) << "Cannot add steps to a started sequence";
+  stages_.back().steps.push_back({name, step, false, 0});
+}
+
+void AsyncSequence::Start(const std::function<void()>& on_done) {
+  CHECK(!started_) << "Sequence " << name_ << " is already started";
+  started_ = true;
+  on_done_ = on_done;
+  start_time_ = steady_clock::now();
+  RunStage(0);
+}
+
+void AsyncSequence::Wait() {
+  while (started_ && !done_) {
+    // OnStageDone() joins the workers of the current stage.
+    OnStageDone(current_stage_);
+  }
+}
+
+void AsyncSequence::RunStage(size_t stage_index) {
+  if (stage_index == stages_.size()) {
+    duration_us_ = duration_cast<microseconds>(
+        steady_clock::now() - start_time_).count();
+    done_ = true;
+    LOG(INFO) << name_ << " is done in " << duration_us_ / 1000 << " ms";
+    if (on_done_) {
+      on_done_();
+    }
+    return;
+  }
+  current_stage_ = stage_index;
+  Stage& stage = stages_[stage_index];
+  size_t num_workers = 0;
+  for (auto& step : stage.steps) {
+    if (step.on_worker) {
+      num_workers++;
+    }
+  }
+  num_running_workers_ = num_workers;
+  for (auto& step : stage.steps) {
+    if (!step.on_worker) {
+      continue;
+    }
+    StepInfo* step_ptr = &step;
+    weak_ptr<AsyncSequence*> weak_this(weak_this_owner_);
+    stage.workers.emplace_back([this, step_ptr, stage_index, weak_this] {
+      RunStep(step_ptr);
+      if (--num_running_workers_ > 0) {
+        return;
+      }
+      // The last worker of this stage resumes the sequence on the event loop
+      // thread.
+      event_loop_->PostTask([stage_index, weak_this] {
+        auto owner = weak_this.lock();
+        if (owner != nullptr) {
+          (*owner)->OnStageDone(stage_index);
+        }
+      });
+    });
+  }
+  // Event loop steps overlap with the worker steps.
+  for (auto& step : stage.steps) {
+    if (!step.on_worker) {
+      RunStep(&step);
+    }
+  }
+  if (num_workers == 0) {
+    OnStageDone(stage_index);
+  }
+}
+
+void AsyncSequence::OnStageDone(size_t stage_index) {
+  // Wait() may have completed this stage already.
+  if (done_ || stage_index != current_stage_) {
+    return;
+  }
+  for (auto& worker : stages_[stage_index].workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  stages_[stage_index].workers.clear();
+  RunStage(stage_index + 1);
+}
+
+void AsyncSequence::RunStep(StepInfo* step) {
+  steady_clock::time_point start_time = steady_clock::now();
+  step->step();
+  step->duration_us = duration_cast<microseconds>(
+      steady_clock::now() - start_time).count();
+}
+
+void AsyncSequence::Dump(std::stringstream* ss) const {
+  *ss << name_ << ": ";
+  if (!started_) {
+    *ss << "not started" << endl;
+    return;
+  }
+  if (!done_) {
+    *ss << "in progress, stage " << current_stage_ + 1 << " of "
+        << stages_.size() << endl;
+    return;
+  }
+  *ss << "done in " << duration_us_ / 1000 << " ms" << endl;
+  for (size_t i = 0; i < stages_.size(); i++) {
+    for (const auto& step : stages_[i].steps) {
+      *ss << "  Stage " << i + 1 << ", " << step.name
+          << (step.on_worker ? " (worker)" : "") << ": "
+          << step.duration_us / 1000 << " ms" << endl;
+    }
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_ASYNC_SEQUENCE_H_
+#define WIFICOND_ASYNC_SEQUENCE_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+class EventLoop;
+
+// Runs stages of steps without blocking the event loop, and records how long
+// each step and the whole sequence took.
+// A stage starts once every step of the previous stage is done. Within a
+// stage, worker steps run concurrently on their own threads, overlapped with
+// the event loop steps, which run one after another on the event loop thread.
+// Worker steps must not touch any state owned by the event loop thread.
+class AsyncSequence {
+ public:
+  using Step = std::function<void()>;
+
+  AsyncSequence(const std::string& name, EventLoop* event_loop);
+  // Waits for the sequence to complete.
+  ~AsyncSequence();
+
+  // Steps added after this call belong to a new stage.
+  void AddStage();
+  // Adds |step| to the current stage. It runs on a worker thread.
+  void AddWorkerStep(const std::string& name, const Step& step);
+  // Adds |step| to the current stage. It runs on the event loop thread.
+  void AddLoopStep(const std::string& name, const Step& step);
+
+  // Starts the first stage. |on_done| is called on the event loop thread
+  // once every stage is done. It can be null.
+  void Start(const std::function<void()>& on_done);
+  // Blocks until every stage is done. The remaining event loop steps run on
+  // the calling thread, which must be the event loop thread.
+  void Wait();
+  bool IsDone() const { return done_; }
+
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  struct StepInfo {
+    std::string name;
+    Step step;
+    bool on_worker;
+    // Written by the worker thread of this step before it exits.
+    int64_t duration_us;
+  };
+  struct Stage {
+    std::vector<StepInfo> steps;
+    std::vector<std::thread> workers;
+  };
+
+  void RunStage(size_t stage_index);
+  void OnStageDone(size_t stage_index);
+  void RunStep(StepInfo* step);
+
+  const std::string name_;
+  EventLoop* const event_loop_;
+  std::vector<Stage> stages_;
+  size_t current_stage_;
+  // Number of worker steps of the current stage which are still running.
+  std::atomic<size_t> num_running_workers_;
+  bool started_;
+  bool done_;
+  std::function<void()> on_done_;
+  std::chrono::steady_clock::time_point start_time_;
+  int64_t duration_us_;
+  // Tasks posted by worker threads hold a weak reference to this, so that
+  // they are dropped once this sequence is destroyed.
+  std::shared_ptr<AsyncSequence*> weak_this_owner_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncSequence);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_ASYNC_SEQUENCE_H_
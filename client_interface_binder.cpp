@@ -18,62 +18,77 @@
 
 #include <vector>
 
+#include <android-base/logging.h>
 #include <binder/Status.h>
 
 #include "wificond/client_interface_impl.h"
+#include "wificond/net/mac_address.h"
+#include "wificond/net/netlink_rate_limiter.h"
 
 using android::binder::Status;
 using android::net::wifi::IANQPDoneCallback;
+using android::net::wifi::ILinkQualityEvent;
 using android::net::wifi::IWifiScannerImpl;
 using std::vector;
 
 namespace android {
 namespace wificond {
 
-ClientInterfaceBinder::ClientInterfaceBinder(ClientInterfaceImpl* impl)
-    : impl_(impl) {
+ClientInterfaceBinder::ClientInterfaceBinder(
+    ClientInterfaceImpl* impl,
+    std::recursive_mutex* interface_lock)
+    : impl_(impl),
+      interface_lock_(interface_lock) {
 }
 
 ClientInterfaceBinder::~ClientInterfaceBinder() {
 }
 
 Status ClientInterfaceBinder::enableSupplicant(bool* success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   *success = impl_ && impl_->EnableSupplicant();
   return Status::ok();
 }
 
 Status ClientInterfaceBinder::disableSupplicant(bool* success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   *success = impl_ && impl_->DisableSupplicant();
   return Status::ok();
 }
 
 Status ClientInterfaceBinder::getPacketCounters(
     vector<int32_t>* out_packet_counters) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (impl_ == nullptr) {
     return Status::ok();
   }
+  NetlinkRateLimiter::ScopedLimit limit;
   impl_->GetPacketCounters(out_packet_counters);
   return Status::ok();
 }
 
 Status ClientInterfaceBinder::signalPoll(
     vector<int32_t>* out_signal_poll_results) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (impl_ == nullptr) {
     return Status::ok();
   }
+  NetlinkRateLimiter::ScopedLimit limit;
   impl_->SignalPoll(out_signal_poll_results);
   return Status::ok();
 }
 
 Status ClientInterfaceBinder::getMacAddress(vector<uint8_t>* out_mac_address) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (impl_ == nullptr) {
     return Status::ok();
   }
-  *out_mac_address = impl_->GetMacAddress();
+  *out_mac_address = impl_->GetMacAddress().ToBytes();
   return Status::ok();
 }
 
 Status ClientInterfaceBinder::getInterfaceName(std::string* out_name) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (impl_ == nullptr) {
     return Status::ok();
   }
@@ -83,6 +98,7 @@ Status ClientInterfaceBinder::getInterfaceName(std::string* out_name) {
 
 Status ClientInterfaceBinder::getWifiScannerImpl(
     sp<IWifiScannerImpl>* out_wifi_scanner_impl) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (impl_ == nullptr) {
     *out_wifi_scanner_impl = nullptr;
     return Status::ok();
@@ -95,11 +111,49 @@ Status ClientInterfaceBinder::requestANQP(
     const vector<uint8_t>& bssid,
     const sp<IANQPDoneCallback>& callback,
     bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
   if (impl_ == nullptr) {
     *out_success = false;
     return Status::ok();
   }
-  *out_success = impl_->requestANQP(bssid, callback);
+  MacAddress mac_address;
+  if (!MacAddress::FromBytes(bssid, &mac_address)) {
+    LOG(ERROR) << "Invalid BSSID for ANQP request";
+    *out_success = false;
+    return Status::ok();
+  }
+  *out_success = impl_->requestANQP(mac_address, callback);
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::subscribeLinkQualityEvents(
+    int32_t rssi_threshold_dbm,
+    int32_t rssi_hysteresis_db,
+    const sp<ILinkQualityEvent>& handler,
+    bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
+  if (impl_ == nullptr) {
+    *out_success = false;
+    return Status::ok();
+  }
+  // 0 dBm would disable RSSI monitoring in kernel.
+  if (rssi_threshold_dbm >= 0 || rssi_hysteresis_db < 0 || handler == nullptr) {
+    LOG(ERROR) << "Invalid link quality monitoring settings";
+    *out_success = false;
+    return Status::ok();
+  }
+  *out_success = impl_->SubscribeLinkQualityEvents(rssi_threshold_dbm,
+                                                   rssi_hysteresis_db,
+                                                   handler);
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::unsubscribeLinkQualityEvents() {
+  std::lock_guard<std::recursive_mutex> lock(*interface_lock_);
+  if (impl_ == nullptr) {
+    return Status::ok();
+  }
+  impl_->UnsubscribeLinkQualityEvents();
   return Status::ok();
 }
 
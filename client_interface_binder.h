@@ -17,6 +17,8 @@
 #ifndef WIFICOND_CLIENT_INTERFACE_BINDER_H_
 #define WIFICOND_CLIENT_INTERFACE_BINDER_H_
 
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <binder/Status.h>
 
@@ -29,10 +31,12 @@ class ClientInterfaceImpl;
 
 class ClientInterfaceBinder : public android::net::wifi::BnClientInterface {
  public:
-  explicit ClientInterfaceBinder(ClientInterfaceImpl* impl);
+  // Calls into |impl| are made with |*interface_lock| held.
+  ClientInterfaceBinder(ClientInterfaceImpl* impl,
+                        std::recursive_mutex* interface_lock);
   ~ClientInterfaceBinder() override;
 
-  // Called by |impl_| its destruction.
+  // Called by |impl_| its destruction, with the interface lock held.
   // This informs the binder proxy that no future manipulations of |impl_|
   // by remote processes are possible.
   void NotifyImplDead() { impl_ = nullptr; }
@@ -52,9 +56,16 @@ class ClientInterfaceBinder : public android::net::wifi::BnClientInterface {
       const ::std::vector<uint8_t>& bssid,
       const ::android::sp<::android::net::wifi::IANQPDoneCallback>& callback,
       bool* out_success) override;
+  ::android::binder::Status subscribeLinkQualityEvents(
+      int32_t rssi_threshold_dbm,
+      int32_t rssi_hysteresis_db,
+      const ::android::sp<::android::net::wifi::ILinkQualityEvent>& handler,
+      bool* out_success) override;
+  ::android::binder::Status unsubscribeLinkQualityEvents() override;
 
  private:
   ClientInterfaceImpl* impl_;
+  std::recursive_mutex* const interface_lock_;
 
   DISALLOW_COPY_AND_ASSIGN(ClientInterfaceBinder);
 };
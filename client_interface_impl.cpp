@@ -22,6 +22,7 @@
 #include <wifi_system/supplicant_manager.h>
 
 #include "wificond/client_interface_binder.h"
+#include "wificond/metrics_registry.h"
 #include "wificond/net/mlme_event.h"
 #include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/offload/offload_service_utils.h"
@@ -30,6 +31,7 @@
 #include "wificond/scanning/scanner_impl.h"
 
 using android::net::wifi::IClientInterface;
+using android::net::wifi::ILinkQualityEvent;
 using com::android::server::wifi::wificond::NativeScanResult;
 using android::sp;
 using android::wifi_system::InterfaceTool;
@@ -43,6 +45,12 @@ using std::vector;
 namespace android {
 namespace wificond {
 
+namespace {
+
+GaugeMetric num_client_interfaces("interfaces.client");
+
+}  // namespace
+
 MlmeEventHandlerImpl::MlmeEventHandlerImpl(ClientInterfaceImpl* client_interface)
     : client_interface_(client_interface) {
 }
@@ -60,7 +68,7 @@ void MlmeEventHandlerImpl::OnConnect(unique_ptr<MlmeConnectEvent> event) {
       LOG(INFO) << "Connect timeout";
     }
     client_interface_->is_associated_ = false;
-    client_interface_->bssid_.clear();
+    client_interface_->bssid_ = MacAddress();
   }
 }
 
@@ -71,7 +79,7 @@ void MlmeEventHandlerImpl::OnRoam(unique_ptr<MlmeRoamEvent> event) {
     client_interface_->bssid_ = event->GetBSSID();
   } else {
     client_interface_->is_associated_ = false;
-    client_interface_->bssid_.clear();
+    client_interface_->bssid_ = MacAddress();
   }
 }
 
@@ -85,18 +93,51 @@ void MlmeEventHandlerImpl::OnAssociate(unique_ptr<MlmeAssociateEvent> event) {
       LOG(INFO) << "Associate timeout";
     }
     client_interface_->is_associated_ = false;
-    client_interface_->bssid_.clear();
+    client_interface_->bssid_ = MacAddress();
   }
 }
 
 void MlmeEventHandlerImpl::OnDisconnect(unique_ptr<MlmeDisconnectEvent> event) {
   client_interface_->is_associated_ = false;
-  client_interface_->bssid_.clear();
+  client_interface_->bssid_ = MacAddress();
 }
 
 void MlmeEventHandlerImpl::OnDisassociate(unique_ptr<MlmeDisassociateEvent> event) {
   client_interface_->is_associated_ = false;
-  client_interface_->bssid_.clear();
+  client_interface_->bssid_ = MacAddress();
+}
+
+void MlmeEventHandlerImpl::OnCqm(unique_ptr<MlmeCqmEvent> event) {
+  const sp<ILinkQualityEvent> handler =
+      client_interface_->link_quality_event_handler_;
+  if (handler == nullptr) {
+    return;
+  }
+  switch (event->GetType()) {
+    case MlmeCqmEvent::kRssiThresholdLow:
+      handler->OnRssiThresholdCrossed(ILinkQualityEvent::RSSI_THRESHOLD_LOW);
+      break;
+    case MlmeCqmEvent::kRssiThresholdHigh:
+      handler->OnRssiThresholdCrossed(ILinkQualityEvent::RSSI_THRESHOLD_HIGH);
+      break;
+    case MlmeCqmEvent::kPacketLoss:
+      handler->OnPacketLoss(event->GetBSSID().ToBytes(),
+                            event->GetNumLostPackets());
+      break;
+    case MlmeCqmEvent::kBeaconLoss:
+      handler->OnBeaconLoss();
+      break;
+  }
+}
+
+void MlmeEventHandlerImpl::OnChannelSwitch(
+    unique_ptr<MlmeChannelSwitchEvent> event) {
+  client_interface_->associate_freq_ = event->GetFrequency();
+  const sp<ILinkQualityEvent> handler =
+      client_interface_->link_quality_event_handler_;
+  if (handler != nullptr) {
+    handler->OnChannelSwitch(event->GetFrequency(), event->GetChannelWidth());
+  }
 }
 
 
@@ -104,11 +145,14 @@ ClientInterfaceImpl::ClientInterfaceImpl(
     uint32_t wiphy_index,
     const std::string& interface_name,
     uint32_t interface_index,
-    const std::vector<uint8_t>& interface_mac_addr,
+    const MacAddress& interface_mac_addr,
     InterfaceTool* if_tool,
     SupplicantManager* supplicant_manager,
     NetlinkUtils* netlink_utils,
-    ScanUtils* scan_utils)
+    ScanUtils* scan_utils,
+    RegulatoryModel* regulatory_model,
+    BssCache* bss_cache,
+    EventLoop* event_loop)
     : wiphy_index_(wiphy_index),
       interface_name_(interface_name),
       interface_index_(interface_index),
@@ -117,13 +161,21 @@ ClientInterfaceImpl::ClientInterfaceImpl(
       supplicant_manager_(supplicant_manager),
       netlink_utils_(netlink_utils),
       scan_utils_(scan_utils),
+      regulatory_model_(regulatory_model),
       offload_service_utils_(new OffloadServiceUtils()),
       mlme_event_handler_(new MlmeEventHandlerImpl(this)),
-      binder_(new ClientInterfaceBinder(this)),
-      is_associated_(false) {
+      binder_(new ClientInterfaceBinder(
+          this, &netlink_utils->GetInterfaceLock(interface_index))),
+      is_associated_(false),
+      associate_freq_(0),
+      num_event_overrun_resyncs_(0),
+      num_synthesized_notifications_(0) {
   netlink_utils_->SubscribeMlmeEvent(
       interface_index_,
       mlme_event_handler_.get());
+  netlink_utils_->SubscribeEventOverrun(
+      interface_index_,
+      std::bind(&ClientInterfaceImpl::OnEventOverrun, this));
   if (!netlink_utils_->GetWiphyInfo(wiphy_index_,
                                &band_info_,
                                &scan_capabilities_,
@@ -139,14 +191,26 @@ ClientInterfaceImpl::ClientInterfaceImpl(
                              this,
                              netlink_utils_,
                              scan_utils_,
+                             regulatory_model_,
+                             bss_cache,
+                             event_loop,
                              offload_service_utils_);
+  num_client_interfaces.Add(1);
 }
 
 ClientInterfaceImpl::~ClientInterfaceImpl() {
+  // Waits for the binder calls in progress on other threads, and keeps new
+  // ones out until the interface is detached from its binder objects.
+  std::lock_guard<std::recursive_mutex> lock(
+      netlink_utils_->GetInterfaceLock(interface_index_));
   binder_->NotifyImplDead();
   scanner_->Invalidate();
+  num_client_interfaces.Add(-1);
+  UnsubscribeLinkQualityEvents();
   DisableSupplicant();
+  netlink_utils_->UnsubscribeEventOverrun(interface_index_);
   netlink_utils_->UnsubscribeMlmeEvent(interface_index_);
+  netlink_utils_->DropRequestTemplates(interface_index_);
   if_tool_->SetUpState(interface_name_.c_str(), false);
 }
 
@@ -155,6 +219,8 @@ sp<android::net::wifi::IClientInterface> ClientInterfaceImpl::GetBinder() const
 }
 
 void ClientInterfaceImpl::Dump(std::stringstream* ss) const {
+  std::lock_guard<std::recursive_mutex> lock(
+      netlink_utils_->GetInterfaceLock(interface_index_));
   *ss << "------- Dump of client interface with index: "
       << interface_index_ << " and name: " << interface_name_
       << "-------" << endl;
@@ -174,6 +240,11 @@ void ClientInterfaceImpl::Dump(std::stringstream* ss) const {
       << wiphy_features_.supports_random_mac_oneshot_scan << endl;
   *ss << "Device supports random MAC for scheduled scan: "
       << wiphy_features_.supports_random_mac_sched_scan << endl;
+  *ss << "Resyncs after dropped kernel events: "
+      << num_event_overrun_resyncs_ << endl;
+  *ss << "Notifications synthesized by resyncs: "
+      << num_synthesized_notifications_ << endl;
+  scanner_->Dump(ss);
   *ss << "------- Dump End -------" << endl;
 }
 
@@ -222,17 +293,39 @@ bool ClientInterfaceImpl::SignalPoll(vector<int32_t>* out_signal_poll_results) {
   return true;
 }
 
-const vector<uint8_t>& ClientInterfaceImpl::GetMacAddress() {
+const MacAddress& ClientInterfaceImpl::GetMacAddress() const {
   return interface_mac_addr_;
 }
 
 bool ClientInterfaceImpl::requestANQP(
-      const ::std::vector<uint8_t>& bssid,
+      const MacAddress& bssid,
       const ::android::sp<::android::net::wifi::IANQPDoneCallback>& callback) {
   // TODO(nywang): query ANQP information from wpa_supplicant.
   return true;
 }
 
+bool ClientInterfaceImpl::SubscribeLinkQualityEvents(
+    int32_t rssi_threshold_dbm,
+    uint32_t rssi_hysteresis_db,
+    const sp<ILinkQualityEvent>& handler) {
+  if (!netlink_utils_->SetCqmRssiConfig(interface_index_,
+                                        rssi_threshold_dbm,
+                                        rssi_hysteresis_db)) {
+    return false;
+  }
+  link_quality_event_handler_ = handler;
+  return true;
+}
+
+void ClientInterfaceImpl::UnsubscribeLinkQualityEvents() {
+  if (link_quality_event_handler_ == nullptr) {
+    return;
+  }
+  // Stop kernel from waking us up for events nobody listens to.
+  netlink_utils_->SetCqmRssiConfig(interface_index_, 0, 0);
+  link_quality_event_handler_ = nullptr;
+}
+
 bool ClientInterfaceImpl::RefreshAssociateFreq() {
   // wpa_supplicant fetches associate frequency using the latest scan result.
   // We should follow the same method here before we find a better solution.
@@ -248,6 +341,46 @@ bool ClientInterfaceImpl::RefreshAssociateFreq() {
   return false;
 }
 
+void ClientInterfaceImpl::OnEventOverrun() {
+  LOG(WARNING) << "Resyncing state of interface " << interface_name_
+               << " after kernel dropped events";
+  num_event_overrun_resyncs_++;
+  // A single dump serves both the connection state and the scanner:
+  // kernel marks the BSS we are associated with in its scan result cache.
+  std::vector<NativeScanResult> scan_results;
+  if (!scan_utils_->GetScanResult(interface_index_, &scan_results)) {
+    LOG(ERROR) << "Failed to get scan results for resync";
+    return;
+  }
+  const NativeScanResult* associated_bss = nullptr;
+  for (auto& scan_result : scan_results) {
+    if (scan_result.associated) {
+      associated_bss = &scan_result;
+      break;
+    }
+  }
+  // Kernel may keep the BSS status for a moment after the station entry is
+  // gone, so the station table has the final say.
+  StationInfo station_info;
+  bool associated = associated_bss != nullptr &&
+      netlink_utils_->GetStationInfo(interface_index_,
+                                     associated_bss->bssid,
+                                     &station_info);
+  if (associated && (!is_associated_ || bssid_ != associated_bss->bssid)) {
+    LOG(INFO) << "Missed association event, catching up";
+    is_associated_ = true;
+    bssid_ = associated_bss->bssid;
+    associate_freq_ = associated_bss->frequency;
+    num_synthesized_notifications_++;
+  } else if (!associated && is_associated_) {
+    LOG(INFO) << "Missed disconnection event, catching up";
+    is_associated_ = false;
+    bssid_ = MacAddress();
+    num_synthesized_notifications_++;
+  }
+  scanner_->ResyncScanState();
+}
+
 bool ClientInterfaceImpl::IsAssociated() const {
   return is_associated_;
 }
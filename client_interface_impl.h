@@ -25,6 +25,8 @@
 #include <wifi_system/supplicant_manager.h>
 
 #include "android/net/wifi/IClientInterface.h"
+#include "android/net/wifi/ILinkQualityEvent.h"
+#include "wificond/net/mac_address.h"
 #include "wificond/net/mlme_event_handler.h"
 #include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/offload/offload_service_utils.h"
@@ -33,8 +35,11 @@
 namespace android {
 namespace wificond {
 
+class BssCache;
 class ClientInterfaceBinder;
 class ClientInterfaceImpl;
+class EventLoop;
+class RegulatoryModel;
 class ScanUtils;
 
 class MlmeEventHandlerImpl : public MlmeEventHandler {
@@ -46,6 +51,8 @@ class MlmeEventHandlerImpl : public MlmeEventHandler {
   void OnAssociate(std::unique_ptr<MlmeAssociateEvent> event) override;
   void OnDisconnect(std::unique_ptr<MlmeDisconnectEvent> event) override;
   void OnDisassociate(std::unique_ptr<MlmeDisassociateEvent> event) override;
+  void OnCqm(std::unique_ptr<MlmeCqmEvent> event) override;
+  void OnChannelSwitch(std::unique_ptr<MlmeChannelSwitchEvent> event) override;
 
  private:
   ClientInterfaceImpl* client_interface_;
@@ -63,11 +70,14 @@ class ClientInterfaceImpl {
       uint32_t wiphy_index,
       const std::string& interface_name,
       uint32_t interface_index,
-      const std::vector<uint8_t>& interface_mac_addr,
+      const MacAddress& interface_mac_addr,
       android::wifi_system::InterfaceTool* if_tool,
       android::wifi_system::SupplicantManager* supplicant_manager,
       NetlinkUtils* netlink_utils,
-      ScanUtils* scan_utils);
+      ScanUtils* scan_utils,
+      RegulatoryModel* regulatory_model,
+      BssCache* bss_cache,
+      EventLoop* event_loop);
   virtual ~ClientInterfaceImpl();
 
   // Get a pointer to the binder representing this ClientInterfaceImpl.
@@ -77,36 +87,52 @@ class ClientInterfaceImpl {
   bool DisableSupplicant();
   bool GetPacketCounters(std::vector<int32_t>* out_packet_counters);
   bool SignalPoll(std::vector<int32_t>* out_signal_poll_results);
-  const std::vector<uint8_t>& GetMacAddress();
+  const MacAddress& GetMacAddress() const;
   const std::string& GetInterfaceName() const { return interface_name_; }
   const android::sp<ScannerImpl> GetScanner() { return scanner_; };
   bool requestANQP(
-      const ::std::vector<uint8_t>& bssid,
+      const MacAddress& bssid,
       const ::android::sp<::android::net::wifi::IANQPDoneCallback>& callback);
+  bool SubscribeLinkQualityEvents(
+      int32_t rssi_threshold_dbm,
+      uint32_t rssi_hysteresis_db,
+      const android::sp<android::net::wifi::ILinkQualityEvent>& handler);
+  void UnsubscribeLinkQualityEvents();
   virtual bool IsAssociated() const;
   void Dump(std::stringstream* ss) const;
 
  private:
   bool RefreshAssociateFreq();
+  // Queries kernel for the association and scan state after NL80211
+  // multicast events were dropped, and catches up on missed notifications.
+  void OnEventOverrun();
 
   const uint32_t wiphy_index_;
   const std::string interface_name_;
   const uint32_t interface_index_;
-  const std::vector<uint8_t> interface_mac_addr_;
+  const MacAddress interface_mac_addr_;
   android::wifi_system::InterfaceTool* const if_tool_;
   android::wifi_system::SupplicantManager* const supplicant_manager_;
   NetlinkUtils* const netlink_utils_;
   ScanUtils* const scan_utils_;
+  RegulatoryModel* const regulatory_model_;
   const std::shared_ptr<OffloadServiceUtils> offload_service_utils_;
   const std::unique_ptr<MlmeEventHandlerImpl> mlme_event_handler_;
   const android::sp<ClientInterfaceBinder> binder_;
   android::sp<ScannerImpl> scanner_;
+  android::sp<android::net::wifi::ILinkQualityEvent>
+      link_quality_event_handler_;
 
   // Cached information for this connection.
   bool is_associated_;
-  std::vector<uint8_t> bssid_;
+  MacAddress bssid_;
   uint32_t associate_freq_;
 
+  // Number of resyncs triggered by dropped multicast events, and number of
+  // missed notifications we synthesized during these resyncs.
+  uint32_t num_event_overrun_resyncs_;
+  uint32_t num_synthesized_notifications_;
+
   // Capability information for this wiphy/interface.
   BandInfo band_info_;
   ScanCapabilities scan_capabilities_;
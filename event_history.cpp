@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/event_history.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <utils/Timers.h>
+
+using android::base::ReadFileToString;
+using android::base::StringAppendF;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// "WEVH"
+constexpr uint32_t kMagic = 0x48564557;
+// Must be incremented whenever the layout of Header or Record changes.
+constexpr uint32_t kVersion = 1;
+
+uint64_t GetWallTimeMs() {
+  return ns2ms(systemTime(SYSTEM_TIME_REALTIME));
+}
+
+uint32_t GetChecksum(const EventHistory::Record& record) {
+  return crc32(0,
+               reinterpret_cast<const Bytef*>(&record) +
+                   sizeof(record.checksum),
+               sizeof(record) - sizeof(record.checksum));
+}
+
+const char* EventTypeToString(uint8_t type) {
+  switch (type) {
+    case EventHistory::kScanTriggered:
+      return "scan_triggered";
+    case EventHistory::kScanResults:
+      return "scan_results";
+    case EventHistory::kScanAborted:
+      return "scan_aborted";
+    case EventHistory::kSchedScanResults:
+      return "sched_scan_results";
+    case EventHistory::kBss:
+      return "bss";
+    case EventHistory::kMlmeEvent:
+      return "mlme_event";
+    case EventHistory::kRegChange:
+      return "reg_change";
+    case EventHistory::kNetlinkError:
+      return "netlink_error";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace
+
+struct EventHistory::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t capacity;
+  // Keeps the records aligned to their size.
+  uint8_t reserved[sizeof(Record) - 4 * sizeof(uint32_t)];
+};
+
+const size_t EventHistory::kDefaultSizeBytes = 256 * 1024;
+const char EventHistory::kCsvHeader[] =
+    "sequence,wall_time_ms,event,interface_index,command,code,frequency,"
+    "value,bssid,ssid";
+
+EventHistory::EventHistory(const string& path, size_t size_bytes)
+    : EventHistory(path, size_bytes, GetWallTimeMs) {}
+
+EventHistory::EventHistory(const string& path,
+                           size_t size_bytes,
+                           Clock clock)
+    : path_(path),
+      capacity_(size_bytes > sizeof(Header) ?
+                (size_bytes - sizeof(Header)) / sizeof(Record) : 0),
+      clock_(clock),
+      mapped_size_(0),
+      header_(nullptr),
+      records_(nullptr),
+      next_slot_(0),
+      next_sequence_(1) {
+}
+
+EventHistory::~EventHistory() {
+  Close();
+}
+
+bool EventHistory::Open() {
+  static_assert(sizeof(Header) == sizeof(Record),
+                "Header must keep the records aligned");
+  if (IsOpen()) {
+    return true;
+  }
+  if (capacity_ == 0) {
+    LOG(ERROR) << "Event history " << path_ << " is too small";
+    return false;
+  }
+  fd_.reset(TEMP_FAILURE_RETRY(
+      open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)));
+  if (fd_.get() < 0) {
+    PLOG(ERROR) << "Failed to open event history " << path_;
+    return false;
+  }
+  size_t size = sizeof(Header) + capacity_ * sizeof(Record);
+  struct stat file_stat;
+  if (fstat(fd_.get(), &file_stat) != 0) {
+    PLOG(ERROR) << "Failed to stat event history " << path_;
+    fd_.reset();
+    return false;
+  }
+  bool size_changed = static_cast<size_t>(file_stat.st_size) != size;
+  if (size_changed && ftruncate(fd_.get(), size) != 0) {
+    PLOG(ERROR) << "Failed to resize event history " << path_;
+    fd_.reset();
+    return false;
+  }
+  void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd_.get(), 0);
+  if (mapped == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map event history " << path_;
+    fd_.reset();
+    return false;
+  }
+  mapped_size_ = size;
+  header_ = static_cast<Header*>(mapped);
+  records_ = reinterpret_cast<Record*>(static_cast<uint8_t*>(mapped) +
+                                       sizeof(Header));
+  if (size_changed ||
+      header_->magic != kMagic ||
+      header_->version != kVersion ||
+      header_->record_size != sizeof(Record) ||
+      header_->capacity != capacity_) {
+    LOG(INFO) << "Resetting event history " << path_;
+    Reset();
+    return true;
+  }
+  // Carry on after the newest valid record.
+  uint32_t last_sequence = 0;
+  for (size_t i = 0; i < capacity_; i++) {
+    const Record& record = records_[i];
+    if (record.sequence > last_sequence &&
+        record.checksum == GetChecksum(record)) {
+      last_sequence = record.sequence;
+      next_slot_ = (i + 1) % capacity_;
+    }
+  }
+  next_sequence_ = last_sequence + 1;
+  return true;
+}
+
+void EventHistory::Close() {
+  if (!IsOpen()) {
+    return;
+  }
+  munmap(header_, mapped_size_);
+  mapped_size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+  fd_.reset();
+}
+
+void EventHistory::Reset() {
+  memset(header_, 0, mapped_size_);
+  header_->magic = kMagic;
+  header_->version = kVersion;
+  header_->record_size = sizeof(Record);
+  header_->capacity = capacity_;
+  next_slot_ = 0;
+  next_sequence_ = 1;
+}
+
+void EventHistory::Append(Record* record) {
+  if (!IsOpen()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  record->sequence = next_sequence_++;
+  record->wall_time_ms = clock_();
+  record->checksum = GetChecksum(*record);
+  memcpy(&records_[next_slot_], record, sizeof(*record));
+  next_slot_ = (next_slot_ + 1) % capacity_;
+}
+
+void EventHistory::RecordScanTriggered(uint32_t interface_index,
+                                       uint32_t num_frequencies) {
+  Record record = {};
+  record.type = kScanTriggered;
+  record.interface_index = interface_index;
+  record.frequency = num_frequencies;
+  Append(&record);
+}
+
+void EventHistory::RecordScanDone(uint32_t interface_index, EventType type) {
+  Record record = {};
+  record.type = type;
+  record.interface_index = interface_index;
+  Append(&record);
+}
+
+void EventHistory::RecordBss(uint32_t interface_index,
+                             const MacAddress& bssid,
+                             const Ssid& ssid,
+                             uint32_t frequency,
+                             int32_t signal_mbm) {
+  Record record = {};
+  record.type = kBss;
+  record.interface_index = interface_index;
+  record.frequency = frequency;
+  record.value = signal_mbm;
+  memcpy(record.bssid, bssid.data(), sizeof(record.bssid));
+  record.ssid_size = std::min(ssid.size(), sizeof(record.ssid));
+  memcpy(record.ssid, ssid.data(), record.ssid_size);
+  Append(&record);
+}
+
+void EventHistory::RecordMlmeEvent(uint32_t interface_index,
+                                   uint8_t command,
+                                   const MacAddress& bssid,
+                                   uint16_t code) {
+  Record record = {};
+  record.type = kMlmeEvent;
+  record.command = command;
+  record.code = code;
+  record.interface_index = interface_index;
+  memcpy(record.bssid, bssid.data(), sizeof(record.bssid));
+  Append(&record);
+}
+
+void EventHistory::RecordRegChange(const string& country_code) {
+  Record record = {};
+  record.type = kRegChange;
+  record.ssid_size = std::min(country_code.size(), sizeof(record.ssid));
+  memcpy(record.ssid, country_code.data(), record.ssid_size);
+  Append(&record);
+}
+
+void EventHistory::RecordNetlinkError(uint8_t command,
+                                      int error_code,
+                                      uint16_t attribute_type) {
+  Record record = {};
+  record.type = kNetlinkError;
+  record.command = command;
+  record.code = attribute_type;
+  record.value = error_code;
+  Append(&record);
+}
+
+bool EventHistory::ReadFile(const string& path, vector<Record>* records) {
+  string contents;
+  if (!ReadFileToString(path, &contents)) {
+    PLOG(ERROR) << "Failed to read event history " << path;
+    return false;
+  }
+  Header header;
+  if (contents.size() < sizeof(header)) {
+    LOG(ERROR) << path << " is not an event history";
+    return false;
+  }
+  memcpy(&header, contents.data(), sizeof(header));
+  if (header.magic != kMagic ||
+      header.version != kVersion ||
+      header.record_size != sizeof(Record) ||
+      contents.size() != sizeof(header) + header.capacity * sizeof(Record)) {
+    LOG(ERROR) << path << " is not an event history of version " << kVersion;
+    return false;
+  }
+  size_t first = records->size();
+  for (size_t i = 0; i < header.capacity; i++) {
+    Record record;
+    memcpy(&record, contents.data() + sizeof(header) + i * sizeof(record),
+           sizeof(record));
+    if (record.sequence != 0 && record.checksum == GetChecksum(record)) {
+      records->push_back(record);
+    }
+  }
+  std::sort(records->begin() + first, records->end(),
+            [](const Record& a, const Record& b) {
+              return a.sequence < b.sequence;
+            });
+  return true;
+}
+
+string EventHistory::ToCsv(const Record& record) {
+  string csv;
+  StringAppendF(&csv, "%u,%llu,%s,%u,%u,%u,%u,%d,",
+                record.sequence,
+                static_cast<unsigned long long>(record.wall_time_ms),
+                EventTypeToString(record.type),
+                record.interface_index,
+                record.command,
+                record.code,
+                record.frequency,
+                record.value);
+  if (record.type == kBss || record.type == kMlmeEvent) {
+    StringAppendF(&csv, "%02x:%02x:%02x:%02x:%02x:%02x",
+                  record.bssid[0], record.bssid[1], record.bssid[2],
+                  record.bssid[3], record.bssid[4], record.bssid[5]);
+  }
+  csv += ',';
+  // SSIDs are quoted, and non printable bytes are escaped, so that any
+  // SSID fits in a CSV field.
+  csv += '"';
+  size_t ssid_size = std::min<size_t>(record.ssid_size, sizeof(record.ssid));
+  for (size_t i = 0; i < ssid_size; i++) {
+    uint8_t c = record.ssid[i];
+    if (c == '"') {
+      csv += "\"\"";
+    } else if (c >= 0x20 && c < 0x7f && c != '\\') {
+      csv += static_cast<char>(c);
+    } else {
+      StringAppendF(&csv, "\\x%02x", c);
+    }
+  }
+  csv += '"';
+  return csv;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_EVENT_HISTORY_H_
+#define WIFICOND_EVENT_HISTORY_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+#include "wificond/net/mac_address.h"
+#include "wificond/net/ssid.h"
+
+namespace android {
+namespace wificond {
+
+// History of what wificond saw, kept in a memory mapped ring file of fixed
+// size records, so that it can be analyzed after a connectivity incident,
+// a crash or a reboot.
+// Records carry a sequence number and a checksum. The file header is only
+// written when the file is created, so a crash in the middle of a write
+// loses at most the record being written, which fails its checksum.
+// When the ring is full, the oldest record is overwritten.
+// Once the history is open, events can be recorded from several threads.
+class EventHistory {
+ public:
+  // Returns the wall clock time in milliseconds.
+  typedef std::function<uint64_t()> Clock;
+
+  enum EventType : uint8_t {
+    // Kernel started a single scan.
+    kScanTriggered = 1,
+    // A single scan completed.
+    kScanResults = 2,
+    // A single scan was aborted.
+    kScanAborted = 3,
+    // A scheduled scan found results.
+    kSchedScanResults = 4,
+    // A BSS in a scan result dump.
+    kBss = 5,
+    // A connect, associate, roam, disconnect, deauthenticate or disassociate
+    // event.
+    kMlmeEvent = 6,
+    // The regulatory domain changed.
+    kRegChange = 7,
+    // Kernel rejected a request.
+    kNetlinkError = 8,
+  };
+
+  // A record of the file. Fields which don't apply to its type are 0.
+  struct Record {
+    // CRC-32 of the record, from |sequence| to the end.
+    uint32_t checksum;
+    // Starts from 1. 0 marks an empty slot.
+    uint32_t sequence;
+    uint64_t wall_time_ms;
+    uint8_t type;
+    // NL80211 command of a kMlmeEvent or a kNetlinkError.
+    uint8_t command;
+    // Status or reason code of a kMlmeEvent, or the offending attribute of a
+    // kNetlinkError.
+    uint16_t code;
+    uint32_t interface_index;
+    // Channel of a kBss, or number of channels of a kScanTriggered.
+    uint32_t frequency;
+    // Signal of a kBss, or the errno of a kNetlinkError.
+    int32_t value;
+    uint8_t bssid[MacAddress::kSize];
+    uint8_t ssid_size;
+    // Truncated SSID of a kBss, or the country code of a kRegChange.
+    uint8_t ssid[25];
+  };
+  static_assert(sizeof(Record) == 64, "Records must stay compact");
+
+  // Default size of the file, header included.
+  static const size_t kDefaultSizeBytes;
+
+  // Uses the system wall clock.
+  EventHistory(const std::string& path, size_t size_bytes);
+  EventHistory(const std::string& path, size_t size_bytes, Clock clock);
+  ~EventHistory();
+
+  // Maps the file, and finds where the last run stopped writing. A missing
+  // file or a file of another version or size is reset to an empty history.
+  // Returns false if the file can't be used.
+  bool Open();
+  bool IsOpen() const { return records_ != nullptr; }
+
+  void RecordScanTriggered(uint32_t interface_index, uint32_t num_frequencies);
+  void RecordScanDone(uint32_t interface_index, EventType type);
+  void RecordBss(uint32_t interface_index,
+                 const MacAddress& bssid,
+                 const Ssid& ssid,
+                 uint32_t frequency,
+                 int32_t signal_mbm);
+  void RecordMlmeEvent(uint32_t interface_index,
+                       uint8_t command,
+                       const MacAddress& bssid,
+                       uint16_t code);
+  void RecordRegChange(const std::string& country_code);
+  void RecordNetlinkError(uint8_t command,
+                          int error_code,
+                          uint16_t attribute_type);
+
+  // Reads the valid records of history file |path|, oldest first.
+  // This works on a file copied off the device.
+  // Returns false if |path| is not a history file.
+  static bool ReadFile(const std::string& path, std::vector<Record>* records);
+  // Column names of the CSV lines written by ToCsv().
+  static const char kCsvHeader[];
+  // Returns |record| as a CSV line, without line break.
+  static std::string ToCsv(const Record& record);
+
+ private:
+  struct Header;
+
+  void Append(Record* record);
+  void Reset();
+  void Close();
+
+  const std::string path_;
+  const size_t capacity_;
+  const Clock clock_;
+
+  android::base::unique_fd fd_;
+  size_t mapped_size_;
+  Header* header_;
+  Record* records_;
+  // Guards the records and the ring position, once the file is open.
+  std::mutex lock_;
+  // Slot of the next record.
+  size_t next_slot_;
+  uint32_t next_sequence_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventHistory);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_EVENT_HISTORY_H_
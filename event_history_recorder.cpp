@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/event_history_recorder.h"
+
+#include <linux/nl80211.h>
+
+#include "wificond/event_history.h"
+#include "wificond/net/mlme_event.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/scanning/scan_result.h"
+
+using com::android::server::wifi::wificond::NativeScanResult;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+using namespace std::placeholders;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const uint8_t kRecordedCommands[] = {
+    NL80211_CMD_TRIGGER_SCAN,
+    NL80211_CMD_NEW_SCAN_RESULTS,
+    NL80211_CMD_SCAN_ABORTED,
+    NL80211_CMD_SCHED_SCAN_RESULTS,
+    NL80211_CMD_CONNECT,
+    NL80211_CMD_ASSOCIATE,
+    NL80211_CMD_ROAM,
+    NL80211_CMD_DISCONNECT,
+    NL80211_CMD_DEAUTHENTICATE,
+    NL80211_CMD_DISASSOCIATE,
+    NL80211_CMD_REG_CHANGE,
+    NL80211_CMD_WIPHY_REG_CHANGE,
+};
+
+}  // namespace
+
+EventHistoryRecorder::EventHistoryRecorder(EventHistory* event_history,
+                                           NetlinkManager* netlink_manager,
+                                           ScanUtils* scan_utils)
+    : event_history_(event_history),
+      netlink_manager_(netlink_manager),
+      scan_utils_(scan_utils) {
+  for (uint8_t command : kRecordedCommands) {
+    subscriptions_.emplace_back(new NL80211EventSubscription());
+    netlink_manager_->SubscribeEvent(command,
+                                     NL80211EventDispatcher::kAnyInterface,
+                                     this,
+                                     subscriptions_.back().get());
+  }
+  scan_utils_->SubscribeScanResultsDumped(
+      std::bind(&EventHistoryRecorder::OnScanResultsDumped, this, _1, _2));
+  netlink_manager_->SubscribeRequestError(
+      std::bind(&EventHistoryRecorder::OnRequestError, this, _1, _2));
+}
+
+EventHistoryRecorder::~EventHistoryRecorder() {
+  netlink_manager_->UnsubscribeRequestError();
+  scan_utils_->UnsubscribeScanResultsDumped();
+}
+
+void EventHistoryRecorder::OnNL80211Event(const NL80211Event& event) {
+  switch (event.command) {
+    case NL80211_CMD_TRIGGER_SCAN: {
+      // Kernel leaves out the frequencies of scans on all channels.
+      vector<uint32_t> frequencies;
+      NL80211NestedAttr frequencies_attr(0);
+      if (event.packet.GetAttribute(NL80211_ATTR_SCAN_FREQUENCIES,
+                                    &frequencies_attr)) {
+        frequencies_attr.GetListOfAttributeValues(&frequencies);
+      }
+      event_history_->RecordScanTriggered(event.interface_index,
+                                          frequencies.size());
+      break;
+    }
+    case NL80211_CMD_NEW_SCAN_RESULTS:
+      event_history_->RecordScanDone(event.interface_index,
+                                     EventHistory::kScanResults);
+      break;
+    case NL80211_CMD_SCAN_ABORTED:
+      event_history_->RecordScanDone(event.interface_index,
+                                     EventHistory::kScanAborted);
+      break;
+    case NL80211_CMD_SCHED_SCAN_RESULTS:
+      event_history_->RecordScanDone(event.interface_index,
+                                     EventHistory::kSchedScanResults);
+      break;
+    case NL80211_CMD_REG_CHANGE:
+    case NL80211_CMD_WIPHY_REG_CHANGE: {
+      // Empty unless the regulatory domain pertains to a country.
+      string country_code;
+      event.packet.GetAttributeValue(NL80211_ATTR_REG_ALPHA2, &country_code);
+      event_history_->RecordRegChange(country_code);
+      break;
+    }
+    default:
+      OnMlmeEvent(event);
+      break;
+  }
+}
+
+void EventHistoryRecorder::OnMlmeEvent(const NL80211Event& event) {
+  MacAddress bssid;
+  uint16_t code = 0;
+  switch (event.command) {
+    case NL80211_CMD_CONNECT: {
+      unique_ptr<MlmeConnectEvent> connect_event =
+          MlmeConnectEvent::InitFromPacket(&event.packet);
+      if (connect_event != nullptr) {
+        bssid = connect_event->GetBSSID();
+        code = connect_event->GetStatusCode();
+      }
+      break;
+    }
+    case NL80211_CMD_ASSOCIATE: {
+      unique_ptr<MlmeAssociateEvent> associate_event =
+          MlmeAssociateEvent::InitFromPacket(&event.packet);
+      if (associate_event != nullptr) {
+        bssid = associate_event->GetBSSID();
+        code = associate_event->GetStatusCode();
+      }
+      break;
+    }
+    case NL80211_CMD_ROAM: {
+      unique_ptr<MlmeRoamEvent> roam_event =
+          MlmeRoamEvent::InitFromPacket(&event.packet);
+      if (roam_event != nullptr) {
+        bssid = roam_event->GetBSSID();
+        code = roam_event->GetStatusCode();
+      }
+      break;
+    }
+    case NL80211_CMD_DISCONNECT:
+      event.packet.GetAttributeValue(NL80211_ATTR_REASON_CODE, &code);
+      break;
+    default:
+      // Deauthentication and disassociation only carry the raw frame.
+      break;
+  }
+  event_history_->RecordMlmeEvent(event.interface_index, event.command, bssid,
+                                  code);
+}
+
+void EventHistoryRecorder::OnScanResultsDumped(
+    uint32_t interface_index,
+    const vector<NativeScanResult>& scan_results) {
+  for (const auto& scan_result : scan_results) {
+    event_history_->RecordBss(interface_index,
+                              scan_result.bssid,
+                              scan_result.ssid,
+                              scan_result.frequency,
+                              scan_result.signal_mbm);
+  }
+}
+
+void EventHistoryRecorder::OnRequestError(const NL80211Packet& request,
+                                          const NetlinkError& error) {
+  event_history_->RecordNetlinkError(request.GetCommand(),
+                                     error.error_code,
+                                     error.attribute_type);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_EVENT_HISTORY_RECORDER_H_
+#define WIFICOND_EVENT_HISTORY_RECORDER_H_
+
+#include <memory>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_event_dispatcher.h"
+#include "wificond/scanning/scan_utils.h"
+
+namespace android {
+namespace wificond {
+
+class EventHistory;
+
+// Writes the scan, MLME and regulatory events from kernel, the BSSs of scan
+// result dumps and the requests kernel rejected to an EventHistory.
+// This sees the events of all interfaces, so that no interface needs to know
+// about the history.
+class EventHistoryRecorder : public NL80211EventObserver {
+ public:
+  // Subscribes to |netlink_manager| and |scan_utils|, which must outlive
+  // this recorder.
+  EventHistoryRecorder(EventHistory* event_history,
+                       NetlinkManager* netlink_manager,
+                       ScanUtils* scan_utils);
+  ~EventHistoryRecorder() override;
+
+  void OnNL80211Event(const NL80211Event& event) override;
+
+ private:
+  void OnScanResultsDumped(
+      uint32_t interface_index,
+      const std::vector<
+          ::com::android::server::wifi::wificond::NativeScanResult>&
+          scan_results);
+  void OnRequestError(const NL80211Packet& request, const NetlinkError& error);
+  void OnMlmeEvent(const NL80211Event& event);
+
+  EventHistory* const event_history_;
+  NetlinkManager* const netlink_manager_;
+  ScanUtils* const scan_utils_;
+  std::vector<std::unique_ptr<NL80211EventSubscription>> subscriptions_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventHistoryRecorder);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_EVENT_HISTORY_RECORDER_H_
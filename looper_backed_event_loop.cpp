@@ -20,8 +20,17 @@
 #include <utils/Looper.h>
 #include <utils/Timers.h>
 
+#include "wificond/metrics_registry.h"
+
+using android::wificond::HistogramMetric;
+
 namespace {
 
+// Time spent running tasks and file descriptor callbacks. While one runs,
+// the others wait.
+HistogramMetric task_run_time_us("event_loop.task_run_time_us");
+HistogramMetric fd_callback_run_time_us("event_loop.fd_callback_run_time_us");
+
 class EventLoopCallback : public android::MessageHandler {
  public:
   explicit EventLoopCallback(const std::function<void()>& callback)
@@ -31,7 +40,10 @@ class EventLoopCallback : public android::MessageHandler {
   ~EventLoopCallback() override = default;
 
   virtual void handleMessage(const android::Message& message) {
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
     callback_();
+    task_run_time_us.Record(
+        ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - start_time));
   }
 
  private:
@@ -49,7 +61,10 @@ class WatchFdCallback : public android::LooperCallback {
   ~WatchFdCallback() override = default;
 
   virtual int handleEvent(int fd, int events, void* data) {
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
     callback_(fd);
+    fd_callback_run_time_us.Record(
+        ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - start_time));
     // Returning 1 means Looper keeps watching this file descriptor after
     // callback is called.
     // See Looper.h for details.
@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <sys/capability.h>
 
+#include <algorithm>
 #include <csignal>
 #include <memory>
 
@@ -32,14 +33,20 @@
 #include <utils/String16.h>
 #include <wifi_system/interface_tool.h>
 
+#include "wificond/event_history.h"
+#include "wificond/event_history_recorder.h"
 #include "wificond/ipc_constants.h"
 #include "wificond/looper_backed_event_loop.h"
 #include "wificond/net/netlink_manager.h"
 #include "wificond/net/netlink_utils.h"
+#include "wificond/scanning/bss_cache.h"
 #include "wificond/scanning/scan_utils.h"
 #include "wificond/server.h"
 
 using android::net::wifi::IWificond;
+using android::wificond::BssCache;
+using android::wificond::EventHistory;
+using android::wificond::EventHistoryRecorder;
 using android::wifi_system::HostapdManager;
 using android::wifi_system::InterfaceTool;
 using android::wifi_system::SupplicantManager;
@@ -48,6 +55,15 @@ using std::unique_ptr;
 
 namespace {
 
+const char kBssCacheEnabledProperty[] = "persist.wifi.wificond.bss_cache";
+const char kBssCachePath[] = "/data/misc/wifi/wificond_bss_cache";
+const char kEventHistoryEnabledProperty[] =
+    "persist.wifi.wificond.event_history";
+const char kEventHistoryPath[] = "/data/misc/wifi/wificond_event_history";
+// Number of binder threads. 0 serves binder calls on the event loop thread.
+const char kBinderThreadsProperty[] = "persist.wifi.wificond.binder_threads";
+constexpr int32_t kMaxBinderThreads = 8;
+
 class ScopedSignalHandler final {
  public:
   ScopedSignalHandler(android::wificond::LooperBackedEventLoop* event_loop) {
@@ -91,6 +107,14 @@ int SetupBinderOrCrash() {
   return binder_fd;
 }
 
+// Serves binder calls on a pool of |num_threads| threads, so that a slow
+// call on one interface doesn't hold up the calls on the others.
+void StartBinderThreadPool(int32_t num_threads) {
+  android::ProcessState::self()->setThreadPoolMaxThreadCount(num_threads);
+  android::IPCThreadState::self()->disableBackgroundScheduling(true);
+  android::ProcessState::self()->startThreadPool();
+}
+
 // Setup our interface to the hw Binder driver or die trying.
 int SetupHwBinderOrCrash() {
   int binder_fd = -1;
@@ -101,6 +125,34 @@ int SetupHwBinderOrCrash() {
   return binder_fd;
 }
 
+// Returns the BSS cache if it is enabled and can be used, or nullptr.
+unique_ptr<BssCache> CreateBssCache() {
+  if (!property_get_bool(kBssCacheEnabledProperty, false)) {
+    return nullptr;
+  }
+  unique_ptr<BssCache> bss_cache(
+      new BssCache(kBssCachePath, BssCache::kDefaultCapacity));
+  if (!bss_cache->Open()) {
+    LOG(ERROR) << "Failed to open BSS cache, scan results are not kept";
+    return nullptr;
+  }
+  return bss_cache;
+}
+
+// Returns the event history if it is enabled and can be used, or nullptr.
+unique_ptr<EventHistory> CreateEventHistory() {
+  if (!property_get_bool(kEventHistoryEnabledProperty, false)) {
+    return nullptr;
+  }
+  unique_ptr<EventHistory> event_history(
+      new EventHistory(kEventHistoryPath, EventHistory::kDefaultSizeBytes));
+  if (!event_history->Open()) {
+    LOG(ERROR) << "Failed to open event history, events are not kept";
+    return nullptr;
+  }
+  return event_history;
+}
+
 void RegisterServiceOrCrash(const android::sp<android::IBinder>& service) {
   android::sp<android::IServiceManager> sm = android::defaultServiceManager();
   CHECK_EQ(sm != NULL, true) << "Could not obtain IServiceManager";
@@ -127,11 +179,15 @@ int main(int argc, char** argv) {
       new android::wificond::LooperBackedEventLoop());
   ScopedSignalHandler scoped_signal_handler(event_dispatcher.get());
 
-  int binder_fd = SetupBinderOrCrash();
-  CHECK(event_dispatcher->WatchFileDescriptor(
-      binder_fd,
-      android::wificond::EventLoop::kModeInput,
-      &OnBinderReadReady)) << "Failed to watch binder FD";
+  int32_t num_binder_threads = std::min(
+      property_get_int32(kBinderThreadsProperty, 0), kMaxBinderThreads);
+  if (num_binder_threads <= 0) {
+    int binder_fd = SetupBinderOrCrash();
+    CHECK(event_dispatcher->WatchFileDescriptor(
+        binder_fd,
+        android::wificond::EventLoop::kModeInput,
+        &OnBinderReadReady)) << "Failed to watch binder FD";
+  }
 
   int hw_binder_fd = SetupHwBinderOrCrash();
   CHECK(event_dispatcher->WatchFileDescriptor(
@@ -139,20 +195,38 @@ int main(int argc, char** argv) {
       &OnHwBinderReadReady)) << "Failed to watch Hw Binder FD";
 
   android::wificond::NetlinkManager netlink_manager(event_dispatcher.get());
+  if (num_binder_threads > 0) {
+    // One synchronous socket per binder thread, and one for the event loop.
+    netlink_manager.SetMaxSyncSockets(num_binder_threads + 1);
+  }
   if (!netlink_manager.Start()) {
     LOG(ERROR) << "Failed to start netlink manager";
   }
   android::wificond::NetlinkUtils netlink_utils(&netlink_manager);
   android::wificond::ScanUtils scan_utils(&netlink_manager);
+  unique_ptr<BssCache> bss_cache = CreateBssCache();
+  unique_ptr<EventHistory> event_history = CreateEventHistory();
+  unique_ptr<EventHistoryRecorder> event_history_recorder;
+  if (event_history) {
+    event_history_recorder.reset(new EventHistoryRecorder(
+        event_history.get(), &netlink_manager, &scan_utils));
+  }
 
   unique_ptr<android::wificond::Server> server(new android::wificond::Server(
       unique_ptr<InterfaceTool>(new InterfaceTool),
       unique_ptr<SupplicantManager>(new SupplicantManager()),
       unique_ptr<HostapdManager>(new HostapdManager()),
       &netlink_utils,
-      &scan_utils));
+      &scan_utils,
+      bss_cache.get(),
+      event_dispatcher.get()));
   server->CleanUpSystemState();
   RegisterServiceOrCrash(server.get());
+  if (num_binder_threads > 0) {
+    LOG(INFO) << "Serving binder calls on " << num_binder_threads
+              << " threads";
+    StartBinderThreadPool(num_binder_threads);
+  }
 
   event_dispatcher->Poll();
   LOG(INFO) << "wificond is about to exit";
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/metrics_registry.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::endl;
+using std::string;
+using std::stringstream;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// log2(HistogramMetric::kNumSubBuckets).
+constexpr int kSubBucketBits = 2;
+
+}  // namespace
+
+constexpr size_t CounterMetric::kNumShards;
+constexpr int HistogramMetric::kNumSubBuckets;
+constexpr size_t HistogramMetric::kNumBuckets;
+
+int64_t MetricsRegistry::Snapshot::GetHistogramPercentile(
+    const string& name,
+    double percentile) const {
+  const auto it = histograms.find(name);
+  if (it == histograms.end() || it->second.count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(
+      std::ceil(it->second.count * std::min(percentile, 100.0) / 100));
+  uint64_t num_values = 0;
+  for (const auto& bucket : it->second.buckets) {
+    num_values += bucket.second;
+    if (num_values >= std::max<uint64_t>(rank, 1)) {
+      return bucket.first;
+    }
+  }
+  return it->second.buckets.rbegin()->first;
+}
+
+void MetricsRegistry::Snapshot::Dump(stringstream* ss) const {
+  for (const auto& counter : counters) {
+    *ss << "counter " << counter.first << ": " << counter.second << endl;
+  }
+  for (const auto& gauge : gauges) {
+    *ss << "gauge " << gauge.first << ": " << gauge.second << endl;
+  }
+  for (const auto& histogram : histograms) {
+    *ss << "histogram " << histogram.first
+        << ": count " << histogram.second.count
+        << ", sum " << histogram.second.sum
+        << ", p50 " << GetHistogramPercentile(histogram.first, 50)
+        << ", p99 " << GetHistogramPercentile(histogram.first, 99)
+        << ", buckets:";
+    for (const auto& bucket : histogram.second.buckets) {
+      *ss << " " << bucket.first << "=" << bucket.second;
+    }
+    *ss << endl;
+  }
+}
+
+MetricsRegistry::MetricsRegistry()
+    : head_(nullptr) {
+}
+
+MetricsRegistry* MetricsRegistry::GetDefault() {
+  static MetricsRegistry* registry = new MetricsRegistry();
+  return registry;
+}
+
+void MetricsRegistry::Register(Metric* metric) {
+  Metric* head = head_.load(std::memory_order_relaxed);
+  do {
+    metric->next_ = head;
+  } while (!head_.compare_exchange_weak(head, metric,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed));
+}
+
+MetricsRegistry::Snapshot MetricsRegistry::GetSnapshot() const {
+  Snapshot snapshot;
+  for (const Metric* metric = head_.load(std::memory_order_acquire);
+       metric != nullptr;
+       metric = metric->next_) {
+    metric->AddToSnapshot(&snapshot);
+  }
+  return snapshot;
+}
+
+void MetricsRegistry::Dump(stringstream* ss) const {
+  *ss << "------- Dump of metrics -------" << endl;
+  GetSnapshot().Dump(ss);
+  *ss << "------- Dump End -------" << endl;
+}
+
+Metric::Metric(const char* name, MetricsRegistry* registry)
+    : name_(name),
+      next_(nullptr) {
+  registry->Register(this);
+}
+
+CounterMetric::CounterMetric(const char* name, MetricsRegistry* registry)
+    : Metric(name, registry) {
+}
+
+uint64_t CounterMetric::GetValue() const {
+  uint64_t value = 0;
+  for (const Shard& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+size_t CounterMetric::GetShardIndex() {
+  static std::atomic<size_t> next_shard_index(0);
+  thread_local size_t shard_index =
+      next_shard_index.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+  return shard_index;
+}
+
+void CounterMetric::AddToSnapshot(MetricsRegistry::Snapshot* snapshot) const {
+  // Metrics of the same name are added up.
+  snapshot->counters[GetName()] += GetValue();
+}
+
+GaugeMetric::GaugeMetric(const char* name, MetricsRegistry* registry)
+    : Metric(name, registry),
+      value_(0) {
+}
+
+void GaugeMetric::AddToSnapshot(MetricsRegistry::Snapshot* snapshot) const {
+  snapshot->gauges[GetName()] += GetValue();
+}
+
+HistogramMetric::HistogramMetric(const char* name, MetricsRegistry* registry)
+    : Metric(name, registry),
+      sum_(0) {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void HistogramMetric::Record(int64_t value) {
+  value = std::max<int64_t>(value, 0);
+  buckets_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+size_t HistogramMetric::GetBucketIndex(int64_t value) {
+  if (value < kNumSubBuckets) {
+    return std::max<int64_t>(value, 0);
+  }
+  // Index of the highest bit set, which is at least kSubBucketBits.
+  int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+  size_t sub_bucket = (value >> (exponent - kSubBucketBits)) &
+                      (kNumSubBuckets - 1);
+  return (exponent - kSubBucketBits + 1) * kNumSubBuckets + sub_bucket;
+}
+
+int64_t HistogramMetric::GetBucketLowerBound(size_t index) {
+  if (index < static_cast<size_t>(kNumSubBuckets)) {
+    return index;
+  }
+  int exponent = index / kNumSubBuckets + kSubBucketBits - 1;
+  int64_t sub_bucket = index % kNumSubBuckets;
+  return (kNumSubBuckets + sub_bucket) << (exponent - kSubBucketBits);
+}
+
+void HistogramMetric::AddToSnapshot(
+    MetricsRegistry::Snapshot* snapshot) const {
+  MetricsRegistry::Snapshot::HistogramValue& histogram =
+      snapshot->histograms[GetName()];
+  // A zero-initialized value is inserted for a new name.
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    uint64_t count = buckets_[i].load(std::memory_order_relaxed);
+    if (count == 0) {
+      continue;
+    }
+    histogram.buckets[GetBucketLowerBound(i)] += count;
+    histogram.count += count;
+  }
+  histogram.sum += sum_.load(std::memory_order_relaxed);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_METRICS_REGISTRY_H_
+#define WIFICOND_METRICS_REGISTRY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+class Metric;
+
+// Named counters, gauges and histograms of wificond.
+// Metrics are usually defined at namespace scope in the file which updates
+// them, and they register themselves with the default registry when they
+// are constructed:
+//
+//   CounterMetric num_foo_requests("foo.requests");
+//   ...
+//   num_foo_requests.Increment();
+//
+// Updating a metric and taking a snapshot never block. A snapshot is not
+// atomic across metrics, so related metrics may be off by the updates which
+// ran concurrently with it.
+// A metric must outlive the registry it is registered with, which is the
+// case of metrics of static storage duration and the default registry.
+class MetricsRegistry {
+ public:
+  struct Snapshot {
+    struct HistogramValue {
+      uint64_t count;
+      int64_t sum;
+      // A mapping from the lower bound of a bucket to the number of values
+      // in it. Empty buckets are omitted.
+      std::map<int64_t, uint64_t> buckets;
+    };
+
+    // Returns the value of histogram |name| which |percentile| percent of
+    // its values are below, as the lower bound of its bucket.
+    // Returns 0 if there is no such histogram or it has no value.
+    int64_t GetHistogramPercentile(const std::string& name,
+                                   double percentile) const;
+    // Writes one line per metric, ordered by name.
+    void Dump(std::stringstream* ss) const;
+
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, int64_t> gauges;
+    std::map<std::string, HistogramValue> histograms;
+  };
+
+  MetricsRegistry();
+  ~MetricsRegistry() = default;
+
+  // Returns the registry which metrics register with by default.
+  // It is created on first use and never destroyed, so that metrics can be
+  // registered by static initializers in any order.
+  static MetricsRegistry* GetDefault();
+
+  // Adds |metric| to this registry. Called by the constructor of Metric.
+  void Register(Metric* metric);
+  Snapshot GetSnapshot() const;
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  // Metrics are only ever added, at the head of this list.
+  std::atomic<Metric*> head_;
+
+  DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+class Metric {
+ public:
+  virtual ~Metric() = default;
+
+  const std::string& GetName() const { return name_; }
+
+ protected:
+  Metric(const char* name, MetricsRegistry* registry);
+
+ private:
+  friend class MetricsRegistry;
+
+  // Adds the current value of this metric to |snapshot|.
+  virtual void AddToSnapshot(MetricsRegistry::Snapshot* snapshot) const = 0;
+
+  const std::string name_;
+  // Next metric of the registry.
+  Metric* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(Metric);
+};
+
+// A count which only goes up, such as the number of requests.
+// Increments from different threads go to different cache lines, so that
+// threads updating the same counter don't contend with each other.
+class CounterMetric : public Metric {
+ public:
+  explicit CounterMetric(
+      const char* name,
+      MetricsRegistry* registry = MetricsRegistry::GetDefault());
+  ~CounterMetric() override = default;
+
+  void Increment() { Add(1); }
+  void Add(uint64_t value) {
+    shards_[GetShardIndex()].value.fetch_add(value,
+                                             std::memory_order_relaxed);
+  }
+  uint64_t GetValue() const;
+
+  // Number of cache lines a counter is split into.
+  static constexpr size_t kNumShards = 8;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  // Returns the shard of the calling thread. Threads are assigned shards
+  // in turn on their first increment.
+  static size_t GetShardIndex();
+  void AddToSnapshot(MetricsRegistry::Snapshot* snapshot) const override;
+
+  Shard shards_[kNumShards];
+
+  DISALLOW_COPY_AND_ASSIGN(CounterMetric);
+};
+
+// A value which goes up and down, such as the number of interfaces.
+class GaugeMetric : public Metric {
+ public:
+  explicit GaugeMetric(
+      const char* name,
+      MetricsRegistry* registry = MetricsRegistry::GetDefault());
+  ~GaugeMetric() override = default;
+
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  void Add(int64_t delta) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  int64_t GetValue() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  void AddToSnapshot(MetricsRegistry::Snapshot* snapshot) const override;
+
+  std::atomic<int64_t> value_;
+
+  DISALLOW_COPY_AND_ASSIGN(GaugeMetric);
+};
+
+// A distribution of non-negative values, such as latencies.
+// Buckets are log-linear: values below kNumSubBuckets have a bucket each,
+// and every power of two above is split into kNumSubBuckets buckets of equal
+// width. So a value is counted in a bucket whose lower bound is within 25%
+// of it, whatever its magnitude. Negative values are counted as 0.
+class HistogramMetric : public Metric {
+ public:
+  static constexpr int kNumSubBuckets = 4;
+  // Enough buckets for any non-negative int64_t.
+  static constexpr size_t kNumBuckets = 62 * kNumSubBuckets;
+
+  explicit HistogramMetric(
+      const char* name,
+      MetricsRegistry* registry = MetricsRegistry::GetDefault());
+  ~HistogramMetric() override = default;
+
+  void Record(int64_t value);
+
+  static size_t GetBucketIndex(int64_t value);
+  static int64_t GetBucketLowerBound(size_t index);
+
+ private:
+  void AddToSnapshot(MetricsRegistry::Snapshot* snapshot) const override;
+
+  std::atomic<uint64_t> buckets_[kNumBuckets];
+  std::atomic<int64_t> sum_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramMetric);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_METRICS_REGISTRY_H_
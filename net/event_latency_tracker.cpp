@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/event_latency_tracker.h"
+
+#include <algorithm>
+#include <string>
+
+#include <android-base/logging.h>
+
+using std::endl;
+using std::stringstream;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int64_t kNanoSecondsPerMicroSecond = 1000;
+
+}  // namespace
+
+constexpr size_t EventLatencyTracker::kNumBuckets;
+const int64_t EventLatencyTracker::kBucketUpperBoundsUs[kNumBuckets - 1] = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 500000};
+const int64_t EventLatencyTracker::kUnknownQueueWait = -1;
+const int64_t EventLatencyTracker::kDefaultSlowEventThresholdNs = 50000000;
+const size_t EventLatencyTracker::kMaxSlowEvents = 16;
+
+EventLatencyTracker::Histogram::Histogram()
+    : counts(),
+      num_events(0),
+      total_ns(0),
+      max_ns(0) {
+}
+
+EventLatencyTracker::EventLatencyTracker()
+    : EventLatencyTracker(kDefaultSlowEventThresholdNs) {
+}
+
+EventLatencyTracker::EventLatencyTracker(int64_t slow_event_threshold_ns)
+    : slow_event_threshold_ns_(slow_event_threshold_ns) {
+}
+
+void EventLatencyTracker::OnEventHandled(uint8_t command,
+                                         uint32_t interface_index,
+                                         int64_t queue_wait_ns,
+                                         int64_t handling_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  CommandStats& stats = command_stats_[command];
+  if (queue_wait_ns != kUnknownQueueWait) {
+    AddToHistogram(queue_wait_ns, &stats.queue_wait);
+  }
+  AddToHistogram(handling_ns, &stats.handling);
+  if (queue_wait_ns < slow_event_threshold_ns_ &&
+      handling_ns < slow_event_threshold_ns_) {
+    return;
+  }
+  LOG(WARNING) << "Slow NL80211 event " << static_cast<int>(command)
+               << " of interface " << interface_index << ": queue wait "
+               << (queue_wait_ns == kUnknownQueueWait ?
+                   "unknown" :
+                   std::to_string(queue_wait_ns / kNanoSecondsPerMicroSecond) +
+                       " us")
+               << ", handling " << handling_ns / kNanoSecondsPerMicroSecond
+               << " us";
+  if (slow_events_.size() == kMaxSlowEvents) {
+    slow_events_.pop_front();
+  }
+  slow_events_.push_back(
+      {command, interface_index, queue_wait_ns, handling_ns});
+}
+
+EventLatencyTracker::Histogram EventLatencyTracker::GetQueueWaitHistogram(
+    uint8_t command) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  const auto it = command_stats_.find(command);
+  return it == command_stats_.end() ? Histogram() : it->second.queue_wait;
+}
+
+EventLatencyTracker::Histogram EventLatencyTracker::GetHandlingHistogram(
+    uint8_t command) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  const auto it = command_stats_.find(command);
+  return it == command_stats_.end() ? Histogram() : it->second.handling;
+}
+
+vector<EventLatencyTracker::SlowEvent>
+EventLatencyTracker::GetSlowEvents() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return vector<SlowEvent>(slow_events_.begin(), slow_events_.end());
+}
+
+void EventLatencyTracker::AddToHistogram(int64_t latency_ns,
+                                         Histogram* histogram) {
+  // The wall clock may have been set back since kernel queued the event.
+  latency_ns = std::max<int64_t>(latency_ns, 0);
+  size_t bucket = std::upper_bound(kBucketUpperBoundsUs,
+                                   kBucketUpperBoundsUs + kNumBuckets - 1,
+                                   latency_ns / kNanoSecondsPerMicroSecond) -
+                  kBucketUpperBoundsUs;
+  histogram->counts[bucket]++;
+  histogram->num_events++;
+  histogram->total_ns += latency_ns;
+  histogram->max_ns = std::max(histogram->max_ns, latency_ns);
+}
+
+void EventLatencyTracker::DumpHistogram(const Histogram& histogram,
+                                        stringstream* ss) {
+  *ss << "count: " << histogram.num_events;
+  if (histogram.num_events == 0) {
+    return;
+  }
+  *ss << ", mean (us): "
+      << histogram.total_ns / static_cast<int64_t>(histogram.num_events) /
+             kNanoSecondsPerMicroSecond
+      << ", max (us): " << histogram.max_ns / kNanoSecondsPerMicroSecond
+      << ", buckets:";
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    *ss << " " << histogram.counts[i];
+  }
+}
+
+void EventLatencyTracker::Dump(stringstream* ss) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  *ss << "NL80211 event latency buckets (us): <";
+  for (size_t i = 0; i < kNumBuckets - 1; i++) {
+    *ss << kBucketUpperBoundsUs[i] << ", <";
+  }
+  *ss << "inf" << endl;
+  for (const auto& it : command_stats_) {
+    *ss << "NL80211 event " << static_cast<int>(it.first)
+        << " queue wait ";
+    DumpHistogram(it.second.queue_wait, ss);
+    *ss << endl;
+    *ss << "NL80211 event " << static_cast<int>(it.first)
+        << " handling ";
+    DumpHistogram(it.second.handling, ss);
+    *ss << endl;
+  }
+  *ss << "Slow NL80211 events (over "
+      << slow_event_threshold_ns_ / kNanoSecondsPerMicroSecond
+      << " us): " << slow_events_.size() << endl;
+  for (const auto& slow_event : slow_events_) {
+    *ss << "  event " << static_cast<int>(slow_event.command)
+        << " of interface " << slow_event.interface_index << ": queue wait ";
+    if (slow_event.queue_wait_ns == kUnknownQueueWait) {
+      *ss << "unknown";
+    } else {
+      *ss << slow_event.queue_wait_ns / kNanoSecondsPerMicroSecond << " us";
+    }
+    *ss << ", handling "
+        << slow_event.handling_ns / kNanoSecondsPerMicroSecond << " us"
+        << endl;
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
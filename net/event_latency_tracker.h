@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_EVENT_LATENCY_TRACKER_H_
+#define WIFICOND_NET_EVENT_LATENCY_TRACKER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// Latency of the NL80211 events received on the event socket, per event
+// command. It is split into:
+// - queue wait: from kernel queuing the event on the socket to wificond
+//   starting to handle it. This is only known when kernel timestamps the
+//   datagrams of the socket.
+// - handling time: from wificond starting to handle the event to all its
+//   handlers returning.
+// Each is counted in a histogram. Events which waited or took longer than a
+// threshold are logged, and the latest of them are kept for dumps.
+// This is thread-safe.
+class EventLatencyTracker {
+ public:
+  // Number of histogram buckets. Bucket i counts latencies shorter than
+  // kBucketUpperBoundsUs[i], and the last bucket counts all longer ones.
+  static constexpr size_t kNumBuckets = 9;
+  static const int64_t kBucketUpperBoundsUs[kNumBuckets - 1];
+  // Queue wait of events which kernel didn't timestamp.
+  static const int64_t kUnknownQueueWait;
+  static const int64_t kDefaultSlowEventThresholdNs;
+  // Number of slow events kept. Older ones are dropped.
+  static const size_t kMaxSlowEvents;
+
+  struct Histogram {
+    Histogram();
+    uint64_t counts[kNumBuckets];
+    uint64_t num_events;
+    int64_t total_ns;
+    int64_t max_ns;
+  };
+
+  struct SlowEvent {
+    uint8_t command;
+    uint32_t interface_index;
+    // kUnknownQueueWait if kernel didn't timestamp the event.
+    int64_t queue_wait_ns;
+    int64_t handling_ns;
+  };
+
+  // Uses the default threshold.
+  EventLatencyTracker();
+  explicit EventLatencyTracker(int64_t slow_event_threshold_ns);
+
+  // Records that an event of |command| for |interface_index| waited
+  // |queue_wait_ns| in the socket queue, and took |handling_ns| to handle.
+  void OnEventHandled(uint8_t command,
+                      uint32_t interface_index,
+                      int64_t queue_wait_ns,
+                      int64_t handling_ns);
+
+  Histogram GetQueueWaitHistogram(uint8_t command) const;
+  Histogram GetHandlingHistogram(uint8_t command) const;
+  // Returns the latest slow events, oldest first.
+  std::vector<SlowEvent> GetSlowEvents() const;
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  struct CommandStats {
+    Histogram queue_wait;
+    Histogram handling;
+  };
+
+  static void AddToHistogram(int64_t latency_ns, Histogram* histogram);
+  static void DumpHistogram(const Histogram& histogram,
+                            std::stringstream* ss);
+
+  const int64_t slow_event_threshold_ns_;
+  mutable std::mutex lock_;
+  // A mapping from NL80211 command to the latencies of its events.
+  std::map<uint8_t, CommandStats> command_stats_;
+  std::deque<SlowEvent> slow_events_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventLatencyTracker);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_EVENT_LATENCY_TRACKER_H_
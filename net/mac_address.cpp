@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/mac_address.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+constexpr size_t MacAddress::kSize;
+
+bool MacAddress::FromBytes(const uint8_t* data, size_t size, MacAddress* out) {
+  if (size != kSize) {
+    return false;
+  }
+  memcpy(out->bytes_.data(), data, kSize);
+  return true;
+}
+
+bool MacAddress::FromBytes(const vector<uint8_t>& bytes, MacAddress* out) {
+  return FromBytes(bytes.data(), bytes.size(), out);
+}
+
+vector<uint8_t> MacAddress::ToBytes() const {
+  return vector<uint8_t>(bytes_.begin(), bytes_.end());
+}
+
+string MacAddress::ToString() const {
+  char buffer[3 * kSize];
+  snprintf(buffer, sizeof(buffer), "%02x:%02x:%02x:%02x:%02x:%02x",
+           bytes_[0], bytes_[1], bytes_[2], bytes_[3], bytes_[4], bytes_[5]);
+  return string(buffer);
+}
+
+bool MacAddress::IsZero() const {
+  for (uint8_t b : bytes_) {
+    if (b != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t MacAddress::Hash() const {
+  uint64_t value = 0;
+  for (uint8_t b : bytes_) {
+    value = (value << 8) | b;
+  }
+  return std::hash<uint64_t>()(value);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_MAC_ADDRESS_H_
+#define WIFICOND_NET_MAC_ADDRESS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace android {
+namespace wificond {
+
+// A 48 bit IEEE 802 MAC address, such as an interface address or a BSSID.
+// This is a trivially copyable value type, so it can be stored and passed
+// around without heap allocations. Byte vectors are only used at the binder
+// boundary, see FromBytes() and ToBytes().
+class MacAddress {
+ public:
+  static constexpr size_t kSize = 6;
+
+  // Creates the all zero address, which is used for 'no address'.
+  constexpr MacAddress() : bytes_{} {}
+  explicit constexpr MacAddress(const std::array<uint8_t, kSize>& bytes)
+      : bytes_(bytes) {}
+
+  // Copies an address from |size| bytes at |data|.
+  // Returns false if |size| is not the size of a MAC address.
+  static bool FromBytes(const uint8_t* data, size_t size, MacAddress* out);
+  static bool FromBytes(const std::vector<uint8_t>& bytes, MacAddress* out);
+
+  std::vector<uint8_t> ToBytes() const;
+  // Returns the address in the colon separated form, e.g. 12:ef:a1:2c:97:8b.
+  std::string ToString() const;
+
+  bool IsZero() const;
+  const uint8_t* data() const { return bytes_.data(); }
+  constexpr size_t size() const { return kSize; }
+  size_t Hash() const;
+
+  bool operator==(const MacAddress& other) const {
+    return bytes_ == other.bytes_;
+  }
+  bool operator!=(const MacAddress& other) const {
+    return bytes_ != other.bytes_;
+  }
+  bool operator<(const MacAddress& other) const {
+    return bytes_ < other.bytes_;
+  }
+
+ private:
+  std::array<uint8_t, kSize> bytes_;
+};
+
+static_assert(std::is_trivially_copyable<MacAddress>::value,
+              "MacAddress must be trivially copyable");
+static_assert(sizeof(MacAddress) == MacAddress::kSize,
+              "MacAddress must not have padding");
+
+}  // namespace wificond
+}  // namespace android
+
+namespace std {
+
+template <>
+struct hash<android::wificond::MacAddress> {
+  size_t operator()(const android::wificond::MacAddress& address) const {
+    return address.Hash();
+  }
+};
+
+}  // namespace std
+
+#endif  // WIFICOND_NET_MAC_ADDRESS_H_
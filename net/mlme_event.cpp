@@ -16,16 +16,14 @@
 
 #include "wificond/net/mlme_event.h"
 
-#include <vector>
-
 #include <linux/nl80211.h>
 
 #include <android-base/logging.h>
 
+#include "wificond/net/nl80211_attribute.h"
 #include "wificond/net/nl80211_packet.h"
 
 using std::unique_ptr;
-using std::vector;
 
 namespace android {
 namespace wificond {
@@ -34,7 +32,7 @@ namespace {
 
 bool GetCommonFields(const NL80211Packet* packet,
                      uint32_t* if_index,
-                     vector<uint8_t>* bssid) {
+                     MacAddress* bssid) {
   if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, if_index)) {
      LOG(ERROR) << "Failed to get NL80211_ATTR_IFINDEX";
      return false;
@@ -141,5 +139,80 @@ unique_ptr<MlmeDisassociateEvent> MlmeDisassociateEvent::InitFromPacket(
   return disassociate_event;
 }
 
+unique_ptr<MlmeCqmEvent> MlmeCqmEvent::InitFromPacket(
+    const NL80211Packet* packet) {
+  if (packet->GetCommand() != NL80211_CMD_NOTIFY_CQM) {
+    return nullptr;
+  }
+  unique_ptr<MlmeCqmEvent> cqm_event(new MlmeCqmEvent());
+  if (!GetCommonFields(packet,
+                       &(cqm_event->interface_index_),
+                       &(cqm_event->bssid_))){
+    return nullptr;
+  }
+  NL80211NestedAttr cqm(0);
+  if (!packet->GetAttribute(NL80211_ATTR_CQM, &cqm)) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_CQM";
+    return nullptr;
+  }
+  cqm_event->num_lost_packets_ = 0;
+  uint32_t rssi_event;
+  if (cqm.GetAttributeValue(NL80211_ATTR_CQM_RSSI_THRESHOLD_EVENT,
+                            &rssi_event)) {
+    switch (rssi_event) {
+      case NL80211_CQM_RSSI_THRESHOLD_EVENT_LOW:
+        cqm_event->type_ = kRssiThresholdLow;
+        break;
+      case NL80211_CQM_RSSI_THRESHOLD_EVENT_HIGH:
+        cqm_event->type_ = kRssiThresholdHigh;
+        break;
+      case NL80211_CQM_RSSI_BEACON_LOSS_EVENT:
+        // Older drivers report beacon loss as an RSSI event.
+        cqm_event->type_ = kBeaconLoss;
+        break;
+      default:
+        LOG(WARNING) << "Unknown CQM RSSI event: " << rssi_event;
+        return nullptr;
+    }
+    return cqm_event;
+  }
+  if (cqm.GetAttributeValue(NL80211_ATTR_CQM_PKT_LOSS_EVENT,
+                            &(cqm_event->num_lost_packets_))) {
+    cqm_event->type_ = kPacketLoss;
+    return cqm_event;
+  }
+  if (cqm.HasAttribute(NL80211_ATTR_CQM_BEACON_LOSS_EVENT)) {
+    cqm_event->type_ = kBeaconLoss;
+    return cqm_event;
+  }
+  // TX error rate events are not configured by wificond.
+  LOG(DEBUG) << "Ignoring CQM event of unknown type";
+  return nullptr;
+}
+
+unique_ptr<MlmeChannelSwitchEvent> MlmeChannelSwitchEvent::InitFromPacket(
+    const NL80211Packet* packet) {
+  if (packet->GetCommand() != NL80211_CMD_CH_SWITCH_NOTIFY) {
+    return nullptr;
+  }
+  unique_ptr<MlmeChannelSwitchEvent> channel_switch_event(
+      new MlmeChannelSwitchEvent());
+  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX,
+                                 &(channel_switch_event->interface_index_))) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_IFINDEX";
+    return nullptr;
+  }
+  if (!packet->GetAttributeValue(NL80211_ATTR_WIPHY_FREQ,
+                                 &(channel_switch_event->frequency_))) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_WIPHY_FREQ";
+    return nullptr;
+  }
+  if (!packet->GetAttributeValue(NL80211_ATTR_CHANNEL_WIDTH,
+                                 &(channel_switch_event->channel_width_))) {
+    channel_switch_event->channel_width_ = NL80211_CHAN_WIDTH_20_NOHT;
+  }
+  return channel_switch_event;
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -18,10 +18,11 @@
 #define WIFICOND_NET_MLME_EVENT_H_
 
 #include <memory>
-#include <vector>
 
 #include <android-base/macros.h>
 
+#include "wificond/net/mac_address.h"
+
 namespace android {
 namespace wificond {
 
@@ -32,7 +33,7 @@ class MlmeConnectEvent {
   static std::unique_ptr<MlmeConnectEvent> InitFromPacket(
       const NL80211Packet* packet);
   // Returns the BSSID of the associated AP.
-  const std::vector<uint8_t>& GetBSSID() const { return bssid_; }
+  const MacAddress& GetBSSID() const { return bssid_; }
   // Get the status code of this connect event.
   // 0 = success, non-zero = failure.
   // Status codes definition: IEEE 802.11-2012, 8.4.1.9, Table 8-37
@@ -44,7 +45,7 @@ class MlmeConnectEvent {
   MlmeConnectEvent() = default;
 
   uint32_t interface_index_;
-  std::vector<uint8_t> bssid_;
+  MacAddress bssid_;
   uint16_t status_code_;
   bool is_timeout_;
 
@@ -56,7 +57,7 @@ class MlmeAssociateEvent {
   static std::unique_ptr<MlmeAssociateEvent> InitFromPacket(
       const NL80211Packet* packet);
   // Returns the BSSID of the associated AP.
-  const std::vector<uint8_t>& GetBSSID() const { return bssid_; }
+  const MacAddress& GetBSSID() const { return bssid_; }
   // Get the status code of this associate event.
   // 0 = success, non-zero = failure.
   // Status codes definition: IEEE 802.11-2012, 8.4.1.9, Table 8-37
@@ -68,7 +69,7 @@ class MlmeAssociateEvent {
   MlmeAssociateEvent() = default;
 
   uint32_t interface_index_;
-  std::vector<uint8_t> bssid_;
+  MacAddress bssid_;
   uint16_t status_code_;
   bool is_timeout_;
 
@@ -80,7 +81,7 @@ class MlmeRoamEvent {
   static std::unique_ptr<MlmeRoamEvent> InitFromPacket(
       const NL80211Packet* packet);
   // Returns the BSSID of the associated AP.
-  const std::vector<uint8_t>& GetBSSID() const { return bssid_; }
+  const MacAddress& GetBSSID() const { return bssid_; }
   // Get the status code of this roam event.
   // 0 = success, non-zero = failure.
   // Status codes definition: IEEE 802.11-2012, 8.4.1.9, Table 8-37
@@ -91,7 +92,7 @@ class MlmeRoamEvent {
   MlmeRoamEvent() = default;
 
   uint32_t interface_index_;
-  std::vector<uint8_t> bssid_;
+  MacAddress bssid_;
   uint16_t status_code_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeRoamEvent);
@@ -107,7 +108,7 @@ class MlmeDisconnectEvent {
   MlmeDisconnectEvent() = default;
 
   uint32_t interface_index_;
-  std::vector<uint8_t> bssid_;
+  MacAddress bssid_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeDisconnectEvent);
 };
@@ -121,11 +122,66 @@ class MlmeDisassociateEvent {
   MlmeDisassociateEvent() = default;
 
   uint32_t interface_index_;
-  std::vector<uint8_t> bssid_;
+  MacAddress bssid_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeDisassociateEvent);
 };
 
+// A connection quality monitor notification.
+class MlmeCqmEvent {
+ public:
+  enum Type {
+    // RSSI fell below the configured threshold.
+    kRssiThresholdLow,
+    // RSSI rose above the configured threshold.
+    kRssiThresholdHigh,
+    // Several consecutive frames to |GetBSSID()| were not acknowledged.
+    kPacketLoss,
+    // Beacons of the associated AP were missed.
+    kBeaconLoss,
+  };
+
+  static std::unique_ptr<MlmeCqmEvent> InitFromPacket(
+      const NL80211Packet* packet);
+  Type GetType() const { return type_; }
+  // Returns the peer of a kPacketLoss event.
+  const MacAddress& GetBSSID() const { return bssid_; }
+  // Returns the number of lost packets of a kPacketLoss event.
+  uint32_t GetNumLostPackets() const { return num_lost_packets_; }
+  uint32_t GetInterfaceIndex() const { return interface_index_; }
+
+ private:
+  MlmeCqmEvent() = default;
+
+  uint32_t interface_index_;
+  MacAddress bssid_;
+  Type type_;
+  uint32_t num_lost_packets_;
+
+  DISALLOW_COPY_AND_ASSIGN(MlmeCqmEvent);
+};
+
+// Notifies that the associated AP moved the connection to another channel.
+class MlmeChannelSwitchEvent {
+ public:
+  static std::unique_ptr<MlmeChannelSwitchEvent> InitFromPacket(
+      const NL80211Packet* packet);
+  // Returns the new operating frequency in MHz.
+  uint32_t GetFrequency() const { return frequency_; }
+  // Returns one of |enum nl80211_chan_width|.
+  uint32_t GetChannelWidth() const { return channel_width_; }
+  uint32_t GetInterfaceIndex() const { return interface_index_; }
+
+ private:
+  MlmeChannelSwitchEvent() = default;
+
+  uint32_t interface_index_;
+  uint32_t frequency_;
+  uint32_t channel_width_;
+
+  DISALLOW_COPY_AND_ASSIGN(MlmeChannelSwitchEvent);
+};
+
 }  // namespace wificond
 }  // namespace android
 
@@ -35,6 +35,9 @@ class MlmeEventHandler {
   virtual void OnAssociate(std::unique_ptr<MlmeAssociateEvent> event) = 0;
   virtual void OnDisconnect(std::unique_ptr<MlmeDisconnectEvent> event) = 0;
   virtual void OnDisassociate(std::unique_ptr<MlmeDisassociateEvent> event) = 0;
+  virtual void OnCqm(std::unique_ptr<MlmeCqmEvent> event) = 0;
+  virtual void OnChannelSwitch(
+      std::unique_ptr<MlmeChannelSwitchEvent> event) = 0;
 
 };
 
@@ -16,6 +16,8 @@
 
 #include "net/netlink_manager.h"
 
+#include <algorithm>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -23,18 +25,22 @@
 #include <linux/nl80211.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <time.h>
 
 #include <android-base/logging.h>
 #include <utils/Timers.h>
 
 #include "net/mlme_event.h"
 #include "net/mlme_event_handler.h"
+#include "net/netlink_rate_limiter.h"
 #include "net/nl80211_attribute.h"
 #include "net/nl80211_packet.h"
+#include "wificond/metrics_registry.h"
 
 using android::base::unique_fd;
 using std::placeholders::_1;
 using std::string;
+using std::stringstream;
 using std::unique_ptr;
 using std::vector;
 
@@ -47,7 +53,17 @@ namespace {
 constexpr int kReceiveBufferSize = 8 * 1024;
 constexpr uint32_t kBroadcastSequenceNumber = 0;
 constexpr int kMaximumNetlinkMessageWaitMilliSeconds = 300;
-uint8_t ReceiveBuffer[kReceiveBufferSize];
+// Netlink socket options from linux/netlink.h.
+// They are defined here because older kernel headers don't have them.
+constexpr int kNetlinkCapAck = 10;  // NETLINK_CAP_ACK
+constexpr int kNetlinkExtAck = 11;  // NETLINK_EXT_ACK
+
+// Requests sent to kernel, and answered by the rate limiter instead.
+CounterMetric num_requests("netlink.requests");
+CounterMetric num_failed_requests("netlink.requests_failed");
+CounterMetric num_coalesced_requests("netlink.requests_coalesced");
+CounterMetric num_rejected_requests("netlink.requests_rejected");
+HistogramMetric request_latency_us("netlink.request_latency_us");
 
 void AppendPacket(vector<unique_ptr<const NL80211Packet>>* vec,
                   unique_ptr<const NL80211Packet> packet) {
@@ -56,36 +72,121 @@ void AppendPacket(vector<unique_ptr<const NL80211Packet>>* vec,
 
 }
 
+string NetlinkError::ToString() const {
+  stringstream ss;
+  ss << strerror(error_code);
+  if (!message.empty()) {
+    ss << ": " << message;
+  }
+  if (attribute_offset != 0) {
+    ss << " (attribute " << attribute_type
+       << " at offset " << attribute_offset << ")";
+  }
+  return ss.str();
+}
+
 NetlinkManager::NetlinkManager(EventLoop* event_loop)
     : started_(false),
+      num_sync_sockets_(0),
+      max_sync_sockets_(1),
       event_loop_(event_loop),
+      event_overrun_count_(0),
+      ack_bytes_saved_(0),
       sequence_number_(0) {
+  AddEventRoute(NL80211_CMD_NEW_SCAN_RESULTS,
+                &NetlinkManager::OnScanResultsReady);
+  // Scan was aborted, for unspecified reasons. Partial scan results may be
+  // available.
+  AddEventRoute(NL80211_CMD_SCAN_ABORTED, &NetlinkManager::OnScanResultsReady);
+  AddEventRoute(NL80211_CMD_SCHED_SCAN_RESULTS,
+                &NetlinkManager::OnSchedScanResultsReady);
+  AddEventRoute(NL80211_CMD_SCHED_SCAN_STOPPED,
+                &NetlinkManager::OnSchedScanResultsReady);
+  AddEventRoute(NL80211_CMD_CONNECT, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_ASSOCIATE, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_ROAM, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_DISCONNECT, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_DISASSOCIATE, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_NOTIFY_CQM, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_CH_SWITCH_NOTIFY, &NetlinkManager::OnMlmeEvent);
+  AddEventRoute(NL80211_CMD_REG_CHANGE, &NetlinkManager::OnRegChangeEvent);
+  AddEventRoute(NL80211_CMD_WIPHY_REG_CHANGE,
+                &NetlinkManager::OnRegChangeEvent);
+  AddEventRoute(NL80211_CMD_NEW_STATION, &NetlinkManager::OnStationEvent);
+  AddEventRoute(NL80211_CMD_DEL_STATION, &NetlinkManager::OnStationEvent);
 }
 
 NetlinkManager::~NetlinkManager() {
 }
 
 uint32_t NetlinkManager::GetSequenceNumber() {
-  if (++sequence_number_ == kBroadcastSequenceNumber) {
-    ++sequence_number_;
+  uint32_t sequence_number = ++sequence_number_;
+  if (sequence_number == kBroadcastSequenceNumber) {
+    sequence_number = ++sequence_number_;
   }
-  return sequence_number_;
+  return sequence_number;
+}
+
+std::recursive_mutex& NetlinkManager::GetInterfaceLock(
+    uint32_t interface_index) {
+  return interface_locks_[interface_index % kNumInterfaceLocks];
 }
 
 void NetlinkManager::ReceivePacketAndRunHandler(int fd) {
-  ssize_t len = read(fd, ReceiveBuffer, kReceiveBufferSize);
+  // Synchronous requests of other threads may be receiving at the same time.
+  uint8_t buffer[kReceiveBufferSize];
+  // Room for the SCM_TIMESTAMPNS message of the event socket.
+  uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+  struct iovec iov = {buffer, kReceiveBufferSize};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t len = TEMP_FAILURE_RETRY(recvmsg(fd, &msg, 0));
   if (len == -1) {
-    LOG(ERROR) << "Failed to read packet from buffer";
+    // Kernel reports ENOBUFS once it had to drop multicast messages because
+    // the socket receive buffer was full. The socket is still usable.
+    if (errno == ENOBUFS && fd == async_netlink_fd_.get()) {
+      OnEventOverrun();
+      return;
+    }
+    LOG(ERROR) << "Failed to read packet from buffer: " << strerror(errno);
     return;
   }
   if (len == 0) {
     return;
   }
+  int64_t kernel_time_ns = 0;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+       cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_TIMESTAMPNS &&
+        cmsg->cmsg_len >= CMSG_LEN(sizeof(struct timespec))) {
+      struct timespec kernel_time;
+      memcpy(&kernel_time, CMSG_DATA(cmsg), sizeof(kernel_time));
+      kernel_time_ns = seconds_to_nanoseconds(kernel_time.tv_sec) +
+                       kernel_time.tv_nsec;
+    }
+  }
+  HandleReceivedMessages(buffer, len, kernel_time_ns);
+}
+
+void NetlinkManager::HandleReceivedMessages(const uint8_t* buffer,
+                                            size_t len) {
+  HandleReceivedMessages(buffer, len, 0);
+}
+
+void NetlinkManager::HandleReceivedMessages(const uint8_t* buffer,
+                                            size_t len,
+                                            int64_t kernel_time_ns) {
   // There might be multiple message in one datagram payload.
-  uint8_t* ptr = ReceiveBuffer;
-  while (ptr < ReceiveBuffer + len) {
+  const uint8_t* ptr = buffer;
+  while (ptr < buffer + len) {
     // peek at the header.
-    if (ptr + sizeof(nlmsghdr) > ReceiveBuffer + len) {
+    if (ptr + sizeof(nlmsghdr) > buffer + len) {
       LOG(ERROR) << "payload is broken.";
       return;
     }
@@ -104,45 +205,71 @@ void NetlinkManager::ReceivePacketAndRunHandler(int fd) {
 
     // Handle multicasts.
     if (sequence_number == kBroadcastSequenceNumber) {
-      BroadcastHandler(std::move(packet));
+      BroadcastHandler(std::move(packet), kernel_time_ns);
       continue;
     }
 
-    auto itr = message_handlers_.find(sequence_number);
-    // There is no handler for this sequence number.
-    if (itr == message_handlers_.end()) {
-      LOG(WARNING) << "No handler for message: " << sequence_number;
-      return;
-    }
-    // A multipart message is terminated by NLMSG_DONE.
-    // In this case we don't need to run the handler.
-    // NLMSG_NOOP means no operation, message must be discarded.
-    uint32_t message_type =  packet->GetMessageType();
-    if (message_type == NLMSG_DONE || message_type == NLMSG_NOOP) {
-      message_handlers_.erase(itr);
-      return;
-    }
-    if (message_type == NLMSG_OVERRUN) {
-      LOG(ERROR) << "Get message overrun notification";
-      message_handlers_.erase(itr);
-      return;
-    }
+    std::function<void(unique_ptr<const NL80211Packet>)> handler;
+    {
+      std::lock_guard<std::mutex> lock(message_handlers_lock_);
+      auto itr = message_handlers_.find(sequence_number);
+      // There is no handler for this sequence number.
+      if (itr == message_handlers_.end()) {
+        LOG(WARNING) << "No handler for message: " << sequence_number;
+        return;
+      }
+      // A multipart message is terminated by NLMSG_DONE.
+      // In this case we don't need to run the handler.
+      // NLMSG_NOOP means no operation, message must be discarded.
+      uint32_t message_type =  packet->GetMessageType();
+      if (message_type == NLMSG_DONE || message_type == NLMSG_NOOP) {
+        message_handlers_.erase(itr);
+        return;
+      }
+      if (message_type == NLMSG_OVERRUN) {
+        LOG(ERROR) << "Get message overrun notification";
+        message_handlers_.erase(itr);
+        return;
+      }
 
-    // In case we receive a NLMSG_ERROR message:
-    // NLMSG_ERROR could be either an error or an ACK.
-    // It is an ACK message only when error code field is set to 0.
-    // An ACK could be return when we explicitly request that with NLM_F_ACK.
-    // An ERROR could be received on NLM_F_ACK or other failure cases.
-    // We should still run handler in this case, leaving it for the caller
-    // to decide what to do with the packet.
-
-    bool is_multi = packet->IsMulti();
-    // Run the handler.
-    itr->second(std::move(packet));
-    // Remove handler after processing.
-    if (!is_multi) {
-      message_handlers_.erase(itr);
+      // In case we receive a NLMSG_ERROR message:
+      // NLMSG_ERROR could be either an error or an ACK.
+      // It is an ACK message only when error code field is set to 0.
+      // An ACK could be return when we explicitly request that with
+      // NLM_F_ACK.
+      // An ERROR could be received on NLM_F_ACK or other failure cases.
+      // We should still run handler in this case, leaving it for the caller
+      // to decide what to do with the packet.
+
+      // The handler of a multipart message stays for the next parts.
+      // Others are removed, and they run without the lock held.
+      if (packet->IsMulti()) {
+        handler = itr->second;
+      } else {
+        handler = std::move(itr->second);
+        message_handlers_.erase(itr);
+      }
     }
+    handler(std::move(packet));
+  }
+}
+
+void NetlinkManager::OnEventOverrun() {
+  uint64_t event_overrun_count = ++event_overrun_count_;
+  rate_limiter_.InvalidateResponses();
+  LOG(WARNING) << "Kernel dropped NL80211 multicast events, overrun count: "
+               << event_overrun_count;
+  // Handlers may query kernel and (un)subscribe while running, so iterate
+  // over a copy.
+  std::map<uint32_t, OnEventOverrunHandler> handlers;
+  {
+    std::lock_guard<std::mutex> lock(handlers_lock_);
+    handlers = on_event_overrun_handler_;
+  }
+  for (auto& handler : handlers) {
+    std::lock_guard<std::recursive_mutex> interface_lock(
+        GetInterfaceLock(handler.first));
+    handler.second();
   }
 }
 
@@ -196,17 +323,19 @@ bool NetlinkManager::Start() {
     LOG(DEBUG) << "NetlinkManager is already started";
     return true;
   }
-  bool setup_rt = SetupSocket(&sync_netlink_fd_);
-  if (!setup_rt) {
+  unique_fd sync_netlink_fd = AcquireSyncSocket();
+  if (sync_netlink_fd.get() < 0) {
     LOG(ERROR) << "Failed to setup synchronous netlink socket";
     return false;
   }
+  ReleaseSyncSocket(std::move(sync_netlink_fd));
 
-  setup_rt = SetupSocket(&async_netlink_fd_);
+  bool setup_rt = SetupSocket(&async_netlink_fd_);
   if (!setup_rt) {
     LOG(ERROR) << "Failed to setup asynchronous netlink socket";
     return false;
   }
+  EnableTimestamps(async_netlink_fd_.get());
 
   // Request family id for nl80211 messages.
   if (!DiscoverFamilyId()) {
@@ -244,23 +373,66 @@ bool NetlinkManager::RegisterHandlerAndSendMessage(
     LOG(ERROR) << "Do not use asynchronous interface for dump request !";
     return false;
   }
+  // The reply may be received on the event loop thread as soon as the
+  // request is sent, so the handler is registered first.
+  {
+    std::lock_guard<std::mutex> lock(message_handlers_lock_);
+    message_handlers_[packet.GetMessageSequence()] = handler;
+  }
   if (!SendMessageInternal(packet, async_netlink_fd_.get())) {
+    EraseMessageHandler(packet.GetMessageSequence());
     return false;
   }
-  message_handlers_[packet.GetMessageSequence()] = handler;
   return true;
 }
 
 bool NetlinkManager::SendMessageAndGetResponses(
     const NL80211Packet& packet,
     vector<unique_ptr<const NL80211Packet>>* response) {
-  if (!SendMessageInternal(packet, sync_netlink_fd_.get())) {
+  NetlinkRateLimiter::Admission admission =
+      rate_limiter_.Admit(packet, response);
+  if (admission == NetlinkRateLimiter::kRejected) {
+    // |response| carries an EBUSY error, so that callers tell throttling
+    // apart from I/O failures.
+    num_rejected_requests.Increment();
+    return true;
+  }
+  if (admission == NetlinkRateLimiter::kCoalesced) {
+    num_coalesced_requests.Increment();
+    return true;
+  }
+  num_requests.Increment();
+  // This includes the wait for a socket while other threads use them all.
+  nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  unique_fd netlink_fd = AcquireSyncSocket();
+  if (netlink_fd.get() < 0) {
+    num_failed_requests.Increment();
+    return false;
+  }
+  bool success =
+      SendMessageAndReceiveResponses(packet, netlink_fd.get(), response);
+  ReleaseSyncSocket(std::move(netlink_fd));
+  request_latency_us.Record(
+      ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - start_time));
+  if (!success) {
+    num_failed_requests.Increment();
+    return false;
+  }
+  rate_limiter_.OnResponse(packet, *response);
+  return true;
+}
+
+bool NetlinkManager::SendMessageAndReceiveResponses(
+    const NL80211Packet& packet,
+    int fd,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  if (!SendMessageInternal(packet, fd)) {
     return false;
   }
   // Polling netlink socket, waiting for GetFamily reply.
   struct pollfd netlink_output;
   memset(&netlink_output, 0, sizeof(netlink_output));
-  netlink_output.fd = sync_netlink_fd_.get();
+  netlink_output.fd = fd;
   netlink_output.events = POLLIN;
 
   uint32_t sequence = packet.GetMessageSequence();
@@ -270,10 +442,12 @@ bool NetlinkManager::SendMessageAndGetResponses(
   // NLMSG_DONE message.
   // ReceivePacketAndRunHandler() will remove the handler after receiving a
   // NLMSG_DONE message.
-  message_handlers_[sequence] = std::bind(AppendPacket, response, _1);
+  {
+    std::lock_guard<std::mutex> lock(message_handlers_lock_);
+    message_handlers_[sequence] = std::bind(AppendPacket, response, _1);
+  }
 
-  while (time_remaining > 0 &&
-      message_handlers_.find(sequence) != message_handlers_.end()) {
+  while (time_remaining > 0 && HasMessageHandler(sequence)) {
     nsecs_t interval = systemTime(SYSTEM_TIME_MONOTONIC);
     int poll_return = poll(&netlink_output,
                            1,
@@ -281,25 +455,72 @@ bool NetlinkManager::SendMessageAndGetResponses(
 
     if (poll_return == 0) {
       LOG(ERROR) << "Failed to poll netlink fd: time out ";
-      message_handlers_.erase(sequence);
+      EraseMessageHandler(sequence);
       return false;
     } else if (poll_return == -1) {
       LOG(ERROR) << "Failed to poll netlink fd: " << strerror(errno);
-      message_handlers_.erase(sequence);
+      EraseMessageHandler(sequence);
       return false;
     }
-    ReceivePacketAndRunHandler(sync_netlink_fd_.get());
+    ReceivePacketAndRunHandler(fd);
     interval = systemTime(SYSTEM_TIME_MONOTONIC) - interval;
     time_remaining -= static_cast<int>(ns2ms(interval));
   }
   if (time_remaining <= 0) {
     LOG(ERROR) << "Timeout waiting for netlink reply messages";
-    message_handlers_.erase(sequence);
+    EraseMessageHandler(sequence);
     return false;
   }
   return true;
 }
 
+unique_fd NetlinkManager::AcquireSyncSocket() {
+  std::unique_lock<std::mutex> lock(sync_sockets_lock_);
+  while (idle_sync_sockets_.empty() &&
+         num_sync_sockets_ >= max_sync_sockets_) {
+    sync_socket_released_.wait(lock);
+  }
+  if (!idle_sync_sockets_.empty()) {
+    unique_fd netlink_fd = std::move(idle_sync_sockets_.back());
+    idle_sync_sockets_.pop_back();
+    return netlink_fd;
+  }
+  // Count the new socket before it is set up, so that concurrent callers
+  // don't go over the maximum.
+  num_sync_sockets_++;
+  lock.unlock();
+  unique_fd netlink_fd;
+  if (!SetupSocket(&netlink_fd)) {
+    lock.lock();
+    num_sync_sockets_--;
+    sync_socket_released_.notify_one();
+    return unique_fd();
+  }
+  return netlink_fd;
+}
+
+void NetlinkManager::ReleaseSyncSocket(unique_fd netlink_fd) {
+  std::lock_guard<std::mutex> lock(sync_sockets_lock_);
+  idle_sync_sockets_.push_back(std::move(netlink_fd));
+  sync_socket_released_.notify_one();
+}
+
+void NetlinkManager::SetMaxSyncSockets(size_t max_sync_sockets) {
+  std::lock_guard<std::mutex> lock(sync_sockets_lock_);
+  max_sync_sockets_ = std::max<size_t>(max_sync_sockets, 1);
+  sync_socket_released_.notify_all();
+}
+
+bool NetlinkManager::HasMessageHandler(uint32_t sequence_number) {
+  std::lock_guard<std::mutex> lock(message_handlers_lock_);
+  return message_handlers_.find(sequence_number) != message_handlers_.end();
+}
+
+void NetlinkManager::EraseMessageHandler(uint32_t sequence_number) {
+  std::lock_guard<std::mutex> lock(message_handlers_lock_);
+  message_handlers_.erase(sequence_number);
+}
+
 bool NetlinkManager::SendMessageAndGetSingleResponse(
     const NL80211Packet& packet,
     unique_ptr<const NL80211Packet>* response) {
@@ -310,8 +531,9 @@ bool NetlinkManager::SendMessageAndGetSingleResponse(
   if (response_or_error->GetMessageType() == NLMSG_ERROR) {
     // We use ERROR because we are not expecting to receive a ACK here.
     // In that case the caller should use |SendMessageAndGetAckOrError|.
-    LOG(ERROR) << "Received error message: "
-               << strerror(response_or_error->GetErrorCode());
+    NetlinkError error;
+    ParseError(packet, *response_or_error, &error);
+    LOG(ERROR) << "Received error message: " << error.ToString();
     return false;
   }
   *response = std::move(response_or_error);
@@ -336,6 +558,16 @@ bool NetlinkManager::SendMessageAndGetSingleResponseOrError(
 
 bool NetlinkManager::SendMessageAndGetAckOrError(const NL80211Packet& packet,
                                                  int* error_code) {
+  NetlinkError error;
+  if (!SendMessageAndGetAckOrError(packet, &error)) {
+    return false;
+  }
+  *error_code = error.error_code;
+  return true;
+}
+
+bool NetlinkManager::SendMessageAndGetAckOrError(const NL80211Packet& packet,
+                                                 NetlinkError* error) {
   unique_ptr<const NL80211Packet> response;
   if (!SendMessageAndGetSingleResponseOrError(packet, &response)) {
     return false;
@@ -346,23 +578,58 @@ bool NetlinkManager::SendMessageAndGetAckOrError(const NL80211Packet& packet,
     return false;
   }
 
-  *error_code = response->GetErrorCode();
+  ParseError(packet, *response, error);
   return true;
 }
 
 bool NetlinkManager::SendMessageAndGetAck(const NL80211Packet& packet) {
-  int error_code;
-  if (!SendMessageAndGetAckOrError(packet, &error_code)) {
+  NetlinkError error;
+  if (!SendMessageAndGetAckOrError(packet, &error)) {
     return false;
   }
-  if (error_code != 0) {
-    LOG(ERROR) << "Received error messsage: " << strerror(error_code);
+  if (error.error_code != 0) {
+    LOG(ERROR) << "Received error messsage: " << error.ToString();
     return false;
   }
 
   return true;
 }
 
+void NetlinkManager::ParseError(const NL80211Packet& request,
+                                const NL80211Packet& response,
+                                NetlinkError* error) {
+  *error = NetlinkError();
+  error->error_code = response.GetErrorCode();
+  if (!response.GetExtendedAck(&error->message, &error->attribute_offset)) {
+    // Error code is still valid even if extended ACK is broken.
+    error->message.clear();
+    error->attribute_offset = 0;
+  }
+  const vector<uint8_t>& request_data = request.GetConstData();
+  if (error->attribute_offset >= NLMSG_HDRLEN &&
+      error->attribute_offset + NLA_HDRLEN <= request_data.size()) {
+    const nlattr* attribute = reinterpret_cast<const nlattr*>(
+        request_data.data() + error->attribute_offset);
+    error->attribute_type = attribute->nla_type & NLA_TYPE_MASK;
+  }
+  // ACKs never carry the original request. Error messages do, unless they
+  // are capped.
+  if (error->error_code != 0 && response.IsCapped()) {
+    ack_bytes_saved_ += request_data.size() - NLMSG_HDRLEN;
+  }
+  if (error->error_code == 0) {
+    return;
+  }
+  OnRequestErrorHandler handler;
+  {
+    std::lock_guard<std::mutex> lock(handlers_lock_);
+    handler = on_request_error_handler_;
+  }
+  if (handler) {
+    handler(request, *error);
+  }
+}
+
 bool NetlinkManager::SendMessageInternal(const NL80211Packet& packet, int fd) {
   const vector<uint8_t>& data = packet.GetConstData();
   ssize_t bytes_sent =
@@ -402,9 +669,43 @@ bool NetlinkManager::SetupSocket(unique_fd* netlink_fd) {
     LOG(ERROR) << "Failed to bind netlink socket: " << strerror(errno);
     return false;
   }
+  // Ask kernel not to echo the original request back in error messages,
+  // and to attach an error message and the offending attribute instead.
+  // Both are optional: older kernels don't support them, and we still get
+  // the error code in that case.
+  const int enable = 1;
+  if (setsockopt(netlink_fd->get(),
+                 SOL_NETLINK,
+                 kNetlinkCapAck,
+                 &enable,
+                 sizeof(enable)) < 0) {
+    LOG(WARNING) << "Failed to set NETLINK_CAP_ACK option: " << strerror(errno);
+  }
+  if (setsockopt(netlink_fd->get(),
+                 SOL_NETLINK,
+                 kNetlinkExtAck,
+                 &enable,
+                 sizeof(enable)) < 0) {
+    LOG(WARNING) << "Failed to set NETLINK_EXT_ACK option: " << strerror(errno);
+  }
   return true;
 }
 
+void NetlinkManager::EnableTimestamps(int netlink_fd) {
+  // Event latency is still tracked without timestamps, only the queue wait
+  // of events is unknown. Some kernels accept the option but never attach
+  // timestamps to netlink datagrams.
+  int enable = 1;
+  if (setsockopt(netlink_fd,
+                 SOL_SOCKET,
+                 SO_TIMESTAMPNS,
+                 &enable,
+                 sizeof(enable)) < 0) {
+    LOG(WARNING) << "Failed to enable timestamps on netlink socket: "
+                 << strerror(errno);
+  }
+}
+
 bool NetlinkManager::WatchSocket(unique_fd* netlink_fd) {
   // Watch socket
   bool watch_fd_rt = event_loop_->WatchFileDescriptor(
@@ -419,7 +720,13 @@ bool NetlinkManager::WatchSocket(unique_fd* netlink_fd) {
 }
 
 uint16_t NetlinkManager::GetFamilyId() {
-  return message_types_[NL80211_GENL_NAME].family_id;
+  // This is called from several threads, so it must not insert into
+  // |message_types_|.
+  const auto it = message_types_.find(NL80211_GENL_NAME);
+  if (it == message_types_.end()) {
+    return 0;
+  }
+  return it->second.family_id;
 }
 
 bool NetlinkManager::DiscoverFamilyId() {
@@ -461,75 +768,82 @@ bool NetlinkManager::SubscribeToEvents(const string& group) {
   return true;
 }
 
-void NetlinkManager::BroadcastHandler(unique_ptr<const NL80211Packet> packet) {
+void NetlinkManager::BroadcastHandler(unique_ptr<const NL80211Packet> packet,
+                                      int64_t kernel_time_ns) {
   if (packet->GetMessageType() != GetFamilyId()) {
     LOG(ERROR) << "Wrong family id for multicast message";
     return;
   }
-  uint32_t command = packet->GetCommand();
+  // Socket timestamps are taken from the wall clock.
+  int64_t queue_wait_ns = EventLatencyTracker::kUnknownQueueWait;
+  if (kernel_time_ns != 0) {
+    queue_wait_ns = std::max<int64_t>(
+        systemTime(SYSTEM_TIME_REALTIME) - kernel_time_ns, 0);
+  }
+  int64_t handling_start_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+  // Kernel state changed, so some cached query responses may be stale.
+  rate_limiter_.OnEvent(*packet);
+  event_dispatcher_.Dispatch(*packet);
+  uint32_t interface_index = 0;
+  packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index);
+  event_latency_tracker_.OnEventHandled(
+      packet->GetCommand(),
+      interface_index,
+      queue_wait_ns,
+      systemTime(SYSTEM_TIME_MONOTONIC) - handling_start_ns);
+}
 
-  if (command == NL80211_CMD_NEW_SCAN_RESULTS ||
-      // Scan was aborted, for unspecified reasons.partial scan results may be
-      // available.
-      command == NL80211_CMD_SCAN_ABORTED) {
-    OnScanResultsReady(std::move(packet));
-    return;
-  }
+void NetlinkManager::AddEventRoute(uint8_t command,
+                                   EventRoute::Handler handler) {
+  event_routes_.emplace_back(new EventRoute(this, handler));
+  event_dispatcher_.Subscribe(command,
+                              NL80211EventDispatcher::kAnyInterface,
+                              event_routes_.back().get(),
+                              &event_routes_.back()->subscription);
+}
+
+void NetlinkManager::SubscribeEvent(uint8_t command,
+                                    uint32_t interface_index,
+                                    NL80211EventObserver* observer,
+                                    NL80211EventSubscription* subscription) {
+  event_dispatcher_.Subscribe(command, interface_index, observer, subscription);
+}
 
-  if (command == NL80211_CMD_SCHED_SCAN_RESULTS ||
-      command == NL80211_CMD_SCHED_SCAN_STOPPED) {
-    OnSchedScanResultsReady(std::move(packet));
+void NetlinkManager::OnStationEvent(const NL80211Event& event) {
+  // Station events for AP mode.
+  if (event.interface_index == NL80211EventDispatcher::kAnyInterface) {
+    LOG(WARNING) << "Failed to get interface index from station event";
     return;
   }
-
-
-  // Driver which supports SME uses both NL80211_CMD_AUTHENTICATE and
-  // NL80211_CMD_ASSOCIATE, otherwise it uses NL80211_CMD_CONNECT
-  // to notify a combination of authentication and association processses.
-  // Currently we monitor CONNECT/ASSOCIATE/ROAM event for up-to-date
-  // frequency and bssid.
-  // TODO(nywang): Handle other MLME events, which help us track the
-  // connection state better.
-  if (command == NL80211_CMD_CONNECT ||
-      command == NL80211_CMD_ASSOCIATE ||
-      command == NL80211_CMD_ROAM ||
-      command == NL80211_CMD_DISCONNECT ||
-      command == NL80211_CMD_DISASSOCIATE) {
-      OnMlmeEvent(std::move(packet));
-     return;
-  }
-  if (command == NL80211_CMD_REG_CHANGE) {
-    OnRegChangeEvent(std::move(packet));
+  std::lock_guard<std::recursive_mutex> interface_lock(
+      GetInterfaceLock(event.interface_index));
+  OnStationEventHandler handler =
+      GetHandler(on_station_event_handler_, event.interface_index);
+  if (!handler) {
     return;
   }
-  // Station eventsFor AP mode.
-  if (command == NL80211_CMD_NEW_STATION ||
-      command == NL80211_CMD_DEL_STATION) {
-    uint32_t if_index;
-    if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
-      LOG(WARNING) << "Failed to get interface index from station event";
-      return;
-    }
-    const auto handler = on_station_event_handler_.find(if_index);
-    if (handler != on_station_event_handler_.end()) {
-      vector<uint8_t> mac_address;
-      if (!packet->GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
-        LOG(WARNING) << "Failed to get mac address from station event";
-        return;
-      }
-      if (command == NL80211_CMD_NEW_STATION) {
-        handler->second(NEW_STATION, mac_address);
-      } else {
-        handler->second(DEL_STATION, mac_address);
-      }
-    }
+  MacAddress mac_address;
+  if (!event.packet.GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
+    LOG(WARNING) << "Failed to get mac address from station event";
     return;
   }
+  if (event.command == NL80211_CMD_NEW_STATION) {
+    handler(NEW_STATION, mac_address);
+  } else {
+    handler(DEL_STATION, mac_address);
+  }
 }
 
-void NetlinkManager::OnRegChangeEvent(unique_ptr<const NL80211Packet> packet) {
-  uint32_t wiphy_index;
-  if (!packet->GetAttributeValue(NL80211_ATTR_WIPHY, &wiphy_index)) {
+void NetlinkManager::OnRegChangeEvent(const NL80211Event& event) {
+  const NL80211Packet* packet = &event.packet;
+  // NL80211_CMD_WIPHY_REG_CHANGE is about the private regulatory domain of
+  // a wiphy. NL80211_CMD_REG_CHANGE only carries a wiphy index if the change
+  // was requested by the driver of that wiphy. Otherwise the global
+  // regulatory domain changed, which applies to all wiphys.
+  uint32_t wiphy_index = event.wiphy_index;
+  bool has_wiphy_index = event.has_wiphy_index;
+  if (!has_wiphy_index &&
+      event.command == NL80211_CMD_WIPHY_REG_CHANGE) {
     LOG(ERROR) << "Failed to get wiphy index from reg changed message";
     return;
   }
@@ -563,103 +877,146 @@ void NetlinkManager::OnRegChangeEvent(unique_ptr<const NL80211Packet> packet) {
     return;
   }
 
-  const auto handler = on_reg_domain_changed_handler_.find(wiphy_index);
-  if (handler == on_reg_domain_changed_handler_.end()) {
+  if (!has_wiphy_index) {
+    // Handlers may (un)subscribe while running, so iterate over a copy.
+    std::map<uint32_t, OnRegDomainChangedHandler> handlers;
+    {
+      std::lock_guard<std::mutex> lock(handlers_lock_);
+      handlers = on_reg_domain_changed_handler_;
+    }
+    for (auto& handler : handlers) {
+      handler.second(country_code);
+    }
+    return;
+  }
+  OnRegDomainChangedHandler handler =
+      GetHandler(on_reg_domain_changed_handler_, wiphy_index);
+  if (!handler) {
     LOG(DEBUG) << "No handler for country code changed event from wiphy"
                << "with index: " << wiphy_index;
     return;
   }
-  handler->second(country_code);
+  handler(country_code);
 }
 
-void NetlinkManager::OnMlmeEvent(unique_ptr<const NL80211Packet> packet) {
-  uint32_t if_index;
-
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+void NetlinkManager::OnMlmeEvent(const NL80211Event& event) {
+  // Driver which supports SME uses both NL80211_CMD_AUTHENTICATE and
+  // NL80211_CMD_ASSOCIATE, otherwise it uses NL80211_CMD_CONNECT
+  // to notify a combination of authentication and association processses.
+  // Currently we monitor CONNECT/ASSOCIATE/ROAM event for up-to-date
+  // frequency and bssid.
+  // TODO(nywang): Handle other MLME events, which help us track the
+  // connection state better.
+  const NL80211Packet* packet = &event.packet;
+  uint32_t if_index = event.interface_index;
+  if (if_index == NL80211EventDispatcher::kAnyInterface) {
     LOG(ERROR) << "Failed to get interface index from a MLME event message";
     return;
   }
-  const auto handler = on_mlme_event_handler_.find(if_index);
-  if (handler == on_mlme_event_handler_.end()) {
+  std::lock_guard<std::recursive_mutex> interface_lock(
+      GetInterfaceLock(if_index));
+  MlmeEventHandler* handler = GetHandler(on_mlme_event_handler_, if_index);
+  if (handler == nullptr) {
     LOG(DEBUG) << "No handler for mlme event from interface"
                << " with index: " << if_index;
     return;
   }
-  uint32_t command = packet->GetCommand();
+  uint32_t command = event.command;
   if (command == NL80211_CMD_CONNECT) {
-    auto event = MlmeConnectEvent::InitFromPacket(packet.get());
-    if (event != nullptr) {
-      handler->second->OnConnect(std::move(event));
+    auto mlme_event = MlmeConnectEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnConnect(std::move(mlme_event));
     }
     return;
   }
   if (command == NL80211_CMD_ASSOCIATE) {
-    auto event = MlmeAssociateEvent::InitFromPacket(packet.get());
-    if (event != nullptr) {
-      handler->second->OnAssociate(std::move(event));
+    auto mlme_event = MlmeAssociateEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnAssociate(std::move(mlme_event));
     }
     return;
   }
   if (command == NL80211_CMD_ROAM) {
-    auto event = MlmeRoamEvent::InitFromPacket(packet.get());
-    if (event != nullptr) {
-      handler->second->OnRoam(std::move(event));
+    auto mlme_event = MlmeRoamEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnRoam(std::move(mlme_event));
     }
     return;
   }
   if (command == NL80211_CMD_DISCONNECT) {
-    auto event = MlmeDisconnectEvent::InitFromPacket(packet.get());
-    if (event != nullptr) {
-      handler->second->OnDisconnect(std::move(event));
+    auto mlme_event = MlmeDisconnectEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnDisconnect(std::move(mlme_event));
     }
     return;
   }
   if (command == NL80211_CMD_DISASSOCIATE) {
-    auto event = MlmeDisassociateEvent::InitFromPacket(packet.get());
-    if (event != nullptr) {
-      handler->second->OnDisassociate(std::move(event));
+    auto mlme_event = MlmeDisassociateEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnDisassociate(std::move(mlme_event));
+    }
+    return;
+  }
+  if (command == NL80211_CMD_NOTIFY_CQM) {
+    auto mlme_event = MlmeCqmEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnCqm(std::move(mlme_event));
+    }
+    return;
+  }
+  if (command == NL80211_CMD_CH_SWITCH_NOTIFY) {
+    auto mlme_event = MlmeChannelSwitchEvent::InitFromPacket(packet);
+    if (mlme_event != nullptr) {
+      handler->OnChannelSwitch(std::move(mlme_event));
     }
     return;
   }
 
 }
 
-void NetlinkManager::OnSchedScanResultsReady(unique_ptr<const NL80211Packet> packet) {
-  uint32_t if_index;
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+void NetlinkManager::OnSchedScanResultsReady(const NL80211Event& event) {
+  uint32_t if_index = event.interface_index;
+  if (if_index == NL80211EventDispatcher::kAnyInterface) {
     LOG(ERROR) << "Failed to get interface index from scan result notification";
     return;
   }
 
-  const auto handler = on_sched_scan_result_ready_handler_.find(if_index);
-  if (handler == on_sched_scan_result_ready_handler_.end()) {
+  std::lock_guard<std::recursive_mutex> interface_lock(
+      GetInterfaceLock(if_index));
+  OnSchedScanResultsReadyHandler handler =
+      GetHandler(on_sched_scan_result_ready_handler_, if_index);
+  if (!handler) {
     LOG(DEBUG) << "No handler for scheduled scan result notification from"
                << " interface with index: " << if_index;
     return;
   }
   // Run scan result notification handler.
-  handler->second(if_index, packet->GetCommand() == NL80211_CMD_SCHED_SCAN_STOPPED);
+  handler(if_index, event.command == NL80211_CMD_SCHED_SCAN_STOPPED);
 }
 
-void NetlinkManager::OnScanResultsReady(unique_ptr<const NL80211Packet> packet) {
-  uint32_t if_index;
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+void NetlinkManager::OnScanResultsReady(const NL80211Event& event) {
+  const NL80211Packet* packet = &event.packet;
+  uint32_t if_index = event.interface_index;
+  if (if_index == NL80211EventDispatcher::kAnyInterface) {
     LOG(ERROR) << "Failed to get interface index from scan result notification";
     return;
   }
   bool aborted = false;
-  if (packet->GetCommand() == NL80211_CMD_SCAN_ABORTED) {
+  if (event.command == NL80211_CMD_SCAN_ABORTED) {
     aborted = true;
   }
 
-  const auto handler = on_scan_result_ready_handler_.find(if_index);
-  if (handler == on_scan_result_ready_handler_.end()) {
+  std::lock_guard<std::recursive_mutex> interface_lock(
+      GetInterfaceLock(if_index));
+  OnScanResultsReadyHandler handler =
+      GetHandler(on_scan_result_ready_handler_, if_index);
+  if (!handler) {
     LOG(WARNING) << "No handler for scan result notification from interface"
                  << " with index: " << if_index;
     return;
   }
 
-  vector<vector<uint8_t>> ssids;
+  vector<Ssid> ssids;
   NL80211NestedAttr ssids_attr(0);
   if (!packet->GetAttribute(NL80211_ATTR_SCAN_SSIDS, &ssids_attr)) {
     if (!aborted) {
@@ -682,57 +1039,108 @@ void NetlinkManager::OnScanResultsReady(unique_ptr<const NL80211Packet> packet)
     }
   }
   // Run scan result notification handler.
-  handler->second(if_index, aborted, ssids, freqs);
+  handler(if_index, aborted, ssids, freqs);
 }
 
 void NetlinkManager::SubscribeStationEvent(
     uint32_t interface_index,
     OnStationEventHandler handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_station_event_handler_[interface_index] = handler;
 }
 
 void NetlinkManager::UnsubscribeStationEvent(uint32_t interface_index) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_station_event_handler_.erase(interface_index);
 }
 
+void NetlinkManager::SubscribeEventOverrun(
+    uint32_t interface_index,
+    OnEventOverrunHandler handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
+  on_event_overrun_handler_[interface_index] = handler;
+}
+
+void NetlinkManager::UnsubscribeEventOverrun(uint32_t interface_index) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
+  on_event_overrun_handler_.erase(interface_index);
+}
+
+void NetlinkManager::SubscribeRequestError(OnRequestErrorHandler handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
+  on_request_error_handler_ = handler;
+}
+
+void NetlinkManager::UnsubscribeRequestError() {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
+  on_request_error_handler_ = nullptr;
+}
+
+uint64_t NetlinkManager::GetEventOverrunCount() const {
+  return event_overrun_count_;
+}
+
+uint64_t NetlinkManager::GetAckBytesSaved() const {
+  return ack_bytes_saved_;
+}
+
+void NetlinkManager::Dump(stringstream* ss) const {
+  *ss << "------- Dump of netlink manager -------" << std::endl;
+  *ss << "Event socket overruns: " << event_overrun_count_.load()
+      << std::endl;
+  *ss << "Bytes saved by capped ACKs: " << ack_bytes_saved_.load()
+      << std::endl;
+  rate_limiter_.Dump(ss);
+  event_latency_tracker_.Dump(ss);
+  *ss << "------- Dump End -------" << std::endl;
+}
+
 void NetlinkManager::SubscribeRegDomainChange(
     uint32_t wiphy_index,
     OnRegDomainChangedHandler handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_reg_domain_changed_handler_[wiphy_index] = handler;
 }
 
 void NetlinkManager::UnsubscribeRegDomainChange(uint32_t wiphy_index) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_reg_domain_changed_handler_.erase(wiphy_index);
 }
 
 void NetlinkManager::SubscribeScanResultNotification(
     uint32_t interface_index,
     OnScanResultsReadyHandler handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_scan_result_ready_handler_[interface_index] = handler;
 }
 
 void NetlinkManager::UnsubscribeScanResultNotification(
     uint32_t interface_index) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_scan_result_ready_handler_.erase(interface_index);
 }
 
 void NetlinkManager::SubscribeMlmeEvent(uint32_t interface_index,
                                         MlmeEventHandler* handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_mlme_event_handler_[interface_index] = handler;
 }
 
 void NetlinkManager::UnsubscribeMlmeEvent(uint32_t interface_index) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_mlme_event_handler_.erase(interface_index);
 }
 
 void NetlinkManager::SubscribeSchedScanResultNotification(
       uint32_t interface_index,
       OnSchedScanResultsReadyHandler handler) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_sched_scan_result_ready_handler_[interface_index] = handler;
 }
 
 void NetlinkManager::UnsubscribeSchedScanResultNotification(
     uint32_t interface_index) {
+  std::lock_guard<std::mutex> lock(handlers_lock_);
   on_sched_scan_result_ready_handler_.erase(interface_index);
 }
 
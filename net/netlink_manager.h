@@ -17,14 +17,25 @@
 #ifndef WIFICOND_NET_NETLINK_MANAGER_H_
 #define WIFICOND_NET_NETLINK_MANAGER_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <android-base/macros.h>
 #include <android-base/unique_fd.h>
 
 #include "event_loop.h"
+#include "net/event_latency_tracker.h"
+#include "net/mac_address.h"
+#include "net/netlink_rate_limiter.h"
+#include "net/nl80211_event_dispatcher.h"
+#include "net/ssid.h"
 
 namespace android {
 namespace wificond {
@@ -59,7 +70,7 @@ struct MessageType {
 typedef std::function<void(
     uint32_t interface_index,
     bool aborted,
-    std::vector<std::vector<uint8_t>>& ssids,
+    std::vector<Ssid>& ssids,
     std::vector<uint32_t>& frequencies)> OnScanResultsReadyHandler;
 
 // This describes a type of function handling scheduled scan results ready
@@ -96,8 +107,51 @@ enum StationEvent {
 // |mac_address| is the station mac address associated with this event.
 typedef std::function<void(
     StationEvent event,
-    const std::vector<uint8_t>& mac_address)> OnStationEventHandler;
+    const MacAddress& mac_address)> OnStationEventHandler;
+
+// This describes a type of function handling a multicast overrun on the
+// event socket.
+// When this is called, kernel has dropped an unknown number of NL80211
+// multicast events because the socket receive buffer was full. Subscribers
+// are supposed to query kernel for the state they track, instead of waiting
+// for notifications which may never arrive.
+typedef std::function<void()> OnEventOverrunHandler;
+
+// Structured description of a NLMSG_ERROR response from kernel.
+struct NetlinkError {
+  NetlinkError()
+      : error_code(0),
+        attribute_offset(0),
+        attribute_type(0) {}
+  // Returns a human readable description of this error for logging.
+  std::string ToString() const;
+
+  // An error number defined in errno.h. 0 means the request was acknowledged.
+  int error_code;
+  // Error message from kernel extended ACK. Empty if kernel didn't provide one.
+  std::string message;
+  // Offset in bytes of the offending attribute from the start of the request.
+  // 0 if kernel didn't report one.
+  uint32_t attribute_offset;
+  // Type of the attribute found at |attribute_offset| in the request.
+  // 0 if |attribute_offset| is not set or is out of the request boundary.
+  uint16_t attribute_type;
+};
 
+// This describes a type of function handling a request which kernel
+// rejected.
+// |request| is the rejected request, and |error| is what kernel replied.
+typedef std::function<void(
+    const NL80211Packet& request,
+    const NetlinkError& error)> OnRequestErrorHandler;
+
+// NetlinkManager can be used from several threads, e.g. when binder calls
+// are served by a thread pool. Events are dispatched on the event loop
+// thread.
+// Calls into the objects of an interface are serialized by the interface
+// lock, see GetInterfaceLock(). Locks are taken in this order: interface
+// lock, then the internal locks of NetlinkManager. Handlers never run with
+// an internal lock held.
 class NetlinkManager {
  public:
   explicit NetlinkManager(EventLoop* event_loop);
@@ -109,6 +163,7 @@ class NetlinkManager {
   // Returns true if this netlink manager object is started.
   virtual bool IsStarted() const;
   // Returns a sequence number available for use.
+  // Concurrent callers get distinct sequence numbers.
   virtual uint32_t GetSequenceNumber();
   // Get NL80211 netlink family id,
   virtual uint16_t GetFamilyId();
@@ -121,8 +176,12 @@ class NetlinkManager {
   virtual bool RegisterHandlerAndSendMessage(const NL80211Packet& packet,
       std::function<void(std::unique_ptr<const NL80211Packet>)> handler);
   // Synchronous version of |RegisterHandlerAndSendMessage|.
+  // The request owns a synchronous socket until it is done, so that it is
+  // the only reader of its replies. See SetMaxSyncSockets().
   // Returns true on successfully receiving an valid reply.
   // Reply packets will be stored in |*response|.
+  // Inside a NetlinkRateLimiter::ScopedLimit, the request may be answered
+  // with an EBUSY error or a recent identical response instead.
   virtual bool SendMessageAndGetResponses(
       const NL80211Packet& packet,
       std::vector<std::unique_ptr<const NL80211Packet>>* response);
@@ -152,6 +211,11 @@ class NetlinkManager {
   // Error code will be stored in |*error_code|
   virtual bool SendMessageAndGetAckOrError(const NL80211Packet& packet,
                                            int* error_code);
+  // Same as above, but the error code, as well as the error message and the
+  // offending attribute reported by kernel extended ACK, will be stored in
+  // |*error|.
+  virtual bool SendMessageAndGetAckOrError(const NL80211Packet& packet,
+                                           NetlinkError* error);
   // Wrapper of |SendMessageAndGetResponses| that returns true iff the response
   // is an ACK.
   virtual bool SendMessageAndGetAck(const NL80211Packet& packet);
@@ -227,17 +291,146 @@ class NetlinkManager {
   // Cancel the sign-up of receiving station events.
   virtual void UnsubscribeStationEvent(uint32_t interface_index);
 
+  // Sign up to be notified when multicast events were dropped by kernel.
+  // See the declaration of OnEventOverrunHandler for the semantics of this
+  // callback.
+  // Only one handler can be registered per interface index.
+  // New handler will replace the registered handler if they are for the
+  // same interface index.
+  virtual void SubscribeEventOverrun(uint32_t interface_index,
+                                     OnEventOverrunHandler handler);
+
+  // Cancel the sign-up of receiving event overrun notifications.
+  virtual void UnsubscribeEventOverrun(uint32_t interface_index);
+
+  // Sign up to be notified whenever kernel rejects a request with an error.
+  // Only one handler can be registered. New handler will replace the
+  // registered one.
+  void SubscribeRequestError(OnRequestErrorHandler handler);
+
+  // Cancel the sign-up of receiving request errors.
+  void UnsubscribeRequestError();
+
+  // Sign up |observer| for multicast events with |command| from interface
+  // |interface_index|, or from any interface if |interface_index| is
+  // NL80211EventDispatcher::kAnyInterface.
+  // Unlike the Subscribe* functions above, any number of observers can
+  // subscribe to the same event, and they are all notified.
+  // The subscription lasts until |*subscription| is unsubscribed or
+  // destroyed. Caller keeps the ownership of |observer| and |subscription|.
+  // This must be called from the event loop thread.
+  virtual void SubscribeEvent(uint8_t command,
+                              uint32_t interface_index,
+                              NL80211EventObserver* observer,
+                              NL80211EventSubscription* subscription);
+
+  // Returns the number of times kernel reported ENOBUFS on the event socket
+  // since this netlink manager was created.
+  uint64_t GetEventOverrunCount() const;
+
+  // Returns the number of bytes kernel didn't echo back to us in error
+  // messages, because NETLINK_CAP_ACK is enabled on the sockets.
+  uint64_t GetAckBytesSaved() const;
+
+  // Returns the admission controller of synchronous requests, which keeps
+  // the numbers of admitted, coalesced and rejected requests.
+  const NetlinkRateLimiter& GetRateLimiter() const { return rate_limiter_; }
+
+  // Returns the latencies of the events received on the event socket.
+  const EventLatencyTracker& GetEventLatencyTracker() const {
+    return event_latency_tracker_;
+  }
+
+  // Allows up to |max_sync_sockets| synchronous requests to be in flight at
+  // the same time, each on its own socket. Sockets are opened when needed.
+  // The default is 1, which serializes synchronous requests.
+  void SetMaxSyncSockets(size_t max_sync_sockets);
+
+  // Returns the lock which serializes the calls into the objects of
+  // interface |interface_index|: binder calls, and the events and tasks
+  // the event loop runs for them. Interfaces are spread over a fixed set of
+  // locks, so a lock outlives the objects it protects. It is recursive, so
+  // that handlers can call back into their interface.
+  std::recursive_mutex& GetInterfaceLock(uint32_t interface_index);
+
+  void Dump(std::stringstream* ss) const;
+
+ protected:
+  // Parses |len| bytes of netlink messages in |buffer| and dispatches them
+  // to the registered handlers.
+  void HandleReceivedMessages(const uint8_t* buffer, size_t len);
+  // Same as above, for a datagram which kernel queued on the socket at
+  // wall clock time |kernel_time_ns|. 0 means the time is unknown.
+  void HandleReceivedMessages(const uint8_t* buffer,
+                              size_t len,
+                              int64_t kernel_time_ns);
+  // Called when kernel drops multicast events for us.
+  // This notifies all subscribers so that they can resync their state.
+  void OnEventOverrun();
+
  private:
+  static constexpr size_t kNumInterfaceLocks = 8;
+
   bool SetupSocket(android::base::unique_fd* netlink_fd);
   bool WatchSocket(android::base::unique_fd* netlink_fd);
+  // Asks kernel to timestamp the datagrams queued on |netlink_fd|.
+  void EnableTimestamps(int netlink_fd);
   void ReceivePacketAndRunHandler(int fd);
   bool DiscoverFamilyId();
   bool SendMessageInternal(const NL80211Packet& packet, int fd);
-  void BroadcastHandler(std::unique_ptr<const NL80211Packet> packet);
-  void OnRegChangeEvent(std::unique_ptr<const NL80211Packet> packet);
-  void OnMlmeEvent(std::unique_ptr<const NL80211Packet> packet);
-  void OnScanResultsReady(std::unique_ptr<const NL80211Packet> packet);
-  void OnSchedScanResultsReady(std::unique_ptr<const NL80211Packet> packet);
+  // Sends |packet| on synchronous socket |fd|, and waits for the replies.
+  bool SendMessageAndReceiveResponses(
+      const NL80211Packet& packet,
+      int fd,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  // Returns an idle synchronous socket. A new socket is opened if none is
+  // idle and there are less than |max_sync_sockets_|. Otherwise this waits
+  // until a socket is released.
+  // Returns an invalid fd if a new socket can't be set up.
+  android::base::unique_fd AcquireSyncSocket();
+  void ReleaseSyncSocket(android::base::unique_fd netlink_fd);
+  bool HasMessageHandler(uint32_t sequence_number);
+  void EraseMessageHandler(uint32_t sequence_number);
+  // Returns a copy of the handler registered for |index| in |handlers|, or
+  // an empty handler.
+  template <typename Handler>
+  Handler GetHandler(const std::map<uint32_t, Handler>& handlers,
+                     uint32_t index) {
+    std::lock_guard<std::mutex> lock(handlers_lock_);
+    const auto it = handlers.find(index);
+    return it == handlers.end() ? Handler() : it->second;
+  }
+  // Fills |*error| from NLMSG_ERROR message |response| which kernel sent
+  // in reply to |request|.
+  void ParseError(const NL80211Packet& request,
+                  const NL80211Packet& response,
+                  NetlinkError* error);
+  void BroadcastHandler(std::unique_ptr<const NL80211Packet> packet,
+                        int64_t kernel_time_ns);
+  void OnRegChangeEvent(const NL80211Event& event);
+  void OnMlmeEvent(const NL80211Event& event);
+  void OnScanResultsReady(const NL80211Event& event);
+  void OnSchedScanResultsReady(const NL80211Event& event);
+  void OnStationEvent(const NL80211Event& event);
+
+  // Forwards the events of one command to a member function, so that the
+  // handler maps below are fed by the dispatch table.
+  class EventRoute : public NL80211EventObserver {
+   public:
+    typedef void (NetlinkManager::*Handler)(const NL80211Event& event);
+    EventRoute(NetlinkManager* netlink_manager, Handler handler)
+        : netlink_manager_(netlink_manager),
+          handler_(handler) {}
+    void OnNL80211Event(const NL80211Event& event) override {
+      (netlink_manager_->*handler_)(event);
+    }
+    NL80211EventSubscription subscription;
+
+   private:
+    NetlinkManager* const netlink_manager_;
+    const Handler handler_;
+  };
+  void AddEventRoute(uint8_t command, EventRoute::Handler handler);
 
   // This handler revceives mapping from NL80211 family name to family id,
   // as well as mapping from group name to group id.
@@ -250,13 +443,29 @@ class NetlinkManager {
   // middle of a dump request.
   // Using different sockets help us avoid the complexity of message
   // rescheduling.
-  android::base::unique_fd sync_netlink_fd_;
+  // For the same reason, concurrent synchronous requests don't share a
+  // socket. Idle synchronous sockets are kept here.
+  std::vector<android::base::unique_fd> idle_sync_sockets_;
+  // Number of synchronous sockets, idle or in use.
+  size_t num_sync_sockets_;
+  size_t max_sync_sockets_;
+  std::mutex sync_sockets_lock_;
+  std::condition_variable sync_socket_released_;
   android::base::unique_fd async_netlink_fd_;
   EventLoop* event_loop_;
 
+  // Dispatch table of multicast events, indexed by NL80211 command.
+  NL80211EventDispatcher event_dispatcher_;
+  std::vector<std::unique_ptr<EventRoute>> event_routes_;
+
   // This is a collection of message handlers, for each sequence number.
   std::map<uint32_t,
       std::function<void(std::unique_ptr<const NL80211Packet>)>> message_handlers_;
+  std::mutex message_handlers_lock_;
+
+  std::recursive_mutex interface_locks_[kNumInterfaceLocks];
+  // Guards the handler maps and the request error handler below.
+  std::mutex handlers_lock_;
 
   // A mapping from interface index to the handler registered to receive
   // scan results notifications.
@@ -274,10 +483,21 @@ class NetlinkManager {
 
   std::map<uint32_t, OnStationEventHandler> on_station_event_handler_;
 
+  // A mapping from interface index to the handler registered to be notified
+  // of dropped multicast events.
+  std::map<uint32_t, OnEventOverrunHandler> on_event_overrun_handler_;
+  OnRequestErrorHandler on_request_error_handler_;
+  std::atomic<uint64_t> event_overrun_count_;
+  std::atomic<uint64_t> ack_bytes_saved_;
+  // Token bucket admission of synchronous requests. Requests over budget
+  // are coalesced onto recent identical queries, or rejected.
+  NetlinkRateLimiter rate_limiter_;
+  EventLatencyTracker event_latency_tracker_;
+
   // Mapping from family name to family id, and group name to group id.
   std::map<std::string, MessageType> message_types_;
 
-  uint32_t sequence_number_;
+  std::atomic<uint32_t> sequence_number_;
 
   DISALLOW_COPY_AND_ASSIGN(NetlinkManager);
 };
@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/netlink_rate_limiter.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <string.h>
+
+#include <android-base/logging.h>
+#include <utils/Timers.h>
+
+#include "net/nl80211_packet.h"
+
+using std::endl;
+using std::stringstream;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int64_t kNanoSecondsPerMilliSecond = 1000000;
+
+const char* kRequestClassNames[] = {
+  "scan trigger",
+  "station query",
+  "scan result query",
+  "device query",
+  "unlimited"
+};
+
+// Scan triggers are expensive for the driver, and framework doesn't need
+// more than one every few seconds.
+constexpr NetlinkRateLimiter::Budget kScanTriggerBudget = {4, 1000, 0};
+// Signal polls and station queries are cheap, but apps can make the
+// framework issue them in a tight loop.
+constexpr NetlinkRateLimiter::Budget kStationQueryBudget = {10, 100, 1000};
+constexpr NetlinkRateLimiter::Budget kScanResultQueryBudget = {5, 500, 1000};
+constexpr NetlinkRateLimiter::Budget kDeviceQueryBudget = {10, 500, 1000};
+constexpr NetlinkRateLimiter::Budget kUnlimitedBudget = {0, 0, 0};
+
+// Set by the innermost ScopedLimit of this thread.
+thread_local bool requests_limited = false;
+
+int64_t GetMonotonicTimeNs() {
+  return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// Returns true if an event with |command| may change the answer to
+// queries of |request_class|.
+bool IsStaleAfterEvent(NetlinkRateLimiter::RequestClass request_class,
+                       uint8_t command) {
+  switch (command) {
+    case NL80211_CMD_NEW_SCAN_RESULTS:
+    case NL80211_CMD_SCAN_ABORTED:
+    case NL80211_CMD_SCHED_SCAN_RESULTS:
+      return request_class == NetlinkRateLimiter::kScanResultQuery;
+    case NL80211_CMD_CONNECT:
+    case NL80211_CMD_DISCONNECT:
+    case NL80211_CMD_ROAM:
+    case NL80211_CMD_ASSOCIATE:
+    case NL80211_CMD_DEAUTHENTICATE:
+    case NL80211_CMD_DISASSOCIATE:
+    case NL80211_CMD_NEW_STATION:
+    case NL80211_CMD_DEL_STATION:
+      // Kernel marks the associated BSS in its scan results.
+      return request_class == NetlinkRateLimiter::kStationQuery ||
+             request_class == NetlinkRateLimiter::kScanResultQuery;
+    case NL80211_CMD_CH_SWITCH_NOTIFY:
+      return request_class != NetlinkRateLimiter::kScanTrigger;
+    case NL80211_CMD_REG_CHANGE:
+    case NL80211_CMD_WIPHY_REG_CHANGE:
+    case NL80211_CMD_NEW_INTERFACE:
+    case NL80211_CMD_DEL_INTERFACE:
+    case NL80211_CMD_NEW_WIPHY:
+    case NL80211_CMD_DEL_WIPHY:
+      return request_class == NetlinkRateLimiter::kDeviceQuery;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+NetlinkRateLimiter::NetlinkRateLimiter()
+    : NetlinkRateLimiter(GetMonotonicTimeNs) {
+}
+
+NetlinkRateLimiter::NetlinkRateLimiter(Clock clock)
+    : clock_(clock) {
+  SetBudget(kScanTrigger, kScanTriggerBudget);
+  SetBudget(kStationQuery, kStationQueryBudget);
+  SetBudget(kScanResultQuery, kScanResultQueryBudget);
+  SetBudget(kDeviceQuery, kDeviceQueryBudget);
+  SetBudget(kUnlimited, kUnlimitedBudget);
+}
+
+NetlinkRateLimiter::ScopedLimit::ScopedLimit(bool enabled)
+    : was_enabled_(requests_limited) {
+  requests_limited = enabled;
+}
+
+NetlinkRateLimiter::ScopedLimit::~ScopedLimit() {
+  requests_limited = was_enabled_;
+}
+
+NetlinkRateLimiter::RequestClass NetlinkRateLimiter::GetRequestClass(
+    const NL80211Packet& request) {
+  if (request.GetMessageType() == GENL_ID_CTRL) {
+    return kUnlimited;
+  }
+  switch (request.GetCommand()) {
+    case NL80211_CMD_TRIGGER_SCAN:
+      return kScanTrigger;
+    case NL80211_CMD_GET_STATION:
+    case NL80211_CMD_GET_SURVEY:
+      return kStationQuery;
+    case NL80211_CMD_GET_SCAN:
+      return kScanResultQuery;
+    case NL80211_CMD_GET_WIPHY:
+    case NL80211_CMD_GET_INTERFACE:
+    case NL80211_CMD_GET_REG:
+    case NL80211_CMD_GET_PROTOCOL_FEATURES:
+      return kDeviceQuery;
+    default:
+      return kUnlimited;
+  }
+}
+
+void NetlinkRateLimiter::SetBudget(RequestClass request_class,
+                                   const Budget& budget) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Bucket* bucket = &buckets_[request_class];
+  bucket->budget = budget;
+  bucket->tokens = budget.burst;
+  bucket->last_refill_ns = clock_();
+}
+
+NetlinkRateLimiter::Admission NetlinkRateLimiter::Admit(
+    const NL80211Packet& request,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  RequestClass request_class = GetRequestClass(request);
+  std::lock_guard<std::mutex> lock(lock_);
+  Bucket* bucket = &buckets_[request_class];
+  if (request_class == kUnlimited) {
+    // Kernel reports the state changes these cause with events, see
+    // OnEvent().
+    bucket->stats.admitted++;
+    return kAdmitted;
+  }
+  if (!requests_limited) {
+    bucket->stats.bypassed++;
+    return kAdmitted;
+  }
+  int64_t now_ns = clock_();
+  Refill(bucket, now_ns);
+  if (bucket->tokens > 0) {
+    bucket->tokens--;
+    bucket->stats.admitted++;
+    return kAdmitted;
+  }
+  if (Coalesce(request, *bucket, now_ns, response)) {
+    LOG(DEBUG) << "Coalesced NL80211 command "
+               << static_cast<int>(request.GetCommand())
+               << " onto a recent identical query";
+    bucket->stats.coalesced++;
+    return kCoalesced;
+  }
+  LOG(WARNING) << "Rejected NL80211 command "
+               << static_cast<int>(request.GetCommand()) << " with EBUSY: "
+               << kRequestClassNames[request_class] << " budget exhausted";
+  bucket->stats.rejected++;
+  response->push_back(CreateBusyError(request));
+  return kRejected;
+}
+
+void NetlinkRateLimiter::OnResponse(
+    const NL80211Packet& request,
+    const vector<unique_ptr<const NL80211Packet>>& response) {
+  std::lock_guard<std::mutex> lock(lock_);
+  const Bucket& bucket = buckets_[GetRequestClass(request)];
+  if (bucket.budget.coalesce_window_ms == 0) {
+    return;
+  }
+  CachedResponse* cached_response =
+      &cached_responses_[GetRequestKey(request)];
+  cached_response->request_class = GetRequestClass(request);
+  cached_response->interface_index = 0;
+  request.GetAttributeValue(NL80211_ATTR_IFINDEX,
+                            &cached_response->interface_index);
+  cached_response->timestamp_ns = clock_();
+  cached_response->packets.clear();
+  for (const auto& packet : response) {
+    cached_response->packets.push_back(packet->GetConstData());
+  }
+}
+
+void NetlinkRateLimiter::OnEvent(const NL80211Packet& event) {
+  // Events without an interface, e.g. regulatory domain changes, affect
+  // all interfaces.
+  uint32_t interface_index = 0;
+  event.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index);
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto it = cached_responses_.begin(); it != cached_responses_.end();) {
+    const CachedResponse& cached_response = it->second;
+    if (IsStaleAfterEvent(cached_response.request_class,
+                          event.GetCommand()) &&
+        (interface_index == 0 || cached_response.interface_index == 0 ||
+         cached_response.interface_index == interface_index)) {
+      it = cached_responses_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void NetlinkRateLimiter::InvalidateResponses() {
+  std::lock_guard<std::mutex> lock(lock_);
+  cached_responses_.clear();
+}
+
+NetlinkRateLimiter::Stats NetlinkRateLimiter::GetStats(
+    RequestClass request_class) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return buckets_[request_class].stats;
+}
+
+void NetlinkRateLimiter::Dump(stringstream* ss) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  for (int i = 0; i < kNumRequestClasses; i++) {
+    const Stats& stats = buckets_[i].stats;
+    *ss << "NL80211 " << kRequestClassNames[i] << " requests admitted: "
+        << stats.admitted << ", coalesced: " << stats.coalesced
+        << ", rejected: " << stats.rejected
+        << ", bypassed: " << stats.bypassed << endl;
+  }
+}
+
+vector<uint8_t> NetlinkRateLimiter::GetRequestKey(
+    const NL80211Packet& request) {
+  vector<uint8_t> key = request.GetConstData();
+  if (key.size() >= sizeof(nlmsghdr)) {
+    nlmsghdr* header = reinterpret_cast<nlmsghdr*>(key.data());
+    header->nlmsg_seq = 0;
+    header->nlmsg_pid = 0;
+  }
+  return key;
+}
+
+unique_ptr<const NL80211Packet> NetlinkRateLimiter::CreateBusyError(
+    const NL80211Packet& request) {
+  // A capped error message, which doesn't echo the payload of the request.
+  vector<uint8_t> data(NLMSG_HDRLEN + sizeof(nlmsgerr), 0);
+  nlmsgerr* error = reinterpret_cast<nlmsgerr*>(data.data() + NLMSG_HDRLEN);
+  error->error = -EBUSY;
+  const vector<uint8_t>& request_data = request.GetConstData();
+  memcpy(&error->msg, request_data.data(),
+         std::min(request_data.size(), sizeof(nlmsghdr)));
+  nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data.data());
+  nl_header->nlmsg_len = data.size();
+  nl_header->nlmsg_type = NLMSG_ERROR;
+  nl_header->nlmsg_flags = kNetlinkFlagCapped;
+  nl_header->nlmsg_seq = request.GetMessageSequence();
+  nl_header->nlmsg_pid = request.GetPortId();
+  return unique_ptr<const NL80211Packet>(new NL80211Packet(data));
+}
+
+void NetlinkRateLimiter::Refill(Bucket* bucket, int64_t now_ns) {
+  int64_t interval_ns =
+      bucket->budget.refill_interval_ms * kNanoSecondsPerMilliSecond;
+  if (interval_ns == 0) {
+    return;
+  }
+  int64_t new_tokens = (now_ns - bucket->last_refill_ns) / interval_ns;
+  if (new_tokens <= 0) {
+    return;
+  }
+  bucket->last_refill_ns += new_tokens * interval_ns;
+  bucket->tokens = static_cast<uint32_t>(std::min<int64_t>(
+      bucket->budget.burst, bucket->tokens + new_tokens));
+  if (bucket->tokens == bucket->budget.burst) {
+    // Don't accumulate credit while the bucket is full.
+    bucket->last_refill_ns = now_ns;
+  }
+}
+
+bool NetlinkRateLimiter::Coalesce(
+    const NL80211Packet& request,
+    const Bucket& bucket,
+    int64_t now_ns,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  if (bucket.budget.coalesce_window_ms == 0) {
+    return false;
+  }
+  const auto cached_response = cached_responses_.find(GetRequestKey(request));
+  if (cached_response == cached_responses_.end() ||
+      now_ns - cached_response->second.timestamp_ns >
+          bucket.budget.coalesce_window_ms * kNanoSecondsPerMilliSecond) {
+    return false;
+  }
+  for (const auto& data : cached_response->second.packets) {
+    unique_ptr<NL80211Packet> packet(new NL80211Packet(data));
+    packet->SetMessageSequence(request.GetMessageSequence());
+    response->push_back(std::move(packet));
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
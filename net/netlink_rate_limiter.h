@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NETLINK_RATE_LIMITER_H_
+#define WIFICOND_NET_NETLINK_RATE_LIMITER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+class NL80211Packet;
+
+// Admission control for synchronous NL80211 requests.
+// Each class of request has a token bucket. A request consumes one token.
+// When a query class runs out of tokens, the request is answered with the
+// response of an identical query which completed recently, if there is one.
+// Otherwise the request is rejected without reaching kernel, and answered
+// with an EBUSY error.
+// Only requests made on behalf of a binder caller are limited, see
+// ScopedLimit. Requests which wificond makes on its own, e.g. to set up
+// interfaces or to resync after an event, and requests which don't belong to
+// any limited class are always admitted.
+// This is thread-safe.
+class NetlinkRateLimiter {
+ public:
+  enum RequestClass {
+    // Single scan triggers: NL80211_CMD_TRIGGER_SCAN.
+    kScanTrigger,
+    // Link and station queries: NL80211_CMD_GET_STATION, NL80211_CMD_GET_SURVEY.
+    kStationQuery,
+    // Scan result dumps: NL80211_CMD_GET_SCAN.
+    kScanResultQuery,
+    // Device queries: NL80211_CMD_GET_WIPHY, NL80211_CMD_GET_INTERFACE,
+    // NL80211_CMD_GET_REG, NL80211_CMD_GET_PROTOCOL_FEATURES.
+    kDeviceQuery,
+    // Everything else, including control messages and commands which stop
+    // or abort an operation. These are never limited.
+    // Scheduled scans are started rarely, and a rejected start would leave
+    // PNO silently off, so NL80211_CMD_START_SCHED_SCAN is not limited
+    // either.
+    kUnlimited,
+    kNumRequestClasses
+  };
+
+  enum Admission {
+    // The request can be sent to kernel.
+    kAdmitted,
+    // The request is answered with a cached response of an identical query.
+    kCoalesced,
+    // The request must not be sent. It is answered with an EBUSY error.
+    kRejected
+  };
+
+  struct Budget {
+    // Maximum number of requests in a burst.
+    uint32_t burst;
+    // A new token becomes available every |refill_interval_ms| milliseconds.
+    uint32_t refill_interval_ms;
+    // Responses to queries of this class can be reused for this long.
+    // 0 means requests of this class are never coalesced.
+    uint32_t coalesce_window_ms;
+  };
+
+  struct Stats {
+    Stats() : admitted(0), coalesced(0), rejected(0), bypassed(0) {}
+    uint64_t admitted;
+    uint64_t coalesced;
+    uint64_t rejected;
+    // Requests made outside of a ScopedLimit, which don't take tokens.
+    uint64_t bypassed;
+  };
+
+  // Requests sent by this thread while a ScopedLimit with |enabled| set is
+  // the innermost one alive count against the budgets. Binder calls use it
+  // around the queries they make for framework.
+  class ScopedLimit {
+   public:
+    explicit ScopedLimit(bool enabled = true);
+    ~ScopedLimit();
+
+   private:
+    // State of the enclosing scope, restored on destruction.
+    bool was_enabled_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedLimit);
+  };
+
+  // Returns current time in nanoseconds from a monotonic clock.
+  typedef std::function<int64_t()> Clock;
+
+  // Uses default budgets and the system monotonic clock.
+  NetlinkRateLimiter();
+  explicit NetlinkRateLimiter(Clock clock);
+
+  static RequestClass GetRequestClass(const NL80211Packet& request);
+
+  // Replaces the budget of |request_class|, and refills its bucket.
+  void SetBudget(RequestClass request_class, const Budget& budget);
+
+  // Decides whether |request| can be sent to kernel now.
+  // If this returns kCoalesced, the cached response is appended to
+  // |*response|. If this returns kRejected, a NLMSG_ERROR message carrying
+  // EBUSY is appended instead, as if kernel had refused the request.
+  Admission Admit(const NL80211Packet& request,
+                  std::vector<std::unique_ptr<const NL80211Packet>>* response);
+
+  // Records the |response| kernel sent to an admitted |request|, so that
+  // identical queries can be coalesced onto it.
+  void OnResponse(
+      const NL80211Packet& request,
+      const std::vector<std::unique_ptr<const NL80211Packet>>& response);
+
+  // Drops the cached responses which |event| may have made stale: those of
+  // the query classes the event affects, on the interface it carries.
+  void OnEvent(const NL80211Packet& event);
+
+  // Drops all cached responses. This should be called when kernel state
+  // may have changed in an unknown way, e.g. when events were lost.
+  void InvalidateResponses();
+
+  Stats GetStats(RequestClass request_class) const;
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  struct Bucket {
+    Budget budget;
+    uint32_t tokens;
+    int64_t last_refill_ns;
+    Stats stats;
+  };
+
+  struct CachedResponse {
+    RequestClass request_class;
+    // 0 if the query isn't bound to an interface.
+    uint32_t interface_index;
+    int64_t timestamp_ns;
+    std::vector<std::vector<uint8_t>> packets;
+  };
+
+  // Returns the request bytes without sequence number and port id, so that
+  // identical queries have identical keys.
+  static std::vector<uint8_t> GetRequestKey(const NL80211Packet& request);
+  static std::unique_ptr<const NL80211Packet> CreateBusyError(
+      const NL80211Packet& request);
+  void Refill(Bucket* bucket, int64_t now_ns);
+  bool Coalesce(const NL80211Packet& request,
+                const Bucket& bucket,
+                int64_t now_ns,
+                std::vector<std::unique_ptr<const NL80211Packet>>* response);
+
+  Clock clock_;
+  mutable std::mutex lock_;
+  Bucket buckets_[kNumRequestClasses];
+  // Mapping from request key to the latest response to this request.
+  std::map<std::vector<uint8_t>, CachedResponse> cached_responses_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetlinkRateLimiter);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NETLINK_RATE_LIMITER_H_
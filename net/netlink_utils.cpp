@@ -39,6 +39,15 @@ namespace {
 uint32_t k2GHzFrequencyLowerBound = 2400;
 uint32_t k2GHzFrequencyUpperBound = 2500;
 
+// Packs |mac_address| into the variant of a request template.
+uint64_t GetMacAddressVariant(const MacAddress& mac_address) {
+  uint64_t variant = 0;
+  for (size_t i = 0; i < mac_address.size(); i++) {
+    variant = (variant << 8) | mac_address.data()[i];
+  }
+  return variant;
+}
+
 }  // namespace
 NetlinkUtils::NetlinkUtils(NetlinkManager* netlink_manager)
     : netlink_manager_(netlink_manager) {
@@ -149,7 +158,7 @@ bool NetlinkUtils::GetInterfaces(uint32_t wiphy_index,
       continue;
     }
 
-    vector<uint8_t> if_mac_addr;
+    MacAddress if_mac_addr;
     if (!packet->GetAttributeValue(NL80211_ATTR_MAC, &if_mac_addr)) {
       LOG(WARNING) << "Failed to get interface mac address";
       continue;
@@ -192,50 +201,366 @@ bool NetlinkUtils::SetInterfaceMode(uint32_t interface_index,
   return true;
 }
 
+bool NetlinkUtils::SetCqmRssiConfig(uint32_t interface_index,
+                                    int32_t rssi_threshold_dbm,
+                                    uint32_t rssi_hysteresis_db) {
+  NL80211Packet set_cqm(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_SET_CQM,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  // Force an ACK response upon success.
+  set_cqm.AddFlag(NLM_F_ACK);
+
+  set_cqm.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  NL80211NestedAttr cqm_attr(NL80211_ATTR_CQM);
+  // Kernel reads the threshold as a signed value.
+  cqm_attr.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_CQM_RSSI_THOLD,
+                            static_cast<uint32_t>(rssi_threshold_dbm)));
+  cqm_attr.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_CQM_RSSI_HYST, rssi_hysteresis_db));
+  set_cqm.AddAttribute(cqm_attr);
+
+  if (!netlink_manager_->SendMessageAndGetAck(set_cqm)) {
+    LOG(ERROR) << "NL80211_CMD_SET_CQM failed";
+    return false;
+  }
+
+  return true;
+}
+
+bool NetlinkUtils::CreateInterface(uint32_t wiphy_index,
+                                   const string& name,
+                                   uint32_t iftype,
+                                   InterfaceInfo* out_interface) {
+  NL80211Packet new_interface(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_INTERFACE,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_interface.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index));
+  new_interface.AddAttribute(NL80211Attr<string>(NL80211_ATTR_IFNAME, name));
+  new_interface.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFTYPE, iftype));
+
+  // Kernel replies with the description of the new interface.
+  unique_ptr<const NL80211Packet> response;
+  if (!netlink_manager_->SendMessageAndGetSingleResponse(new_interface,
+                                                         &response)) {
+    LOG(ERROR) << "NL80211_CMD_NEW_INTERFACE failed";
+    return false;
+  }
+  if (response->GetCommand() != NL80211_CMD_NEW_INTERFACE) {
+    LOG(ERROR) << "Wrong command in response to a new interface request: "
+               << static_cast<int>(response->GetCommand());
+    return false;
+  }
+  InterfaceInfo interface;
+  if (!response->GetAttributeValue(NL80211_ATTR_IFINDEX, &interface.index) ||
+      !response->GetAttributeValue(NL80211_ATTR_IFNAME, &interface.name) ||
+      !response->GetAttributeValue(NL80211_ATTR_MAC,
+                                   &interface.mac_address)) {
+    LOG(ERROR) << "Failed to get the new interface " << name;
+    return false;
+  }
+  *out_interface = interface;
+  return true;
+}
+
+bool NetlinkUtils::DeleteInterface(uint32_t interface_index) {
+  NL80211Packet del_interface(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_DEL_INTERFACE,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  // Force an ACK response upon success.
+  del_interface.AddFlag(NLM_F_ACK);
+  del_interface.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+
+  if (!netlink_manager_->SendMessageAndGetAck(del_interface)) {
+    LOG(ERROR) << "NL80211_CMD_DEL_INTERFACE failed";
+    return false;
+  }
+  return true;
+}
+
+bool InterfaceCombination::Allows(const vector<uint32_t>& iftypes) const {
+  if (iftypes.size() > max_interfaces) {
+    return false;
+  }
+  vector<uint32_t> remaining;
+  for (const Limit& limit : limits) {
+    remaining.push_back(limit.max);
+  }
+  for (uint32_t iftype : iftypes) {
+    bool found = false;
+    for (size_t i = 0; i < limits.size(); i++) {
+      if (iftype < 32 && (limits[i].types & (1u << iftype))) {
+        if (remaining[i] == 0) {
+          return false;
+        }
+        remaining[i]--;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BandInfo::BandInfo(const vector<ChannelInfo>& channels) {
+  for (const auto& channel : channels) {
+    // Channel is disabled in current regulatory domain.
+    if (channel.disabled) {
+      continue;
+    }
+    // If this is an available/usable DFS frequency, we should save it to
+    // DFS frequencies list.
+    if (channel.dfs_state == NL80211_DFS_AVAILABLE ||
+        channel.dfs_state == NL80211_DFS_USABLE) {
+      band_dfs.push_back(channel.frequency);
+    } else {
+      // Since there is no guarantee for the order of band attributes,
+      // we do some math here.
+      if (channel.frequency > k2GHzFrequencyLowerBound &&
+          channel.frequency < k2GHzFrequencyUpperBound) {
+        band_2g.push_back(channel.frequency);
+      } else {
+        band_5g.push_back(channel.frequency);
+      }
+    }
+  }
+}
+
+bool ChannelInfo::operator==(const ChannelInfo& rhs) const {
+  return frequency == rhs.frequency &&
+         max_tx_power_mbm == rhs.max_tx_power_mbm &&
+         disabled == rhs.disabled &&
+         no_ir == rhs.no_ir &&
+         radar == rhs.radar &&
+         dfs_state == rhs.dfs_state &&
+         no_ht40_minus == rhs.no_ht40_minus &&
+         no_ht40_plus == rhs.no_ht40_plus &&
+         no_80mhz == rhs.no_80mhz &&
+         no_160mhz == rhs.no_160mhz;
+}
+
 bool NetlinkUtils::GetWiphyInfo(
     uint32_t wiphy_index,
     BandInfo* out_band_info,
     ScanCapabilities* out_scan_capabilities,
     WiphyFeatures* out_wiphy_features) {
-  NL80211Packet get_wiphy(
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!DumpWiphy(wiphy_index, &response)) {
+    return false;
+  }
+
+  vector<ChannelInfo> channels;
+  ScanCapabilities scan_capabilities(0, 0, 0, 0, 0, 0);
+  uint32_t feature_flags = 0;
+  // Kernels older than 4.4 don't report extended features.
+  vector<uint8_t> ext_feature_flags;
+  bool has_scan_capabilities = false;
+  bool has_feature_flags = false;
+  // Each message carries a part of the wiphy information. Merge them in
+  // the order they arrive.
+  for (auto& packet : response) {
+    if (!MergeChannels(packet.get(), &channels) ||
+        !MergeScanCapabilities(packet.get(),
+                               &scan_capabilities,
+                               &has_scan_capabilities)) {
+      return false;
+    }
+    if (packet->GetAttributeValue(NL80211_ATTR_FEATURE_FLAGS,
+                                  &feature_flags)) {
+      has_feature_flags = true;
+    }
+    packet->GetAttributeValue(NL80211_ATTR_EXT_FEATURES, &ext_feature_flags);
+  }
+  if (!has_scan_capabilities) {
+    LOG(ERROR) << "Failed to get scan capabilities";
+    return false;
+  }
+  if (!has_feature_flags) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_FEATURE_FLAGS";
+    return false;
+  }
+  *out_band_info = BandInfo(channels);
+  *out_scan_capabilities = scan_capabilities;
+  *out_wiphy_features = WiphyFeatures(feature_flags, ext_feature_flags);
+  return true;
+}
+
+bool NetlinkUtils::GetChannels(uint32_t wiphy_index,
+                               vector<ChannelInfo>* out_channels) {
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!DumpWiphy(wiphy_index, &response)) {
+    return false;
+  }
+  vector<ChannelInfo> channels;
+  for (auto& packet : response) {
+    if (!MergeChannels(packet.get(), &channels)) {
+      return false;
+    }
+  }
+  *out_channels = std::move(channels);
+  return true;
+}
+
+bool NetlinkUtils::GetInterfaceCombinations(
+    uint32_t wiphy_index,
+    vector<InterfaceCombination>* out_combinations) {
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!DumpWiphy(wiphy_index, &response)) {
+    return false;
+  }
+  vector<InterfaceCombination> combinations;
+  for (auto& packet : response) {
+    if (!MergeInterfaceCombinations(packet.get(), &combinations)) {
+      return false;
+    }
+  }
+  *out_combinations = std::move(combinations);
+  return true;
+}
+
+bool NetlinkUtils::GetRegulatoryDomain(uint32_t wiphy_index,
+                                       RegulatoryDomain* out_regulatory_domain) {
+  NL80211Packet get_reg(
       netlink_manager_->GetFamilyId(),
-      NL80211_CMD_GET_WIPHY,
+      NL80211_CMD_GET_REG,
       netlink_manager_->GetSequenceNumber(),
       getpid());
-  get_wiphy.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index));
+  // Kernel replies with the regulatory domain of this wiphy if it has a
+  // private one, otherwise with the global regulatory domain.
+  get_reg.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index));
   unique_ptr<const NL80211Packet> response;
-  if (!netlink_manager_->SendMessageAndGetSingleResponse(get_wiphy,
+  if (!netlink_manager_->SendMessageAndGetSingleResponse(get_reg,
                                                          &response)) {
-    LOG(ERROR) << "NL80211_CMD_GET_WIPHY failed";
+    LOG(ERROR) << "NL80211_CMD_GET_REG failed";
     return false;
   }
-  if (response->GetCommand() != NL80211_CMD_NEW_WIPHY) {
-    LOG(ERROR) << "Wrong command in response to a get wiphy request: "
+  if (response->GetCommand() != NL80211_CMD_GET_REG) {
+    LOG(ERROR) << "Wrong command in response to a get regulatory request: "
                << static_cast<int>(response->GetCommand());
     return false;
   }
-  if (!ParseBandInfo(response.get(), out_band_info) ||
-      !ParseScanCapabilities(response.get(), out_scan_capabilities)) {
+  RegulatoryDomain regulatory_domain;
+  if (!response->GetAttributeValue(NL80211_ATTR_REG_ALPHA2,
+                                   &regulatory_domain.country_code)) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_REG_ALPHA2";
     return false;
   }
-  uint32_t feature_flags;
-  if (!response->GetAttributeValue(NL80211_ATTR_FEATURE_FLAGS,
-                                   &feature_flags)) {
-    LOG(ERROR) << "Failed to get NL80211_ATTR_FEATURE_FLAGS";
+  // Not all kernels report DFS region.
+  response->GetAttributeValue(NL80211_ATTR_DFS_REGION,
+                              &regulatory_domain.dfs_region);
+  NL80211NestedAttr rules_attr(0);
+  if (!response->GetAttribute(NL80211_ATTR_REG_RULES, &rules_attr)) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_REG_RULES";
+    return false;
+  }
+  vector<NL80211NestedAttr> rules;
+  if (!rules_attr.GetListOfNestedAttributes(&rules)) {
+    LOG(ERROR) << "Failed to get rules within NL80211_ATTR_REG_RULES";
     return false;
   }
-  *out_wiphy_features = WiphyFeatures(feature_flags);
+  for (auto& rule : rules) {
+    RegulatoryRule regulatory_rule;
+    if (!rule.GetAttributeValue(NL80211_ATTR_FREQ_RANGE_START,
+                                &regulatory_rule.start_frequency_khz) ||
+        !rule.GetAttributeValue(NL80211_ATTR_FREQ_RANGE_END,
+                                &regulatory_rule.end_frequency_khz)) {
+      LOG(ERROR) << "Failed to get frequency range of regulatory rule";
+      return false;
+    }
+    rule.GetAttributeValue(NL80211_ATTR_FREQ_RANGE_MAX_BW,
+                           &regulatory_rule.max_bandwidth_khz);
+    rule.GetAttributeValue(NL80211_ATTR_POWER_RULE_MAX_EIRP,
+                           &regulatory_rule.max_eirp_mbm);
+    rule.GetAttributeValue(NL80211_ATTR_REG_RULE_FLAGS,
+                           &regulatory_rule.flags);
+    regulatory_domain.rules.push_back(regulatory_rule);
+  }
+  *out_regulatory_domain = regulatory_domain;
   return true;
 }
 
-bool NetlinkUtils::ParseScanCapabilities(
+bool NetlinkUtils::DumpWiphy(
+    uint32_t wiphy_index,
+    vector<unique_ptr<const NL80211Packet>>* out_packets) {
+  NL80211Packet get_wiphy(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_WIPHY,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  // Capabilities of a wiphy with many bands and channels don't fit in a
+  // single message. Ask kernel to split them over a multipart dump, which is
+  // restricted to |wiphy_index| by NL80211_ATTR_WIPHY.
+  get_wiphy.AddFlag(NLM_F_DUMP);
+  get_wiphy.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index));
+  get_wiphy.AddFlagAttribute(NL80211_ATTR_SPLIT_WIPHY_DUMP);
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!netlink_manager_->SendMessageAndGetResponses(get_wiphy, &response)) {
+    LOG(ERROR) << "NL80211_CMD_GET_WIPHY dump failed";
+    return false;
+  }
+  if (response.empty()) {
+    LOG(ERROR) << "No wiphy is found";
+    return false;
+  }
+  out_packets->clear();
+  for (auto& packet : response) {
+    if (packet->GetMessageType() == NLMSG_ERROR) {
+      LOG(ERROR) << "Receive ERROR message: "
+                 << strerror(packet->GetErrorCode());
+      return false;
+    }
+    if (packet->GetMessageType() != netlink_manager_->GetFamilyId()) {
+      LOG(ERROR) << "Wrong message type for new wiphy message: "
+                 << packet->GetMessageType();
+      return false;
+    }
+    if (packet->GetCommand() != NL80211_CMD_NEW_WIPHY) {
+      LOG(ERROR) << "Wrong command in response to a get wiphy request: "
+                 << static_cast<int>(packet->GetCommand());
+      return false;
+    }
+    // Kernels which don't filter the dump report all wiphys.
+    uint32_t packet_wiphy_index;
+    if (packet->GetAttributeValue(NL80211_ATTR_WIPHY, &packet_wiphy_index) &&
+        packet_wiphy_index != wiphy_index) {
+      continue;
+    }
+    out_packets->push_back(std::move(packet));
+  }
+  return true;
+}
+
+bool NetlinkUtils::MergeScanCapabilities(
     const NL80211Packet* const packet,
-    ScanCapabilities* out_scan_capabilities) {
+    ScanCapabilities* scan_capabilities,
+    bool* has_scan_capabilities) {
+  // Scan plan capabilities are optional, and they don't come in the same
+  // message as the other scan capabilities in a split dump.
+  packet->GetAttributeValue(NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS,
+                            &scan_capabilities->max_num_scan_plans);
+  packet->GetAttributeValue(NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL,
+                            &scan_capabilities->max_scan_plan_interval);
+  packet->GetAttributeValue(NL80211_ATTR_MAX_SCAN_PLAN_ITERATIONS,
+                            &scan_capabilities->max_scan_plan_iterations);
+
+  // Kernel reports the following capabilities together.
   uint8_t max_num_scan_ssids;
   if (!packet->GetAttributeValue(NL80211_ATTR_MAX_NUM_SCAN_SSIDS,
                                    &max_num_scan_ssids)) {
-    LOG(ERROR) << "Failed to get the capacity of maximum number of scan ssids";
-    return false;
+    return true;
   }
 
   uint8_t max_num_sched_scan_ssids;
@@ -246,17 +571,6 @@ bool NetlinkUtils::ParseScanCapabilities(
     return false;
   }
 
-  // Use default value 0 for scan plan capabilities if attributes are missing.
-  uint32_t max_num_scan_plans = 0;
-  packet->GetAttributeValue(NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS,
-                            &max_num_scan_plans);
-  uint32_t max_scan_plan_interval = 0;
-  packet->GetAttributeValue(NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL,
-                            &max_scan_plan_interval);
-  uint32_t max_scan_plan_iterations = 0;
-  packet->GetAttributeValue(NL80211_ATTR_MAX_SCAN_PLAN_ITERATIONS,
-                            &max_scan_plan_iterations);
-
   uint8_t max_match_sets;
   if (!packet->GetAttributeValue(NL80211_ATTR_MAX_MATCH_SETS,
                                    &max_match_sets)) {
@@ -264,31 +578,78 @@ bool NetlinkUtils::ParseScanCapabilities(
                << "of a scheduled scan";
     return false;
   }
-  *out_scan_capabilities = ScanCapabilities(max_num_scan_ssids,
-                                            max_num_sched_scan_ssids,
-                                            max_match_sets,
-                                            max_num_scan_plans,
-                                            max_scan_plan_interval,
-                                            max_scan_plan_iterations);
+  scan_capabilities->max_num_scan_ssids = max_num_scan_ssids;
+  scan_capabilities->max_num_sched_scan_ssids = max_num_sched_scan_ssids;
+  scan_capabilities->max_match_sets = max_match_sets;
+  *has_scan_capabilities = true;
   return true;
 }
 
-bool NetlinkUtils::ParseBandInfo(const NL80211Packet* const packet,
-                                 BandInfo* out_band_info) {
+bool NetlinkUtils::MergeInterfaceCombinations(
+    const NL80211Packet* const packet,
+    vector<InterfaceCombination>* combinations) {
+  NL80211NestedAttr combinations_attr(0);
+  if (!packet->GetAttribute(NL80211_ATTR_INTERFACE_COMBINATIONS,
+                            &combinations_attr)) {
+    // Not every message of a split dump carries interface combinations.
+    return true;
+  }
+  vector<NL80211NestedAttr> combination_attrs;
+  if (!combinations_attr.GetListOfNestedAttributes(&combination_attrs)) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_INTERFACE_COMBINATIONS";
+    return false;
+  }
+  for (auto& combination_attr : combination_attrs) {
+    InterfaceCombination combination;
+    NL80211NestedAttr limits_attr(0);
+    vector<NL80211NestedAttr> limit_attrs;
+    if (!combination_attr.GetAttributeValue(NL80211_IFACE_COMB_MAXNUM,
+                                            &combination.max_interfaces) ||
+        !combination_attr.GetAttribute(NL80211_IFACE_COMB_LIMITS,
+                                       &limits_attr) ||
+        !limits_attr.GetListOfNestedAttributes(&limit_attrs)) {
+      LOG(ERROR) << "Failed to parse interface combination";
+      return false;
+    }
+    combination_attr.GetAttributeValue(NL80211_IFACE_COMB_NUM_CHANNELS,
+                                       &combination.num_channels);
+    for (auto& limit_attr : limit_attrs) {
+      InterfaceCombination::Limit limit;
+      NL80211NestedAttr types_attr(0);
+      vector<NL80211NestedAttr> type_attrs;
+      if (!limit_attr.GetAttributeValue(NL80211_IFACE_LIMIT_MAX, &limit.max) ||
+          !limit_attr.GetAttribute(NL80211_IFACE_LIMIT_TYPES, &types_attr) ||
+          !types_attr.GetListOfNestedAttributes(&type_attrs)) {
+        LOG(ERROR) << "Failed to parse interface combination limit";
+        return false;
+      }
+      // Interface types are flag attributes, whose ids are the types.
+      for (auto& type_attr : type_attrs) {
+        if (type_attr.GetAttributeId() < 32) {
+          limit.types |= 1u << type_attr.GetAttributeId();
+        }
+      }
+      combination.limits.push_back(limit);
+    }
+    combinations->push_back(combination);
+  }
+  return true;
+}
 
+bool NetlinkUtils::MergeChannels(const NL80211Packet* const packet,
+                                 vector<ChannelInfo>* channels) {
   NL80211NestedAttr bands_attr(0);
   if (!packet->GetAttribute(NL80211_ATTR_WIPHY_BANDS, &bands_attr)) {
-    LOG(ERROR) << "Failed to get NL80211_ATTR_WIPHY_BANDS";
-    return false;
+    // Not every message of a split dump carries bands.
+    return true;
   }
   vector<NL80211NestedAttr> bands;
   if (!bands_attr.GetListOfNestedAttributes(&bands)) {
     LOG(ERROR) << "Failed to get bands within NL80211_ATTR_WIPHY_BANDS";
     return false;
   }
-  vector<uint32_t> frequencies_2g;
-  vector<uint32_t> frequencies_5g;
-  vector<uint32_t> frequencies_dfs;
+  // In a split dump the frequencies of one band may be spread over several
+  // messages, and each frequency is reported once. So we simply append them.
   for (unsigned int band_index = 0; band_index < bands.size(); band_index++) {
     NL80211NestedAttr freqs_attr(0);
     if (!bands[band_index].GetAttribute(NL80211_BAND_ATTR_FREQS, &freqs_attr)) {
@@ -301,55 +662,55 @@ bool NetlinkUtils::ParseBandInfo(const NL80211Packet* const packet,
       continue;
     }
     for (auto& freq : freqs) {
-      uint32_t frequency_value;
+      ChannelInfo channel;
       if (!freq.GetAttributeValue(NL80211_FREQUENCY_ATTR_FREQ,
-                                  &frequency_value)) {
+                                  &channel.frequency)) {
         LOG(DEBUG) << "Failed to get NL80211_FREQUENCY_ATTR_FREQ";
         continue;
       }
-      // Channel is disabled in current regulatory domain.
-      if (freq.HasAttribute(NL80211_FREQUENCY_ATTR_DISABLED)) {
-        continue;
-      }
-      // If this is an available/usable DFS frequency, we should save it to
-      // DFS frequencies list.
-      uint32_t dfs_state;
-      if (freq.GetAttributeValue(NL80211_FREQUENCY_ATTR_DFS_STATE,
-                                 &dfs_state) &&
-          (dfs_state == NL80211_DFS_AVAILABLE ||
-               dfs_state == NL80211_DFS_USABLE)) {
-        frequencies_dfs.push_back(frequency_value);
-      } else {
-        // Since there is no guarantee for the order of band attributes,
-        // we do some math here.
-        if (frequency_value > k2GHzFrequencyLowerBound &&
-            frequency_value < k2GHzFrequencyUpperBound) {
-          frequencies_2g.push_back(frequency_value);
-        } else {
-          frequencies_5g.push_back(frequency_value);
-        }
-      }
+      freq.GetAttributeValue(NL80211_FREQUENCY_ATTR_MAX_TX_POWER,
+                             &channel.max_tx_power_mbm);
+      channel.disabled = freq.HasAttribute(NL80211_FREQUENCY_ATTR_DISABLED);
+      channel.no_ir = freq.HasAttribute(NL80211_FREQUENCY_ATTR_NO_IR);
+      channel.radar = freq.HasAttribute(NL80211_FREQUENCY_ATTR_RADAR);
+      freq.GetAttributeValue(NL80211_FREQUENCY_ATTR_DFS_STATE,
+                             &channel.dfs_state);
+      channel.no_ht40_minus =
+          freq.HasAttribute(NL80211_FREQUENCY_ATTR_NO_HT40_MINUS);
+      channel.no_ht40_plus =
+          freq.HasAttribute(NL80211_FREQUENCY_ATTR_NO_HT40_PLUS);
+      channel.no_80mhz = freq.HasAttribute(NL80211_FREQUENCY_ATTR_NO_80MHZ);
+      channel.no_160mhz = freq.HasAttribute(NL80211_FREQUENCY_ATTR_NO_160MHZ);
+      channels->push_back(channel);
     }
   }
-  *out_band_info = BandInfo(frequencies_2g, frequencies_5g, frequencies_dfs);
   return true;
 }
 
 bool NetlinkUtils::GetStationInfo(uint32_t interface_index,
-                                  const vector<uint8_t>& mac_address,
+                                  const MacAddress& mac_address,
                                   StationInfo* out_station_info) {
-  NL80211Packet get_station(
-      netlink_manager_->GetFamilyId(),
-      NL80211_CMD_GET_STATION,
-      netlink_manager_->GetSequenceNumber(),
-      getpid());
-  get_station.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
-                                                 interface_index));
-  get_station.AddAttribute(NL80211Attr<vector<uint8_t>>(NL80211_ATTR_MAC,
-                                                        mac_address));
+  // Only the sequence number changes between polls of the same station.
+  uint64_t variant = GetMacAddressVariant(mac_address);
+  uint32_t sequence = netlink_manager_->GetSequenceNumber();
+  NL80211Packet* get_station = request_templates_.Get(
+      NL80211_CMD_GET_STATION, interface_index, variant, sequence, getpid());
+  if (get_station == nullptr) {
+    unique_ptr<NL80211Packet> request(new NL80211Packet(
+        netlink_manager_->GetFamilyId(),
+        NL80211_CMD_GET_STATION,
+        sequence,
+        getpid()));
+    request->AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
+                                                interface_index));
+    request->AddAttribute(NL80211Attr<MacAddress>(NL80211_ATTR_MAC,
+                                                  mac_address));
+    get_station = request_templates_.Put(interface_index, variant,
+                                         std::move(request));
+  }
 
   unique_ptr<const NL80211Packet> response;
-  if (!netlink_manager_->SendMessageAndGetSingleResponse(get_station,
+  if (!netlink_manager_->SendMessageAndGetSingleResponse(*get_station,
                                                          &response)) {
     LOG(ERROR) << "NL80211_CMD_GET_STATION failed";
     return false;
@@ -427,5 +788,35 @@ void NetlinkUtils::UnsubscribeStationEvent(uint32_t interface_index) {
   netlink_manager_->UnsubscribeStationEvent(interface_index);
 }
 
+void NetlinkUtils::SubscribeEventOverrun(uint32_t interface_index,
+                                         OnEventOverrunHandler handler) {
+  netlink_manager_->SubscribeEventOverrun(interface_index, handler);
+}
+
+void NetlinkUtils::UnsubscribeEventOverrun(uint32_t interface_index) {
+  netlink_manager_->UnsubscribeEventOverrun(interface_index);
+}
+
+void NetlinkUtils::DropRequestTemplates(uint32_t interface_index) {
+  request_templates_.RemoveInterface(interface_index);
+}
+
+void NetlinkUtils::SubscribeEvent(uint8_t command,
+                                  uint32_t interface_index,
+                                  NL80211EventObserver* observer,
+                                  NL80211EventSubscription* subscription) {
+  netlink_manager_->SubscribeEvent(command, interface_index, observer,
+                                   subscription);
+}
+
+std::recursive_mutex& NetlinkUtils::GetInterfaceLock(
+    uint32_t interface_index) {
+  return netlink_manager_->GetInterfaceLock(interface_index);
+}
+
+void NetlinkUtils::Dump(std::stringstream* ss) const {
+  netlink_manager_->Dump(ss);
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -17,6 +17,8 @@
 #ifndef WIFICOND_NET_NETLINK_UTILS_H_
 #define WIFICOND_NET_NETLINK_UTILS_H_
 
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -24,16 +26,30 @@
 
 #include <android-base/macros.h>
 
+#include "wificond/net/mac_address.h"
 #include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_request_cache.h"
 
 namespace android {
 namespace wificond {
 
+// Scan type definitions from linux/nl80211.h of kernel 4.17.
+// They are defined here because older kernel headers don't have them.
+// NL80211_EXT_FEATURE_LOW_SPAN_SCAN and friends, indices of bits in
+// NL80211_ATTR_EXT_FEATURES.
+constexpr uint32_t kExtFeatureLowSpanScan = 22;
+constexpr uint32_t kExtFeatureLowPowerScan = 23;
+constexpr uint32_t kExtFeatureHighAccuracyScan = 24;
+// NL80211_SCAN_FLAG_LOW_SPAN and friends, in NL80211_ATTR_SCAN_FLAGS.
+constexpr uint32_t kScanFlagLowSpan = 1 << 8;
+constexpr uint32_t kScanFlagLowPower = 1 << 9;
+constexpr uint32_t kScanFlagHighAccuracy = 1 << 10;
+
 struct InterfaceInfo {
   InterfaceInfo() = default;
   InterfaceInfo(uint32_t index_,
                 const std::string name_,
-                const std::vector<uint8_t> mac_address_)
+                const MacAddress& mac_address_)
       : index(index_),
         name(name_),
         mac_address(mac_address_) {}
@@ -42,11 +58,76 @@ struct InterfaceInfo {
   // Name of this interface.
   std::string name;
   // MAC address of this interface.
-  std::vector<uint8_t> mac_address;
+  MacAddress mac_address;
+};
+
+// Value of ChannelInfo::dfs_state for channels without radar detection.
+constexpr uint32_t kDfsStateNone = 0xffffffff;
+
+struct ChannelInfo {
+  ChannelInfo()
+      : frequency(0),
+        max_tx_power_mbm(0),
+        disabled(false),
+        no_ir(false),
+        radar(false),
+        dfs_state(kDfsStateNone),
+        no_ht40_minus(false),
+        no_ht40_plus(false),
+        no_80mhz(false),
+        no_160mhz(false) {}
+  bool operator==(const ChannelInfo& rhs) const;
+  bool operator!=(const ChannelInfo& rhs) const { return !(*this == rhs); }
+  // Center frequency in MHz.
+  uint32_t frequency;
+  // Maximum transmission power in mBm.
+  uint32_t max_tx_power_mbm;
+  // Channel is not allowed in current regulatory domain.
+  bool disabled;
+  // No mechanisms that initiate radiation are permitted on this channel,
+  // which includes active scanning.
+  bool no_ir;
+  // Radar detection is required on this channel.
+  bool radar;
+  // One of |enum nl80211_dfs_state|, or kDfsStateNone.
+  uint32_t dfs_state;
+  // Width limits of this channel.
+  bool no_ht40_minus;
+  bool no_ht40_plus;
+  bool no_80mhz;
+  bool no_160mhz;
+};
+
+struct RegulatoryRule {
+  RegulatoryRule()
+      : start_frequency_khz(0),
+        end_frequency_khz(0),
+        max_bandwidth_khz(0),
+        max_eirp_mbm(0),
+        flags(0) {}
+  uint32_t start_frequency_khz;
+  uint32_t end_frequency_khz;
+  uint32_t max_bandwidth_khz;
+  // Maximum EIRP in mBm.
+  uint32_t max_eirp_mbm;
+  // Set of |enum nl80211_reg_rule_flags|.
+  uint32_t flags;
+};
+
+struct RegulatoryDomain {
+  RegulatoryDomain() : dfs_region(0) {}
+  // ISO / IEC 3166 alpha2 country code, or "00" for the world regulatory
+  // domain.
+  std::string country_code;
+  // One of |enum nl80211_dfs_regions|.
+  uint8_t dfs_region;
+  std::vector<RegulatoryRule> rules;
 };
 
 struct BandInfo {
   BandInfo() = default;
+  // Groups usable |channels| by band.
+  explicit BandInfo(const std::vector<ChannelInfo>& channels);
   BandInfo(std::vector<uint32_t>& band_2g_,
            std::vector<uint32_t>& band_5g_,
            std::vector<uint32_t>& band_dfs_)
@@ -94,20 +175,75 @@ struct ScanCapabilities {
 struct WiphyFeatures {
   WiphyFeatures()
       : supports_random_mac_oneshot_scan(false),
-        supports_random_mac_sched_scan(false) {}
+        supports_random_mac_sched_scan(false),
+        supports_low_priority_oneshot_scan(false),
+        supports_low_span_oneshot_scan(false),
+        supports_low_power_oneshot_scan(false),
+        supports_high_accuracy_oneshot_scan(false) {}
   WiphyFeatures(uint32_t feature_flags)
+      : WiphyFeatures(feature_flags, std::vector<uint8_t>()) {}
+  // |ext_feature_flags| is the NL80211_ATTR_EXT_FEATURES bitmap, indexed by
+  // enum nl80211_ext_feature_index.
+  WiphyFeatures(uint32_t feature_flags,
+                const std::vector<uint8_t>& ext_feature_flags)
       : supports_random_mac_oneshot_scan(
             feature_flags & NL80211_FEATURE_SCAN_RANDOM_MAC_ADDR),
         supports_random_mac_sched_scan(
-            feature_flags & NL80211_FEATURE_SCHED_SCAN_RANDOM_MAC_ADDR) {}
+            feature_flags & NL80211_FEATURE_SCHED_SCAN_RANDOM_MAC_ADDR),
+        supports_low_priority_oneshot_scan(
+            feature_flags & NL80211_FEATURE_LOW_PRIORITY_SCAN),
+        supports_low_span_oneshot_scan(HasExtFeature(
+            ext_feature_flags, kExtFeatureLowSpanScan)),
+        supports_low_power_oneshot_scan(HasExtFeature(
+            ext_feature_flags, kExtFeatureLowPowerScan)),
+        supports_high_accuracy_oneshot_scan(HasExtFeature(
+            ext_feature_flags, kExtFeatureHighAccuracyScan)) {}
   // This device/driver supports using a random MAC address during scan
   // (while not associated).
   bool supports_random_mac_oneshot_scan;
   // This device/driver supports using a random MAC address for every
   // scan iteration during scheduled scan (while not associated).
   bool supports_random_mac_sched_scan;
-  // There are other flags included in NL80211_ATTR_FEATURE_FLAGS.
+  // This device/driver supports scans which yield to other traffic.
+  bool supports_low_priority_oneshot_scan;
+  // This device/driver supports low span, low power and high accuracy
+  // scans. See kScanFlagLowSpan and friends.
+  bool supports_low_span_oneshot_scan;
+  bool supports_low_power_oneshot_scan;
+  bool supports_high_accuracy_oneshot_scan;
+  // There are other flags included in NL80211_ATTR_FEATURE_FLAGS and
+  // NL80211_ATTR_EXT_FEATURES.
   // We will add them once we find them useful.
+
+ private:
+  static bool HasExtFeature(const std::vector<uint8_t>& ext_feature_flags,
+                            uint32_t feature) {
+    return feature / 8 < ext_feature_flags.size() &&
+           (ext_feature_flags[feature / 8] & (1 << (feature % 8)));
+  }
+};
+
+// One of the NL80211_ATTR_INTERFACE_COMBINATIONS of a wiphy, i.e. a set of
+// interfaces which the wiphy can run concurrently.
+struct InterfaceCombination {
+  struct Limit {
+    Limit() : max(0), types(0) {}
+    Limit(uint32_t max_, uint32_t types_) : max(max_), types(types_) {}
+    // Maximum number of interfaces of |types|.
+    uint32_t max;
+    // Bitmap of (1 << |enum nl80211_iftype|).
+    uint32_t types;
+  };
+  InterfaceCombination() : max_interfaces(0), num_channels(0) {}
+  // Returns true if interfaces of |iftypes| can run concurrently under this
+  // combination. Every interface takes a slot from the first limit which
+  // includes its type, the same way cfg80211 checks combinations.
+  bool Allows(const std::vector<uint32_t>& iftypes) const;
+  std::vector<Limit> limits;
+  // Maximum total number of interfaces.
+  uint32_t max_interfaces;
+  // Number of different channels these interfaces can use at the same time.
+  uint32_t num_channels;
 };
 
 struct StationInfo {
@@ -168,20 +304,63 @@ class NetlinkUtils {
   virtual bool SetInterfaceMode(uint32_t interface_index,
                                 InterfaceMode mode);
 
+  // Create a virtual interface named |name| on wiphy |wiphy_index|.
+  // |iftype| is one of |enum nl80211_iftype|.
+  // |*out_interface| returns the new interface.
+  // Returns true on success.
+  virtual bool CreateInterface(uint32_t wiphy_index,
+                               const std::string& name,
+                               uint32_t iftype,
+                               InterfaceInfo* out_interface);
+
+  // Delete the interface with index |interface_index|.
+  // Returns true on success.
+  virtual bool DeleteInterface(uint32_t interface_index);
+
+  // Get the interface combinations supported by wiphy |wiphy_index|.
+  // |*out_combinations| is empty if the wiphy does not support running
+  // several interfaces at the same time.
+  // Returns true on success.
+  virtual bool GetInterfaceCombinations(
+      uint32_t wiphy_index,
+      std::vector<InterfaceCombination>* out_combinations);
+
   // Get wiphy capability information from kernel.
+  // This uses a split wiphy dump, so that capabilities of wiphys with many
+  // bands and channels are not truncated.
   // Returns true on success.
   virtual bool GetWiphyInfo(uint32_t wiphy_index,
                             BandInfo* out_band_info,
                             ScanCapabilities* out_scan_capabilities,
                             WiphyFeatures* out_wiphy_features);
 
+  // Get the channels of wiphy |wiphy_index| from kernel, including the
+  // channels that are disabled in current regulatory domain.
+  // Returns true on success.
+  virtual bool GetChannels(uint32_t wiphy_index,
+                           std::vector<ChannelInfo>* out_channels);
+
+  // Get the regulatory domain that applies to wiphy |wiphy_index| from kernel.
+  // Returns true on success.
+  virtual bool GetRegulatoryDomain(uint32_t wiphy_index,
+                                   RegulatoryDomain* out_regulatory_domain);
+
   // Get station info from kernel.
   // |*out_station_info]| is the struct of available station information.
   // Returns true on success.
   virtual bool GetStationInfo(uint32_t interface_index,
-                              const std::vector<uint8_t>& mac_address,
+                              const MacAddress& mac_address,
                               StationInfo* out_station_info);
 
+  // Configure connection quality monitoring of interface |interface_index|.
+  // Kernel sends a NL80211_CMD_NOTIFY_CQM event whenever the RSSI of the
+  // connection crosses |rssi_threshold_dbm| by more than |rssi_hysteresis_db|.
+  // A |rssi_threshold_dbm| of 0 disables RSSI monitoring.
+  // Returns true on success.
+  virtual bool SetCqmRssiConfig(uint32_t interface_index,
+                                int32_t rssi_threshold_dbm,
+                                uint32_t rssi_hysteresis_db);
+
   // Sign up to be notified when there is MLME event.
   // Only one handler can be registered per interface index.
   // New handler will replace the registered handler if they are for the
@@ -217,12 +396,60 @@ class NetlinkUtils {
   // Cancel the sign-up of receiving station events.
   virtual void UnsubscribeStationEvent(uint32_t interface_index);
 
+  // Sign up to be notified when kernel dropped multicast events, so that
+  // cached state of interface |interface_index| can be resynchronized.
+  // Only one handler can be registered per interface index.
+  // New handler will replace the registered handler if they are for the
+  // same interface index.
+  virtual void SubscribeEventOverrun(uint32_t interface_index,
+                                     OnEventOverrunHandler handler);
+
+  // Cancel the sign-up of receiving event overrun notifications.
+  virtual void UnsubscribeEventOverrun(uint32_t interface_index);
+
+  // Drops the pre-encoded requests of interface |interface_index|.
+  // This should be called when the interface goes away.
+  virtual void DropRequestTemplates(uint32_t interface_index);
+
+  // Sign up |observer| for multicast events with |command| from interface
+  // |interface_index|. Any number of observers can subscribe to the same
+  // event. See NetlinkManager::SubscribeEvent() for details.
+  virtual void SubscribeEvent(uint8_t command,
+                              uint32_t interface_index,
+                              NL80211EventObserver* observer,
+                              NL80211EventSubscription* subscription);
+
+  // Returns the lock which serializes the calls into the objects of
+  // interface |interface_index|. See NetlinkManager::GetInterfaceLock().
+  std::recursive_mutex& GetInterfaceLock(uint32_t interface_index);
+
+  // Dumps netlink statistics, including the numbers of requests which were
+  // coalesced or rejected by admission control.
+  void Dump(std::stringstream* ss) const;
+
  private:
-  bool ParseBandInfo(const NL80211Packet* const packet,
-                     BandInfo* out_band_info);
-  bool ParseScanCapabilities(const NL80211Packet* const packet,
-                             ScanCapabilities* out_scan_capabilities);
+  // Sends a split wiphy dump request for wiphy |wiphy_index|.
+  // |*out_packets| returns the messages which carry parts of this wiphy.
+  bool DumpWiphy(uint32_t wiphy_index,
+                 std::vector<std::unique_ptr<const NL80211Packet>>* out_packets);
+  // Appends the channels carried by |packet| to |*channels|.
+  bool MergeChannels(const NL80211Packet* const packet,
+                     std::vector<ChannelInfo>* channels);
+  // Merges the scan capabilities carried by |packet| into
+  // |*scan_capabilities|. |*has_scan_capabilities| is set to true once the
+  // mandatory scan capabilities are found.
+  bool MergeScanCapabilities(const NL80211Packet* const packet,
+                             ScanCapabilities* scan_capabilities,
+                             bool* has_scan_capabilities);
+  // Appends the interface combinations carried by |packet| to
+  // |*combinations|.
+  bool MergeInterfaceCombinations(
+      const NL80211Packet* const packet,
+      std::vector<InterfaceCombination>* combinations);
   NetlinkManager* netlink_manager_;
+  // Pre-encoded NL80211_CMD_GET_STATION requests, which are sent at every
+  // signal poll.
+  NL80211RequestCache request_templates_;
 
   DISALLOW_COPY_AND_ASSIGN(NetlinkUtils);
 };
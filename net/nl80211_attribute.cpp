@@ -29,6 +29,8 @@ template class NL80211Attr<uint32_t>;
 template class NL80211Attr<uint64_t>;
 template class NL80211Attr<vector<uint8_t>>;
 template class NL80211Attr<string>;
+template class NL80211Attr<MacAddress>;
+template class NL80211Attr<Ssid>;
 
 // For BaseNL80211Attr
 void BaseNL80211Attr::InitHeaderAndResize(int attribute_id,
@@ -82,6 +84,23 @@ bool BaseNL80211Attr::GetAttributeImpl(const uint8_t* buf,
   return false;
 }
 
+bool BaseNL80211Attr::GetMacAddressImpl(const uint8_t* buf,
+                                        size_t len,
+                                        int attr_id,
+                                        MacAddress* mac_address) {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  if (!GetAttributeImpl(buf, len, attr_id, &start, &end)) {
+    return false;
+  }
+  const nlattr* header = reinterpret_cast<const nlattr*>(start);
+  if (header->nla_len < NLA_HDRLEN) {
+    return false;
+  }
+  return MacAddress::FromBytes(start + NLA_HDRLEN,
+                               header->nla_len - NLA_HDRLEN,
+                               mac_address);
+}
 
 // For NL80211Attr<std::vector<uint8_t>>
 NL80211Attr<vector<uint8_t>>::NL80211Attr(int id,
@@ -130,6 +149,59 @@ string NL80211Attr<string>::GetValue() const {
                 str_length);
 }
 
+// For NL80211Attr<MacAddress>
+NL80211Attr<MacAddress>::NL80211Attr(int id, const MacAddress& mac_address) {
+  InitHeaderAndResize(id, mac_address.size());
+  memcpy(data_.data() + NLA_HDRLEN, mac_address.data(), mac_address.size());
+}
+
+NL80211Attr<MacAddress>::NL80211Attr(const vector<uint8_t>& data) {
+  data_ = data;
+}
+
+bool NL80211Attr<MacAddress>::IsValid() const {
+  if (!BaseNL80211Attr::IsValid()) {
+    return false;
+  }
+  const nlattr* header = reinterpret_cast<const nlattr*>(data_.data());
+  return header->nla_len == NLA_HDRLEN + MacAddress::kSize;
+}
+
+MacAddress NL80211Attr<MacAddress>::GetValue() const {
+  MacAddress mac_address;
+  MacAddress::FromBytes(data_.data() + NLA_HDRLEN, MacAddress::kSize,
+                        &mac_address);
+  return mac_address;
+}
+
+// For NL80211Attr<Ssid>
+NL80211Attr<Ssid>::NL80211Attr(int id, const Ssid& ssid) {
+  InitHeaderAndResize(id, ssid.size());
+  if (!ssid.empty()) {
+    memcpy(data_.data() + NLA_HDRLEN, ssid.data(), ssid.size());
+  }
+}
+
+NL80211Attr<Ssid>::NL80211Attr(const vector<uint8_t>& data) {
+  data_ = data;
+}
+
+bool NL80211Attr<Ssid>::IsValid() const {
+  if (!BaseNL80211Attr::IsValid()) {
+    return false;
+  }
+  const nlattr* header = reinterpret_cast<const nlattr*>(data_.data());
+  return header->nla_len <= NLA_HDRLEN + Ssid::kMaxSize;
+}
+
+Ssid NL80211Attr<Ssid>::GetValue() const {
+  const nlattr* header = reinterpret_cast<const nlattr*>(data_.data());
+  Ssid ssid;
+  Ssid::FromBytes(data_.data() + NLA_HDRLEN, header->nla_len - NLA_HDRLEN,
+                  &ssid);
+  return ssid;
+}
+
 // For NL80211NestedAttr
 NL80211NestedAttr::NL80211NestedAttr(int id) {
   InitHeaderAndResize(id, 0);
@@ -185,6 +257,12 @@ bool NL80211NestedAttr::GetAttribute(int id,
   return true;
 }
 
+bool NL80211NestedAttr::GetAttributeValue(int id, MacAddress* value) const {
+  return BaseNL80211Attr::GetMacAddressImpl(data_.data() + NLA_HDRLEN,
+                                            data_.size() - NLA_HDRLEN,
+                                            id, value);
+}
+
 bool NL80211NestedAttr::GetListOfNestedAttributes(
     vector<NL80211NestedAttr>* value) const {
   const uint8_t* ptr = data_.data() + NLA_HDRLEN;
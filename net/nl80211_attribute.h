@@ -27,6 +27,9 @@
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 
+#include "wificond/net/mac_address.h"
+#include "wificond/net/ssid.h"
+
 namespace android {
 namespace wificond {
 
@@ -48,6 +51,13 @@ class BaseNL80211Attr {
                               int attr_id,
                               uint8_t** attr_start,
                               uint8_t** attr_end);
+  // Similar to |GetAttributeImpl|, but copies the payload of a MAC address
+  // attribute straight into |*mac_address|, without allocating.
+  // Returns false if the attribute is missing or is not 6 bytes long.
+  static bool GetMacAddressImpl(const uint8_t* buf,
+                                size_t len,
+                                int attr_id,
+                                MacAddress* mac_address);
 
  protected:
   BaseNL80211Attr() = default;
@@ -120,6 +130,26 @@ class NL80211Attr<std::string> : public BaseNL80211Attr {
   std::string GetValue() const;
 };  // class NL80211Attr for string
 
+template <>
+class NL80211Attr<MacAddress> : public BaseNL80211Attr {
+ public:
+  NL80211Attr(int id, const MacAddress& mac_address);
+  explicit NL80211Attr(const std::vector<uint8_t>& data);
+  ~NL80211Attr() override = default;
+  bool IsValid() const override;
+  MacAddress GetValue() const;
+};  // class NL80211Attr for MAC address
+
+template <>
+class NL80211Attr<Ssid> : public BaseNL80211Attr {
+ public:
+  NL80211Attr(int id, const Ssid& ssid);
+  explicit NL80211Attr(const std::vector<uint8_t>& data);
+  ~NL80211Attr() override = default;
+  bool IsValid() const override;
+  Ssid GetValue() const;
+};  // class NL80211Attr for SSID
+
 // Force the compiler not to instantiate these templates because
 // they will be instantiated in nl80211_attribute.cpp file. This helps
 // reduce compile time as well as object file size.
@@ -129,6 +159,8 @@ extern template class NL80211Attr<uint32_t>;
 extern template class NL80211Attr<uint64_t>;
 extern template class NL80211Attr<std::vector<uint8_t>>;
 extern template class NL80211Attr<std::string>;
+extern template class NL80211Attr<MacAddress>;
+extern template class NL80211Attr<Ssid>;
 
 class NL80211NestedAttr : public BaseNL80211Attr {
  public:
@@ -163,6 +195,8 @@ class NL80211NestedAttr : public BaseNL80211Attr {
     *value = attribute.GetValue();
     return true;
   }
+  // Reads a MAC address attribute without allocating.
+  bool GetAttributeValue(int id, MacAddress* value) const;
 
   // Some of the nested attribute contains a list of same type sub-attributes.
   // This function retrieves a vector of attribute value from a nested
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/nl80211_event_dispatcher.h"
+
+#include <linux/nl80211.h>
+
+#include "net/nl80211_packet.h"
+
+namespace android {
+namespace wificond {
+
+constexpr uint32_t NL80211EventDispatcher::kAnyInterface;
+constexpr size_t NL80211EventDispatcher::kNumCommands;
+
+NL80211Event::NL80211Event(const NL80211Packet& packet_)
+    : packet(packet_),
+      command(packet_.GetCommand()),
+      interface_index(NL80211EventDispatcher::kAnyInterface),
+      has_wiphy_index(false),
+      wiphy_index(0) {
+  packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index);
+  has_wiphy_index = packet.GetAttributeValue(NL80211_ATTR_WIPHY, &wiphy_index);
+}
+
+NL80211EventSubscription::NL80211EventSubscription()
+    : dispatcher_(nullptr),
+      observer_(nullptr),
+      command_(0),
+      interface_index_(NL80211EventDispatcher::kAnyInterface),
+      previous_(nullptr),
+      next_(nullptr) {
+}
+
+NL80211EventSubscription::~NL80211EventSubscription() {
+  Unsubscribe();
+}
+
+void NL80211EventSubscription::Unsubscribe() {
+  if (dispatcher_ != nullptr) {
+    dispatcher_->Unlink(this);
+  }
+}
+
+NL80211EventDispatcher::NL80211EventDispatcher()
+    : heads_(),
+      tails_(),
+      cursors_(nullptr) {
+}
+
+NL80211EventDispatcher::~NL80211EventDispatcher() {
+  for (size_t i = 0; i < kNumCommands; i++) {
+    while (heads_[i] != nullptr) {
+      Unlink(heads_[i]);
+    }
+  }
+}
+
+void NL80211EventDispatcher::Subscribe(uint8_t command,
+                                       uint32_t interface_index,
+                                       NL80211EventObserver* observer,
+                                       NL80211EventSubscription* subscription) {
+  subscription->Unsubscribe();
+  subscription->dispatcher_ = this;
+  subscription->observer_ = observer;
+  subscription->command_ = command;
+  subscription->interface_index_ = interface_index;
+  subscription->previous_ = tails_[command];
+  subscription->next_ = nullptr;
+  if (tails_[command] != nullptr) {
+    tails_[command]->next_ = subscription;
+  } else {
+    heads_[command] = subscription;
+  }
+  tails_[command] = subscription;
+}
+
+size_t NL80211EventDispatcher::Dispatch(const NL80211Packet& packet) {
+  const NL80211Event event(packet);
+  size_t num_notified = 0;
+  Cursor cursor = {heads_[event.command], cursors_};
+  cursors_ = &cursor;
+  while (cursor.next != nullptr) {
+    NL80211EventSubscription* subscription = cursor.next;
+    cursor.next = subscription->next_;
+    if (subscription->interface_index_ != kAnyInterface &&
+        subscription->interface_index_ != event.interface_index) {
+      continue;
+    }
+    num_notified++;
+    subscription->observer_->OnNL80211Event(event);
+  }
+  cursors_ = cursor.outer;
+  return num_notified;
+}
+
+size_t NL80211EventDispatcher::GetNumSubscriptions(uint8_t command) const {
+  size_t num_subscriptions = 0;
+  for (const NL80211EventSubscription* subscription = heads_[command];
+       subscription != nullptr;
+       subscription = subscription->next_) {
+    num_subscriptions++;
+  }
+  return num_subscriptions;
+}
+
+void NL80211EventDispatcher::Unlink(NL80211EventSubscription* subscription) {
+  // Running dispatch loops must skip the removed subscription.
+  for (Cursor* cursor = cursors_; cursor != nullptr; cursor = cursor->outer) {
+    if (cursor->next == subscription) {
+      cursor->next = subscription->next_;
+    }
+  }
+  uint8_t command = subscription->command_;
+  if (subscription->previous_ != nullptr) {
+    subscription->previous_->next_ = subscription->next_;
+  } else {
+    heads_[command] = subscription->next_;
+  }
+  if (subscription->next_ != nullptr) {
+    subscription->next_->previous_ = subscription->previous_;
+  } else {
+    tails_[command] = subscription->previous_;
+  }
+  subscription->dispatcher_ = nullptr;
+  subscription->observer_ = nullptr;
+  subscription->previous_ = nullptr;
+  subscription->next_ = nullptr;
+}
+
+}  // namespace wificond
+}  // namespace android
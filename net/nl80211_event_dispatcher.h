@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NL80211_EVENT_DISPATCHER_H_
+#define WIFICOND_NET_NL80211_EVENT_DISPATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+class NL80211EventDispatcher;
+class NL80211Packet;
+
+// A NL80211 multicast event, with the attributes used for dispatching
+// decoded once for all observers.
+struct NL80211Event {
+  explicit NL80211Event(const NL80211Packet& packet);
+
+  const NL80211Packet& packet;
+  // One of |enum nl80211_commands| in nl80211.h.
+  uint8_t command;
+  // NL80211_ATTR_IFINDEX, or 0 if the event doesn't carry one.
+  uint32_t interface_index;
+  bool has_wiphy_index;
+  uint32_t wiphy_index;
+};
+
+class NL80211EventObserver {
+ public:
+  virtual ~NL80211EventObserver() = default;
+  // Called for each event matching a subscription of this observer.
+  // It is safe to unsubscribe any subscription, including the one being
+  // notified, from here.
+  virtual void OnNL80211Event(const NL80211Event& event) = 0;
+};
+
+// Links an observer to the events of one command from one interface.
+// Subscriptions are owned by the subscriber, and unsubscribe themselves when
+// destroyed. An observer interested in several commands holds several
+// subscriptions.
+// Neither subscribing nor dispatching allocates memory.
+class NL80211EventSubscription {
+ public:
+  NL80211EventSubscription();
+  ~NL80211EventSubscription();
+
+  void Unsubscribe();
+  bool IsActive() const { return dispatcher_ != nullptr; }
+
+ private:
+  friend class NL80211EventDispatcher;
+
+  NL80211EventDispatcher* dispatcher_;
+  NL80211EventObserver* observer_;
+  uint8_t command_;
+  uint32_t interface_index_;
+  NL80211EventSubscription* previous_;
+  NL80211EventSubscription* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(NL80211EventSubscription);
+};
+
+// Dispatch table of NL80211 multicast events, indexed by command.
+// Each command has a list of subscriptions, which are notified in the order
+// they subscribed. Any number of observers can subscribe to the same command
+// and interface.
+class NL80211EventDispatcher {
+ public:
+  // Interface index for subscriptions to events from all interfaces, as well
+  // as events which are not about an interface.
+  static constexpr uint32_t kAnyInterface = 0;
+
+  NL80211EventDispatcher();
+  // Deactivates all subscriptions.
+  ~NL80211EventDispatcher();
+
+  // Subscribes |observer| to events with |command| from interface
+  // |interface_index|. |*subscription| is unsubscribed first if it is active.
+  // Caller keeps the ownership of |observer| and |subscription|, and must
+  // keep |observer| alive while |subscription| is active.
+  void Subscribe(uint8_t command,
+                 uint32_t interface_index,
+                 NL80211EventObserver* observer,
+                 NL80211EventSubscription* subscription);
+
+  // Decodes |packet| and notifies the matching observers.
+  // Returns the number of observers notified.
+  size_t Dispatch(const NL80211Packet& packet);
+
+  // Returns the number of active subscriptions to |command|.
+  size_t GetNumSubscriptions(uint8_t command) const;
+
+ private:
+  friend class NL80211EventSubscription;
+
+  // Commands are 8 bits wide in the generic netlink header.
+  static constexpr size_t kNumCommands = 256;
+
+  // Position of a running dispatch loop, so that subscriptions can be
+  // removed while observers run. Cursors of nested dispatches are chained.
+  struct Cursor {
+    NL80211EventSubscription* next;
+    Cursor* outer;
+  };
+
+  void Unlink(NL80211EventSubscription* subscription);
+
+  NL80211EventSubscription* heads_[kNumCommands];
+  NL80211EventSubscription* tails_[kNumCommands];
+  Cursor* cursors_;
+
+  DISALLOW_COPY_AND_ASSIGN(NL80211EventDispatcher);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NL80211_EVENT_DISPATCHER_H_
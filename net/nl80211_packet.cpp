@@ -16,8 +16,13 @@
 
 #include "wificond/net/nl80211_packet.h"
 
+#include <string.h>
+
+#include <algorithm>
+
 #include <android-base/logging.h>
 
+using std::string;
 using std::vector;
 
 namespace android {
@@ -132,6 +137,59 @@ int NL80211Packet::GetErrorCode() const {
   return -*reinterpret_cast<const int*>(data_.data() + NLMSG_HDRLEN);
 }
 
+bool NL80211Packet::IsCapped() const {
+  return GetFlags() & kNetlinkFlagCapped;
+}
+
+bool NL80211Packet::GetExtendedAck(string* message,
+                                   uint32_t* attribute_offset) const {
+  message->clear();
+  *attribute_offset = 0;
+  if (!(GetFlags() & kNetlinkFlagAckTlvs)) {
+    return true;
+  }
+  // Extended ACK attributes follow the error code and the header of the
+  // original request, as well as its payload unless the message is capped.
+  if (data_.size() < NLMSG_HDRLEN + sizeof(nlmsgerr)) {
+    LOG(ERROR) << "Broken extended ACK message.";
+    return false;
+  }
+  const nlmsgerr* error =
+      reinterpret_cast<const nlmsgerr*>(data_.data() + NLMSG_HDRLEN);
+  size_t payload_size = sizeof(nlmsgerr);
+  if (!IsCapped()) {
+    if (error->msg.nlmsg_len < NLMSG_HDRLEN) {
+      LOG(ERROR) << "Broken extended ACK message.";
+      return false;
+    }
+    payload_size += error->msg.nlmsg_len - NLMSG_HDRLEN;
+  }
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_.data());
+  size_t end = std::min<size_t>(data_.size(), nl_header->nlmsg_len);
+  size_t offset = NLMSG_HDRLEN + NLMSG_ALIGN(payload_size);
+  while (offset + NLA_HDRLEN <= end) {
+    const nlattr* attribute =
+        reinterpret_cast<const nlattr*>(data_.data() + offset);
+    if (attribute->nla_len < NLA_HDRLEN ||
+        offset + attribute->nla_len > end) {
+      LOG(ERROR) << "Broken extended ACK attribute.";
+      return false;
+    }
+    const char* value =
+        reinterpret_cast<const char*>(data_.data() + offset + NLA_HDRLEN);
+    size_t value_size = attribute->nla_len - NLA_HDRLEN;
+    uint16_t type = attribute->nla_type & NLA_TYPE_MASK;
+    if (type == kNetlinkErrorAttrMsg) {
+      message->assign(value, strnlen(value, value_size));
+    } else if (type == kNetlinkErrorAttrOffset &&
+               value_size >= sizeof(uint32_t)) {
+      memcpy(attribute_offset, value, sizeof(uint32_t));
+    }
+    offset += NLA_ALIGN(attribute->nla_len);
+  }
+  return true;
+}
+
 const vector<uint8_t>& NL80211Packet::GetConstData() const {
   return data_;
 }
@@ -215,6 +273,13 @@ bool NL80211Packet::GetAttribute(int id,
   return true;
 }
 
+bool NL80211Packet::GetAttributeValue(int id, MacAddress* value) const {
+  return BaseNL80211Attr::GetMacAddressImpl(
+      data_.data() + NLMSG_HDRLEN + GENL_HDRLEN,
+      data_.size() - NLMSG_HDRLEN - GENL_HDRLEN,
+      id, value);
+}
+
 void NL80211Packet::DebugLog() const {
   const uint8_t* ptr = data_.data() + NLMSG_HDRLEN + GENL_HDRLEN;
   const uint8_t* end_ptr = data_.data() + data_.size();
@@ -18,6 +18,7 @@
 #define WIFICOND_NET_NL80211_PACKET_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <linux/genetlink.h>
@@ -30,6 +31,18 @@
 namespace android {
 namespace wificond {
 
+// Extended ACK definitions from linux/netlink.h.
+// They are defined here because older kernel headers don't have them.
+// NLMSG_ERROR message flag: payload of the original request was omitted.
+constexpr uint16_t kNetlinkFlagCapped = 0x100;  // NLM_F_CAPPED
+// NLMSG_ERROR message flag: extended ACK attributes are appended.
+constexpr uint16_t kNetlinkFlagAckTlvs = 0x200;  // NLM_F_ACK_TLVS
+// Extended ACK attribute carrying an error message string.
+constexpr uint16_t kNetlinkErrorAttrMsg = 1;  // NLMSGERR_ATTR_MSG
+// Extended ACK attribute carrying the u32 offset of the offending attribute
+// in the original request.
+constexpr uint16_t kNetlinkErrorAttrOffset = 2;  // NLMSGERR_ATTR_OFFS
+
 // NL80211Packets are used to communicate with the cfg80211 kernel subsystem
 // (via the nl80211 interface).  An NL80211 packet is a type of generic netlink
 // packet (i.e. it includes netlink and generic netlink headers).
@@ -79,6 +92,19 @@ class NL80211Packet {
   // NLMSG_ERROR message before calling GetErrorCode().
   // Returns an error number defined in errno.h
   int GetErrorCode() const;
+  // Returns true if kernel omitted the payload of the original request from
+  // this NLMSG_ERROR message. See NETLINK_CAP_ACK.
+  bool IsCapped() const;
+  // Caller is responsible for checking that this is a valid
+  // NLMSG_ERROR message before calling GetExtendedAck().
+  // Parses the extended ACK attributes kernel appends to NLMSG_ERROR messages
+  // when NETLINK_EXT_ACK is enabled on the socket.
+  // |*message| is set to the error message from kernel, or empty if there is
+  // none.
+  // |*attribute_offset| is set to the offset in bytes of the offending
+  // attribute from the start of the original request, or 0 if there is none.
+  // Returns false if the extended ACK attributes are broken.
+  bool GetExtendedAck(std::string* message, uint32_t* attribute_offset) const;
   const std::vector<uint8_t>& GetConstData() const;
 
   // Setter functions.
@@ -127,6 +153,8 @@ class NL80211Packet {
     *value = attribute.GetValue();
     return true;
   }
+  // Reads a MAC address attribute without allocating.
+  bool GetAttributeValue(int id, MacAddress* value) const;
 
   template <typename T>
   bool GetAttribute(int id, NL80211Attr<T>* attribute) const {
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/nl80211_request_cache.h"
+
+using std::make_pair;
+using std::unique_ptr;
+
+namespace android {
+namespace wificond {
+
+NL80211Packet* NL80211RequestCache::Get(uint8_t command,
+                                        uint32_t interface_index,
+                                        uint64_t variant,
+                                        uint32_t sequence,
+                                        uint32_t pid) {
+  std::lock_guard<std::mutex> lock(lock_);
+  const auto it = templates_.find(make_pair(interface_index, command));
+  if (it == templates_.end() || it->second.variant != variant) {
+    return nullptr;
+  }
+  NL80211Packet* request = it->second.request.get();
+  request->SetMessageSequence(sequence);
+  request->SetPortId(pid);
+  return request;
+}
+
+NL80211Packet* NL80211RequestCache::Put(uint32_t interface_index,
+                                        uint64_t variant,
+                                        unique_ptr<NL80211Packet> request) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Template& entry =
+      templates_[make_pair(interface_index, request->GetCommand())];
+  entry.variant = variant;
+  entry.request = std::move(request);
+  return entry.request.get();
+}
+
+void NL80211RequestCache::RemoveInterface(uint32_t interface_index) {
+  std::lock_guard<std::mutex> lock(lock_);
+  templates_.erase(
+      templates_.lower_bound(
+          make_pair(interface_index, static_cast<uint8_t>(0))),
+      templates_.upper_bound(
+          make_pair(interface_index, static_cast<uint8_t>(UINT8_MAX))));
+}
+
+size_t NL80211RequestCache::size() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return templates_.size();
+}
+
+}  // namespace wificond
+}  // namespace android
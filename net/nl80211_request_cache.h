@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NL80211_REQUEST_CACHE_H_
+#define WIFICOND_NET_NL80211_REQUEST_CACHE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/nl80211_packet.h"
+
+namespace android {
+namespace wificond {
+
+// Pre-encoded NL80211 requests, for requests which are sent repeatedly and
+// only differ in their sequence number, e.g. station info polls.
+// There is one template per command and interface. |variant| tells apart
+// requests of the same command and interface with different attributes,
+// e.g. the station MAC address. A template of another variant replaces the
+// previous one.
+// The cache can be shared by threads, but a template must only be used
+// with the interface lock of its interface held, see
+// NetlinkManager::GetInterfaceLock().
+class NL80211RequestCache {
+ public:
+  NL80211RequestCache() = default;
+  ~NL80211RequestCache() = default;
+
+  // Returns the template of |command| on |interface_index| with |variant|,
+  // with its sequence number and port id set to |sequence| and |pid|.
+  // Returns nullptr if there is no such template.
+  NL80211Packet* Get(uint8_t command,
+                     uint32_t interface_index,
+                     uint64_t variant,
+                     uint32_t sequence,
+                     uint32_t pid);
+  // Stores |request| as the template of its command on |interface_index|
+  // with |variant|, and returns it.
+  NL80211Packet* Put(uint32_t interface_index,
+                     uint64_t variant,
+                     std::unique_ptr<NL80211Packet> request);
+  // Drops the templates of |interface_index|.
+  void RemoveInterface(uint32_t interface_index);
+
+  size_t size() const;
+
+ private:
+  struct Template {
+    uint64_t variant;
+    std::unique_ptr<NL80211Packet> request;
+  };
+  mutable std::mutex lock_;
+  // Mapping from (interface index, command) to template.
+  std::map<std::pair<uint32_t, uint8_t>, Template> templates_;
+
+  DISALLOW_COPY_AND_ASSIGN(NL80211RequestCache);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NL80211_REQUEST_CACHE_H_
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/ssid.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+}  // namespace
+
+constexpr size_t Ssid::kMaxSize;
+
+bool Ssid::FromBytes(const uint8_t* data, size_t size, Ssid* out) {
+  if (size > kMaxSize) {
+    return false;
+  }
+  *out = Ssid();
+  if (size > 0) {
+    memcpy(out->bytes_, data, size);
+  }
+  out->size_ = static_cast<uint8_t>(size);
+  return true;
+}
+
+bool Ssid::FromBytes(const vector<uint8_t>& bytes, Ssid* out) {
+  return FromBytes(bytes.data(), bytes.size(), out);
+}
+
+Ssid Ssid::FromString(const string& str) {
+  Ssid ssid;
+  FromBytes(reinterpret_cast<const uint8_t*>(str.data()),
+            std::min(str.size(), kMaxSize),
+            &ssid);
+  return ssid;
+}
+
+vector<uint8_t> Ssid::ToBytes() const {
+  return vector<uint8_t>(bytes_, bytes_ + size_);
+}
+
+string Ssid::ToString() const {
+  return string(reinterpret_cast<const char*>(bytes_), size_);
+}
+
+size_t Ssid::Hash() const {
+  uint64_t hash = kFnvOffsetBasis;
+  for (size_t i = 0; i < size_; i++) {
+    hash = (hash ^ bytes_[i]) * kFnvPrime;
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool Ssid::operator==(const Ssid& other) const {
+  return size_ == other.size_ && memcmp(bytes_, other.bytes_, size_) == 0;
+}
+
+bool Ssid::operator<(const Ssid& other) const {
+  return std::lexicographical_compare(bytes_, bytes_ + size_,
+                                      other.bytes_, other.bytes_ + other.size_);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_SSID_H_
+#define WIFICOND_NET_SSID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace android {
+namespace wificond {
+
+// An 802.11 SSID: up to 32 arbitrary bytes, stored inline.
+// This is a trivially copyable value type, so lists of SSIDs for scan and
+// PNO requests need a single allocation for the whole list rather than one
+// per SSID. Byte vectors are only used at the binder and offload HAL
+// boundaries, see FromBytes() and ToBytes().
+class Ssid {
+ public:
+  // IEEE Std 802.11: 9.4.2.2
+  static constexpr size_t kMaxSize = 32;
+
+  // Creates the empty SSID, which is used for wildcard scans.
+  constexpr Ssid() : size_(0), bytes_{} {}
+
+  // Copies an SSID from |size| bytes at |data|.
+  // Returns false if |size| is larger than |kMaxSize|.
+  static bool FromBytes(const uint8_t* data, size_t size, Ssid* out);
+  static bool FromBytes(const std::vector<uint8_t>& bytes, Ssid* out);
+  // Same as FromBytes(), for constants in code and tests.
+  // Truncates |str| to |kMaxSize| bytes.
+  static Ssid FromString(const std::string& str);
+
+  std::vector<uint8_t> ToBytes() const;
+  // Returns the SSID as is. It might not be printable.
+  std::string ToString() const;
+
+  const uint8_t* data() const { return bytes_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  // FNV-1a over the bytes of the SSID.
+  size_t Hash() const;
+
+  bool operator==(const Ssid& other) const;
+  bool operator!=(const Ssid& other) const { return !(*this == other); }
+  bool operator<(const Ssid& other) const;
+
+ private:
+  uint8_t size_;
+  // Bytes past |size_| are always zero, so that comparisons and hashing
+  // never look at stale data.
+  uint8_t bytes_[kMaxSize];
+};
+
+static_assert(std::is_trivially_copyable<Ssid>::value,
+              "Ssid must be trivially copyable");
+
+}  // namespace wificond
+}  // namespace android
+
+namespace std {
+
+template <>
+struct hash<android::wificond::Ssid> {
+  size_t operator()(const android::wificond::Ssid& ssid) const {
+    return ssid.Hash();
+  }
+};
+
+}  // namespace std
+
+#endif  // WIFICOND_NET_SSID_H_
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/regulatory_model.h"
+
+#include <utility>
+
+#include <ctype.h>
+
+#include <android-base/logging.h>
+
+using std::endl;
+using std::map;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Kernel uses special alpha2 codes like "00" for the world regulatory
+// domain, or "98" for an intersection of regulatory domains.
+string GetCountryCodeFromAlpha2(const string& alpha2) {
+  if (alpha2.size() == 2 && isalpha(alpha2[0]) && isalpha(alpha2[1])) {
+    return alpha2;
+  }
+  return "";
+}
+
+}  // namespace
+
+RegulatoryModel::RegulatoryModel(uint32_t wiphy_index,
+                                 NetlinkUtils* netlink_utils,
+                                 OnChannelsChangedHandler handler)
+    : wiphy_index_(wiphy_index),
+      netlink_utils_(netlink_utils),
+      on_channels_changed_handler_(handler),
+      loaded_(false),
+      num_updates_(0) {
+}
+
+bool RegulatoryModel::Load() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return LoadLocked();
+}
+
+bool RegulatoryModel::IsLoaded() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return loaded_;
+}
+
+string RegulatoryModel::GetCountryCode() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return country_code_;
+}
+
+RegulatoryDomain RegulatoryModel::GetRegulatoryDomain() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return regulatory_domain_;
+}
+
+bool RegulatoryModel::LoadLocked() {
+  if (loaded_) {
+    return true;
+  }
+  KernelState state;
+  if (!Fetch(&state)) {
+    LOG(ERROR) << "Failed to load channels of wiphy " << wiphy_index_;
+    return false;
+  }
+  vector<uint32_t> changed_frequencies;
+  ApplyLocked(&state, &changed_frequencies);
+  country_code_ = GetCountryCodeFromAlpha2(regulatory_domain_.country_code);
+  return true;
+}
+
+bool RegulatoryModel::GetBandInfo(BandInfo* out_band_info) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!LoadLocked()) {
+    return false;
+  }
+  vector<ChannelInfo> channels;
+  for (const auto& channel : channels_) {
+    channels.push_back(channel.second);
+  }
+  *out_band_info = BandInfo(channels);
+  return true;
+}
+
+bool RegulatoryModel::GetChannel(uint32_t frequency,
+                                 ChannelInfo* out_channel) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!LoadLocked()) {
+    return false;
+  }
+  const auto channel = channels_.find(frequency);
+  if (channel == channels_.end()) {
+    return false;
+  }
+  *out_channel = channel->second;
+  return true;
+}
+
+bool RegulatoryModel::IsChannelUsable(uint32_t frequency) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!LoadLocked()) {
+    return true;
+  }
+  const auto channel = channels_.find(frequency);
+  return channel != channels_.end() && !channel->second.disabled;
+}
+
+void RegulatoryModel::OnRegDomainChanged(const string& country_code) {
+  // The dumps take a while, and queries from other threads shouldn't wait
+  // for them.
+  KernelState state;
+  if (!Fetch(&state)) {
+    LOG(ERROR) << "Failed to update channels of wiphy " << wiphy_index_
+               << " after regulatory domain change";
+    return;
+  }
+  vector<uint32_t> changed_frequencies;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    ApplyLocked(&state, &changed_frequencies);
+    bool country_changed = (country_code != country_code_);
+    country_code_ = country_code;
+    if (!country_changed && changed_frequencies.empty()) {
+      LOG(DEBUG) << "Regulatory domain change didn't change any channel";
+      return;
+    }
+    num_updates_++;
+  }
+  LOG(INFO) << "Regulatory domain changed to country: \"" << country_code
+            << "\", " << changed_frequencies.size() << " channels changed";
+  if (on_channels_changed_handler_) {
+    on_channels_changed_handler_(country_code, changed_frequencies);
+  }
+}
+
+bool RegulatoryModel::Fetch(KernelState* state) const {
+  vector<ChannelInfo> channel_list;
+  if (!netlink_utils_->GetChannels(wiphy_index_, &channel_list)) {
+    return false;
+  }
+  // Channels already carry the effect of the regulatory rules. So the model
+  // is still usable if kernel doesn't report the regulatory domain.
+  state->has_regulatory_domain =
+      netlink_utils_->GetRegulatoryDomain(wiphy_index_,
+                                          &state->regulatory_domain);
+  if (!state->has_regulatory_domain) {
+    LOG(WARNING) << "Failed to get regulatory domain of wiphy "
+                 << wiphy_index_;
+  }
+  for (const auto& channel : channel_list) {
+    state->channels[channel.frequency] = channel;
+  }
+  return true;
+}
+
+void RegulatoryModel::ApplyLocked(KernelState* state,
+                                  vector<uint32_t>* changed_frequencies) {
+  if (state->has_regulatory_domain) {
+    regulatory_domain_ = std::move(state->regulatory_domain);
+  }
+  changed_frequencies->clear();
+  // Removed channels, then new and modified channels.
+  for (const auto& channel : channels_) {
+    if (state->channels.find(channel.first) == state->channels.end()) {
+      changed_frequencies->push_back(channel.first);
+    }
+  }
+  for (const auto& channel : state->channels) {
+    auto it = channels_.find(channel.first);
+    if (it == channels_.end() || it->second != channel.second) {
+      changed_frequencies->push_back(channel.first);
+    }
+  }
+  channels_.swap(state->channels);
+  state->channels.clear();
+  loaded_ = true;
+}
+
+void RegulatoryModel::Dump(stringstream* ss) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  *ss << "------- Dump of regulatory model of wiphy " << wiphy_index_
+      << " -------" << endl;
+  if (!loaded_) {
+    *ss << "Not loaded" << endl;
+    return;
+  }
+  *ss << "Country code: \"" << country_code_ << "\"" << endl;
+  *ss << "Regulatory domain: \"" << regulatory_domain_.country_code
+      << "\", DFS region: " << static_cast<int>(regulatory_domain_.dfs_region)
+      << ", rules: " << regulatory_domain_.rules.size() << endl;
+  *ss << "Channel changes by regulatory domain changes: " << num_updates_
+      << endl;
+  for (const auto& it : channels_) {
+    const ChannelInfo& channel = it.second;
+    *ss << "Channel " << channel.frequency
+        << ": max tx power " << channel.max_tx_power_mbm << " mBm";
+    if (channel.disabled) {
+      *ss << ", disabled";
+    }
+    if (channel.no_ir) {
+      *ss << ", no IR";
+    }
+    if (channel.radar) {
+      *ss << ", radar";
+    }
+    if (channel.dfs_state != kDfsStateNone) {
+      *ss << ", DFS state " << channel.dfs_state;
+    }
+    if (channel.no_ht40_minus) {
+      *ss << ", no HT40-";
+    }
+    if (channel.no_ht40_plus) {
+      *ss << ", no HT40+";
+    }
+    if (channel.no_80mhz) {
+      *ss << ", no 80MHz";
+    }
+    if (channel.no_160mhz) {
+      *ss << ", no 160MHz";
+    }
+    *ss << endl;
+  }
+  *ss << "------- Dump End -------" << endl;
+}
+
+}  // namespace wificond
+}  // namespace android
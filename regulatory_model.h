@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_REGULATORY_MODEL_H_
+#define WIFICOND_REGULATORY_MODEL_H_
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/netlink_utils.h"
+
+namespace android {
+namespace wificond {
+
+// Keeps the regulatory domain and the channels of a wiphy in memory.
+// The model is loaded from kernel once, and then updated by the owner
+// forwarding regulatory change events, so that channel queries don't need to
+// dump the wiphy.
+// Queries can come from several threads. The handler is called without the
+// model lock held, so it can query the model.
+class RegulatoryModel {
+ public:
+  // This describes a type of function handling a regulatory change which
+  // changed the channels of the wiphy, or the country.
+  // |country_code| is the current country, or empty if the regulatory
+  // domain does not pertain to a specific country.
+  // |changed_frequencies| lists the channels which were added, removed or
+  // modified by this change.
+  typedef std::function<void(
+      const std::string& country_code,
+      const std::vector<uint32_t>& changed_frequencies)>
+          OnChannelsChangedHandler;
+
+  // |handler| can be empty if nobody needs to be notified.
+  RegulatoryModel(uint32_t wiphy_index,
+                  NetlinkUtils* netlink_utils,
+                  OnChannelsChangedHandler handler);
+
+  // Loads the model from kernel if it is not loaded yet.
+  // Returns true if the model is loaded.
+  bool Load();
+  bool IsLoaded() const;
+  uint32_t GetWiphyIndex() const { return wiphy_index_; }
+
+  // Returns usable channels grouped by band.
+  // Returns false if the model cannot be loaded.
+  bool GetBandInfo(BandInfo* out_band_info);
+  // Returns false if the wiphy doesn't have channel |frequency|, or if the
+  // model cannot be loaded.
+  bool GetChannel(uint32_t frequency, ChannelInfo* out_channel);
+  // Returns false if channel |frequency| is known to be disabled in current
+  // regulatory domain, or if the wiphy doesn't have it.
+  // Returns true if the model cannot be loaded, so that callers leave the
+  // decision to kernel.
+  bool IsChannelUsable(uint32_t frequency);
+  // Returns the current country code, or empty if the regulatory domain does
+  // not pertain to a specific country.
+  std::string GetCountryCode() const;
+  RegulatoryDomain GetRegulatoryDomain() const;
+
+  // Called when kernel reports a regulatory domain change of this wiphy.
+  // Notifies the handler if any channel or the country changed.
+  void OnRegDomainChanged(const std::string& country_code);
+
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  // Channels and regulatory domain of the wiphy as read from kernel.
+  struct KernelState {
+    // Mapping from frequency to channel.
+    std::map<uint32_t, ChannelInfo> channels;
+    bool has_regulatory_domain = false;
+    RegulatoryDomain regulatory_domain;
+  };
+
+  bool LoadLocked();
+  // Reads the regulatory domain and the channels from kernel.
+  // This only touches |*state|, so it runs without |lock_| held.
+  // Returns true on success.
+  bool Fetch(KernelState* state) const;
+  // Replaces the model with |state|, which is left empty.
+  // |*changed_frequencies| returns the channels which changed.
+  void ApplyLocked(KernelState* state,
+                   std::vector<uint32_t>* changed_frequencies);
+
+  const uint32_t wiphy_index_;
+  NetlinkUtils* const netlink_utils_;
+  OnChannelsChangedHandler on_channels_changed_handler_;
+
+  mutable std::mutex lock_;
+  bool loaded_;
+  std::string country_code_;
+  RegulatoryDomain regulatory_domain_;
+  // Mapping from frequency to channel.
+  std::map<uint32_t, ChannelInfo> channels_;
+  // Number of updates which changed the channels or the country.
+  uint32_t num_updates_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegulatoryModel);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_REGULATORY_MODEL_H_
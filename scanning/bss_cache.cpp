@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/bss_cache.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <type_traits>
+
+#include <android-base/logging.h>
+#include <utils/Timers.h>
+
+using com::android::server::wifi::wificond::NativeScanResult;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// "WBSC"
+constexpr uint32_t kMagic = 0x43534257;
+// Must be incremented whenever the layout of Header or Record changes.
+constexpr uint32_t kVersion = 1;
+constexpr size_t kInfoElementCapacity = 1536;
+
+uint64_t GetWallTimeMs() {
+  return ns2ms(systemTime(SYSTEM_TIME_REALTIME));
+}
+
+uint64_t GetBootTimeMs() {
+  return ns2ms(systemTime(SYSTEM_TIME_BOOTTIME));
+}
+
+}  // namespace
+
+struct BssCache::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t capacity;
+};
+
+struct BssCache::Record {
+  // CRC-32 of the record, from |in_use| to the end.
+  uint32_t checksum;
+  uint32_t in_use;
+  // Wall clock time when the BSS was last seen.
+  uint64_t last_seen_wall_ms;
+  uint32_t frequency;
+  int32_t signal_mbm;
+  uint16_t capability;
+  uint16_t info_element_size;
+  uint8_t bssid[MacAddress::kSize];
+  uint8_t ssid_size;
+  uint8_t ssid[Ssid::kMaxSize];
+  uint8_t reserved[5];
+  uint8_t info_element[kInfoElementCapacity];
+};
+
+const size_t BssCache::kDefaultCapacity = 256;
+const size_t BssCache::kMaxInfoElementSize = kInfoElementCapacity;
+
+BssCache::BssCache(const string& path, size_t capacity)
+    : BssCache(path, capacity, GetWallTimeMs, GetBootTimeMs) {}
+
+BssCache::BssCache(const string& path,
+                   size_t capacity,
+                   Clock wall_clock,
+                   Clock boot_clock)
+    : path_(path),
+      capacity_(capacity),
+      wall_clock_(wall_clock),
+      boot_clock_(boot_clock),
+      mapped_size_(0),
+      header_(nullptr),
+      records_(nullptr),
+      num_corrupted_records_(0),
+      num_writes_(0) {
+}
+
+BssCache::~BssCache() {
+  Close();
+}
+
+bool BssCache::Open() {
+  static_assert(std::is_trivially_copyable<Record>::value,
+                "Records are copied to the file as is");
+  static_assert(sizeof(Record) % 8 == 0,
+                "Records must keep their alignment in the file");
+  if (IsOpen()) {
+    return true;
+  }
+  fd_.reset(TEMP_FAILURE_RETRY(
+      open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)));
+  if (fd_.get() < 0) {
+    PLOG(ERROR) << "Failed to open BSS cache " << path_;
+    return false;
+  }
+  size_t size = sizeof(Header) + capacity_ * sizeof(Record);
+  struct stat file_stat;
+  if (fstat(fd_.get(), &file_stat) != 0) {
+    PLOG(ERROR) << "Failed to stat BSS cache " << path_;
+    fd_.reset();
+    return false;
+  }
+  bool size_changed = static_cast<size_t>(file_stat.st_size) != size;
+  if (size_changed && ftruncate(fd_.get(), size) != 0) {
+    PLOG(ERROR) << "Failed to resize BSS cache " << path_;
+    fd_.reset();
+    return false;
+  }
+  void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd_.get(), 0);
+  if (mapped == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map BSS cache " << path_;
+    fd_.reset();
+    return false;
+  }
+  mapped_size_ = size;
+  header_ = static_cast<Header*>(mapped);
+  records_ = reinterpret_cast<Record*>(static_cast<uint8_t*>(mapped) +
+                                       sizeof(Header));
+  if (size_changed || !LoadRecords()) {
+    LOG(INFO) << "Resetting BSS cache " << path_;
+    Reset();
+  }
+  LOG(INFO) << "Loaded " << slots_.size() << " BSSs from BSS cache";
+  return true;
+}
+
+void BssCache::Close() {
+  if (!IsOpen()) {
+    return;
+  }
+  munmap(header_, mapped_size_);
+  mapped_size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+  slots_.clear();
+  free_slots_.clear();
+  fd_.reset();
+}
+
+bool BssCache::LoadRecords() {
+  if (header_->magic != kMagic ||
+      header_->version != kVersion ||
+      header_->record_size != sizeof(Record) ||
+      header_->capacity != capacity_) {
+    return false;
+  }
+  slots_.clear();
+  free_slots_.clear();
+  // Fill slots from the end, so that the first ones are taken first.
+  for (size_t i = capacity_; i-- > 0;) {
+    Record* record = &records_[i];
+    if (!record->in_use) {
+      free_slots_.push_back(i);
+      continue;
+    }
+    MacAddress bssid;
+    uint32_t checksum = crc32(
+        0, reinterpret_cast<const Bytef*>(record) + sizeof(record->checksum),
+        sizeof(Record) - sizeof(record->checksum));
+    if (checksum != record->checksum ||
+        record->ssid_size > Ssid::kMaxSize ||
+        record->info_element_size > kInfoElementCapacity ||
+        !MacAddress::FromBytes(record->bssid, sizeof(record->bssid), &bssid) ||
+        slots_.count(bssid) != 0) {
+      num_corrupted_records_++;
+      record->in_use = 0;
+      free_slots_.push_back(i);
+      continue;
+    }
+    slots_[bssid] = i;
+  }
+  if (num_corrupted_records_ != 0) {
+    LOG(WARNING) << "Dropped " << num_corrupted_records_
+                 << " corrupted records from BSS cache";
+  }
+  return true;
+}
+
+void BssCache::Reset() {
+  memset(header_, 0, mapped_size_);
+  header_->magic = kMagic;
+  header_->version = kVersion;
+  header_->record_size = sizeof(Record);
+  header_->capacity = capacity_;
+  slots_.clear();
+  free_slots_.clear();
+  for (size_t i = capacity_; i-- > 0;) {
+    free_slots_.push_back(i);
+  }
+}
+
+size_t BssCache::GetSlot(const MacAddress& bssid) {
+  const auto it = slots_.find(bssid);
+  if (it != slots_.end()) {
+    return it->second;
+  }
+  size_t slot;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    // Replace the BSS which was seen the longest time ago.
+    auto oldest = slots_.begin();
+    for (auto entry = slots_.begin(); entry != slots_.end(); ++entry) {
+      if (records_[entry->second].last_seen_wall_ms <
+          records_[oldest->second].last_seen_wall_ms) {
+        oldest = entry;
+      }
+    }
+    slot = oldest->second;
+    slots_.erase(oldest);
+  }
+  slots_[bssid] = slot;
+  return slot;
+}
+
+void BssCache::Update(const vector<NativeScanResult>& scan_results) {
+  if (!IsOpen() || capacity_ == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  uint64_t wall_now_ms = wall_clock_();
+  uint64_t boot_now_ms = boot_clock_();
+  Record record;
+  for (const auto& scan_result : scan_results) {
+    if (scan_result.info_element.size() > kInfoElementCapacity) {
+      continue;
+    }
+    memset(&record, 0, sizeof(record));
+    record.in_use = 1;
+    uint64_t last_seen_boot_ms = scan_result.tsf / 1000;
+    uint64_t age_ms = boot_now_ms > last_seen_boot_ms ?
+        boot_now_ms - last_seen_boot_ms : 0;
+    record.last_seen_wall_ms = wall_now_ms > age_ms ? wall_now_ms - age_ms : 0;
+    record.frequency = scan_result.frequency;
+    record.signal_mbm = scan_result.signal_mbm;
+    record.capability = scan_result.capability;
+    record.info_element_size = scan_result.info_element.size();
+    memcpy(record.bssid, scan_result.bssid.data(), sizeof(record.bssid));
+    record.ssid_size = scan_result.ssid.size();
+    memcpy(record.ssid, scan_result.ssid.data(), scan_result.ssid.size());
+    memcpy(record.info_element, scan_result.info_element.data(),
+           scan_result.info_element.size());
+    record.checksum = crc32(
+        0, reinterpret_cast<const Bytef*>(&record) + sizeof(record.checksum),
+        sizeof(Record) - sizeof(record.checksum));
+    memcpy(&records_[GetSlot(scan_result.bssid)], &record, sizeof(record));
+    num_writes_++;
+  }
+}
+
+void BssCache::GetScanResults(uint64_t max_age_ms,
+                              vector<NativeScanResult>* scan_results) const {
+  if (!IsOpen()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  uint64_t wall_now_ms = wall_clock_();
+  uint64_t boot_now_ms = boot_clock_();
+  for (const auto& entry : slots_) {
+    const Record& record = records_[entry.second];
+    uint64_t age_ms = wall_now_ms > record.last_seen_wall_ms ?
+        wall_now_ms - record.last_seen_wall_ms : 0;
+    if (age_ms > max_age_ms) {
+      continue;
+    }
+    NativeScanResult scan_result;
+    scan_result.bssid = entry.first;
+    Ssid::FromBytes(record.ssid, record.ssid_size, &scan_result.ssid);
+    scan_result.info_element.assign(
+        record.info_element, record.info_element + record.info_element_size);
+    scan_result.frequency = record.frequency;
+    scan_result.signal_mbm = record.signal_mbm;
+    scan_result.tsf = age_ms < boot_now_ms ?
+        (boot_now_ms - age_ms) * 1000 : 0;
+    scan_result.capability = record.capability;
+    scan_result.associated = false;
+    scan_results->push_back(std::move(scan_result));
+  }
+}
+
+size_t BssCache::size() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return slots_.size();
+}
+
+void BssCache::Dump(std::stringstream* ss) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  *ss << "BSS cache " << path_ << ": "
+      << (IsOpen() ? "open" : "closed")
+      << ", " << slots_.size() << " of " << capacity_ << " BSSs"
+      << ", corrupted records " << num_corrupted_records_
+      << ", writes " << num_writes_ << endl;
+}
+
+}  // namespace wificond
+}  // namespace android
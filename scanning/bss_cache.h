@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_BSS_CACHE_H_
+#define WIFICOND_SCANNING_BSS_CACHE_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+#include "wificond/net/mac_address.h"
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace wificond {
+
+// Scan results kept in a memory mapped file, so that they survive restarts
+// of wificond and reboots.
+// The file is a versioned header followed by |capacity| fixed size records,
+// one per BSS. Each record carries a checksum, so that records torn by a
+// crash in the middle of a write are dropped when the file is loaded.
+// Records are rewritten in place when their BSS is seen again. When the
+// file is full, the BSS which was seen the longest time ago is replaced.
+// Once the cache is open, it can be used by several threads.
+class BssCache {
+ public:
+  // Returns current time in milliseconds.
+  typedef std::function<uint64_t()> Clock;
+
+  // Default number of BSSs kept in the file.
+  static const size_t kDefaultCapacity;
+  // BSSs whose information elements are larger than this are not kept.
+  static const size_t kMaxInfoElementSize;
+
+  // Uses the system wall clock and boot time clock.
+  BssCache(const std::string& path, size_t capacity);
+  // |wall_clock| must not go back across restarts, so that the age of BSSs
+  // can be told after a reboot. |boot_clock| is the clock of
+  // NativeScanResult::tsf.
+  BssCache(const std::string& path,
+           size_t capacity,
+           Clock wall_clock,
+           Clock boot_clock);
+  ~BssCache();
+
+  // Maps the file, and loads the valid records from it. A missing file or a
+  // file of another version or capacity is reset to an empty cache.
+  // Returns false if the file can't be used.
+  bool Open();
+  bool IsOpen() const { return records_ != nullptr; }
+
+  // Writes the records of |scan_results|.
+  void Update(
+      const std::vector<::com::android::server::wifi::wificond::
+          NativeScanResult>& scan_results);
+  // Appends the BSSs which were seen at most |max_age_ms| ago to
+  // |*scan_results|. Their tsf tells when they were seen, relative to the
+  // current boot time. BSSs seen before boot have a tsf of 0.
+  void GetScanResults(
+      uint64_t max_age_ms,
+      std::vector<::com::android::server::wifi::wificond::NativeScanResult>*
+          scan_results) const;
+  // Number of BSSs in the cache.
+  size_t size() const;
+
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  struct Header;
+  struct Record;
+
+  // Returns the slot to write BSS |bssid| to.
+  size_t GetSlot(const MacAddress& bssid);
+  bool LoadRecords();
+  void Reset();
+  void Close();
+
+  const std::string path_;
+  const size_t capacity_;
+  const Clock wall_clock_;
+  const Clock boot_clock_;
+
+  // Guards the records and the fields below, once the file is open.
+  mutable std::mutex lock_;
+
+  android::base::unique_fd fd_;
+  size_t mapped_size_;
+  Header* header_;
+  Record* records_;
+  // Mapping from BSSID to the index of its record.
+  std::unordered_map<MacAddress, size_t> slots_;
+  // Indices of the records which are not in use.
+  std::vector<size_t> free_slots_;
+  // Number of records dropped because of a wrong checksum when loading.
+  size_t num_corrupted_records_;
+  uint64_t num_writes_;
+
+  DISALLOW_COPY_AND_ASSIGN(BssCache);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_BSS_CACHE_H_
@@ -21,6 +21,7 @@
 #include "wificond/parcelable_utils.h"
 
 using android::status_t;
+using android::wificond::Ssid;
 
 namespace com {
 namespace android {
@@ -29,12 +30,16 @@ namespace wifi {
 namespace wificond {
 
 status_t HiddenNetwork::writeToParcel(::android::Parcel* parcel) const {
-  RETURN_IF_FAILED(parcel->writeByteVector(ssid_));
+  RETURN_IF_FAILED(parcel->writeByteVector(ssid_.ToBytes()));
   return ::android::OK;
 }
 
 status_t HiddenNetwork::readFromParcel(const ::android::Parcel* parcel) {
-  RETURN_IF_FAILED(parcel->readByteVector(&ssid_));
+  std::vector<uint8_t> ssid;
+  RETURN_IF_FAILED(parcel->readByteVector(&ssid));
+  if (!Ssid::FromBytes(ssid, &ssid_)) {
+    return ::android::BAD_VALUE;
+  }
   return ::android::OK;
 }
 
@@ -22,6 +22,8 @@
 #include <binder/Parcel.h>
 #include <binder/Parcelable.h>
 
+#include "wificond/net/ssid.h"
+
 namespace com {
 namespace android {
 namespace server {
@@ -37,7 +39,7 @@ class HiddenNetwork : public ::android::Parcelable {
   ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
   ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
 
-  std::vector<uint8_t> ssid_;
+  ::android::wificond::Ssid ssid_;
 };
 
 }  // namespace wificond
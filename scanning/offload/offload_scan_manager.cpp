@@ -15,10 +15,13 @@
  */
 #include "wificond/scanning/offload/offload_scan_manager.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/logging.h>
+#include <utils/Timers.h>
 
+#include "wificond/metrics_registry.h"
 #include "wificond/scanning/offload/hidl_call_util.h"
 #include "wificond/scanning/offload/offload_scan_utils.h"
 #include "wificond/scanning/offload/offload_service_utils.h"
@@ -34,9 +37,11 @@ using android::hardware::wifi::offload::V1_0::ScanStats;
 using android::hardware::wifi::offload::V1_0::OffloadStatus;
 using android::hardware::wifi::offload::V1_0::OffloadStatusCode;
 
+using android::wificond::CounterMetric;
 using android::wificond::OffloadCallback;
 using ::com::android::server::wifi::wificond::NativeScanResult;
 using ::com::android::server::wifi::wificond::NativeScanStats;
+using std::endl;
 using std::vector;
 using std::weak_ptr;
 using std::shared_ptr;
@@ -45,8 +50,22 @@ using namespace std::placeholders;
 
 namespace {
 const uint32_t kSubscriptionDelayMs = 5000;
+// Offload HAL lookups are retried after 1s, 2s, 4s, ... up to 64s.
+const int64_t kDiscoveryInitialDelayMs = 1000;
+const int64_t kDiscoveryMaxDelayMs = 64000;
+const uint32_t kMaxDiscoveryAttempts = 10;
+
+CounterMetric num_scan_result_reports("offload.scan_result_reports");
+CounterMetric num_scan_results("offload.scan_results");
+CounterMetric num_errors("offload.errors");
+CounterMetric num_service_deaths("offload.service_deaths");
+
+uint64_t GetBootTimeUs() {
+  return ns2us(systemTime(SYSTEM_TIME_BOOTTIME));
 }
 
+}  // namespace
+
 namespace android {
 namespace wificond {
 
@@ -71,7 +90,8 @@ void OffloadCallbackHandlersImpl::OnErrorHandler(const OffloadStatus& status) {
 
 OffloadScanManager::OffloadScanManager(
     weak_ptr<OffloadServiceUtils> utils,
-    shared_ptr<OffloadScanCallbackInterface> callback)
+    shared_ptr<OffloadScanCallbackInterface> callback,
+    EventLoop* event_loop)
     : wifi_offload_hal_(nullptr),
       wifi_offload_callback_(nullptr),
       death_recipient_(nullptr),
@@ -79,9 +99,20 @@ OffloadScanManager::OffloadScanManager(
       service_available_(false),
       offload_service_utils_(utils),
       offload_callback_handlers_(new OffloadCallbackHandlersImpl(this)),
-      event_callback_(callback) {
+      event_callback_(callback),
+      event_loop_(event_loop),
+      discovery_pending_(false),
+      discovery_attempts_(0),
+      service_lost_time_us_(0),
+      num_recoveries_(0),
+      last_recovery_time_ms_(0),
+      max_recovery_time_ms_(0),
+      weak_this_owner_(new OffloadScanManager*(this)) {
   if (InitService()) {
     offload_status_ = OffloadScanManager::kNoError;
+  } else if (offload_service_utils_.lock()->IsOffloadScanSupported()) {
+    // The service may not have been started yet.
+    ScheduleServiceDiscovery();
   }
 }
 
@@ -122,15 +153,67 @@ bool OffloadScanManager::InitService() {
   return true;
 }
 
-bool OffloadScanManager::InitServiceIfNeeded() {
-  if (!service_available_) {
-    return InitService();
+void OffloadScanManager::ScheduleServiceDiscovery() {
+  if (discovery_pending_) {
+    return;
+  }
+  if (discovery_attempts_ >= kMaxDiscoveryAttempts) {
+    LOG(ERROR) << "Unable to find Offload HAL service after "
+               << discovery_attempts_ << " attempts";
+    return;
+  }
+  int64_t delay_ms = std::min(kDiscoveryInitialDelayMs << discovery_attempts_,
+                              kDiscoveryMaxDelayMs);
+  discovery_attempts_++;
+  discovery_pending_ = true;
+  weak_ptr<OffloadScanManager*> weak_this(weak_this_owner_);
+  event_loop_->PostDelayedTask(
+      [weak_this] {
+        shared_ptr<OffloadScanManager*> self = weak_this.lock();
+        if (self != nullptr) {
+          (*self)->DiscoverService();
+        }
+      },
+      delay_ms);
+}
+
+void OffloadScanManager::DiscoverService() {
+  {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    discovery_pending_ = false;
+    if (service_available_) {
+      return;
+    }
+    if (!InitService()) {
+      ScheduleServiceDiscovery();
+      return;
+    }
+    OnServiceDiscovered();
+  }
+  if (event_callback_ != nullptr) {
+    event_callback_->OnOffloadServiceAvailable();
+  }
+}
+
+void OffloadScanManager::OnServiceDiscovered() {
+  offload_status_ = OffloadScanManager::kNoError;
+  discovery_attempts_ = 0;
+  if (service_lost_time_us_ != 0) {
+    last_recovery_time_ms_ = (GetBootTimeUs() - service_lost_time_us_) / 1000;
+    max_recovery_time_ms_ =
+        std::max(max_recovery_time_ms_, last_recovery_time_ms_);
+    num_recoveries_++;
+    service_lost_time_us_ = 0;
+    LOG(INFO) << "Offload HAL service recovered after "
+              << last_recovery_time_ms_ << " ms";
+  } else {
+    LOG(INFO) << "Offload HAL service discovered";
   }
-  return true;
 }
 
 bool OffloadScanManager::stopScan(OffloadScanManager::ReasonCode* reason_code) {
-  if (!InitServiceIfNeeded() ||
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  if (!service_available_ ||
       (getOffloadStatus() != OffloadScanManager::kNoError)) {
     *reason_code = OffloadScanManager::kNotAvailable;
     return false;
@@ -181,11 +264,17 @@ bool OffloadScanManager::VerifyAndConvertHIDLStatus(
 
 bool OffloadScanManager::startScan(
     uint32_t interval_ms, int32_t rssi_threshold,
-    const vector<vector<uint8_t>>& scan_ssids,
-    const vector<vector<uint8_t>>& match_ssids,
+    const vector<Ssid>& scan_ssids,
+    const vector<Ssid>& match_ssids,
     const vector<uint8_t>& match_security, const vector<uint32_t>& freqs,
     OffloadScanManager::ReasonCode* reason_code) {
-  if (!InitServiceIfNeeded() ||
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  if (!service_available_ && !discovery_pending_) {
+    // Lookups gave up earlier; a new scan request starts them over.
+    discovery_attempts_ = 0;
+    ScheduleServiceDiscovery();
+  }
+  if (!service_available_ ||
       getOffloadStatus() != OffloadScanManager::kNoError) {
     *reason_code = OffloadScanManager::kNotAvailable;
     LOG(WARNING) << "Offload HAL scans are not available";
@@ -230,6 +319,7 @@ bool OffloadScanManager::SubscribeScanResults(
 }
 
 OffloadScanManager::StatusCode OffloadScanManager::getOffloadStatus() const {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
   if (!service_available_) {
     return OffloadScanManager::kNoService;
   }
@@ -238,6 +328,7 @@ OffloadScanManager::StatusCode OffloadScanManager::getOffloadStatus() const {
 
 bool OffloadScanManager::getScanResults(
     std::vector<NativeScanResult>* out_scan_results) {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
   for (const auto& scan_result : cached_scan_results_) {
     out_scan_results->push_back(scan_result);
   }
@@ -245,7 +336,8 @@ bool OffloadScanManager::getScanResults(
 }
 
 bool OffloadScanManager::getScanStats(NativeScanStats* native_scan_stats) {
-  if (!InitServiceIfNeeded()) {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  if (!service_available_) {
     LOG(ERROR) << "Offload HAL service unavailable";
     return false;
   }
@@ -256,6 +348,17 @@ bool OffloadScanManager::getScanStats(NativeScanStats* native_scan_stats) {
   return GetScanStats(native_scan_stats);
 }
 
+void OffloadScanManager::Dump(std::stringstream* ss) const {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  *ss << "Offload HAL service "
+      << (service_available_ ? "available" : "unavailable")
+      << ", discovery attempts " << discovery_attempts_
+      << (discovery_pending_ ? " (pending)" : "")
+      << ", recoveries " << num_recoveries_
+      << ", last recovery time " << last_recovery_time_ms_
+      << " ms, max recovery time " << max_recovery_time_ms_ << " ms" << endl;
+}
+
 OffloadScanManager::~OffloadScanManager() {
   if (wifi_offload_hal_ != nullptr) {
     wifi_offload_hal_->unlinkToDeath(death_recipient_);
@@ -264,11 +367,16 @@ OffloadScanManager::~OffloadScanManager() {
 
 void OffloadScanManager::ReportScanResults(
     const vector<ScanResult>& scanResult) {
-  cached_scan_results_.clear();
-  if (!OffloadScanUtils::convertToNativeScanResults(scanResult,
-                                                    &cached_scan_results_)) {
-    LOG(WARNING) << "Unable to convert scan results to native format";
-    return;
+  num_scan_result_reports.Increment();
+  num_scan_results.Add(scanResult.size());
+  {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    cached_scan_results_.clear();
+    if (!OffloadScanUtils::convertToNativeScanResults(
+            scanResult, &cached_scan_results_)) {
+      LOG(WARNING) << "Unable to convert scan results to native format";
+      return;
+    }
   }
   if (event_callback_ != nullptr) {
     event_callback_->OnOffloadScanResult();
@@ -300,6 +408,7 @@ void OffloadScanManager::ReportError(const OffloadStatus& status) {
   }
   if (status_result != OffloadScanManager::kNoError) {
     LOG(WARNING) << "Offload Error reported " << status.description;
+    num_errors.Increment();
     if (event_callback_ != nullptr) {
       event_callback_->OnOffloadError(
           OffloadScanCallbackInterface::REMOTE_FAILURE);
@@ -307,23 +416,35 @@ void OffloadScanManager::ReportError(const OffloadStatus& status) {
       LOG(WARNING) << "No callback to report Offload HAL Errors to wificond";
     }
   }
+  std::lock_guard<std::recursive_mutex> lock(lock_);
   offload_status_ = status_result;
 }
 
 void OffloadScanManager::OnObjectDeath(uint64_t cookie) {
-  if (wifi_offload_hal_ == reinterpret_cast<IOffload*>(cookie)) {
+  {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    if (wifi_offload_hal_ != reinterpret_cast<IOffload*>(cookie)) {
+      return;
+    }
     LOG(ERROR) << "Death Notification for Wifi Offload HAL";
+    num_service_deaths.Increment();
     wifi_offload_hal_.clear();
-    if (event_callback_ != nullptr) {
-      event_callback_->OnOffloadError(
-          OffloadScanCallbackInterface::BINDER_DEATH);
-    } else {
-      LOG(WARNING)
-          << "No callback to report Offload HAL Binder death to wificond";
-    }
+    // Mark the service unavailable before notifying, so that a stopScan()
+    // from the callback does not reach the dead service.
     service_available_ = false;
     death_recipient_.clear();
+    service_lost_time_us_ = GetBootTimeUs();
+  }
+  if (event_callback_ != nullptr) {
+    event_callback_->OnOffloadError(
+        OffloadScanCallbackInterface::BINDER_DEATH);
+  } else {
+    LOG(WARNING)
+        << "No callback to report Offload HAL Binder death to wificond";
   }
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  discovery_attempts_ = 0;
+  ScheduleServiceDiscovery();
 }
 
 }  // namespace wificond
@@ -17,10 +17,15 @@
 #define WIFICOND_OFFLOAD_SCAN_MANAGER_H_
 
 #include <android/hardware/wifi/offload/1.0/IOffload.h>
+#include "wificond/event_loop.h"
+#include "wificond/net/ssid.h"
 #include "wificond/scanning/offload/offload_callback.h"
 #include "wificond/scanning/offload/offload_callback_handlers.h"
 #include "wificond/scanning/offload_scan_callback_interface_impl.h"
 
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <vector>
 
 namespace com {
@@ -89,9 +94,13 @@ class OffloadScanManager {
     kTransactionFailed,
   };
 
-  explicit OffloadScanManager(
+  // When the Offload HAL service is not available, it is looked up again
+  // in the background by tasks posted to |event_loop|, with exponential
+  // backoff. |callback| is notified once the service is back.
+  OffloadScanManager(
       std::weak_ptr<OffloadServiceUtils> utils,
-      std::shared_ptr<OffloadScanCallbackInterface> callback);
+      std::shared_ptr<OffloadScanCallbackInterface> callback,
+      EventLoop* event_loop);
   virtual ~OffloadScanManager();
   /* Request start of offload scans with scan parameters and scan filter
    * settings. Internally calls Offload HAL service with configureScans()
@@ -99,8 +108,8 @@ class OffloadScanManager {
    */
   virtual bool startScan(
       uint32_t /* interval_ms */, int32_t /* rssi_threshold */,
-      const std::vector<std::vector<uint8_t>>& /* scan_ssids */,
-      const std::vector<std::vector<uint8_t>>& /* match_ssids */,
+      const std::vector<Ssid>& /* scan_ssids */,
+      const std::vector<Ssid>& /* match_ssids */,
       const std::vector<uint8_t>& /* match_security */,
       const std::vector<uint32_t>& /* freqs */,
       ReasonCode* /* failure reason */);
@@ -117,6 +126,8 @@ class OffloadScanManager {
   virtual bool getScanResults(
       std::vector<::com::android::server::wifi::wificond::NativeScanResult>*
           out_scan_results);
+  /* Dumps the availability and recovery statistics of Offload HAL */
+  void Dump(std::stringstream* ss) const;
 
  private:
   void ReportScanResults(
@@ -136,12 +147,22 @@ class OffloadScanManager {
       android::hardware::wifi::offload::V1_0::ScanParam,
       android::hardware::wifi::offload::V1_0::ScanFilter,
       OffloadScanManager::ReasonCode* reason_code);
-  bool InitServiceIfNeeded();
   bool InitService();
+  // Posts a delayed lookup of the Offload HAL service, unless one is already
+  // pending or |kMaxDiscoveryAttempts| lookups failed since the service was
+  // lost.
+  void ScheduleServiceDiscovery();
+  void DiscoverService();
+  // Records the time to recover.
+  void OnServiceDiscovered();
 
   /* Handle binder death */
   void OnObjectDeath(uint64_t /* cookie */);
 
+  // Guards the members below. Scans are requested by binder calls, while
+  // the Offload HAL reports on the event loop thread. |event_callback_| is
+  // called without it held.
+  mutable std::recursive_mutex lock_;
   android::sp<android::hardware::wifi::offload::V1_0::IOffload>
       wifi_offload_hal_;
   android::sp<OffloadCallback> wifi_offload_callback_;
@@ -154,6 +175,19 @@ class OffloadScanManager {
   const std::weak_ptr<OffloadServiceUtils> offload_service_utils_;
   const std::shared_ptr<OffloadCallbackHandlersImpl> offload_callback_handlers_;
   std::shared_ptr<OffloadScanCallbackInterface> event_callback_;
+  EventLoop* const event_loop_;
+
+  bool discovery_pending_;
+  uint32_t discovery_attempts_;
+  // Boot time when the service died, 0 if it is not being recovered.
+  uint64_t service_lost_time_us_;
+  uint32_t num_recoveries_;
+  uint64_t last_recovery_time_ms_;
+  uint64_t max_recovery_time_ms_;
+
+  // Discovery tasks hold a weak reference to this, so that they do nothing
+  // once |this| is destroyed.
+  std::shared_ptr<OffloadScanManager*> weak_this_owner_;
 
   friend class OffloadCallbackHandlersImpl;
 };
@@ -40,11 +40,12 @@ bool OffloadScanUtils::convertToNativeScanResults(
   if (native_scan_result == nullptr) return false;
   for (size_t i = 0; i < scan_result.size(); i++) {
     NativeScanResult single_scan_result;
-    single_scan_result.ssid.assign(scan_result[i].networkInfo.ssid.begin(),
-                                   scan_result[i].networkInfo.ssid.end());
-    for (size_t j = 0; j < scan_result[i].bssid.elementCount(); j++) {
-      single_scan_result.bssid.push_back(scan_result[i].bssid[j]);
-    }
+    Ssid::FromBytes(scan_result[i].networkInfo.ssid.data(),
+                    scan_result[i].networkInfo.ssid.size(),
+                    &single_scan_result.ssid);
+    MacAddress::FromBytes(scan_result[i].bssid.data(),
+                          scan_result[i].bssid.elementCount(),
+                          &single_scan_result.bssid);
     single_scan_result.frequency = scan_result[i].frequency;
     single_scan_result.signal_mbm = scan_result[i].rssi;
     single_scan_result.tsf = systemTime(SYSTEM_TIME_MONOTONIC) / 1000;
@@ -56,21 +57,21 @@ bool OffloadScanUtils::convertToNativeScanResults(
 }
 
 ScanParam OffloadScanUtils::createScanParam(
-    const vector<vector<uint8_t>>& ssid_list,
+    const vector<Ssid>& ssid_list,
     const vector<uint32_t>& frequency_list, uint32_t scan_interval_ms) {
   ScanParam scan_param;
   scan_param.disconnectedModeScanIntervalMs = scan_interval_ms;
   scan_param.frequencyList = frequency_list;
   vector<hidl_vec<uint8_t>> ssid_list_tmp;
   for (const auto& ssid : ssid_list) {
-    ssid_list_tmp.push_back(ssid);
+    ssid_list_tmp.push_back(ssid.ToBytes());
   }
   scan_param.ssidList = ssid_list_tmp;
   return scan_param;
 }
 
 ScanFilter OffloadScanUtils::createScanFilter(
-    const vector<vector<uint8_t>>& ssids, const vector<uint8_t>& flags,
+    const vector<Ssid>& ssids, const vector<uint8_t>& flags,
     int8_t rssi_threshold) {
   ScanFilter scan_filter;
   vector<NetworkInfo> nw_info_list;
@@ -79,7 +80,7 @@ ScanFilter OffloadScanUtils::createScanFilter(
   // Note that the number of ssids should match the number of security flags
   for (const auto& ssid : ssids) {
     NetworkInfo nw_info;
-    nw_info.ssid = ssid;
+    nw_info.ssid = ssid.ToBytes();
     if (i < flags.size()) {
       nw_info.flags = flags[i++];
     } else {
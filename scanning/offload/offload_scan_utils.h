@@ -17,6 +17,7 @@
 #define WIFICOND_OFFLOAD_SCAN_UTILS_H_
 
 #include <android/hardware/wifi/offload/1.0/IOffload.h>
+#include "wificond/net/ssid.h"
 #include "wificond/scanning/offload/offload_callback.h"
 
 #include <vector>
@@ -46,7 +47,7 @@ class OffloadScanUtils {
       const std::vector<android::hardware::wifi::offload::V1_0::ScanResult>&,
       std::vector<::com::android::server::wifi::wificond::NativeScanResult>*);
   static android::hardware::wifi::offload::V1_0::ScanParam createScanParam(
-      const std::vector<std::vector<uint8_t>>& ssid_list,
+      const std::vector<Ssid>& ssid_list,
       const std::vector<uint32_t>& frequency_list, uint32_t scan_interval_ms);
   /* Creates ScanFilter using ssids, security flags and rssi_threshold
    * The caller must ensure that the number of ssids match the number of
@@ -55,7 +56,7 @@ class OffloadScanUtils {
    * network
    */
   static android::hardware::wifi::offload::V1_0::ScanFilter createScanFilter(
-      const std::vector<std::vector<uint8_t>>& ssids,
+      const std::vector<Ssid>& ssids,
       const std::vector<uint8_t>& flags, int8_t rssi_threshold);
   static ::com::android::server::wifi::wificond::NativeScanStats
       convertToNativeScanStats(
@@ -56,8 +56,10 @@ OffloadServiceUtils::GetOffloadScanCallbackInterface(ScannerImpl* parent) {
 
 std::shared_ptr<OffloadScanManager> OffloadServiceUtils::GetOffloadScanManager(
     std::weak_ptr<OffloadServiceUtils> service_utils,
-    std::shared_ptr<OffloadScanCallbackInterfaceImpl> callback_interface) {
-  return std::make_shared<OffloadScanManager>(service_utils, callback_interface);
+    std::shared_ptr<OffloadScanCallbackInterfaceImpl> callback_interface,
+    EventLoop* event_loop) {
+  return std::make_shared<OffloadScanManager>(service_utils, callback_interface,
+                                              event_loop);
 }
 
 OffloadDeathRecipient::OffloadDeathRecipient(
@@ -25,6 +25,7 @@ namespace android {
 namespace wificond {
 
 typedef std::function<void(uint64_t)> OffloadDeathRecipientHandler;
+class EventLoop;
 class ScannerImpl;
 class OffloadServiceUtils;
 class OffloadScanManager;
@@ -60,7 +61,8 @@ class OffloadServiceUtils {
   GetOffloadScanCallbackInterface(ScannerImpl* parent);
   virtual std::shared_ptr<OffloadScanManager> GetOffloadScanManager(
       std::weak_ptr<OffloadServiceUtils> service_utils,
-      std::shared_ptr<OffloadScanCallbackInterfaceImpl> callback_interface);
+      std::shared_ptr<OffloadScanCallbackInterfaceImpl> callback_interface,
+      EventLoop* event_loop);
 };
 
 }  // namespace wificond
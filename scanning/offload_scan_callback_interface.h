@@ -34,6 +34,9 @@ class OffloadScanCallbackInterface {
 
   virtual void OnOffloadScanResult() = 0;
   virtual void OnOffloadError(AsyncErrorReason) = 0;
+  // Called when the Offload HAL service is available again after it died
+  // or could not be found.
+  virtual void OnOffloadServiceAvailable() = 0;
 };
 
 }  // namespace wificond
@@ -38,5 +38,9 @@ void OffloadScanCallbackInterfaceImpl::OnOffloadError(
   scanner_impl_->OnOffloadError(error_code);
 }
 
+void OffloadScanCallbackInterfaceImpl::OnOffloadServiceAvailable() {
+  scanner_impl_->OnOffloadServiceAvailable();
+}
+
 }  // namespace wificond
 }  // namespace android
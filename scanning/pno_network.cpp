@@ -21,6 +21,7 @@
 #include "wificond/parcelable_utils.h"
 
 using android::status_t;
+using android::wificond::Ssid;
 
 namespace com {
 namespace android {
@@ -30,7 +31,7 @@ namespace wificond {
 
 status_t PnoNetwork::writeToParcel(::android::Parcel* parcel) const {
   RETURN_IF_FAILED(parcel->writeInt32(is_hidden_ ? 1 : 0));
-  RETURN_IF_FAILED(parcel->writeByteVector(ssid_));
+  RETURN_IF_FAILED(parcel->writeByteVector(ssid_.ToBytes()));
   return ::android::OK;
 }
 
@@ -38,7 +39,11 @@ status_t PnoNetwork::readFromParcel(const ::android::Parcel* parcel) {
   int32_t is_hidden = 0;
   RETURN_IF_FAILED(parcel->readInt32(&is_hidden));
   is_hidden_ = (is_hidden != 0);
-  RETURN_IF_FAILED(parcel->readByteVector(&ssid_));
+  std::vector<uint8_t> ssid;
+  RETURN_IF_FAILED(parcel->readByteVector(&ssid));
+  if (!Ssid::FromBytes(ssid, &ssid_)) {
+    return ::android::BAD_VALUE;
+  }
   return ::android::OK;
 }
 
@@ -22,6 +22,8 @@
 #include <binder/Parcel.h>
 #include <binder/Parcelable.h>
 
+#include "wificond/net/ssid.h"
+
 namespace com {
 namespace android {
 namespace server {
@@ -39,7 +41,7 @@ class PnoNetwork : public ::android::Parcelable {
   ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
 
   bool is_hidden_;
-  std::vector<uint8_t> ssid_;
+  ::android::wificond::Ssid ssid_;
 };
 
 }  // namespace wificond
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/pno_network_matcher.h"
+
+#include <utility>
+
+using com::android::server::wifi::wificond::NativeScanResult;
+using com::android::server::wifi::wificond::PnoSettings;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+const int PnoNetworkMatcher::kNoMatch = -1;
+
+PnoNetworkMatcher::PnoNetworkMatcher(const PnoSettings& pno_settings)
+    : num_networks_(pno_settings.pno_networks_.size()) {
+  network_indices_.reserve(pno_settings.pno_networks_.size());
+  for (size_t i = 0; i < pno_settings.pno_networks_.size(); i++) {
+    network_indices_.emplace(pno_settings.pno_networks_[i].ssid_, i);
+  }
+}
+
+int PnoNetworkMatcher::Match(const NativeScanResult& scan_result) const {
+  const auto it = network_indices_.find(scan_result.ssid);
+  if (it == network_indices_.end()) {
+    return kNoMatch;
+  }
+  return it->second;
+}
+
+void PnoNetworkMatcher::Filter(vector<NativeScanResult>* scan_results,
+                               vector<int>* network_indices) const {
+  if (network_indices != nullptr) {
+    network_indices->clear();
+  }
+  size_t num_matched = 0;
+  for (size_t i = 0; i < scan_results->size(); i++) {
+    int network_index = Match((*scan_results)[i]);
+    if (network_index == kNoMatch) {
+      continue;
+    }
+    if (num_matched != i) {
+      (*scan_results)[num_matched] = std::move((*scan_results)[i]);
+    }
+    num_matched++;
+    if (network_indices != nullptr) {
+      network_indices->push_back(network_index);
+    }
+  }
+  scan_results->resize(num_matched);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_PNO_NETWORK_MATCHER_H_
+#define WIFICOND_SCANNING_PNO_NETWORK_MATCHER_H_
+
+#include <stddef.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "wificond/net/ssid.h"
+#include "wificond/scanning/pno_settings.h"
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace wificond {
+
+// Tells which network of a PnoSettings a scan result belongs to.
+// Networks are looked up by SSID in a hash table, so matching a BSS costs
+// the same regardless of the number of saved networks.
+class PnoNetworkMatcher {
+ public:
+  // Returned by Match() for results of networks that are not saved.
+  static const int kNoMatch;
+
+  PnoNetworkMatcher() = default;
+  explicit PnoNetworkMatcher(
+      const ::com::android::server::wifi::wificond::PnoSettings& pno_settings);
+
+  // Returns the index in PnoSettings::pno_networks_ of the network that
+  // |scan_result| belongs to, or |kNoMatch|.
+  int Match(
+      const ::com::android::server::wifi::wificond::NativeScanResult&
+          scan_result) const;
+  // Removes the results that match no network from |scan_results|.
+  // |network_indices| is filled with the index of the network matched by
+  // each remaining result, if not null.
+  void Filter(
+      std::vector<::com::android::server::wifi::wificond::NativeScanResult>*
+          scan_results,
+      std::vector<int>* network_indices) const;
+
+  // Number of networks the matcher was built from.
+  size_t size() const { return num_networks_; }
+
+ private:
+  // First index of each SSID in PnoSettings::pno_networks_.
+  std::unordered_map<Ssid, int> network_indices_;
+  size_t num_networks_ = 0;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_PNO_NETWORK_MATCHER_H_
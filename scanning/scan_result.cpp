@@ -18,11 +18,12 @@
 
 #include <android-base/logging.h>
 
-#include "wificond/logging_utils.h"
 #include "wificond/parcelable_utils.h"
 
 using android::status_t;
 using android::OK;
+using android::wificond::MacAddress;
+using android::wificond::Ssid;
 using std::string;
 
 namespace com {
@@ -31,8 +32,8 @@ namespace server {
 namespace wifi {
 namespace wificond {
 
-NativeScanResult::NativeScanResult(std::vector<uint8_t>& ssid_,
-                                   std::vector<uint8_t>& bssid_,
+NativeScanResult::NativeScanResult(const Ssid& ssid_,
+                                   const MacAddress& bssid_,
                                    std::vector<uint8_t>& info_element_,
                                    uint32_t frequency_,
                                    int32_t signal_mbm_,
@@ -50,8 +51,8 @@ NativeScanResult::NativeScanResult(std::vector<uint8_t>& ssid_,
 }
 
 status_t NativeScanResult::writeToParcel(::android::Parcel* parcel) const {
-  RETURN_IF_FAILED(parcel->writeByteVector(ssid));
-  RETURN_IF_FAILED(parcel->writeByteVector(bssid));
+  RETURN_IF_FAILED(parcel->writeByteVector(ssid.ToBytes()));
+  RETURN_IF_FAILED(parcel->writeByteVector(bssid.ToBytes()));
   RETURN_IF_FAILED(parcel->writeByteVector(info_element));
   RETURN_IF_FAILED(parcel->writeUint32(frequency));
   RETURN_IF_FAILED(parcel->writeInt32(signal_mbm));
@@ -64,8 +65,16 @@ status_t NativeScanResult::writeToParcel(::android::Parcel* parcel) const {
 }
 
 status_t NativeScanResult::readFromParcel(const ::android::Parcel* parcel) {
-  RETURN_IF_FAILED(parcel->readByteVector(&ssid));
-  RETURN_IF_FAILED(parcel->readByteVector(&bssid));
+  std::vector<uint8_t> ssid_bytes;
+  RETURN_IF_FAILED(parcel->readByteVector(&ssid_bytes));
+  if (!Ssid::FromBytes(ssid_bytes, &ssid)) {
+    return ::android::BAD_VALUE;
+  }
+  std::vector<uint8_t> bssid_bytes;
+  RETURN_IF_FAILED(parcel->readByteVector(&bssid_bytes));
+  if (!MacAddress::FromBytes(bssid_bytes, &bssid)) {
+    return ::android::BAD_VALUE;
+  }
   RETURN_IF_FAILED(parcel->readByteVector(&info_element));
   RETURN_IF_FAILED(parcel->readUint32(&frequency));
   RETURN_IF_FAILED(parcel->readInt32(&signal_mbm));
@@ -80,11 +89,9 @@ status_t NativeScanResult::readFromParcel(const ::android::Parcel* parcel) {
 void NativeScanResult::DebugLog() {
   LOG(INFO) << "Scan result:";
   // |ssid| might be an encoded array but we just print it as ASCII here.
-  string ssid_str(ssid.data(), ssid.data() + ssid.size());
-  LOG(INFO) << "SSID: " << ssid_str;
+  LOG(INFO) << "SSID: " << ssid.ToString();
 
-  LOG(INFO) << "BSSID: "
-            << ::android::wificond::LoggingUtils::GetMacString(bssid);
+  LOG(INFO) << "BSSID: " << bssid.ToString();
   LOG(INFO) << "FREQUENCY: " << frequency;
   LOG(INFO) << "SIGNAL: " << signal_mbm/100 << "dBm";
   LOG(INFO) << "TSF: " << tsf;
@@ -22,6 +22,9 @@
 #include <binder/Parcel.h>
 #include <binder/Parcelable.h>
 
+#include "wificond/net/mac_address.h"
+#include "wificond/net/ssid.h"
+
 namespace com {
 namespace android {
 namespace server {
@@ -32,8 +35,8 @@ namespace wificond {
 class NativeScanResult : public ::android::Parcelable {
  public:
   NativeScanResult() = default;
-  NativeScanResult(std::vector<uint8_t>& ssid,
-                   std::vector<uint8_t>& bssid,
+  NativeScanResult(const ::android::wificond::Ssid& ssid,
+                   const ::android::wificond::MacAddress& bssid,
                    std::vector<uint8_t>& info_element,
                    uint32_t frequency,
                    int32_t signal_mbm,
@@ -46,9 +49,9 @@ class NativeScanResult : public ::android::Parcelable {
   void DebugLog();
 
   // SSID of the BSS.
-  std::vector<uint8_t> ssid;
+  ::android::wificond::Ssid ssid;
   // BSSID of the BSS.
-  std::vector<uint8_t> bssid;
+  ::android::wificond::MacAddress bssid;
   // Binary array containing the raw information elements from the probe
   // response/beacon.
   std::vector<uint8_t> info_element;
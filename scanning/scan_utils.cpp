@@ -23,7 +23,9 @@
 
 #include <android-base/logging.h>
 
+#include "wificond/net/mac_address.h"
 #include "wificond/net/netlink_manager.h"
+#include "wificond/net/netlink_utils.h"
 #include "wificond/net/nl80211_packet.h"
 #include "wificond/scanning/scan_result.h"
 
@@ -59,6 +61,19 @@ void ScanUtils::UnsubscribeScanResultNotification(uint32_t interface_index) {
   netlink_manager_->UnsubscribeScanResultNotification(interface_index);
 }
 
+void ScanUtils::SubscribeScanResultsDumped(
+    OnScanResultsDumpedHandler handler) {
+  on_scan_results_dumped_handler_ = handler;
+}
+
+void ScanUtils::UnsubscribeScanResultsDumped() {
+  on_scan_results_dumped_handler_ = nullptr;
+}
+
+void ScanUtils::DropRequestTemplates(uint32_t interface_index) {
+  request_templates_.RemoveInterface(interface_index);
+}
+
 void ScanUtils::SubscribeSchedScanResultNotification(
     uint32_t interface_index,
     OnSchedScanResultsReadyHandler handler) {
@@ -120,6 +135,9 @@ bool ScanUtils::GetScanResult(uint32_t interface_index,
     }
     out_scan_results->push_back(std::move(scan_result));
   }
+  if (on_scan_results_dumped_handler_) {
+    on_scan_results_dumped_handler_(interface_index, *out_scan_results);
+  }
   return true;
 }
 
@@ -131,7 +149,7 @@ bool ScanUtils::ParseScanResult(unique_ptr<const NL80211Packet> packet,
   }
   NL80211NestedAttr bss(0);
   if (packet->GetAttribute(NL80211_ATTR_BSS, &bss)) {
-    vector<uint8_t> bssid;
+    MacAddress bssid;
     if (!bss.GetAttributeValue(NL80211_BSS_BSSID, &bssid)) {
       LOG(ERROR) << "Failed to get BSSID from scan result packet";
       return false;
@@ -146,7 +164,7 @@ bool ScanUtils::ParseScanResult(unique_ptr<const NL80211Packet> packet,
       LOG(ERROR) << "Failed to get Information Element from scan result packet";
       return false;
     }
-    vector<uint8_t> ssid;
+    Ssid ssid;
     if (!GetSSIDFromInfoElement(ie, &ssid)) {
       // Skip BSS without SSID IE.
       // These scan results are considered as malformed.
@@ -212,7 +230,7 @@ bool ScanUtils::GetBssTimestamp(const NL80211NestedAttr& bss,
 }
 
 bool ScanUtils::GetSSIDFromInfoElement(const vector<uint8_t>& ie,
-                                       vector<uint8_t>* ssid) {
+                                       Ssid* ssid) {
   // Information elements are stored in 'TLV' format.
   // Field:  |   Type     |          Length           |      Value      |
   // Length: |     1      |             1             |     variable    |
@@ -229,13 +247,8 @@ bool ScanUtils::GetSSIDFromInfoElement(const vector<uint8_t>& ie,
     }
     // SSID element is found.
     if (type == kElemIdSsid) {
-      // SSID is an empty string.
-      if (length == 0) {
-        *ssid = vector<uint8_t>();
-      } else {
-        *ssid = vector<uint8_t>(ptr + 2, ptr + length + 2);
-      }
-      return true;
+      // Fails for SSIDs longer than 32 bytes, which are malformed.
+      return Ssid::FromBytes(ptr + 2, length, ssid);
     }
     ptr += 2 + length;
   }
@@ -243,75 +256,114 @@ bool ScanUtils::GetSSIDFromInfoElement(const vector<uint8_t>& ie,
 }
 
 bool ScanUtils::Scan(uint32_t interface_index,
-                     bool request_random_mac,
-                     const vector<vector<uint8_t>>& ssids,
+                     const SingleScanFlags& flags,
+                     const vector<Ssid>& ssids,
                      const vector<uint32_t>& freqs,
                      int* error_code) {
-  NL80211Packet trigger_scan(
-      netlink_manager_->GetFamilyId(),
-      NL80211_CMD_TRIGGER_SCAN,
-      netlink_manager_->GetSequenceNumber(),
-      getpid());
-  // If we do not use NLM_F_ACK, we only receive a unicast repsonse
-  // when there is an error. If everything is good, scan results notification
-  // will only be sent through multicast.
-  // If NLM_F_ACK is set, there will always be an unicast repsonse, either an
-  // ERROR or an ACK message. The handler will always be called and removed by
-  // NetlinkManager.
-  trigger_scan.AddFlag(NLM_F_ACK);
-  NL80211Attr<uint32_t> if_index_attr(NL80211_ATTR_IFINDEX, interface_index);
-
-  NL80211NestedAttr ssids_attr(NL80211_ATTR_SCAN_SSIDS);
-  for (size_t i = 0; i < ssids.size(); i++) {
-    ssids_attr.AddAttribute(NL80211Attr<vector<uint8_t>>(i, ssids[i]));
-  }
-  NL80211NestedAttr freqs_attr(NL80211_ATTR_SCAN_FREQUENCIES);
-  for (size_t i = 0; i < freqs.size(); i++) {
-    freqs_attr.AddAttribute(NL80211Attr<uint32_t>(i, freqs[i]));
+  uint32_t scan_flags = GetNL80211ScanFlags(flags);
+  uint32_t sequence = netlink_manager_->GetSequenceNumber();
+  // Full band wildcard scans are requested over and over, so their requests
+  // are kept and only get a new sequence number.
+  bool is_full_band_wildcard =
+      freqs.empty() && ssids.size() == 1 && ssids[0].empty();
+  NL80211Packet* trigger_scan = nullptr;
+  if (is_full_band_wildcard) {
+    trigger_scan = request_templates_.Get(NL80211_CMD_TRIGGER_SCAN,
+                                          interface_index, scan_flags,
+                                          sequence, getpid());
   }
+  unique_ptr<NL80211Packet> request;
+  if (trigger_scan == nullptr) {
+    request.reset(new NL80211Packet(
+        netlink_manager_->GetFamilyId(),
+        NL80211_CMD_TRIGGER_SCAN,
+        sequence,
+        getpid()));
+    // If we do not use NLM_F_ACK, we only receive a unicast repsonse
+    // when there is an error. If everything is good, scan results
+    // notification will only be sent through multicast.
+    // If NLM_F_ACK is set, there will always be an unicast repsonse, either an
+    // ERROR or an ACK message. The handler will always be called and removed
+    // by NetlinkManager.
+    request->AddFlag(NLM_F_ACK);
+    NL80211Attr<uint32_t> if_index_attr(NL80211_ATTR_IFINDEX, interface_index);
+
+    NL80211NestedAttr ssids_attr(NL80211_ATTR_SCAN_SSIDS);
+    for (size_t i = 0; i < ssids.size(); i++) {
+      ssids_attr.AddAttribute(NL80211Attr<Ssid>(i, ssids[i]));
+    }
+    NL80211NestedAttr freqs_attr(NL80211_ATTR_SCAN_FREQUENCIES);
+    for (size_t i = 0; i < freqs.size(); i++) {
+      freqs_attr.AddAttribute(NL80211Attr<uint32_t>(i, freqs[i]));
+    }
 
-  trigger_scan.AddAttribute(if_index_attr);
-  trigger_scan.AddAttribute(ssids_attr);
-  // An absence of NL80211_ATTR_SCAN_FREQUENCIES attribue informs kernel to
-  // scan all supported frequencies.
-  if (!freqs.empty()) {
-    trigger_scan.AddAttribute(freqs_attr);
-  }
+    request->AddAttribute(if_index_attr);
+    request->AddAttribute(ssids_attr);
+    // An absence of NL80211_ATTR_SCAN_FREQUENCIES attribue informs kernel to
+    // scan all supported frequencies.
+    if (!freqs.empty()) {
+      request->AddAttribute(freqs_attr);
+    }
 
-  if (request_random_mac) {
-    trigger_scan.AddAttribute(
-        NL80211Attr<uint32_t>(NL80211_ATTR_SCAN_FLAGS,
-                              NL80211_SCAN_FLAG_RANDOM_ADDR));
+    if (scan_flags != 0) {
+      request->AddAttribute(
+          NL80211Attr<uint32_t>(NL80211_ATTR_SCAN_FLAGS, scan_flags));
+    }
+    if (is_full_band_wildcard) {
+      trigger_scan = request_templates_.Put(interface_index, scan_flags,
+                                            std::move(request));
+    } else {
+      trigger_scan = request.get();
+    }
   }
   // We are receiving an ERROR/ACK message instead of the actual
   // scan results here, so it is OK to expect a timely response because
   // kernel is supposed to send the ERROR/ACK back before the scan starts.
-  vector<unique_ptr<const NL80211Packet>> response;
-  if (!netlink_manager_->SendMessageAndGetAckOrError(trigger_scan,
-                                                     error_code)) {
+  NetlinkError error;
+  if (!netlink_manager_->SendMessageAndGetAckOrError(*trigger_scan, &error)) {
     // Logging is done inside |SendMessageAndGetAckOrError|.
     return false;
   }
+  *error_code = error.error_code;
   if (*error_code != 0) {
-    LOG(ERROR) << "NL80211_CMD_TRIGGER_SCAN failed: " << strerror(*error_code);
+    LOG(ERROR) << "NL80211_CMD_TRIGGER_SCAN failed: " << error.ToString();
     return false;
   }
   return true;
 }
 
+uint32_t ScanUtils::GetNL80211ScanFlags(const SingleScanFlags& flags) {
+  uint32_t scan_flags = 0;
+  if (flags.request_random_mac) {
+    scan_flags |= NL80211_SCAN_FLAG_RANDOM_ADDR;
+  }
+  if (flags.flush) {
+    scan_flags |= NL80211_SCAN_FLAG_FLUSH;
+  }
+  if (flags.low_priority) {
+    scan_flags |= NL80211_SCAN_FLAG_LOW_PRIORITY;
+  }
+  switch (flags.scan_type) {
+    case SingleScanFlags::ScanType::kLowSpan:
+      scan_flags |= kScanFlagLowSpan;
+      break;
+    case SingleScanFlags::ScanType::kLowPower:
+      scan_flags |= kScanFlagLowPower;
+      break;
+    case SingleScanFlags::ScanType::kHighAccuracy:
+      scan_flags |= kScanFlagHighAccuracy;
+      break;
+    case SingleScanFlags::ScanType::kDefault:
+      break;
+  }
+  return scan_flags;
+}
+
 bool ScanUtils::StopScheduledScan(uint32_t interface_index) {
-  NL80211Packet stop_sched_scan(
-      netlink_manager_->GetFamilyId(),
-      NL80211_CMD_STOP_SCHED_SCAN,
-      netlink_manager_->GetSequenceNumber(),
-      getpid());
-  // Force an ACK response upon success.
-  stop_sched_scan.AddFlag(NLM_F_ACK);
-  stop_sched_scan.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
-  vector<unique_ptr<const NL80211Packet>> response;
+  NL80211Packet* stop_sched_scan =
+      GetInterfaceRequest(NL80211_CMD_STOP_SCHED_SCAN, interface_index);
   int error_code;
-  if (!netlink_manager_->SendMessageAndGetAckOrError(stop_sched_scan,
+  if (!netlink_manager_->SendMessageAndGetAckOrError(*stop_sched_scan,
                                                      &error_code))  {
     LOG(ERROR) << "NL80211_CMD_STOP_SCHED_SCAN failed";
     return false;
@@ -328,19 +380,30 @@ bool ScanUtils::StopScheduledScan(uint32_t interface_index) {
   return true;
 }
 
-bool ScanUtils::AbortScan(uint32_t interface_index) {
-  NL80211Packet abort_scan(
+NL80211Packet* ScanUtils::GetInterfaceRequest(uint8_t command,
+                                             uint32_t interface_index) {
+  uint32_t sequence = netlink_manager_->GetSequenceNumber();
+  NL80211Packet* request = request_templates_.Get(
+      command, interface_index, 0, sequence, getpid());
+  if (request != nullptr) {
+    return request;
+  }
+  unique_ptr<NL80211Packet> new_request(new NL80211Packet(
       netlink_manager_->GetFamilyId(),
-      NL80211_CMD_ABORT_SCAN,
-      netlink_manager_->GetSequenceNumber(),
-      getpid());
-
+      command,
+      sequence,
+      getpid()));
   // Force an ACK response upon success.
-  abort_scan.AddFlag(NLM_F_ACK);
-  abort_scan.AddAttribute(
+  new_request->AddFlag(NLM_F_ACK);
+  new_request->AddAttribute(
       NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  return request_templates_.Put(interface_index, 0, std::move(new_request));
+}
 
-  if (!netlink_manager_->SendMessageAndGetAck(abort_scan)) {
+bool ScanUtils::AbortScan(uint32_t interface_index) {
+  NL80211Packet* abort_scan =
+      GetInterfaceRequest(NL80211_CMD_ABORT_SCAN, interface_index);
+  if (!netlink_manager_->SendMessageAndGetAck(*abort_scan)) {
     LOG(ERROR) << "NL80211_CMD_ABORT_SCAN failed";
     return false;
   }
@@ -352,8 +415,8 @@ bool ScanUtils::StartScheduledScan(
     const SchedScanIntervalSetting& interval_setting,
     int32_t rssi_threshold,
     bool request_random_mac,
-    const std::vector<std::vector<uint8_t>>& scan_ssids,
-    const std::vector<std::vector<uint8_t>>& match_ssids,
+    const std::vector<Ssid>& scan_ssids,
+    const std::vector<Ssid>& match_ssids,
     const std::vector<uint32_t>& freqs,
     int* error_code) {
   NL80211Packet start_sched_scan(
@@ -366,7 +429,7 @@ bool ScanUtils::StartScheduledScan(
 
   NL80211NestedAttr scan_ssids_attr(NL80211_ATTR_SCAN_SSIDS);
   for (size_t i = 0; i < scan_ssids.size(); i++) {
-    scan_ssids_attr.AddAttribute(NL80211Attr<vector<uint8_t>>(i, scan_ssids[i]));
+    scan_ssids_attr.AddAttribute(NL80211Attr<Ssid>(i, scan_ssids[i]));
   }
   NL80211NestedAttr freqs_attr(NL80211_ATTR_SCAN_FREQUENCIES);
   for (size_t i = 0; i < freqs.size(); i++) {
@@ -381,7 +444,7 @@ bool ScanUtils::StartScheduledScan(
   for (size_t i = 0; i < match_ssids.size(); i++) {
     NL80211NestedAttr match_group(i);
     match_group.AddAttribute(
-        NL80211Attr<vector<uint8_t>>(NL80211_SCHED_SCAN_MATCH_ATTR_SSID, match_ssids[i]));
+        NL80211Attr<Ssid>(NL80211_SCHED_SCAN_MATCH_ATTR_SSID, match_ssids[i]));
     match_group.AddAttribute(
         NL80211Attr<int32_t>(NL80211_SCHED_SCAN_MATCH_ATTR_RSSI, rssi_threshold));
     scan_match_attr.AddAttribute(match_group);
@@ -428,14 +491,15 @@ bool ScanUtils::StartScheduledScan(
                               NL80211_SCAN_FLAG_RANDOM_ADDR));
   }
 
-  vector<unique_ptr<const NL80211Packet>> response;
+  NetlinkError error;
   if (!netlink_manager_->SendMessageAndGetAckOrError(start_sched_scan,
-                                                     error_code)) {
+                                                     &error)) {
     // Logging is done inside |SendMessageAndGetAckOrError|.
     return false;
   }
+  *error_code = error.error_code;
   if (*error_code != 0) {
-    LOG(ERROR) << "NL80211_CMD_START_SCHED_SCAN failed: " << strerror(*error_code);
+    LOG(ERROR) << "NL80211_CMD_START_SCHED_SCAN failed: " << error.ToString();
     return false;
   }
 
@@ -17,12 +17,15 @@
 #ifndef WIFICOND_SCANNING_SCAN_UTILS_H_
 #define WIFICOND_SCANNING_SCAN_UTILS_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include <android-base/macros.h>
 
 #include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_request_cache.h"
+#include "wificond/net/ssid.h"
 
 namespace com {
 namespace android {
@@ -55,6 +58,35 @@ struct SchedScanIntervalSetting {
   uint32_t final_interval_ms{0};
 };
 
+// Options of a single scan, mapped to NL80211_ATTR_SCAN_FLAGS.
+// Callers must only set the ones the wiphy supports, see WiphyFeatures.
+struct SingleScanFlags {
+  // Low span, low power and high accuracy scans exclude each other.
+  enum class ScanType {
+    kDefault,
+    kLowSpan,
+    kLowPower,
+    kHighAccuracy,
+  };
+  // Use a random MAC address during scan (while not associated).
+  bool request_random_mac{false};
+  // Flush the scan result cache of kernel before scanning.
+  bool flush{false};
+  // Let the scan yield to other traffic.
+  bool low_priority{false};
+  ScanType scan_type{ScanType::kDefault};
+};
+
+// This describes a type of function handling the results of a scan result
+// dump from kernel.
+// |interface_index| is the index of interface which the scan results are
+// from, and |scan_results| are the results of the dump.
+typedef std::function<void(
+    uint32_t interface_index,
+    const std::vector<
+        ::com::android::server::wifi::wificond::NativeScanResult>&
+            scan_results)> OnScanResultsDumpedHandler;
+
 // Provides scanning helper functions.
 class ScanUtils {
  public:
@@ -71,10 +103,9 @@ class ScanUtils {
       std::vector<::com::android::server::wifi::wificond::NativeScanResult>* out_scan_results);
 
   // Send scan request to kernel for interface with index |interface_index|.
-  // |request_random_mac| is used for asking device/driver to use a random MAC
-  // address during scan.
-  // This flag should only be set if kernel supports this feature as
-  // |supports_random_mac_oneshot_scan| indicates.
+  // |flags| are the options of this scan. They should only be set if kernel
+  // supports them, as |supports_random_mac_oneshot_scan| and friends of
+  // WiphyFeatures indicate.
   // |ssids| is a vector of ssids we request to scan, which mostly is used
   // for hidden networks.
   // If |ssids| is an empty vector, it will do a passive scan.
@@ -84,8 +115,8 @@ class ScanUtils {
   // |error_code| contains the errno kernel replied when this returns false.
   // Returns true on success.
   virtual bool Scan(uint32_t interface_index,
-                    bool request_random_mac,
-                    const std::vector<std::vector<uint8_t>>& ssids,
+                    const SingleScanFlags& flags,
+                    const std::vector<Ssid>& ssids,
                     const std::vector<uint32_t>& freqs,
                     int* error_code);
 
@@ -112,8 +143,8 @@ class ScanUtils {
       const SchedScanIntervalSetting& interval_setting,
       int32_t rssi_threshold,
       bool request_random_mac,
-      const std::vector<std::vector<uint8_t>>& scan_ssids,
-      const std::vector<std::vector<uint8_t>>& match_ssids,
+      const std::vector<Ssid>& scan_ssids,
+      const std::vector<Ssid>& match_ssids,
       const std::vector<uint32_t>& freqs,
       int* error_code);
 
@@ -160,17 +191,39 @@ class ScanUtils {
   // interface with index |interface_index|.
   virtual void UnsubscribeSchedScanResultNotification(uint32_t interface_index);
 
+  // Sign up to be notified of the results of every successful
+  // GetScanResult() call, e.g. to keep a history of the BSSs seen.
+  // Only one handler can be registered. New handler will replace the
+  // registered one.
+  void SubscribeScanResultsDumped(OnScanResultsDumpedHandler handler);
+
+  // Cancel the sign-up of receiving scan result dumps.
+  void UnsubscribeScanResultsDumped();
+
+  // Drops the pre-encoded requests of interface |interface_index|.
+  // This should be called when the interface goes away.
+  virtual void DropRequestTemplates(uint32_t interface_index);
+
  private:
+  // Returns the NL80211_ATTR_SCAN_FLAGS value for |flags|.
+  static uint32_t GetNL80211ScanFlags(const SingleScanFlags& flags);
+  // Returns the pre-encoded |command| request for |interface_index|, which
+  // asks for an ACK and carries no attribute but NL80211_ATTR_IFINDEX.
+  NL80211Packet* GetInterfaceRequest(uint8_t command,
+                                     uint32_t interface_index);
   bool GetBssTimestamp(const NL80211NestedAttr& bss,
                        uint64_t* last_seen_since_boot_microseconds);
-  bool GetSSIDFromInfoElement(const std::vector<uint8_t>& ie,
-                              std::vector<uint8_t>* ssid);
+  bool GetSSIDFromInfoElement(const std::vector<uint8_t>& ie, Ssid* ssid);
   // Converts a NL80211_CMD_NEW_SCAN_RESULTS packet to a ScanResult object.
   bool ParseScanResult(
       std::unique_ptr<const NL80211Packet> packet,
       ::com::android::server::wifi::wificond::NativeScanResult* scan_result);
 
   NetlinkManager* netlink_manager_;
+  OnScanResultsDumpedHandler on_scan_results_dumped_handler_;
+  // Pre-encoded requests of full band wildcard scans, scan aborts and
+  // scheduled scan stops.
+  NL80211RequestCache request_templates_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanUtils);
 };
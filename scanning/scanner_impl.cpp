@@ -16,12 +16,21 @@
 
 #include "wificond/scanning/scanner_impl.h"
 
+#include <algorithm>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <android-base/logging.h>
+#include <utils/Timers.h>
 
 #include "wificond/client_interface_impl.h"
+#include "wificond/event_loop.h"
+#include "wificond/metrics_registry.h"
+#include "wificond/net/netlink_rate_limiter.h"
+#include "wificond/regulatory_model.h"
+#include "wificond/scanning/bss_cache.h"
 #include "wificond/scanning/offload/offload_scan_manager.h"
 #include "wificond/scanning/offload/offload_service_utils.h"
 #include "wificond/scanning/scan_utils.h"
@@ -29,12 +38,14 @@
 using android::binder::Status;
 using android::net::wifi::IPnoScanEvent;
 using android::net::wifi::IScanEvent;
+using android::net::wifi::IWifiScannerImpl;
 using android::hardware::wifi::offload::V1_0::IOffload;
 using android::sp;
 using com::android::server::wifi::wificond::NativeScanResult;
 using com::android::server::wifi::wificond::PnoSettings;
 using com::android::server::wifi::wificond::SingleScanSettings;
 
+using std::endl;
 using std::pair;
 using std::string;
 using std::vector;
@@ -46,11 +57,80 @@ using namespace std::placeholders;
 namespace android {
 namespace wificond {
 
+namespace {
+
+// Binder gives each process a 1MB transaction buffer, and only half of it to
+// oneway transactions. Larger results are left to getScanResults().
+constexpr size_t kMaxResultsInEventBytes = 128 * 1024;
+// BSSs kept by the BSS cache are handed out after a restart only if they
+// were seen this recently.
+constexpr uint64_t kMaxCachedScanResultAgeMs = 10 * 60 * 1000;
+
+// Single scans of all priorities and interfaces. Per priority stats are in
+// the dump of each scanner.
+CounterMetric num_completed_scans("scanning.single_scans_completed");
+CounterMetric num_failed_scans("scanning.single_scans_failed");
+HistogramMetric scan_latency_ms("scanning.single_scan_latency_ms");
+CounterMetric num_pno_scans_started("scanning.pno_scans_started");
+CounterMetric num_offload_pno_scans_started(
+    "scanning.offload_pno_scans_started");
+
+size_t ByteVectorParcelSize(size_t size) {
+  // Length prefix plus data padded to 4 bytes.
+  return sizeof(int32_t) + ((size + 3) & ~static_cast<size_t>(3));
+}
+
+// Returns true if |scan_results| are small enough to be sent in a oneway
+// scan event.
+bool FitsInScanEvent(const vector<NativeScanResult>& scan_results) {
+  // Array length, then the non-null marker and fields of every result.
+  size_t parcel_size = sizeof(int32_t);
+  for (const auto& scan_result : scan_results) {
+    parcel_size += sizeof(int32_t) +
+        ByteVectorParcelSize(scan_result.ssid.size()) +
+        ByteVectorParcelSize(scan_result.bssid.size()) +
+        ByteVectorParcelSize(scan_result.info_element.size()) +
+        // frequency, signal_mbm, tsf, capability and associated.
+        6 * sizeof(int32_t);
+    if (parcel_size > kMaxResultsInEventBytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char* ScanPriorityToString(int32_t priority) {
+  switch (priority) {
+    case IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND:
+      return "background";
+    case IWifiScannerImpl::SCAN_PRIORITY_LOCATION:
+      return "location";
+    case IWifiScannerImpl::SCAN_PRIORITY_CONNECTIVITY:
+      return "connectivity";
+    case IWifiScannerImpl::SCAN_PRIORITY_USER:
+      return "user";
+    default:
+      return "unknown";
+  }
+}
+
+uint64_t GetBootTimeUs() {
+  return ns2us(systemTime(SYSTEM_TIME_BOOTTIME));
+}
+
+}  // namespace
+
+constexpr int32_t ScannerImpl::kNumScanPriorities;
+constexpr int64_t ScannerImpl::kScanResyncTimeoutMs;
+
 ScannerImpl::ScannerImpl(uint32_t wiphy_index, uint32_t interface_index,
                          const ScanCapabilities& scan_capabilities,
                          const WiphyFeatures& wiphy_features,
                          ClientInterfaceImpl* client_interface,
                          NetlinkUtils* netlink_utils, ScanUtils* scan_utils,
+                         RegulatoryModel* regulatory_model,
+                         BssCache* bss_cache,
+                         EventLoop* event_loop,
                          weak_ptr<OffloadServiceUtils> offload_service_utils)
     : valid_(true),
       scan_started_(false),
@@ -58,13 +138,28 @@ ScannerImpl::ScannerImpl(uint32_t wiphy_index, uint32_t interface_index,
       offload_scan_supported_(false),
       pno_scan_running_over_offload_(false),
       pno_scan_results_from_offload_(false),
+      pno_scan_fell_back_from_offload_(false),
+      pno_scan_results_uncounted_(false),
+      scan_events_carry_results_(false),
+      pno_scan_events_carry_results_(false),
+      scan_start_time_us_(0),
+      scan_request_time_us_(0),
+      scan_preempted_(false),
+      scan_deadline_expired_(false),
+      scan_id_(0),
+      has_prefetched_scan_results_(false),
+      use_cached_scan_results_(bss_cache != nullptr),
       wiphy_index_(wiphy_index),
       interface_index_(interface_index),
+      interface_lock_(netlink_utils->GetInterfaceLock(interface_index)),
       scan_capabilities_(scan_capabilities),
       wiphy_features_(wiphy_features),
       client_interface_(client_interface),
       netlink_utils_(netlink_utils),
       scan_utils_(scan_utils),
+      regulatory_model_(regulatory_model),
+      bss_cache_(bss_cache),
+      event_loop_(event_loop),
       scan_event_handler_(nullptr) {
   // Subscribe one-shot scan result notification from kernel.
   LOG(INFO) << "subscribe scan result for interface with index: "
@@ -82,7 +177,7 @@ ScannerImpl::ScannerImpl(uint32_t wiphy_index, uint32_t interface_index,
       offload_scan_callback_interface =
           offload_service_utils.lock()->GetOffloadScanCallbackInterface(this);
   offload_scan_manager_ = offload_service_utils.lock()->GetOffloadScanManager(
-      offload_service_utils, offload_scan_callback_interface);
+      offload_service_utils, offload_scan_callback_interface, event_loop_);
   offload_scan_supported_ = offload_service_utils.lock()->IsOffloadScanSupported();
 }
 
@@ -93,6 +188,13 @@ void ScannerImpl::Invalidate() {
             << (int)interface_index_;
   scan_utils_->UnsubscribeScanResultNotification(interface_index_);
   scan_utils_->UnsubscribeSchedScanResultNotification(interface_index_);
+  scan_utils_->DropRequestTemplates(interface_index_);
+  DropPrefetchedScanResults();
+  pending_scans_.clear();
+  // Pending deadline tasks must leave the interface alone.
+  scan_id_++;
+  // So must binder calls, which may still arrive on other threads.
+  valid_ = false;
 }
 
 bool ScannerImpl::CheckIsValid() {
@@ -105,13 +207,13 @@ bool ScannerImpl::CheckIsValid() {
 
 Status ScannerImpl::getAvailable2gChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
   BandInfo band_info;
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_, &wiphy_features_)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  if (!regulatory_model_->GetBandInfo(&band_info)) {
+    LOG(ERROR) << "Failed to get channels of wiphy";
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
@@ -123,13 +225,13 @@ Status ScannerImpl::getAvailable2gChannels(
 
 Status ScannerImpl::getAvailable5gNonDFSChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
   BandInfo band_info;
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_, &wiphy_features_)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  if (!regulatory_model_->GetBandInfo(&band_info)) {
+    LOG(ERROR) << "Failed to get channels of wiphy";
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
@@ -141,13 +243,13 @@ Status ScannerImpl::getAvailable5gNonDFSChannels(
 
 Status ScannerImpl::getAvailableDFSChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
   BandInfo band_info;
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_, &wiphy_features_)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  if (!regulatory_model_->GetBandInfo(&band_info)) {
+    LOG(ERROR) << "Failed to get channels of wiphy";
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
@@ -158,17 +260,30 @@ Status ScannerImpl::getAvailableDFSChannels(
 }
 
 Status ScannerImpl::getScanResults(vector<NativeScanResult>* out_scan_results) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
-  if (!scan_utils_->GetScanResult(interface_index_, out_scan_results)) {
-    LOG(ERROR) << "Failed to get scan results via NL80211";
+  if (has_prefetched_scan_results_) {
+    *out_scan_results = std::move(prefetched_scan_results_);
+    DropPrefetchedScanResults();
+  } else {
+    NetlinkRateLimiter::ScopedLimit limit;
+    if (!scan_utils_->GetScanResult(interface_index_, out_scan_results)) {
+      LOG(ERROR) << "Failed to get scan results via NL80211";
+      return Status::ok();
+    }
+    UpdateBssCache(*out_scan_results);
+  }
+  if (use_cached_scan_results_) {
+    AppendCachedScanResults(out_scan_results);
   }
   return Status::ok();
 }
 
 Status ScannerImpl::getPnoScanResults(
     vector<NativeScanResult>* out_scan_results) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
@@ -177,31 +292,78 @@ Status ScannerImpl::getPnoScanResults(
       LOG(ERROR) << "Failed to get scan results via Offload HAL";
     }
   } else {
+    NetlinkRateLimiter::ScopedLimit limit;
     if (!scan_utils_->GetScanResult(interface_index_, out_scan_results)) {
       LOG(ERROR) << "Failed to get scan results via NL80211";
     }
   }
+  // Without a pno scan there are no saved networks to match.
+  if (pno_scan_started_ || pno_scan_running_over_offload_) {
+    FilterPnoScanResults(out_scan_results, pno_scan_results_uncounted_);
+  }
   return Status::ok();
 }
 
 Status ScannerImpl::scan(const SingleScanSettings& scan_settings,
                          bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     *out_success = false;
     return Status::ok();
   }
+  if (scan_settings.priority_ < 0 ||
+      scan_settings.priority_ >= kNumScanPriorities) {
+    LOG(ERROR) << "Invalid scan priority: " << scan_settings.priority_;
+    *out_success = false;
+    return Status::ok();
+  }
+  scan_priority_stats_[scan_settings.priority_].num_requested++;
 
+  uint64_t request_time_us = GetBootTimeUs();
   if (scan_started_) {
-    LOG(WARNING) << "Scan already started";
+    // Kernel runs one scan at a time.
+    QueueSingleScan(scan_settings, request_time_us);
+    if (!scan_preempted_ && !scan_deadline_expired_ &&
+        scan_settings.priority_ > scan_settings_.priority_) {
+      PreemptSingleScan();
+    }
+    *out_success = true;
+    return Status::ok();
   }
+  *out_success = StartSingleScan(scan_settings, request_time_us,
+                                 true /* rate_limited */);
+  if (*out_success) {
+    // Results of the previous scan must not be mistaken for this one's.
+    DropPrefetchedScanResults();
+  } else {
+    scan_priority_stats_[scan_settings.priority_].num_failed++;
+    num_failed_scans.Increment();
+  }
+  return Status::ok();
+}
+
+bool ScannerImpl::StartSingleScan(const SingleScanSettings& scan_settings,
+                                  uint64_t request_time_us,
+                                  bool rate_limited) {
+  SingleScanFlags flags;
   // Only request MAC address randomization when station is not associated.
-  bool request_random_mac = wiphy_features_.supports_random_mac_oneshot_scan &&
-                            !client_interface_->IsAssociated();
+  flags.request_random_mac = wiphy_features_.supports_random_mac_oneshot_scan &&
+                             !client_interface_->IsAssociated();
+  // Kernel has supported flushing its scan result cache since 3.8.
+  flags.flush = scan_settings.flush_;
+  if (scan_settings.low_priority_) {
+    if (wiphy_features_.supports_low_priority_oneshot_scan) {
+      flags.low_priority = true;
+    } else {
+      LOG(WARNING) << "Low priority scan is not supported, ignoring it";
+    }
+  }
+  flags.scan_type = GetSupportedScanType(scan_settings.scan_type_);
 
   // Initialize it with an empty ssid for a wild card scan.
-  vector<vector<uint8_t>> ssids = {{}};
+  vector<Ssid> ssids = {Ssid()};
 
-  vector<vector<uint8_t>> skipped_scan_ssids;
+  vector<Ssid> skipped_scan_ssids;
   for (auto& network : scan_settings.hidden_networks_) {
     if (ssids.size() + 1 > scan_capabilities_.max_num_scan_ssids) {
       skipped_scan_ssids.emplace_back(network.ssid_);
@@ -213,40 +375,164 @@ Status ScannerImpl::scan(const SingleScanSettings& scan_settings,
   LogSsidList(skipped_scan_ssids, "Skip scan ssid for single scan");
 
   vector<uint32_t> freqs;
+  vector<uint32_t> skipped_freqs;
   for (auto& channel : scan_settings.channel_settings_) {
+    if (!regulatory_model_->IsChannelUsable(channel.frequency_)) {
+      skipped_freqs.push_back(channel.frequency_);
+      continue;
+    }
     freqs.push_back(channel.frequency_);
   }
+  if (!skipped_freqs.empty()) {
+    std::stringstream ss;
+    for (uint32_t freq : skipped_freqs) {
+      ss << " " << freq;
+    }
+    LOG(WARNING) << "Skip channels disabled in current regulatory domain:"
+                 << ss.str();
+    // An empty frequency list means all channels to kernel.
+    if (freqs.empty()) {
+      LOG(ERROR) << "No usable channel to scan";
+      return false;
+    }
+  }
 
   int error_code = 0;
-  if (!scan_utils_->Scan(interface_index_, request_random_mac, ssids, freqs,
+  NetlinkRateLimiter::ScopedLimit limit(rate_limited);
+  if (!scan_utils_->Scan(interface_index_, flags, ssids, freqs,
                          &error_code)) {
     CHECK(error_code != ENODEV) << "Driver is in a bad state, restarting wificond";
-    *out_success = false;
-    return Status::ok();
+    return false;
   }
   scan_started_ = true;
-  *out_success = true;
-  return Status::ok();
+  scan_preempted_ = false;
+  scan_deadline_expired_ = false;
+  scan_id_++;
+  scan_start_time_us_ = GetBootTimeUs();
+  scan_settings_ = scan_settings;
+  scan_request_time_us_ = request_time_us;
+  if (scan_settings.deadline_ms_ > 0) {
+    // The deadline counts from the request, including the time spent queued.
+    int64_t elapsed_ms = (scan_start_time_us_ - request_time_us) / 1000;
+    int64_t delay_ms =
+        std::max<int64_t>(scan_settings.deadline_ms_ - elapsed_ms, 0);
+    // The task keeps this object alive until the deadline.
+    sp<ScannerImpl> scanner(this);
+    uint32_t scan_id = scan_id_;
+    event_loop_->PostDelayedTask(
+        [scanner, scan_id]() { scanner->OnScanDeadline(scan_id); },
+        delay_ms);
+  }
+  return true;
+}
+
+void ScannerImpl::OnScanDeadline(uint32_t scan_id) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
+  if (!scan_started_ || scan_id != scan_id_ || scan_preempted_) {
+    return;
+  }
+  if (!scan_utils_->AbortScan(interface_index_)) {
+    // The scan is likely to be completing already.
+    LOG(WARNING) << "Failed to abort scan at its deadline";
+    return;
+  }
+  LOG(INFO) << "Aborting scan at its deadline of "
+            << scan_settings_.deadline_ms_ << " ms";
+  scan_deadline_expired_ = true;
+}
+
+void ScannerImpl::QueueSingleScan(const SingleScanSettings& scan_settings,
+                                  uint64_t request_time_us) {
+  // Scan results are shared, so a newer request of the same priority takes
+  // the place of the older one, which has waited the longest though.
+  auto it = pending_scans_.find(scan_settings.priority_);
+  if (it != pending_scans_.end()) {
+    it->second.settings = scan_settings;
+    return;
+  }
+  pending_scans_.emplace(scan_settings.priority_,
+                         PendingScan{scan_settings, request_time_us});
+}
+
+void ScannerImpl::PreemptSingleScan() {
+  if (!scan_utils_->AbortScan(interface_index_)) {
+    // The scan is likely to be completing already.
+    LOG(WARNING) << "Failed to abort scan for a higher priority one";
+    return;
+  }
+  LOG(INFO) << "Preempting " << ScanPriorityToString(scan_settings_.priority_)
+            << " scan";
+  scan_preempted_ = true;
+  scan_priority_stats_[scan_settings_.priority_].num_preempted++;
+  QueueSingleScan(scan_settings_, scan_request_time_us_);
+}
+
+void ScannerImpl::StartNextPendingScan() {
+  while (!pending_scans_.empty()) {
+    PendingScan pending_scan = std::move(pending_scans_.begin()->second);
+    pending_scans_.erase(pending_scans_.begin());
+    // wificond resumes queued scans on its own, so they aren't limited.
+    if (StartSingleScan(pending_scan.settings,
+                        pending_scan.request_time_us,
+                        false /* rate_limited */)) {
+      return;
+    }
+    LOG(ERROR) << "Failed to start pending "
+               << ScanPriorityToString(pending_scan.settings.priority_)
+               << " scan";
+    scan_priority_stats_[pending_scan.settings.priority_].num_failed++;
+    num_failed_scans.Increment();
+    if (scan_event_handler_ != nullptr) {
+      scan_event_handler_->OnScanFailed();
+    }
+  }
+}
+
+void ScannerImpl::RecordSingleScanDone(bool success) {
+  ScanPriorityStats& stats = scan_priority_stats_[scan_settings_.priority_];
+  if (!success) {
+    stats.num_failed++;
+    num_failed_scans.Increment();
+    return;
+  }
+  uint64_t latency_ms = (GetBootTimeUs() - scan_request_time_us_) / 1000;
+  num_completed_scans.Increment();
+  scan_latency_ms.Record(latency_ms);
+  stats.num_completed++;
+  stats.total_latency_ms += latency_ms;
+  stats.max_latency_ms = std::max(stats.max_latency_ms, latency_ms);
 }
 
 Status ScannerImpl::startPnoScan(const PnoSettings& pno_settings,
                                  bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   pno_settings_ = pno_settings;
+  pno_network_matcher_ = PnoNetworkMatcher(pno_settings);
+  pno_network_found_counts_.assign(pno_settings.pno_networks_.size(), 0);
+  pno_scan_results_uncounted_ = false;
   pno_scan_results_from_offload_ = false;
+  pno_scan_fell_back_from_offload_ = false;
   LOG(VERBOSE) << "startPnoScan";
   if (offload_scan_supported_ && StartPnoScanOffload(pno_settings)) {
     // scanning over offload succeeded
     *out_success = true;
+    num_offload_pno_scans_started.Increment();
   } else {
     *out_success = StartPnoScanDefault(pno_settings);
+    // Offload HAL may only be unavailable for now, and pno scans move to it
+    // once it is back.
+    pno_scan_fell_back_from_offload_ = offload_scan_supported_ && *out_success;
+  }
+  if (*out_success) {
+    num_pno_scans_started.Increment();
   }
   return Status::ok();
 }
 
 bool ScannerImpl::StartPnoScanOffload(const PnoSettings& pno_settings) {
   OffloadScanManager::ReasonCode reason_code;
-  vector<vector<uint8_t>> scan_ssids;
-  vector<vector<uint8_t>> match_ssids;
+  vector<Ssid> scan_ssids;
+  vector<Ssid> match_ssids;
   vector<uint8_t> match_security;
   // Empty frequency list: scan all frequencies.
   vector<uint32_t> freqs;
@@ -268,14 +554,16 @@ bool ScannerImpl::StartPnoScanOffload(const PnoSettings& pno_settings) {
 }
 
 void ScannerImpl::ParsePnoSettings(const PnoSettings& pno_settings,
-                                   vector<vector<uint8_t>>* scan_ssids,
-                                   vector<vector<uint8_t>>* match_ssids,
+                                   vector<Ssid>* scan_ssids,
+                                   vector<Ssid>* match_ssids,
                                    vector<uint32_t>* freqs,
                                    vector<uint8_t>* match_security) {
   // TODO provide actionable security match parameters
   const uint8_t kNetworkFlagsDefault = 0;
-  vector<vector<uint8_t>> skipped_scan_ssids;
-  vector<vector<uint8_t>> skipped_match_ssids;
+  vector<Ssid> skipped_scan_ssids;
+  vector<Ssid> skipped_match_ssids;
+  match_ssids->reserve(pno_settings.pno_networks_.size());
+  match_security->reserve(pno_settings.pno_networks_.size());
   for (auto& network : pno_settings.pno_networks_) {
     // Add hidden network ssid.
     if (network.is_hidden_) {
@@ -308,8 +596,8 @@ bool ScannerImpl::StartPnoScanDefault(const PnoSettings& pno_settings) {
     LOG(WARNING) << "Pno scan already started";
   }
   // An empty ssid for a wild card scan.
-  vector<vector<uint8_t>> scan_ssids = {{}};
-  vector<vector<uint8_t>> match_ssids;
+  vector<Ssid> scan_ssids = {Ssid()};
+  vector<Ssid> match_ssids;
   vector<uint8_t> unused;
   // Empty frequency list: scan all frequencies.
   vector<uint32_t> freqs;
@@ -339,6 +627,8 @@ bool ScannerImpl::StartPnoScanDefault(const PnoSettings& pno_settings) {
 }
 
 Status ScannerImpl::stopPnoScan(bool* out_success) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
+  pno_scan_fell_back_from_offload_ = false;
   if (offload_scan_supported_ && StopPnoScanOffload()) {
     // Pno scans over offload stopped successfully
     *out_success = true;
@@ -379,6 +669,7 @@ bool ScannerImpl::StopPnoScanDefault() {
 }
 
 Status ScannerImpl::abortScan() {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
@@ -387,6 +678,22 @@ Status ScannerImpl::abortScan() {
     LOG(WARNING) << "Scan is not started. Ignore abort request";
     return Status::ok();
   }
+  for (const auto& pending_scan : pending_scans_) {
+    // A preempted scan is queued to be resumed, but its failure is recorded
+    // when the abort arrives, like that of any running scan.
+    if (scan_preempted_ && pending_scan.first == scan_settings_.priority_) {
+      continue;
+    }
+    scan_priority_stats_[pending_scan.first].num_failed++;
+    num_failed_scans.Increment();
+  }
+  pending_scans_.clear();
+  if (scan_preempted_ || scan_deadline_expired_) {
+    // The abort is already on its way, and is now reported as a failure.
+    scan_preempted_ = false;
+    scan_deadline_expired_ = false;
+    return Status::ok();
+  }
   if (!scan_utils_->AbortScan(interface_index_)) {
     LOG(WARNING) << "Abort scan failed";
   }
@@ -394,6 +701,7 @@ Status ScannerImpl::abortScan() {
 }
 
 Status ScannerImpl::subscribeScanEvents(const sp<IScanEvent>& handler) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
@@ -403,15 +711,19 @@ Status ScannerImpl::subscribeScanEvents(const sp<IScanEvent>& handler) {
                << " This subscription request will unsubscribe it";
   }
   scan_event_handler_ = handler;
+  scan_events_carry_results_ = false;
   return Status::ok();
 }
 
 Status ScannerImpl::unsubscribeScanEvents() {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   scan_event_handler_ = nullptr;
+  scan_events_carry_results_ = false;
   return Status::ok();
 }
 
 Status ScannerImpl::subscribePnoScanEvents(const sp<IPnoScanEvent>& handler) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!CheckIsValid()) {
     return Status::ok();
   }
@@ -421,33 +733,262 @@ Status ScannerImpl::subscribePnoScanEvents(const sp<IPnoScanEvent>& handler) {
                << " This subscription request will unsubscribe it";
   }
   pno_scan_event_handler_ = handler;
+  pno_scan_events_carry_results_ = false;
 
   return Status::ok();
 }
 
 Status ScannerImpl::unsubscribePnoScanEvents() {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   pno_scan_event_handler_ = nullptr;
+  pno_scan_events_carry_results_ = false;
+  return Status::ok();
+}
+
+Status ScannerImpl::subscribeScanEventsWithResults(
+    const sp<IScanEvent>& handler) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
+  subscribeScanEvents(handler);
+  scan_events_carry_results_ = (scan_event_handler_ != nullptr);
+  return Status::ok();
+}
+
+Status ScannerImpl::subscribePnoScanEventsWithResults(
+    const sp<IPnoScanEvent>& handler) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
+  subscribePnoScanEvents(handler);
+  pno_scan_events_carry_results_ = (pno_scan_event_handler_ != nullptr);
   return Status::ok();
 }
 
 void ScannerImpl::OnScanResultsReady(uint32_t interface_index, bool aborted,
-                                     vector<vector<uint8_t>>& ssids,
+                                     vector<Ssid>& ssids,
                                      vector<uint32_t>& frequencies) {
+  if (scan_started_ && scan_preempted_ && aborted) {
+    // The preempted scan is queued already, and nobody is told about it.
+    scan_started_ = false;
+    scan_preempted_ = false;
+    StartNextPendingScan();
+    return;
+  }
+  // Results found until the deadline are as good as they get.
+  bool deadline_expired = scan_started_ && scan_deadline_expired_ && aborted;
+  // Scans of others, e.g. wpa_supplicant, complete here too.
+  bool requested_scan = scan_started_;
   if (!scan_started_) {
     LOG(INFO) << "Received external scan result notification from kernel.";
+  } else {
+    LOG(INFO) << "Scan completed in "
+              << (GetBootTimeUs() - scan_start_time_us_) / 1000 << " ms";
+    RecordSingleScanDone(!aborted || deadline_expired);
   }
   scan_started_ = false;
+  scan_preempted_ = false;
+  scan_deadline_expired_ = false;
+  if (!aborted) {
+    // Kernel now holds a full view, which the cache has nothing to add to.
+    use_cached_scan_results_ = false;
+  }
   if (scan_event_handler_ != nullptr) {
     // TODO: Pass other parameters back once we find framework needs them.
-    if (aborted) {
+    if (deadline_expired) {
+      ReportPartialScanResults();
+    } else if (aborted) {
       LOG(WARNING) << "Scan aborted";
       scan_event_handler_->OnScanFailed();
+      DropPrefetchedScanResults();
+    } else if (scan_events_carry_results_) {
+      PrefetchScanResults();
+      if (has_prefetched_scan_results_ &&
+          FitsInScanEvent(prefetched_scan_results_)) {
+        scan_event_handler_->OnScanResultReadyWithResults(
+            prefetched_scan_results_);
+        DropPrefetchedScanResults();
+      } else {
+        // The subscriber fetches them with getScanResults(), which is then
+        // answered from the snapshot if there is one.
+        scan_event_handler_->OnScanResultReady();
+      }
     } else {
       scan_event_handler_->OnScanResultReady();
+      // Framework rarely asks for the results of a scan it didn't request,
+      // so these aren't worth a dump.
+      if (requested_scan) {
+        PrefetchScanResults();
+      } else {
+        DropPrefetchedScanResults();
+      }
     }
   } else {
     LOG(WARNING) << "No scan event handler found.";
   }
+  StartNextPendingScan();
+}
+
+void ScannerImpl::ReportPartialScanResults() {
+  PrefetchScanResults();
+  if (has_prefetched_scan_results_ &&
+      FitsInScanEvent(prefetched_scan_results_)) {
+    scan_event_handler_->OnPartialScanResultReady(prefetched_scan_results_);
+    // Subscribers of plain events may still call getScanResults().
+    if (scan_events_carry_results_) {
+      DropPrefetchedScanResults();
+    }
+    return;
+  }
+  scan_event_handler_->OnPartialScanResultReady(vector<NativeScanResult>());
+}
+
+void ScannerImpl::PrefetchScanResults() {
+  // The framework asks for the results as soon as it gets the oneway
+  // OnScanResultReady() call. The notification is handled with
+  // |interface_lock_| held, which getScanResults() also takes, so that call
+  // waits for this dump wherever it is served, and is then answered from the
+  // snapshot instead of dumping again.
+  prefetched_scan_results_.clear();
+  has_prefetched_scan_results_ =
+      scan_utils_->GetScanResult(interface_index_, &prefetched_scan_results_);
+  if (!has_prefetched_scan_results_) {
+    LOG(WARNING) << "Failed to prefetch scan results via NL80211";
+    prefetched_scan_results_.clear();
+    return;
+  }
+  LOG(INFO) << "Prefetched " << prefetched_scan_results_.size()
+            << " scan results";
+  UpdateBssCache(prefetched_scan_results_);
+}
+
+void ScannerImpl::UpdateBssCache(
+    const vector<NativeScanResult>& scan_results) {
+  if (bss_cache_ == nullptr) {
+    return;
+  }
+  bss_cache_->Update(scan_results);
+}
+
+void ScannerImpl::AppendCachedScanResults(
+    vector<NativeScanResult>* scan_results) const {
+  vector<NativeScanResult> cached_scan_results;
+  bss_cache_->GetScanResults(kMaxCachedScanResultAgeMs, &cached_scan_results);
+  std::unordered_set<MacAddress> bssids;
+  for (const auto& scan_result : *scan_results) {
+    bssids.insert(scan_result.bssid);
+  }
+  size_t num_scan_results = scan_results->size();
+  for (auto& scan_result : cached_scan_results) {
+    if (bssids.count(scan_result.bssid) == 0) {
+      scan_results->push_back(std::move(scan_result));
+    }
+  }
+  LOG(INFO) << "Added " << scan_results->size() - num_scan_results
+            << " scan results from BSS cache";
+}
+
+SingleScanFlags::ScanType ScannerImpl::GetSupportedScanType(
+    int32_t scan_type) const {
+  switch (scan_type) {
+    case IWifiScannerImpl::SCAN_TYPE_LOW_SPAN:
+      if (wiphy_features_.supports_low_span_oneshot_scan) {
+        return SingleScanFlags::ScanType::kLowSpan;
+      }
+      break;
+    case IWifiScannerImpl::SCAN_TYPE_LOW_POWER:
+      if (wiphy_features_.supports_low_power_oneshot_scan) {
+        return SingleScanFlags::ScanType::kLowPower;
+      }
+      break;
+    case IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY:
+      if (wiphy_features_.supports_high_accuracy_oneshot_scan) {
+        return SingleScanFlags::ScanType::kHighAccuracy;
+      }
+      break;
+    case IWifiScannerImpl::SCAN_TYPE_DEFAULT:
+      return SingleScanFlags::ScanType::kDefault;
+    default:
+      break;
+  }
+  LOG(WARNING) << "Scan type " << scan_type
+               << " is not supported, using the default one";
+  return SingleScanFlags::ScanType::kDefault;
+}
+
+void ScannerImpl::DropPrefetchedScanResults() {
+  has_prefetched_scan_results_ = false;
+  prefetched_scan_results_.clear();
+}
+
+void ScannerImpl::FilterPnoScanResults(
+    vector<NativeScanResult>* scan_results,
+    bool count_found) {
+  vector<int> network_indices;
+  pno_network_matcher_.Filter(scan_results, &network_indices);
+  if (!count_found) {
+    return;
+  }
+  for (int network_index : network_indices) {
+    pno_network_found_counts_[network_index]++;
+  }
+  pno_scan_results_uncounted_ = false;
+}
+
+void ScannerImpl::ResyncScanState() {
+  if (!scan_started_) {
+    return;
+  }
+  // Kernel doesn't tell whether a scan is still running, and scan results
+  // are updated while it runs, so they don't tell either. The notification
+  // may have been dropped or still be to come, so the scan stays running
+  // until it arrives or the timeout gives up on it.
+  LOG(WARNING) << "Scan notification may have been dropped, waiting "
+               << kScanResyncTimeoutMs << " ms for it";
+  sp<ScannerImpl> scanner(this);
+  uint32_t scan_id = scan_id_;
+  event_loop_->PostDelayedTask(
+      [scanner, scan_id]() { scanner->OnScanResyncTimeout(scan_id); },
+      kScanResyncTimeoutMs);
+}
+
+void ScannerImpl::OnScanResyncTimeout(uint32_t scan_id) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
+  if (!scan_started_ || scan_id != scan_id_) {
+    return;
+  }
+  if (scan_utils_->AbortScan(interface_index_)) {
+    // The scan was stuck, and its abort notification ends it as usual.
+    LOG(WARNING) << "Aborting scan which outlived its resync timeout";
+    return;
+  }
+  // No scan is running, so its notification was among the dropped events.
+  // Whether it completed is unknown, so it is reported as failed.
+  LOG(WARNING) << "No scan notification after resync, failing scan";
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  OnScanResultsReady(interface_index_, true, ssids, frequencies);
+}
+
+void ScannerImpl::Dump(std::stringstream* ss) const {
+  *ss << "Pending single scans: " << pending_scans_.size() << endl;
+  for (int32_t priority = kNumScanPriorities - 1; priority >= 0; priority--) {
+    const ScanPriorityStats& stats = scan_priority_stats_[priority];
+    *ss << "Single scans of " << ScanPriorityToString(priority)
+        << " priority: requested " << stats.num_requested
+        << ", completed " << stats.num_completed
+        << ", failed " << stats.num_failed
+        << ", preempted " << stats.num_preempted
+        << ", average latency "
+        << (stats.num_completed == 0 ?
+            0 : stats.total_latency_ms / stats.num_completed)
+        << " ms, max latency " << stats.max_latency_ms << " ms" << endl;
+  }
+  size_t num_pno_networks_found =
+      std::count_if(pno_network_found_counts_.begin(),
+                    pno_network_found_counts_.end(),
+                    [](uint32_t count) { return count > 0; });
+  *ss << "Pno networks: " << pno_network_matcher_.size()
+      << ", found " << num_pno_networks_found << endl;
+  if (offload_scan_supported_) {
+    offload_scan_manager_->Dump(ss);
+  }
 }
 
 void ScannerImpl::OnSchedScanResultsReady(uint32_t interface_index,
@@ -465,6 +1006,20 @@ void ScannerImpl::OnSchedScanResultsReady(uint32_t interface_index,
     } else {
       LOG(INFO) << "Pno scan result ready event";
       pno_scan_results_from_offload_ = false;
+      pno_scan_results_uncounted_ = true;
+      if (pno_scan_events_carry_results_) {
+        vector<NativeScanResult> scan_results;
+        if (scan_utils_->GetScanResult(interface_index_, &scan_results)) {
+          FilterPnoScanResults(&scan_results, true /* count_found */);
+          if (FitsInScanEvent(scan_results)) {
+            pno_scan_event_handler_->OnPnoNetworkFoundWithResults(
+                scan_results);
+            return;
+          }
+        } else {
+          LOG(ERROR) << "Failed to get pno scan results via NL80211";
+        }
+      }
       pno_scan_event_handler_->OnPnoNetworkFound();
     }
   }
@@ -499,6 +1054,7 @@ SchedScanIntervalSetting ScannerImpl::GenerateIntervalSetting(
 }
 
 void ScannerImpl::OnOffloadScanResult() {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!pno_scan_running_over_offload_) {
     LOG(WARNING) << "Scan results from Offload HAL but scan not requested over "
                     "this interface";
@@ -506,7 +1062,18 @@ void ScannerImpl::OnOffloadScanResult() {
   }
   LOG(INFO) << "Offload Scan results received";
   pno_scan_results_from_offload_ = true;
+  pno_scan_results_uncounted_ = true;
   if (pno_scan_event_handler_ != nullptr) {
+    if (pno_scan_events_carry_results_) {
+      vector<NativeScanResult> scan_results;
+      if (offload_scan_manager_->getScanResults(&scan_results)) {
+        FilterPnoScanResults(&scan_results, true /* count_found */);
+        if (FitsInScanEvent(scan_results)) {
+          pno_scan_event_handler_->OnPnoNetworkFoundWithResults(scan_results);
+          return;
+        }
+      }
+    }
     pno_scan_event_handler_->OnPnoNetworkFound();
   } else {
     LOG(WARNING) << "No scan event handler Offload Scan result";
@@ -515,6 +1082,7 @@ void ScannerImpl::OnOffloadScanResult() {
 
 void ScannerImpl::OnOffloadError(
     OffloadScanCallbackInterface::AsyncErrorReason error_code) {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
   if (!pno_scan_running_over_offload_) {
     // Ignore irrelevant error notifications
     LOG(WARNING) << "Offload HAL Async Error occured but Offload HAL is not "
@@ -549,6 +1117,7 @@ void ScannerImpl::OnOffloadError(
   }
   // Restart PNO scans over netlink interface
   success = StartPnoScanDefault(pno_settings_);
+  pno_scan_fell_back_from_offload_ = success;
   if (success) {
     LOG(INFO) << "Pno scans restarted";
   } else {
@@ -557,14 +1126,31 @@ void ScannerImpl::OnOffloadError(
   }
 }
 
-void ScannerImpl::LogSsidList(vector<vector<uint8_t>>& ssid_list,
+void ScannerImpl::OnOffloadServiceAvailable() {
+  std::lock_guard<std::recursive_mutex> lock(interface_lock_);
+  if (!pno_scan_fell_back_from_offload_ || !pno_scan_started_) {
+    return;
+  }
+  // Replay the last pno request over Offload HAL.
+  if (!StartPnoScanOffload(pno_settings_)) {
+    LOG(WARNING) << "Unable to restart pno scans over Offload HAL";
+    return;
+  }
+  pno_scan_fell_back_from_offload_ = false;
+  if (!StopPnoScanDefault()) {
+    LOG(WARNING) << "Unable to stop netlink pno scan";
+  }
+  LOG(INFO) << "Pno scans moved back to Offload HAL";
+}
+
+void ScannerImpl::LogSsidList(vector<Ssid>& ssid_list,
                               string prefix) {
   if (ssid_list.empty()) {
     return;
   }
   string ssid_list_string;
   for (auto& ssid : ssid_list) {
-    ssid_list_string += string(ssid.begin(), ssid.end());
+    ssid_list_string += ssid.ToString();
     if (&ssid != &ssid_list.back()) {
       ssid_list_string += ", ";
     }
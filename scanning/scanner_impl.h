@@ -17,6 +17,10 @@
 #ifndef WIFICOND_SCANNER_IMPL_H_
 #define WIFICOND_SCANNER_IMPL_H_
 
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <vector>
 
 #include <android-base/macros.h>
@@ -25,16 +29,20 @@
 #include "android/net/wifi/BnWifiScannerImpl.h"
 #include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/offload_scan_callback_interface.h"
+#include "wificond/scanning/pno_network_matcher.h"
 #include "wificond/scanning/scan_utils.h"
 
 namespace android {
 namespace wificond {
 
+class BssCache;
 class ClientInterfaceImpl;
+class EventLoop;
 class OffloadServiceUtils;
 class ScanUtils;
 class OffloadScanCallbackInterfaceImpl;
 class OffloadScanManager;
+class RegulatoryModel;
 
 class ScannerImpl : public android::net::wifi::BnWifiScannerImpl {
  public:
@@ -43,6 +51,9 @@ class ScannerImpl : public android::net::wifi::BnWifiScannerImpl {
               const WiphyFeatures& wiphy_features,
               ClientInterfaceImpl* client_interface,
               NetlinkUtils* netlink_utils, ScanUtils* scan_utils,
+              RegulatoryModel* regulatory_model,
+              BssCache* bss_cache,
+              EventLoop* event_loop,
               std::weak_ptr<OffloadServiceUtils> offload_service_utils);
   ~ScannerImpl();
   // Returns a vector of available frequencies for 2.4GHz channels.
@@ -80,18 +91,99 @@ class ScannerImpl : public android::net::wifi::BnWifiScannerImpl {
       const ::android::sp<::android::net::wifi::IPnoScanEvent>& handler)
       override;
   ::android::binder::Status unsubscribePnoScanEvents() override;
+  ::android::binder::Status subscribeScanEventsWithResults(
+      const ::android::sp<::android::net::wifi::IScanEvent>& handler) override;
+  ::android::binder::Status subscribePnoScanEventsWithResults(
+      const ::android::sp<::android::net::wifi::IPnoScanEvent>& handler)
+      override;
   void OnOffloadScanResult();
   void OnOffloadError(
       OffloadScanCallbackInterface::AsyncErrorReason error_code);
+  // Moves pno scans back to Offload HAL if they fell back to netlink
+  // because of an Offload HAL failure.
+  void OnOffloadServiceAvailable();
   void Invalidate();
+  // Reconciles the single scan state with kernel after multicast events
+  // were dropped. A running scan is failed if it doesn't report within
+  // kScanResyncTimeoutMs.
+  void ResyncScanState();
+  void Dump(std::stringstream* ss) const;
+
+  // How long a scan may run after events were dropped before it is failed.
+  static constexpr int64_t kScanResyncTimeoutMs = 10000;
 
  private:
+  static constexpr int32_t kNumScanPriorities =
+      ::android::net::wifi::IWifiScannerImpl::SCAN_PRIORITY_USER + 1;
+
+  // A single scan waiting for the running one to finish.
+  struct PendingScan {
+    ::com::android::server::wifi::wificond::SingleScanSettings settings;
+    // Boot time in microseconds when the scan was first requested.
+    uint64_t request_time_us;
+  };
+
+  struct ScanPriorityStats {
+    uint32_t num_requested = 0;
+    uint32_t num_completed = 0;
+    uint32_t num_failed = 0;
+    uint32_t num_preempted = 0;
+    // Time from request to results, of the completed scans.
+    uint64_t total_latency_ms = 0;
+    uint64_t max_latency_ms = 0;
+  };
+
   bool CheckIsValid();
   void OnScanResultsReady(uint32_t interface_index, bool aborted,
-                          std::vector<std::vector<uint8_t>>& ssids,
+                          std::vector<Ssid>& ssids,
                           std::vector<uint32_t>& frequencies);
   void OnSchedScanResultsReady(uint32_t interface_index, bool scan_stopped);
-  void LogSsidList(std::vector<std::vector<uint8_t>>& ssid_list,
+  // Triggers a single scan requested at |request_time_us|.
+  // |rate_limited| is set when the trigger is sent for a binder caller.
+  bool StartSingleScan(
+      const ::com::android::server::wifi::wificond::SingleScanSettings&
+          scan_settings,
+      uint64_t request_time_us,
+      bool rate_limited);
+  void QueueSingleScan(
+      const ::com::android::server::wifi::wificond::SingleScanSettings&
+          scan_settings,
+      uint64_t request_time_us);
+  // Aborts the running single scan, and queues it to be resumed later.
+  void PreemptSingleScan();
+  // Starts the queued single scan of highest priority, if any.
+  void StartNextPendingScan();
+  // Accounts the end of the running single scan in |scan_priority_stats_|.
+  void RecordSingleScanDone(bool success);
+  // Aborts single scan |scan_id| if it is still running.
+  void OnScanDeadline(uint32_t scan_id);
+  // Fails single scan |scan_id| if it is still running after events were
+  // dropped.
+  void OnScanResyncTimeout(uint32_t scan_id);
+  // Reports the results of a single scan aborted at its deadline.
+  void ReportPartialScanResults();
+  // Dumps the scan results of this interface into |prefetched_scan_results_|.
+  void PrefetchScanResults();
+  // Writes |scan_results| from kernel to |bss_cache_|, if there is one.
+  void UpdateBssCache(
+      const std::vector<
+          ::com::android::server::wifi::wificond::NativeScanResult>&
+          scan_results);
+  // Appends the BSSs of |bss_cache_| which are missing from |*scan_results|.
+  void AppendCachedScanResults(
+      std::vector<::com::android::server::wifi::wificond::NativeScanResult>*
+          scan_results) const;
+  void DropPrefetchedScanResults();
+  // Maps IWifiScannerImpl::SCAN_TYPE_* to a scan type the wiphy supports.
+  SingleScanFlags::ScanType GetSupportedScanType(int32_t scan_type) const;
+  // Removes the results of networks not in |pno_settings_|. If
+  // |count_found| is set, the remaining ones are accounted in
+  // |pno_network_found_counts_|, which happens once per pno result event.
+  void FilterPnoScanResults(
+      std::vector<com::android::server::wifi::wificond::NativeScanResult>*
+          scan_results,
+      bool count_found);
+  void LogSsidList(std::vector<Ssid>& ssid_list,
                    std::string prefix);
   bool StartPnoScanDefault(
       const ::com::android::server::wifi::wificond::PnoSettings& pno_settings);
@@ -101,8 +193,8 @@ class ScannerImpl : public android::net::wifi::BnWifiScannerImpl {
   bool StopPnoScanOffload();
   void ParsePnoSettings(
       const ::com::android::server::wifi::wificond::PnoSettings& pno_settings,
-      std::vector<std::vector<uint8_t>>* scan_ssids,
-      std::vector<std::vector<uint8_t>>* match_ssids,
+      std::vector<Ssid>* scan_ssids,
+      std::vector<Ssid>* match_ssids,
       std::vector<uint32_t>* freqs, std::vector<uint8_t>* match_security);
   SchedScanIntervalSetting GenerateIntervalSetting(
     const ::com::android::server::wifi::wificond::PnoSettings& pno_settings) const;
@@ -114,10 +206,50 @@ class ScannerImpl : public android::net::wifi::BnWifiScannerImpl {
   bool offload_scan_supported_;
   bool pno_scan_running_over_offload_;
   bool pno_scan_results_from_offload_;
+  // Whether the running netlink pno scan replaces a failed Offload HAL one.
+  bool pno_scan_fell_back_from_offload_;
   ::com::android::server::wifi::wificond::PnoSettings pno_settings_;
+  // Tells which network of |pno_settings_| a pno scan result belongs to.
+  PnoNetworkMatcher pno_network_matcher_;
+  // Number of pno scan results surfaced for each network of |pno_settings_|.
+  std::vector<uint32_t> pno_network_found_counts_;
+  // Whether the results of the latest pno result event are yet to be
+  // accounted, because the subscriber fetches them.
+  bool pno_scan_results_uncounted_;
+  // Whether the subscribers asked for results inside the completion events.
+  bool scan_events_carry_results_;
+  bool pno_scan_events_carry_results_;
+  // Boot time in microseconds when the current single scan was triggered.
+  uint64_t scan_start_time_us_;
+  // Settings, priority and request time of the current single scan, kept to
+  // resume it if it gets preempted.
+  ::com::android::server::wifi::wificond::SingleScanSettings scan_settings_;
+  uint64_t scan_request_time_us_;
+  // Whether the current single scan is being aborted to make way for a
+  // higher priority one.
+  bool scan_preempted_;
+  // Whether the current single scan is being aborted at its deadline.
+  bool scan_deadline_expired_;
+  // Identifies the current single scan to its deadline task.
+  uint32_t scan_id_;
+  // Single scans waiting for the current one, at most one per priority.
+  std::map<int32_t, PendingScan, std::greater<int32_t>> pending_scans_;
+  ScanPriorityStats scan_priority_stats_[kNumScanPriorities];
+  // Snapshot of the single scan results, taken when kernel announced them.
+  // It is handed out by the next getScanResults() call only.
+  bool has_prefetched_scan_results_;
+  std::vector<com::android::server::wifi::wificond::NativeScanResult>
+      prefetched_scan_results_;
+  // Whether getScanResults() adds the BSSs kept by |bss_cache_|, which is the
+  // case until the first single scan on this interface completes.
+  bool use_cached_scan_results_;
 
   const uint32_t wiphy_index_;
   const uint32_t interface_index_;
+  // Serializes binder calls with the events and tasks of this interface.
+  // Every entry point takes it, since binder calls may be served by a
+  // thread pool.
+  std::recursive_mutex& interface_lock_;
 
   // Scanning relevant capability information for this wiphy/interface.
   ScanCapabilities scan_capabilities_;
@@ -126,6 +258,12 @@ class ScannerImpl : public android::net::wifi::BnWifiScannerImpl {
   ClientInterfaceImpl* client_interface_;
   NetlinkUtils* const netlink_utils_;
   ScanUtils* const scan_utils_;
+  // Regulatory channel model of the wiphy. This is never null.
+  RegulatoryModel* const regulatory_model_;
+  // BSSs kept across restarts. This is null if the cache is disabled.
+  BssCache* const bss_cache_;
+  // Runs the scan deadlines.
+  EventLoop* const event_loop_;
   ::android::sp<::android::net::wifi::IPnoScanEvent> pno_scan_event_handler_;
   ::android::sp<::android::net::wifi::IScanEvent> scan_event_handler_;
   std::shared_ptr<OffloadScanManager> offload_scan_manager_;
@@ -18,8 +18,10 @@
 
 #include <android-base/logging.h>
 
+#include "android/net/wifi/IWifiScannerImpl.h"
 #include "wificond/parcelable_utils.h"
 
+using android::net::wifi::IWifiScannerImpl;
 using android::status_t;
 
 namespace com {
@@ -28,6 +30,13 @@ namespace server {
 namespace wifi {
 namespace wificond {
 
+SingleScanSettings::SingleScanSettings()
+    : scan_type_(IWifiScannerImpl::SCAN_TYPE_DEFAULT),
+      flush_(false),
+      low_priority_(false),
+      priority_(IWifiScannerImpl::SCAN_PRIORITY_CONNECTIVITY),
+      deadline_ms_(0) {}
+
 status_t SingleScanSettings::writeToParcel(::android::Parcel* parcel) const {
   RETURN_IF_FAILED(parcel->writeInt32(channel_settings_.size()));
   for (const auto& channel : channel_settings_) {
@@ -43,6 +52,11 @@ status_t SingleScanSettings::writeToParcel(::android::Parcel* parcel) const {
     RETURN_IF_FAILED(parcel->writeInt32(1));
     RETURN_IF_FAILED(network.writeToParcel(parcel));
   }
+  RETURN_IF_FAILED(parcel->writeInt32(scan_type_));
+  RETURN_IF_FAILED(parcel->writeInt32(flush_ ? 1 : 0));
+  RETURN_IF_FAILED(parcel->writeInt32(low_priority_ ? 1 : 0));
+  RETURN_IF_FAILED(parcel->writeInt32(priority_));
+  RETURN_IF_FAILED(parcel->writeInt32(deadline_ms_));
   return ::android::OK;
 }
 
@@ -89,9 +103,60 @@ status_t SingleScanSettings::readFromParcel(const ::android::Parcel* parcel) {
     RETURN_IF_FAILED(network.readFromParcel(parcel));
     hidden_networks_.push_back(network);
   }
+  // The fields below were appended to the parcel over time, and a framework
+  // built before them ends the parcel earlier. Missing fields keep their
+  // defaults.
+  if (parcel->dataAvail() > 0) {
+    RETURN_IF_FAILED(parcel->readInt32(&scan_type_));
+    if (!IsValidScanType()) {
+      LOG(ERROR) << "Invalid scan type: " << scan_type_;
+      return ::android::BAD_VALUE;
+    }
+  }
+  if (parcel->dataAvail() > 0) {
+    int32_t flush = 0;
+    RETURN_IF_FAILED(parcel->readInt32(&flush));
+    flush_ = (flush != 0);
+  }
+  if (parcel->dataAvail() > 0) {
+    int32_t low_priority = 0;
+    RETURN_IF_FAILED(parcel->readInt32(&low_priority));
+    low_priority_ = (low_priority != 0);
+  }
+  if (parcel->dataAvail() > 0) {
+    RETURN_IF_FAILED(parcel->readInt32(&priority_));
+    if (!IsValidPriority()) {
+      LOG(ERROR) << "Invalid scan priority: " << priority_;
+      return ::android::BAD_VALUE;
+    }
+  }
+  if (parcel->dataAvail() > 0) {
+    RETURN_IF_FAILED(parcel->readInt32(&deadline_ms_));
+    if (deadline_ms_ < 0) {
+      LOG(ERROR) << "Invalid scan deadline: " << deadline_ms_;
+      return ::android::BAD_VALUE;
+    }
+  }
   return ::android::OK;
 }
 
+bool SingleScanSettings::IsValidScanType() const {
+  switch (scan_type_) {
+    case IWifiScannerImpl::SCAN_TYPE_DEFAULT:
+    case IWifiScannerImpl::SCAN_TYPE_LOW_SPAN:
+    case IWifiScannerImpl::SCAN_TYPE_LOW_POWER:
+    case IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool SingleScanSettings::IsValidPriority() const {
+  return priority_ >= IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND &&
+         priority_ <= IWifiScannerImpl::SCAN_PRIORITY_USER;
+}
+
 }  // namespace wificond
 }  // namespace wifi
 }  // namespace server
@@ -33,16 +33,36 @@ namespace wificond {
 
 class SingleScanSettings : public ::android::Parcelable {
  public:
-  SingleScanSettings() = default;
+  SingleScanSettings();
   bool operator==(const SingleScanSettings& rhs) const {
     return (channel_settings_ == rhs.channel_settings_ &&
-            hidden_networks_ == rhs.hidden_networks_);
+            hidden_networks_ == rhs.hidden_networks_ &&
+            scan_type_ == rhs.scan_type_ &&
+            flush_ == rhs.flush_ &&
+            low_priority_ == rhs.low_priority_ &&
+            priority_ == rhs.priority_ &&
+            deadline_ms_ == rhs.deadline_ms_);
   }
   ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
   ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
 
   std::vector<ChannelSettings> channel_settings_;
   std::vector<HiddenNetwork> hidden_networks_;
+  // One of IWifiScannerImpl::SCAN_TYPE_*.
+  int32_t scan_type_;
+  // Drop the cached results of previous scans before this scan starts.
+  bool flush_;
+  // Let the scan yield to other traffic, if the wiphy supports it.
+  bool low_priority_;
+  // One of IWifiScannerImpl::SCAN_PRIORITY_*.
+  int32_t priority_;
+  // Time in milliseconds from the request after which the scan is aborted,
+  // and the networks found so far are reported. 0 means no deadline.
+  int32_t deadline_ms_;
+
+ private:
+  bool IsValidScanType() const;
+  bool IsValidPriority() const;
 };
 
 }  // namespace wificond
@@ -16,16 +16,21 @@
 
 #include "wificond/server.h"
 
+#include <algorithm>
+#include <future>
 #include <sstream>
 
+#include <linux/nl80211.h>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <binder/IPCThreadState.h>
 #include <binder/PermissionCache.h>
 
-#include "wificond/logging_utils.h"
+#include "wificond/metrics_registry.h"
 #include "wificond/net/netlink_utils.h"
+#include "wificond/scanning/bss_cache.h"
 #include "wificond/scanning/scan_utils.h"
 
 using android::base::WriteStringToFd;
@@ -35,12 +40,14 @@ using android::IBinder;
 using android::net::wifi::IApInterface;
 using android::net::wifi::IClientInterface;
 using android::net::wifi::IInterfaceEventCallback;
+using android::net::wifi::IRegulatoryEvent;
 using android::wifi_system::HostapdManager;
 using android::wifi_system::InterfaceTool;
 using android::wifi_system::SupplicantManager;
 
 using std::endl;
 using std::placeholders::_1;
+using std::placeholders::_2;
 using std::string;
 using std::stringstream;
 using std::unique_ptr;
@@ -52,6 +59,8 @@ namespace wificond {
 namespace {
 
 constexpr const char* kPermissionDump = "android.permission.DUMP";
+// Name prefix of the virtual interfaces created by wificond.
+constexpr const char* kVirtualInterfacePrefix = "wlan";
 
 }  // namespace
 
@@ -59,15 +68,24 @@ Server::Server(unique_ptr<InterfaceTool> if_tool,
                unique_ptr<SupplicantManager> supplicant_manager,
                unique_ptr<HostapdManager> hostapd_manager,
                NetlinkUtils* netlink_utils,
-               ScanUtils* scan_utils)
+               ScanUtils* scan_utils,
+               BssCache* bss_cache,
+               EventLoop* event_loop)
     : if_tool_(std::move(if_tool)),
       supplicant_manager_(std::move(supplicant_manager)),
       hostapd_manager_(std::move(hostapd_manager)),
       netlink_utils_(netlink_utils),
-      scan_utils_(scan_utils) {
+      scan_utils_(scan_utils),
+      bss_cache_(bss_cache),
+      event_loop_(event_loop),
+      event_loop_thread_id_(std::this_thread::get_id()) {
 }
 
 Status Server::RegisterCallback(const sp<IInterfaceEventCallback>& callback) {
+  Status status;
+  if (ForwardToEventLoop([&] { status = RegisterCallback(callback); })) {
+    return status;
+  }
   for (auto& it : interface_event_callbacks_) {
     if (IInterface::asBinder(callback) == IInterface::asBinder(it)) {
       LOG(WARNING) << "Ignore duplicate interface event callback registration";
@@ -80,6 +98,10 @@ Status Server::RegisterCallback(const sp<IInterfaceEventCallback>& callback) {
 }
 
 Status Server::UnregisterCallback(const sp<IInterfaceEventCallback>& callback) {
+  Status status;
+  if (ForwardToEventLoop([&] { status = UnregisterCallback(callback); })) {
+    return status;
+  }
   for (auto it = interface_event_callbacks_.begin();
        it != interface_event_callbacks_.end();
        it++) {
@@ -94,9 +116,54 @@ Status Server::UnregisterCallback(const sp<IInterfaceEventCallback>& callback) {
   return Status::ok();
 }
 
+Status Server::RegisterRegulatoryEventCallback(
+    const sp<IRegulatoryEvent>& callback) {
+  Status status;
+  if (ForwardToEventLoop(
+          [&] { status = RegisterRegulatoryEventCallback(callback); })) {
+    return status;
+  }
+  for (auto& it : regulatory_event_callbacks_) {
+    if (IInterface::asBinder(callback) == IInterface::asBinder(it)) {
+      LOG(WARNING) << "Ignore duplicate regulatory event callback registration";
+      return Status::ok();
+    }
+  }
+  LOG(INFO) << "New regulatory event callback registered";
+  regulatory_event_callbacks_.push_back(callback);
+  return Status::ok();
+}
+
+Status Server::UnregisterRegulatoryEventCallback(
+    const sp<IRegulatoryEvent>& callback) {
+  Status status;
+  if (ForwardToEventLoop(
+          [&] { status = UnregisterRegulatoryEventCallback(callback); })) {
+    return status;
+  }
+  for (auto it = regulatory_event_callbacks_.begin();
+       it != regulatory_event_callbacks_.end();
+       it++) {
+    if (IInterface::asBinder(callback) == IInterface::asBinder(*it)) {
+      regulatory_event_callbacks_.erase(it);
+      LOG(INFO) << "Unregister regulatory event callback";
+      return Status::ok();
+    }
+  }
+  LOG(WARNING) << "Failed to find registered regulatory event callback"
+               << " to unregister";
+  return Status::ok();
+}
+
 Status Server::createApInterface(sp<IApInterface>* created_interface) {
+  Status status;
+  if (ForwardToEventLoop(
+          [&] { status = createApInterface(created_interface); })) {
+    return status;
+  }
+  WaitForPendingSequences();
   InterfaceInfo interface;
-  if (!SetupInterface(&interface)) {
+  if (!SetupInterface(NL80211_IFTYPE_AP, &interface)) {
     return Status::ok();  // Logging was done internally
   }
 
@@ -114,8 +181,14 @@ Status Server::createApInterface(sp<IApInterface>* created_interface) {
 }
 
 Status Server::createClientInterface(sp<IClientInterface>* created_interface) {
+  Status status;
+  if (ForwardToEventLoop(
+          [&] { status = createClientInterface(created_interface); })) {
+    return status;
+  }
+  WaitForPendingSequences();
   InterfaceInfo interface;
-  if (!SetupInterface(&interface)) {
+  if (!SetupInterface(NL80211_IFTYPE_STATION, &interface)) {
     return Status::ok();  // Logging was done internally
   }
 
@@ -127,7 +200,10 @@ Status Server::createClientInterface(sp<IClientInterface>* created_interface) {
       if_tool_.get(),
       supplicant_manager_.get(),
       netlink_utils_,
-      scan_utils_));
+      scan_utils_,
+      regulatory_model_.get(),
+      bss_cache_,
+      event_loop_));
   *created_interface = client_interface->GetBinder();
   client_interfaces_.push_back(std::move(client_interface));
   BroadcastClientInterfaceReady(client_interfaces_.back()->GetBinder());
@@ -136,24 +212,76 @@ Status Server::createClientInterface(sp<IClientInterface>* created_interface) {
 }
 
 Status Server::tearDownInterfaces() {
+  Status status;
+  if (ForwardToEventLoop([&] { status = tearDownInterfaces(); })) {
+    return status;
+  }
+  WaitForPendingSequences();
   for (auto& it : client_interfaces_) {
     BroadcastClientInterfaceTornDown(it->GetBinder());
   }
-  client_interfaces_.clear();
-
   for (auto& it : ap_interfaces_) {
     BroadcastApInterfaceTornDown(it->GetBinder());
   }
+  // The interface objects are destroyed by the teardown sequence.
+  auto client_interfaces =
+      std::make_shared<vector<unique_ptr<ClientInterfaceImpl>>>(
+          std::move(client_interfaces_));
+  client_interfaces_.clear();
+  auto ap_interfaces = std::make_shared<vector<unique_ptr<ApInterfaceImpl>>>(
+      std::move(ap_interfaces_));
   ap_interfaces_.clear();
-
-  MarkDownAllInterfaces();
+  vector<uint32_t> created_interface_indices =
+      std::move(created_interface_indices_);
+  created_interface_indices_.clear();
 
   netlink_utils_->UnsubscribeRegDomainChange(wiphy_index_);
+  // Scanners of the client interfaces may still use the regulatory model
+  // until the interfaces are destroyed.
+  auto regulatory_model = std::make_shared<unique_ptr<RegulatoryModel>>(
+      std::move(regulatory_model_));
+
+  teardown_sequence_.reset(new AsyncSequence("Teardown", event_loop_));
+  if (!client_interfaces->empty()) {
+    // Stopping wpa_supplicant takes the longest, so it overlaps with the
+    // teardown of AP interfaces. Destroying a client interface stops
+    // wpa_supplicant again, which returns at once when it is stopped.
+    teardown_sequence_->AddWorkerStep("Stop supplicant", [this] {
+      supplicant_manager_->StopSupplicant();
+    });
+  }
+  teardown_sequence_->AddLoopStep("Destroy AP interfaces", [ap_interfaces] {
+    ap_interfaces->clear();
+  });
+  teardown_sequence_->AddStage();
+  teardown_sequence_->AddLoopStep("Destroy client interfaces",
+                                  [client_interfaces, regulatory_model] {
+    client_interfaces->clear();
+    regulatory_model->reset();
+  });
+  teardown_sequence_->AddLoopStep("Delete virtual interfaces",
+                                  [this, created_interface_indices] {
+    for (uint32_t interface_index : created_interface_indices) {
+      netlink_utils_->DeleteInterface(interface_index);
+    }
+  });
+  teardown_sequence_->AddLoopStep("Mark interfaces down", [this] {
+    MarkDownAllInterfaces();
+  });
+  teardown_sequence_->Start(nullptr);
+  // Callers expect the interfaces to be gone when this returns. The stages
+  // still overlap, but this blocks until the last one is done.
+  teardown_sequence_->Wait();
 
   return Status::ok();
 }
 
 Status Server::GetClientInterfaces(vector<sp<IBinder>>* out_client_interfaces) {
+  Status status;
+  if (ForwardToEventLoop(
+          [&] { status = GetClientInterfaces(out_client_interfaces); })) {
+    return status;
+  }
   vector<sp<android::IBinder>> client_interfaces_binder;
   for (auto& it : client_interfaces_) {
     out_client_interfaces->push_back(asBinder(it->GetBinder()));
@@ -162,6 +290,11 @@ Status Server::GetClientInterfaces(vector<sp<IBinder>>* out_client_interfaces) {
 }
 
 Status Server::GetApInterfaces(vector<sp<IBinder>>* out_ap_interfaces) {
+  Status status;
+  if (ForwardToEventLoop(
+          [&] { status = GetApInterfaces(out_ap_interfaces); })) {
+    return status;
+  }
   vector<sp<IBinder>> ap_interfaces_binder;
   for (auto& it : ap_interfaces_) {
     out_ap_interfaces->push_back(asBinder(it->GetBinder()));
@@ -169,6 +302,14 @@ Status Server::GetApInterfaces(vector<sp<IBinder>>* out_ap_interfaces) {
   return binder::Status::ok();
 }
 
+Status Server::getMetrics(String16* out_metrics) {
+  // Metrics are read without locks, so this doesn't wait for the event loop.
+  stringstream ss;
+  MetricsRegistry::GetDefault()->GetSnapshot().Dump(&ss);
+  *out_metrics = String16(ss.str().c_str());
+  return Status::ok();
+}
+
 status_t Server::dump(int fd, const Vector<String16>& /*args*/) {
   if (!PermissionCache::checkCallingPermission(String16(kPermissionDump))) {
     IPCThreadState* ipc = android::IPCThreadState::self();
@@ -176,7 +317,15 @@ status_t Server::dump(int fd, const Vector<String16>& /*args*/) {
                << ") is not permitted to dump wificond state";
     return PERMISSION_DENIED;
   }
+  // The permission is checked on the binder thread, which knows the caller.
+  status_t result = OK;
+  if (ForwardToEventLoop([&] { result = DumpState(fd); })) {
+    return result;
+  }
+  return DumpState(fd);
+}
 
+status_t Server::DumpState(int fd) {
   stringstream ss;
   ss << "Current wiphy index: " << wiphy_index_ << endl;
   ss << "Cached interfaces list from kernel message: " << endl;
@@ -184,7 +333,7 @@ status_t Server::dump(int fd, const Vector<String16>& /*args*/) {
     ss << "Interface index: " << iface.index
        << ", name: " << iface.name
        << ", mac address: "
-       << LoggingUtils::GetMacString(iface.mac_address) << endl;
+       << iface.mac_address.ToString() << endl;
   }
 
   for (const auto& iface : client_interfaces_) {
@@ -195,6 +344,25 @@ status_t Server::dump(int fd, const Vector<String16>& /*args*/) {
     iface->Dump(&ss);
   }
 
+  if (regulatory_model_) {
+    regulatory_model_->Dump(&ss);
+  }
+
+  if (bss_cache_) {
+    bss_cache_->Dump(&ss);
+  }
+
+  netlink_utils_->Dump(&ss);
+
+  if (startup_sequence_) {
+    startup_sequence_->Dump(&ss);
+  }
+  if (teardown_sequence_) {
+    teardown_sequence_->Dump(&ss);
+  }
+
+  MetricsRegistry::GetDefault()->Dump(&ss);
+
   if (!WriteStringToFd(ss.str(), fd)) {
     PLOG(ERROR) << "Failed to dump state to fd " << fd;
     return FAILED_TRANSACTION;
@@ -215,28 +383,98 @@ void Server::MarkDownAllInterfaces() {
 }
 
 void Server::CleanUpSystemState() {
-  supplicant_manager_->StopSupplicant();
-  hostapd_manager_->StopHostapd();
-  MarkDownAllInterfaces();
+  startup_sequence_.reset(new AsyncSequence("Startup", event_loop_));
+  // The daemons stop concurrently. Interfaces are marked down once both of
+  // them are gone, so that they don't bring the interfaces up again.
+  startup_sequence_->AddWorkerStep("Stop supplicant", [this] {
+    supplicant_manager_->StopSupplicant();
+  });
+  startup_sequence_->AddWorkerStep("Stop hostapd", [this] {
+    hostapd_manager_->StopHostapd();
+  });
+  startup_sequence_->AddStage();
+  startup_sequence_->AddLoopStep("Mark interfaces down", [this] {
+    MarkDownAllInterfaces();
+  });
+  startup_sequence_->Start([] {
+    LOG(INFO) << "wificond is ready";
+  });
 }
 
-bool Server::SetupInterface(InterfaceInfo* interface) {
-  if (!ap_interfaces_.empty() || !client_interfaces_.empty()) {
-    // In the future we may support multiple interfaces at once.  However,
-    // today, we support just one.
-    LOG(ERROR) << "Cannot create AP interface when other interfaces exist";
+bool Server::ForwardToEventLoop(const std::function<void()>& call) {
+  if (std::this_thread::get_id() == event_loop_thread_id_) {
     return false;
   }
+  std::promise<void> done;
+  event_loop_->PostTask([&call, &done] {
+    call();
+    done.set_value();
+  });
+  done.get_future().wait();
+  return true;
+}
 
-  if (!RefreshWiphyIndex()) {
+void Server::WaitForPendingSequences() {
+  if (startup_sequence_) {
+    startup_sequence_->Wait();
+  }
+  if (teardown_sequence_) {
+    teardown_sequence_->Wait();
+  }
+}
+
+bool Server::SetupInterface(uint32_t iftype, InterfaceInfo* interface) {
+  // wpa_supplicant and hostapd each manage a single interface, so there is at
+  // most one client and one AP interface.
+  if ((iftype == NL80211_IFTYPE_STATION && !client_interfaces_.empty()) ||
+      (iftype == NL80211_IFTYPE_AP && !ap_interfaces_.empty())) {
+    LOG(ERROR) << "Cannot create a second "
+               << (iftype == NL80211_IFTYPE_AP ? "AP" : "client")
+               << " interface";
     return false;
   }
 
-  netlink_utils_->SubscribeRegDomainChange(
+  vector<uint32_t> iftypes;
+  vector<string> interfaces_in_use;
+  for (const auto& iface : client_interfaces_) {
+    iftypes.push_back(NL80211_IFTYPE_STATION);
+    interfaces_in_use.push_back(iface->GetInterfaceName());
+  }
+  for (const auto& iface : ap_interfaces_) {
+    iftypes.push_back(NL80211_IFTYPE_AP);
+    interfaces_in_use.push_back(iface->GetInterfaceName());
+  }
+
+  const bool has_other_interfaces = !iftypes.empty();
+  if (!has_other_interfaces) {
+    if (!RefreshWiphyIndex()) {
+      return false;
+    }
+
+    if (regulatory_model_ == nullptr ||
+        regulatory_model_->GetWiphyIndex() != wiphy_index_) {
+      regulatory_model_.reset(new RegulatoryModel(
           wiphy_index_,
-          std::bind(&Server::OnRegDomainChanged,
-          this,
-          _1));
+          netlink_utils_,
+          std::bind(&Server::OnChannelsChanged, this, _1, _2)));
+      if (regulatory_model_->Load()) {
+        LogSupportedBands();
+      }
+    }
+
+    netlink_utils_->SubscribeRegDomainChange(
+            wiphy_index_,
+            std::bind(&Server::OnRegDomainChanged,
+            this,
+            _1));
+  } else {
+    iftypes.push_back(iftype);
+    if (!IsInterfaceCombinationSupported(iftypes)) {
+      LOG(ERROR) << "Wiphy does not support concurrent client and AP "
+                 << "interfaces";
+      return false;
+    }
+  }
 
   interfaces_.clear();
   if (!netlink_utils_->GetInterfaces(wiphy_index_, &interfaces_)) {
@@ -251,13 +489,54 @@ bool Server::SetupInterface(InterfaceInfo* interface) {
     // Currently NAN interfaces also use station type.
     // We should blacklist NAN interfaces as well.
     if (iface.name != "p2p0" &&
-        !android::base::StartsWith(iface.name, "aware_data")) {
+        !android::base::StartsWith(iface.name, "aware_data") &&
+        std::find(interfaces_in_use.begin(), interfaces_in_use.end(),
+                  iface.name) == interfaces_in_use.end()) {
       *interface = iface;
       return true;
     }
   }
 
-  LOG(ERROR) << "No usable interface found";
+  if (!has_other_interfaces) {
+    LOG(ERROR) << "No usable interface found";
+    return false;
+  }
+
+  // All the usable interfaces are taken. Create a virtual one, named after
+  // the first free "wlan<N>".
+  string name;
+  for (int i = 0; ; i++) {
+    name = kVirtualInterfacePrefix + std::to_string(i);
+    if (std::none_of(interfaces_.begin(), interfaces_.end(),
+                     [&name](const InterfaceInfo& iface) {
+                       return iface.name == name;
+                     })) {
+      break;
+    }
+  }
+  if (!netlink_utils_->CreateInterface(wiphy_index_, name, iftype,
+                                       interface)) {
+    LOG(ERROR) << "Failed to create interface " << name;
+    return false;
+  }
+  LOG(INFO) << "Created virtual interface " << interface->name;
+  interfaces_.push_back(*interface);
+  created_interface_indices_.push_back(interface->index);
+  return true;
+}
+
+bool Server::IsInterfaceCombinationSupported(const vector<uint32_t>& iftypes) {
+  vector<InterfaceCombination> combinations;
+  if (!netlink_utils_->GetInterfaceCombinations(wiphy_index_,
+                                                &combinations)) {
+    LOG(ERROR) << "Failed to get interface combinations";
+    return false;
+  }
+  for (const auto& combination : combinations) {
+    if (combination.Allows(iftypes)) {
+      return true;
+    }
+  }
   return false;
 }
 
@@ -275,17 +554,27 @@ void Server::OnRegDomainChanged(std::string& country_code) {
   } else {
     LOG(INFO) << "Regulatory domain changed to country: " << country_code;
   }
+  if (regulatory_model_ != nullptr) {
+    regulatory_model_->OnRegDomainChanged(country_code);
+  }
+}
+
+void Server::OnChannelsChanged(const string& country_code,
+                               const vector<uint32_t>& changed_frequencies) {
   LogSupportedBands();
+  vector<int32_t> frequencies(changed_frequencies.begin(),
+                              changed_frequencies.end());
+  for (auto& it : regulatory_event_callbacks_) {
+    it->OnRegulatoryDomainChanged(String16(country_code.c_str()), frequencies);
+  }
 }
 
 void Server::LogSupportedBands() {
   BandInfo band_info;
-  ScanCapabilities scan_capabilities;
-  WiphyFeatures wiphy_features;
-  netlink_utils_->GetWiphyInfo(wiphy_index_,
-                               &band_info,
-                               &scan_capabilities,
-                               &wiphy_features);
+  if (regulatory_model_ == nullptr ||
+      !regulatory_model_->GetBandInfo(&band_info)) {
+    return;
+  }
 
   stringstream ss;
   for (unsigned int i = 0; i < band_info.band_2g.size(); i++) {
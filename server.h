@@ -17,8 +17,10 @@
 #ifndef WIFICOND_SERVER_H_
 #define WIFICOND_SERVER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/macros.h>
@@ -28,26 +30,37 @@
 #include "android/net/wifi/IApInterface.h"
 #include "android/net/wifi/IClientInterface.h"
 #include "android/net/wifi/IInterfaceEventCallback.h"
+#include "android/net/wifi/IRegulatoryEvent.h"
 
 #include "wificond/ap_interface_impl.h"
+#include "wificond/async_sequence.h"
 #include "wificond/client_interface_impl.h"
+#include "wificond/regulatory_model.h"
 
 namespace android {
 namespace wificond {
 
+class BssCache;
+class EventLoop;
 class NL80211Packet;
 class NetlinkUtils;
 class ScanUtils;
 
 struct InterfaceInfo;
 
+// Server must be created on the event loop thread. Its binder calls run on
+// that thread, even when binder calls are served by a thread pool, so that
+// interfaces are only created and destroyed there. Calls on the interfaces
+// themselves run on the pool threads.
 class Server : public android::net::wifi::BnWificond {
  public:
   Server(std::unique_ptr<wifi_system::InterfaceTool> if_tool,
          std::unique_ptr<wifi_system::SupplicantManager> supplicant_man,
          std::unique_ptr<wifi_system::HostapdManager> hostapd_man,
          NetlinkUtils* netlink_utils,
-         ScanUtils* scan_utils);
+         ScanUtils* scan_utils,
+         BssCache* bss_cache,
+         EventLoop* event_loop);
   ~Server() override = default;
 
   android::binder::Status RegisterCallback(
@@ -57,6 +70,13 @@ class Server : public android::net::wifi::BnWificond {
       const android::sp<android::net::wifi::IInterfaceEventCallback>&
           callback) override;
 
+  android::binder::Status RegisterRegulatoryEventCallback(
+      const android::sp<android::net::wifi::IRegulatoryEvent>&
+          callback) override;
+  android::binder::Status UnregisterRegulatoryEventCallback(
+      const android::sp<android::net::wifi::IRegulatoryEvent>&
+          callback) override;
+
   android::binder::Status createApInterface(
       android::sp<android::net::wifi::IApInterface>*
           created_interface) override;
@@ -71,23 +91,34 @@ class Server : public android::net::wifi::BnWificond {
       std::vector<android::sp<android::IBinder>>* out_client_ifs) override;
   android::binder::Status GetApInterfaces(
       std::vector<android::sp<android::IBinder>>* out_ap_ifs) override;
+  android::binder::Status getMetrics(
+      android::String16* out_metrics) override;
   status_t dump(int fd, const Vector<String16>& args) override;
 
   // Call this once on startup.  It ignores all the invariants held
   // in wificond and tries to restore ourselves to a blank state by
   // killing userspace daemons and cleaning up the interface state.
+  // This returns before the daemons are stopped. Interfaces are only set up
+  // once the clean up is done.
   void CleanUpSystemState();
 
  private:
   // Request interface information from kernel and setup local interface object.
-  // This assumes that interface should be in STATION mode. Even if we setup
-  // interface on behalf of createApInterace(), it is Hostapd that configure
-  // the interface to Ap mode later.
+  // A pre-existing interface which is not in use is preferred. It is assumed
+  // to be in STATION mode. Even if we setup interface on behalf of
+  // createApInterace(), it is Hostapd that configure the interface to Ap mode
+  // later. When all of them are in use, a virtual interface of |iftype| is
+  // created if the interface combinations of the wiphy allow it.
+  // |iftype| is one of |enum nl80211_iftype|.
   // Returns true on success, false otherwise.
-  bool SetupInterface(InterfaceInfo* interface);
+  bool SetupInterface(uint32_t iftype, InterfaceInfo* interface);
+  // Returns true if the wiphy can run interfaces of |iftypes| concurrently.
+  bool IsInterfaceCombinationSupported(const std::vector<uint32_t>& iftypes);
   bool RefreshWiphyIndex();
   void LogSupportedBands();
   void OnRegDomainChanged(std::string& country_code);
+  void OnChannelsChanged(const std::string& country_code,
+                         const std::vector<uint32_t>& changed_frequencies);
   void BroadcastClientInterfaceReady(
       android::sp<android::net::wifi::IClientInterface> network_interface);
   void BroadcastApInterfaceReady(
@@ -97,21 +128,46 @@ class Server : public android::net::wifi::BnWificond {
   void BroadcastApInterfaceTornDown(
       android::sp<android::net::wifi::IApInterface> network_interface);
   void MarkDownAllInterfaces();
+  // Blocks until startup clean up and the last teardown are done.
+  void WaitForPendingSequences();
+  // Writes the state of wificond to |fd|.
+  status_t DumpState(int fd);
+  // Returns false if this is the event loop thread. Otherwise runs |call| on
+  // the event loop thread, and returns true once it is done.
+  bool ForwardToEventLoop(const std::function<void()>& call);
 
   const std::unique_ptr<wifi_system::InterfaceTool> if_tool_;
   const std::unique_ptr<wifi_system::SupplicantManager> supplicant_manager_;
   const std::unique_ptr<wifi_system::HostapdManager> hostapd_manager_;
   NetlinkUtils* const netlink_utils_;
   ScanUtils* const scan_utils_;
+  // BSSs kept across restarts. This is null if the cache is disabled.
+  BssCache* const bss_cache_;
+  EventLoop* const event_loop_;
+  const std::thread::id event_loop_thread_id_;
 
   uint32_t wiphy_index_;
   std::vector<std::unique_ptr<ApInterfaceImpl>> ap_interfaces_;
   std::vector<std::unique_ptr<ClientInterfaceImpl>> client_interfaces_;
   std::vector<android::sp<android::net::wifi::IInterfaceEventCallback>>
       interface_event_callbacks_;
+  std::vector<android::sp<android::net::wifi::IRegulatoryEvent>>
+      regulatory_event_callbacks_;
+  // Regulatory channel model of the current wiphy.
+  std::unique_ptr<RegulatoryModel> regulatory_model_;
 
   // Cached interface list from kernel.
   std::vector<InterfaceInfo> interfaces_;
+  // Indices of the virtual interfaces created by us, which are deleted when
+  // interfaces are torn down.
+  std::vector<uint32_t> created_interface_indices_;
+
+  // These run steps which use the members above, so they are declared last
+  // and thus destroyed first.
+  // Stops the daemons and marks interfaces down at startup.
+  std::unique_ptr<AsyncSequence> startup_sequence_;
+  // Destroys the interfaces of the last tearDownInterfaces() call.
+  std::unique_ptr<AsyncSequence> teardown_sequence_;
 
   DISALLOW_COPY_AND_ASSIGN(Server);
 };
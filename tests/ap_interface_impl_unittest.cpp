@@ -47,7 +47,7 @@ namespace {
 
 const char kTestInterfaceName[] = "testwifi0";
 const uint32_t kTestInterfaceIndex = 42;
-const uint8_t kFakeMacAddress[] = {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+const MacAddress kFakeMacAddress({0x45, 0x54, 0xad, 0x67, 0x98, 0xf6});
 
 void CaptureStationEventHandler(
     OnStationEventHandler* out_handler,
@@ -136,14 +136,12 @@ TEST_F(ApInterfaceImplTest, CanGetNumberOfAssociatedStations) {
         if_tool_.get(),
         hostapd_manager_.get()));
 
-  vector<uint8_t> fake_mac_address(kFakeMacAddress,
-                                   kFakeMacAddress + sizeof(kFakeMacAddress));
   EXPECT_EQ(0, ap_interface_->GetNumberOfAssociatedStations());
-  handler(NEW_STATION, fake_mac_address);
+  handler(NEW_STATION, kFakeMacAddress);
   EXPECT_EQ(1, ap_interface_->GetNumberOfAssociatedStations());
-  handler(NEW_STATION, fake_mac_address);
+  handler(NEW_STATION, kFakeMacAddress);
   EXPECT_EQ(2, ap_interface_->GetNumberOfAssociatedStations());
-  handler(DEL_STATION, fake_mac_address);
+  handler(DEL_STATION, kFakeMacAddress);
   EXPECT_EQ(1, ap_interface_->GetNumberOfAssociatedStations());
 }
 
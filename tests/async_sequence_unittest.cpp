@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "wificond/async_sequence.h"
+#include "wificond/looper_backed_event_loop.h"
+#include "wificond/tests/mock_event_loop.h"
+
+using std::chrono::seconds;
+using std::string;
+using std::vector;
+using testing::ElementsAre;
+using testing::HasSubstr;
+using testing::NiceMock;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Records the steps in the order they run, from any thread.
+class StepLog {
+ public:
+  AsyncSequence::Step Record(const string& step) {
+    return [this, step] {
+      std::lock_guard<std::mutex> lock(mutex_);
+      steps_.push_back(step);
+    };
+  }
+  vector<string> GetSteps() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return steps_;
+  }
+
+ private:
+  std::mutex mutex_;
+  vector<string> steps_;
+};
+
+}  // namespace
+
+TEST(AsyncSequenceTest, RunsStagesInOrder) {
+  NiceMock<MockEventLoop> event_loop;
+  StepLog log;
+  bool done = false;
+  AsyncSequence sequence("Test", &event_loop);
+  sequence.AddWorkerStep("worker", log.Record("worker"));
+  sequence.AddStage();
+  sequence.AddLoopStep("first", log.Record("first"));
+  sequence.AddLoopStep("second", log.Record("second"));
+  sequence.Start([&done] { done = true; });
+  sequence.Wait();
+
+  EXPECT_TRUE(done);
+  EXPECT_TRUE(sequence.IsDone());
+  EXPECT_THAT(log.GetSteps(), ElementsAre("worker", "first", "second"));
+}
+
+TEST(AsyncSequenceTest, RunsWorkerStepsConcurrently) {
+  NiceMock<MockEventLoop> event_loop;
+  // Each worker step waits for the other one to start, which only works if
+  // they run at the same time.
+  std::promise<void> first_started;
+  std::promise<void> second_started;
+  bool first_saw_second = false;
+  bool second_saw_first = false;
+  AsyncSequence sequence("Test", &event_loop);
+  sequence.AddWorkerStep("first", [&] {
+    first_started.set_value();
+    first_saw_second = second_started.get_future().wait_for(seconds(5)) ==
+        std::future_status::ready;
+  });
+  sequence.AddWorkerStep("second", [&] {
+    second_started.set_value();
+    second_saw_first = first_started.get_future().wait_for(seconds(5)) ==
+        std::future_status::ready;
+  });
+  sequence.Start(nullptr);
+  sequence.Wait();
+
+  EXPECT_TRUE(first_saw_second);
+  EXPECT_TRUE(second_saw_first);
+}
+
+TEST(AsyncSequenceTest, ResumesOnEventLoop) {
+  LooperBackedEventLoop event_loop;
+  StepLog log;
+  AsyncSequence sequence("Test", &event_loop);
+  sequence.AddWorkerStep("worker", log.Record("worker"));
+  sequence.AddLoopStep("overlapped", log.Record("overlapped"));
+  sequence.AddStage();
+  sequence.AddLoopStep("last", log.Record("last"));
+  sequence.Start([&event_loop] { event_loop.TriggerExit(); });
+  // The worker step is still running or its completion is not handled yet.
+  EXPECT_FALSE(sequence.IsDone());
+  event_loop.Poll();
+
+  EXPECT_TRUE(sequence.IsDone());
+  vector<string> steps = log.GetSteps();
+  ASSERT_EQ(3u, steps.size());
+  EXPECT_EQ("last", steps[2]);
+}
+
+TEST(AsyncSequenceTest, CanDumpStepTimes) {
+  NiceMock<MockEventLoop> event_loop;
+  AsyncSequence sequence("Teardown", &event_loop);
+  std::stringstream ss;
+  sequence.Dump(&ss);
+  EXPECT_THAT(ss.str(), HasSubstr("Teardown: not started"));
+
+  sequence.AddWorkerStep("Stop supplicant", [] {});
+  sequence.AddStage();
+  sequence.AddLoopStep("Mark interfaces down", [] {});
+  sequence.Start(nullptr);
+  sequence.Wait();
+  ss.str("");
+  sequence.Dump(&ss);
+  EXPECT_THAT(ss.str(), HasSubstr("Teardown: done in"));
+  EXPECT_THAT(ss.str(), HasSubstr("Stage 1, Stop supplicant (worker)"));
+  EXPECT_THAT(ss.str(), HasSubstr("Stage 2, Mark interfaces down"));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/tests/benchmark/allocation_counter.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> num_allocations(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    // wificond is built without exceptions.
+    abort();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+  free(ptr);
+}
+
+namespace android {
+namespace wificond {
+
+uint64_t GetNumAllocations() {
+  return num_allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace wificond
+}  // namespace android
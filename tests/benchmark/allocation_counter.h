@@ -14,28 +14,19 @@
  * limitations under the License.
  */
 
-#ifndef WIFICOND_LOGGING_UTILS_H_
-#define WIFICOND_LOGGING_UTILS_H_
+#ifndef WIFICOND_TESTS_BENCHMARK_ALLOCATION_COUNTER_H_
+#define WIFICOND_TESTS_BENCHMARK_ALLOCATION_COUNTER_H_
 
-#include <vector>
-#include <sstream>
-
-#include <android-base/macros.h>
+#include <stdint.h>
 
 namespace android {
 namespace wificond {
 
-class LoggingUtils {
- public:
-  LoggingUtils() = default;
-  static std::string GetMacString(const std::vector<uint8_t>& mac_address);
-
- private:
-
-  DISALLOW_COPY_AND_ASSIGN(LoggingUtils);
-};
+// Returns the number of calls to the global operator new so far.
+// The benchmark binary replaces operator new to count them.
+uint64_t GetNumAllocations();
 
 }  // namespace wificond
 }  // namespace android
 
-#endif  // WIFICOND_LOGGING_UTILS_H_
+#endif  // WIFICOND_TESTS_BENCHMARK_ALLOCATION_COUNTER_H_
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/net/netlink_manager.h"
+
+using std::chrono::duration;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t kScanInterfaceIndex = 1;
+constexpr uint32_t kPollInterfaceIndex = 2;
+constexpr int kNumPollsPerIteration = 200;
+// Time spent by getScanResults() on a busy network, and by signalPoll().
+constexpr microseconds kScanResultsDuration(2000);
+constexpr microseconds kSignalPollDuration(20);
+// Time between two binder calls of the same caller.
+constexpr microseconds kCallInterval(100);
+
+void BusyWait(microseconds duration) {
+  steady_clock::time_point end = steady_clock::now() + duration;
+  while (steady_clock::now() < end) {
+  }
+}
+
+// signalPoll() on one interface while getScanResults() runs back to back on
+// another interface. Reports the percentiles of the signalPoll() latency.
+// With |serialized|, every call takes the same lock, as when all binder calls
+// are served by the event loop thread. Otherwise calls only take the lock of
+// their interface, as when binder calls are served by a thread pool.
+void RunConcurrentCallers(benchmark::State& state, bool serialized) {
+  NetlinkManager netlink_manager(nullptr);
+  std::recursive_mutex event_loop_lock;
+  auto get_lock = [&](uint32_t interface_index) -> std::recursive_mutex& {
+    return serialized ? event_loop_lock :
+        netlink_manager.GetInterfaceLock(interface_index);
+  };
+  vector<double> latencies_us;
+  while (state.KeepRunning()) {
+    std::atomic<bool> done(false);
+    std::thread scan_caller([&] {
+      while (!done) {
+        {
+          std::lock_guard<std::recursive_mutex> lock(
+              get_lock(kScanInterfaceIndex));
+          BusyWait(kScanResultsDuration);
+        }
+        std::this_thread::sleep_for(kCallInterval);
+      }
+    });
+    for (int i = 0; i < kNumPollsPerIteration; i++) {
+      steady_clock::time_point start = steady_clock::now();
+      {
+        std::lock_guard<std::recursive_mutex> lock(
+            get_lock(kPollInterfaceIndex));
+        BusyWait(kSignalPollDuration);
+      }
+      latencies_us.push_back(
+          duration<double, std::micro>(steady_clock::now() - start).count());
+      std::this_thread::sleep_for(kCallInterval);
+    }
+    done = true;
+    scan_caller.join();
+  }
+  std::sort(latencies_us.begin(), latencies_us.end());
+  state.counters["p50_us"] = latencies_us[latencies_us.size() / 2];
+  state.counters["p99_us"] = latencies_us[latencies_us.size() * 99 / 100];
+  state.counters["max_us"] = latencies_us.back();
+}
+
+void BM_SignalPollLatencySerialized(benchmark::State& state) {
+  RunConcurrentCallers(state, true);
+}
+BENCHMARK(BM_SignalPollLatencySerialized)->UseRealTime();
+
+void BM_SignalPollLatencyPerInterface(benchmark::State& state) {
+  RunConcurrentCallers(state, false);
+}
+BENCHMARK(BM_SignalPollLatencyPerInterface)->UseRealTime();
+
+// Sequence numbers taken by several binder threads at once.
+void BM_GetSequenceNumber(benchmark::State& state) {
+  static NetlinkManager netlink_manager(nullptr);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(netlink_manager.GetSequenceNumber());
+  }
+}
+BENCHMARK(BM_GetSequenceNumber)->ThreadRange(1, 4);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
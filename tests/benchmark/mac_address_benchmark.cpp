@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/net/mac_address.h"
+#include "wificond/net/mlme_event.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/tests/benchmark/allocation_counter.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 1;
+const MacAddress kFakeBssid({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+
+// Reports the number of heap allocations per iteration of |state|.
+class AllocationReporter {
+ public:
+  explicit AllocationReporter(benchmark::State* state)
+      : state_(state),
+        start_(GetNumAllocations()) {}
+  ~AllocationReporter() {
+    state_->counters["allocs_per_iter"] =
+        static_cast<double>(GetNumAllocations() - start_) /
+        state_->iterations();
+  }
+
+ private:
+  benchmark::State* state_;
+  uint64_t start_;
+};
+
+NL80211NestedAttr CreateBss() {
+  NL80211NestedAttr bss(NL80211_ATTR_BSS);
+  bss.AddAttribute(NL80211Attr<MacAddress>(NL80211_BSS_BSSID, kFakeBssid));
+  bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_FREQUENCY, 2412));
+  return bss;
+}
+
+// Scan path: the BSSID of each scan result, read as a byte vector.
+void BM_GetBssidAsBytes(benchmark::State& state) {
+  NL80211NestedAttr bss = CreateBss();
+  vector<uint8_t> bssid;
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    bss.GetAttributeValue(NL80211_BSS_BSSID, &bssid);
+    benchmark::DoNotOptimize(bssid.data());
+  }
+}
+BENCHMARK(BM_GetBssidAsBytes);
+
+// Scan path: the BSSID of each scan result, read as a MacAddress.
+void BM_GetBssidAsMacAddress(benchmark::State& state) {
+  NL80211NestedAttr bss = CreateBss();
+  MacAddress bssid;
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    bss.GetAttributeValue(NL80211_BSS_BSSID, &bssid);
+    benchmark::DoNotOptimize(bssid);
+  }
+}
+BENCHMARK(BM_GetBssidAsMacAddress);
+
+// MLME path: parsing a NL80211_CMD_CONNECT event.
+void BM_ParseConnectEvent(benchmark::State& state) {
+  NL80211Packet event(kFakeFamilyId, NL80211_CMD_CONNECT, 0, 0);
+  event.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  event.AddAttribute(NL80211Attr<MacAddress>(NL80211_ATTR_MAC, kFakeBssid));
+  event.AddAttribute(NL80211Attr<uint16_t>(NL80211_ATTR_STATUS_CODE, 0));
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    unique_ptr<MlmeConnectEvent> connect_event =
+        MlmeConnectEvent::InitFromPacket(&event);
+    benchmark::DoNotOptimize(connect_event.get());
+  }
+}
+BENCHMARK(BM_ParseConnectEvent);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
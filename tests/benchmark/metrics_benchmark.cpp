@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/metrics_registry.h"
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+MetricsRegistry registry;
+CounterMetric sharded_counter("benchmark.counter", &registry);
+HistogramMetric histogram("benchmark.histogram", &registry);
+// What a counter would be without sharding.
+std::atomic<uint64_t> shared_counter(0);
+
+// Increments from several binder threads at once.
+void BM_CounterIncrement(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    sharded_counter.Increment();
+  }
+}
+BENCHMARK(BM_CounterIncrement)->ThreadRange(1, 4);
+
+void BM_SharedAtomicIncrement(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    shared_counter.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+BENCHMARK(BM_SharedAtomicIncrement)->ThreadRange(1, 4);
+
+void BM_HistogramRecord(benchmark::State& state) {
+  int64_t value = 0;
+  while (state.KeepRunning()) {
+    histogram.Record(value);
+    value = (value + 4099) & 0xfffff;
+  }
+}
+BENCHMARK(BM_HistogramRecord)->ThreadRange(1, 4);
+
+void BM_GetSnapshot(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(registry.GetSnapshot());
+  }
+}
+BENCHMARK(BM_GetSnapshot);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
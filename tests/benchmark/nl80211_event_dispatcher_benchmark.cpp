@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_event_dispatcher.h"
+#include "wificond/net/nl80211_packet.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 1;
+
+NL80211Packet CreateEvent(uint8_t command, uint32_t interface_index) {
+  NL80211Packet event(kFakeFamilyId, command, 0, 0);
+  event.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  event.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, 0));
+  return event;
+}
+
+class CountingObserver : public NL80211EventObserver {
+ public:
+  void OnNL80211Event(const NL80211Event& event) override {
+    num_events_++;
+    benchmark::DoNotOptimize(num_events_);
+  }
+
+ private:
+  uint64_t num_events_ = 0;
+};
+
+// Dispatching an event nobody subscribed to: decoding and table lookup only.
+void BM_DispatchWithoutSubscribers(benchmark::State& state) {
+  NL80211EventDispatcher dispatcher;
+  NL80211Packet event = CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS,
+                                    kFakeInterfaceIndex);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(dispatcher.Dispatch(event));
+  }
+}
+BENCHMARK(BM_DispatchWithoutSubscribers);
+
+// Dispatching an event to state.range(0) subscribers of the same interface,
+// e.g. the scanner and metrics.
+void BM_DispatchToSubscribers(benchmark::State& state) {
+  NL80211EventDispatcher dispatcher;
+  size_t num_subscribers = state.range(0);
+  vector<CountingObserver> observers(num_subscribers);
+  unique_ptr<NL80211EventSubscription[]> subscriptions(
+      new NL80211EventSubscription[num_subscribers]);
+  for (size_t i = 0; i < num_subscribers; i++) {
+    dispatcher.Subscribe(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex,
+                         &observers[i], &subscriptions[i]);
+  }
+  NL80211Packet event = CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS,
+                                    kFakeInterfaceIndex);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(dispatcher.Dispatch(event));
+  }
+}
+BENCHMARK(BM_DispatchToSubscribers)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Dispatching an event when state.range(0) interfaces subscribed to the same
+// command, but only one of them matches.
+void BM_DispatchAmongInterfaces(benchmark::State& state) {
+  NL80211EventDispatcher dispatcher;
+  size_t num_interfaces = state.range(0);
+  vector<CountingObserver> observers(num_interfaces);
+  unique_ptr<NL80211EventSubscription[]> subscriptions(
+      new NL80211EventSubscription[num_interfaces]);
+  for (size_t i = 0; i < num_interfaces; i++) {
+    dispatcher.Subscribe(NL80211_CMD_CONNECT, kFakeInterfaceIndex + i,
+                         &observers[i], &subscriptions[i]);
+  }
+  NL80211Packet event = CreateEvent(NL80211_CMD_CONNECT,
+                                    kFakeInterfaceIndex + num_interfaces - 1);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(dispatcher.Dispatch(event));
+  }
+}
+BENCHMARK(BM_DispatchAmongInterfaces)->Arg(1)->Arg(4)->Arg(16);
+
+// Baseline: the single subscriber per interface scheme, which looks up a
+// std::map of std::function handlers after decoding the interface index.
+void BM_DispatchThroughHandlerMap(benchmark::State& state) {
+  std::map<uint32_t, std::function<void(uint32_t)>> handlers;
+  uint64_t num_events = 0;
+  handlers[kFakeInterfaceIndex] = [&num_events](uint32_t) { num_events++; };
+  NL80211Packet event = CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS,
+                                    kFakeInterfaceIndex);
+  while (state.KeepRunning()) {
+    uint32_t interface_index;
+    if (event.GetCommand() == NL80211_CMD_NEW_SCAN_RESULTS &&
+        event.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index)) {
+      const auto handler = handlers.find(interface_index);
+      if (handler != handlers.end()) {
+        handler->second(interface_index);
+      }
+    }
+    benchmark::DoNotOptimize(num_events);
+  }
+}
+BENCHMARK(BM_DispatchThroughHandlerMap);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
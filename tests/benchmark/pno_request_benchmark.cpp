@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/ssid.h"
+#include "wificond/tests/benchmark/allocation_counter.h"
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 1;
+constexpr int32_t kFakeRssiThreshold = -80;
+// The largest number of saved networks the framework puts in a PNO request.
+constexpr size_t kNumPnoNetworks = 64;
+
+// Reports the number of heap allocations per iteration of |state|.
+class AllocationReporter {
+ public:
+  explicit AllocationReporter(benchmark::State* state)
+      : state_(state),
+        start_(GetNumAllocations()) {}
+  ~AllocationReporter() {
+    state_->counters["allocs_per_iter"] =
+        static_cast<double>(GetNumAllocations() - start_) /
+        state_->iterations();
+  }
+
+ private:
+  benchmark::State* state_;
+  uint64_t start_;
+};
+
+vector<Ssid> CreateSsids() {
+  vector<Ssid> ssids;
+  for (size_t i = 0; i < kNumPnoNetworks; i++) {
+    ssids.push_back(Ssid::FromString("SavedNetwork" + std::to_string(i)));
+  }
+  return ssids;
+}
+
+vector<vector<uint8_t>> CreateByteVectorSsids() {
+  vector<vector<uint8_t>> ssids;
+  for (const Ssid& ssid : CreateSsids()) {
+    ssids.push_back(ssid.ToBytes());
+  }
+  return ssids;
+}
+
+// Copies the SSID lists the way ScannerImpl::ParsePnoSettings() does, and
+// builds the SSID related attributes of NL80211_CMD_START_SCHED_SCAN the way
+// ScanUtils::StartScheduledScan() does.
+template <typename SsidType>
+NL80211Packet BuildPnoRequest(const vector<SsidType>& networks) {
+  vector<SsidType> scan_ssids;
+  vector<SsidType> match_ssids;
+  scan_ssids.reserve(networks.size());
+  match_ssids.reserve(networks.size());
+  for (const SsidType& ssid : networks) {
+    scan_ssids.push_back(ssid);
+    match_ssids.push_back(ssid);
+  }
+
+  NL80211Packet start_sched_scan(kFakeFamilyId,
+                                 NL80211_CMD_START_SCHED_SCAN, 0, 0);
+  NL80211NestedAttr scan_ssids_attr(NL80211_ATTR_SCAN_SSIDS);
+  for (size_t i = 0; i < scan_ssids.size(); i++) {
+    scan_ssids_attr.AddAttribute(NL80211Attr<SsidType>(i, scan_ssids[i]));
+  }
+  NL80211NestedAttr scan_match_attr(NL80211_ATTR_SCHED_SCAN_MATCH);
+  for (size_t i = 0; i < match_ssids.size(); i++) {
+    NL80211NestedAttr match_group(i);
+    match_group.AddAttribute(NL80211Attr<SsidType>(
+        NL80211_SCHED_SCAN_MATCH_ATTR_SSID, match_ssids[i]));
+    match_group.AddAttribute(NL80211Attr<int32_t>(
+        NL80211_SCHED_SCAN_MATCH_ATTR_RSSI, kFakeRssiThreshold));
+    scan_match_attr.AddAttribute(match_group);
+  }
+  start_sched_scan.AddAttribute(scan_match_attr);
+  start_sched_scan.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  start_sched_scan.AddAttribute(scan_ssids_attr);
+  return start_sched_scan;
+}
+
+// Baseline: SSIDs stored as one heap allocated byte vector each.
+void BM_BuildPnoRequestFromByteVectors(benchmark::State& state) {
+  vector<vector<uint8_t>> networks = CreateByteVectorSsids();
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    NL80211Packet request = BuildPnoRequest(networks);
+    benchmark::DoNotOptimize(request.GetConstData().data());
+  }
+}
+BENCHMARK(BM_BuildPnoRequestFromByteVectors);
+
+void BM_BuildPnoRequestFromSsids(benchmark::State& state) {
+  vector<Ssid> networks = CreateSsids();
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    NL80211Packet request = BuildPnoRequest(networks);
+    benchmark::DoNotOptimize(request.GetConstData().data());
+  }
+}
+BENCHMARK(BM_BuildPnoRequestFromSsids);
+
+// Scan result path: matching the SSIDs of scan results against the saved
+// networks.
+void BM_CompareSsids(benchmark::State& state) {
+  vector<Ssid> networks = CreateSsids();
+  Ssid scan_result_ssid = networks.back();
+  while (state.KeepRunning()) {
+    size_t num_matches = 0;
+    for (const Ssid& ssid : networks) {
+      num_matches += (ssid == scan_result_ssid);
+    }
+    benchmark::DoNotOptimize(num_matches);
+  }
+}
+BENCHMARK(BM_CompareSsids);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
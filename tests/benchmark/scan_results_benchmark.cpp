@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_utils.h"
+
+using com::android::server::wifi::wificond::NativeScanResult;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 1;
+// Typical size of the information elements of a BSS seen in the wild.
+constexpr size_t kFakeIeSize = 300;
+
+// Answers NL80211_CMD_GET_SCAN dumps with a fixed set of BSSes, without
+// going through a socket.
+class CannedScanDumpNetlinkManager : public NetlinkManager {
+ public:
+  explicit CannedScanDumpNetlinkManager(size_t num_bsses)
+      : NetlinkManager(nullptr) {
+    for (size_t i = 0; i < num_bsses; i++) {
+      packets_.push_back(CreateScanResult(i));
+    }
+  }
+
+  uint16_t GetFamilyId() override { return kFakeFamilyId; }
+  uint32_t GetSequenceNumber() override { return 1; }
+  bool SendMessageAndGetResponses(
+      const NL80211Packet& packet,
+      vector<unique_ptr<const NL80211Packet>>* response) override {
+    // Kernel hands out freshly received buffers for every dump.
+    for (const NL80211Packet& scan_result : packets_) {
+      response->emplace_back(new NL80211Packet(scan_result));
+    }
+    return true;
+  }
+
+ private:
+  static NL80211Packet CreateScanResult(size_t index) {
+    NL80211Packet packet(kFakeFamilyId, NL80211_CMD_NEW_SCAN_RESULTS, 1, 0);
+    packet.AddFlag(NLM_F_MULTI);
+    packet.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+    Ssid ssid = Ssid::FromString("Network" + std::to_string(index));
+    // An SSID information element, followed by vendor specific padding.
+    vector<uint8_t> ie(kFakeIeSize, 0xdd);
+    ie[0] = 0;
+    ie[1] = static_cast<uint8_t>(ssid.size());
+    std::copy(ssid.data(), ssid.data() + ssid.size(), ie.begin() + 2);
+    NL80211NestedAttr bss(NL80211_ATTR_BSS);
+    MacAddress bssid({0x12, 0xef, 0xa1, 0x2c, 0x97,
+                      static_cast<uint8_t>(index)});
+    bss.AddAttribute(NL80211Attr<MacAddress>(NL80211_BSS_BSSID, bssid));
+    bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_FREQUENCY, 5180));
+    bss.AddAttribute(NL80211Attr<vector<uint8_t>>(
+        NL80211_BSS_INFORMATION_ELEMENTS, ie));
+    bss.AddAttribute(NL80211Attr<uint64_t>(NL80211_BSS_LAST_SEEN_BOOTTIME,
+                                           1000000));
+    bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_SIGNAL_MBM, -5000));
+    bss.AddAttribute(NL80211Attr<uint16_t>(NL80211_BSS_CAPABILITY, 0));
+    packet.AddAttribute(bss);
+    return packet;
+  }
+
+  vector<NL80211Packet> packets_;
+};
+
+// getScanResults() without a prefetched snapshot: dump and parse on the
+// binder call. The socket round trip to kernel is not included, so this is a
+// lower bound of what the prefetch takes off the binder path.
+void BM_GetScanResultsFromDump(benchmark::State& state) {
+  CannedScanDumpNetlinkManager netlink_manager(state.range(0));
+  ScanUtils scan_utils(&netlink_manager);
+  while (state.KeepRunning()) {
+    vector<NativeScanResult> scan_results;
+    scan_utils.GetScanResult(kFakeInterfaceIndex, &scan_results);
+    benchmark::DoNotOptimize(scan_results.data());
+  }
+}
+BENCHMARK(BM_GetScanResultsFromDump)->Arg(16)->Arg(64)->Arg(256);
+
+// getScanResults() with a prefetched snapshot: the snapshot is moved out.
+void BM_GetScanResultsFromSnapshot(benchmark::State& state) {
+  CannedScanDumpNetlinkManager netlink_manager(state.range(0));
+  ScanUtils scan_utils(&netlink_manager);
+  vector<NativeScanResult> snapshot;
+  scan_utils.GetScanResult(kFakeInterfaceIndex, &snapshot);
+  while (state.KeepRunning()) {
+    vector<NativeScanResult> scan_results = std::move(snapshot);
+    benchmark::DoNotOptimize(scan_results.data());
+    snapshot = std::move(scan_results);
+  }
+}
+BENCHMARK(BM_GetScanResultsFromSnapshot)->Arg(16)->Arg(64)->Arg(256);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include <linux/nl80211.h>
+
+#include <benchmark/benchmark.h>
+
+#include "wificond/net/mac_address.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_request_cache.h"
+#include "wificond/tests/benchmark/allocation_counter.h"
+
+using std::unique_ptr;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 1;
+constexpr uint32_t kFakePortId = 12345;
+const MacAddress kFakeBssid({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+
+// Reports the number of heap allocations per iteration of |state|.
+class AllocationReporter {
+ public:
+  explicit AllocationReporter(benchmark::State* state)
+      : state_(state),
+        start_(GetNumAllocations()) {}
+  ~AllocationReporter() {
+    state_->counters["allocs_per_iter"] =
+        static_cast<double>(GetNumAllocations() - start_) /
+        state_->iterations();
+  }
+
+ private:
+  benchmark::State* state_;
+  uint64_t start_;
+};
+
+unique_ptr<NL80211Packet> BuildGetStationRequest(uint32_t sequence) {
+  unique_ptr<NL80211Packet> request(new NL80211Packet(
+      kFakeFamilyId, NL80211_CMD_GET_STATION, sequence, kFakePortId));
+  request->AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  request->AddAttribute(NL80211Attr<MacAddress>(NL80211_ATTR_MAC, kFakeBssid));
+  return request;
+}
+
+// Signal poll path: NL80211_CMD_GET_STATION built for every poll, the way
+// NetlinkUtils::GetStationInfo() used to.
+void BM_BuildGetStationRequest(benchmark::State& state) {
+  uint32_t sequence = 0;
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    NL80211Packet request(kFakeFamilyId, NL80211_CMD_GET_STATION,
+                          sequence++, kFakePortId);
+    request.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+    request.AddAttribute(
+        NL80211Attr<MacAddress>(NL80211_ATTR_MAC, kFakeBssid));
+    benchmark::DoNotOptimize(request.GetConstData().data());
+  }
+}
+BENCHMARK(BM_BuildGetStationRequest);
+
+// Signal poll path: NL80211_CMD_GET_STATION taken from the request cache,
+// with only its sequence number and port id patched.
+void BM_GetCachedGetStationRequest(benchmark::State& state) {
+  NL80211RequestCache cache;
+  cache.Put(kFakeInterfaceIndex, 0, BuildGetStationRequest(0));
+  uint32_t sequence = 0;
+  AllocationReporter reporter(&state);
+  while (state.KeepRunning()) {
+    NL80211Packet* request = cache.Get(NL80211_CMD_GET_STATION,
+                                       kFakeInterfaceIndex, 0, sequence++,
+                                       kFakePortId);
+    benchmark::DoNotOptimize(request->GetConstData().data());
+  }
+}
+BENCHMARK(BM_GetCachedGetStationRequest);
+
+}  // namespace
+
+}  // namespace wificond
+}  // namespace android
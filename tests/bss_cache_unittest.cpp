@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/bss_cache.h"
+
+using com::android::server::wifi::wificond::NativeScanResult;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr size_t kFakeCapacity = 2;
+constexpr uint64_t kFakeWallTimeMs = 1500000000000;
+constexpr uint64_t kFakeBootTimeMs = 60 * 1000;
+constexpr uint32_t kFakeFrequency = 5180;
+constexpr int32_t kFakeSignalMbm = -5000;
+constexpr uint16_t kFakeCapability = 0x1431;
+
+const Ssid kFakeSsid = Ssid::FromString("Google");
+const MacAddress kFakeBssid({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+const MacAddress kFakeBssid1({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8c});
+const MacAddress kFakeBssid2({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8d});
+const vector<uint8_t> kFakeInfoElement = {0x00, 0x06, 'G', 'o', 'o', 'g', 'l',
+                                          'e', 0x01, 0x01, 0x8c};
+
+NativeScanResult CreateScanResult(const MacAddress& bssid, uint64_t tsf) {
+  NativeScanResult scan_result;
+  scan_result.ssid = kFakeSsid;
+  scan_result.bssid = bssid;
+  scan_result.info_element = kFakeInfoElement;
+  scan_result.frequency = kFakeFrequency;
+  scan_result.signal_mbm = kFakeSignalMbm;
+  scan_result.tsf = tsf;
+  scan_result.capability = kFakeCapability;
+  return scan_result;
+}
+
+}  // namespace
+
+class BssCacheTest : public ::testing::Test {
+ protected:
+  unique_ptr<BssCache> CreateCache(size_t capacity) {
+    return unique_ptr<BssCache>(new BssCache(
+        file_.path, capacity,
+        [this] { return wall_time_ms_; },
+        [this] { return boot_time_ms_; }));
+  }
+
+  TemporaryFile file_;
+  uint64_t wall_time_ms_ = kFakeWallTimeMs;
+  uint64_t boot_time_ms_ = kFakeBootTimeMs;
+};
+
+TEST_F(BssCacheTest, KeepsScanResultsAcrossRestarts) {
+  unique_ptr<BssCache> cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  EXPECT_EQ(0u, cache->size());
+  // Seen 10 seconds ago.
+  cache->Update({CreateScanResult(kFakeBssid,
+                                  (kFakeBootTimeMs - 10 * 1000) * 1000)});
+  cache.reset();
+
+  // Restarted 20 seconds later.
+  wall_time_ms_ += 20 * 1000;
+  boot_time_ms_ += 20 * 1000;
+  cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  EXPECT_EQ(1u, cache->size());
+  vector<NativeScanResult> scan_results;
+  cache->GetScanResults(60 * 1000, &scan_results);
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeSsid, scan_results[0].ssid);
+  EXPECT_EQ(kFakeBssid, scan_results[0].bssid);
+  EXPECT_EQ(kFakeInfoElement, scan_results[0].info_element);
+  EXPECT_EQ(kFakeFrequency, scan_results[0].frequency);
+  EXPECT_EQ(kFakeSignalMbm, scan_results[0].signal_mbm);
+  EXPECT_EQ(kFakeCapability, scan_results[0].capability);
+  EXPECT_EQ((boot_time_ms_ - 30 * 1000) * 1000, scan_results[0].tsf);
+
+  // Too old.
+  scan_results.clear();
+  cache->GetScanResults(29 * 1000, &scan_results);
+  EXPECT_TRUE(scan_results.empty());
+}
+
+TEST_F(BssCacheTest, BssSeenBeforeBootHasZeroTsf) {
+  unique_ptr<BssCache> cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  cache->Update({CreateScanResult(kFakeBssid, kFakeBootTimeMs * 1000)});
+  cache.reset();
+
+  // Rebooted 5 seconds ago.
+  wall_time_ms_ += 10 * 1000;
+  boot_time_ms_ = 5 * 1000;
+  cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  vector<NativeScanResult> scan_results;
+  cache->GetScanResults(60 * 1000, &scan_results);
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(0u, scan_results[0].tsf);
+}
+
+TEST_F(BssCacheTest, ReplacesOldestBssWhenFull) {
+  unique_ptr<BssCache> cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  cache->Update({CreateScanResult(kFakeBssid, kFakeBootTimeMs * 1000),
+                 CreateScanResult(kFakeBssid1, 1000 * 1000)});
+  cache->Update({CreateScanResult(kFakeBssid2, kFakeBootTimeMs * 1000)});
+  EXPECT_EQ(kFakeCapacity, cache->size());
+
+  vector<NativeScanResult> scan_results;
+  cache->GetScanResults(60 * 1000, &scan_results);
+  ASSERT_EQ(2u, scan_results.size());
+  for (const auto& scan_result : scan_results) {
+    EXPECT_NE(kFakeBssid1, scan_result.bssid);
+  }
+}
+
+TEST_F(BssCacheTest, SkipsTooLargeInfoElements) {
+  unique_ptr<BssCache> cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  NativeScanResult scan_result =
+      CreateScanResult(kFakeBssid, kFakeBootTimeMs * 1000);
+  scan_result.info_element.resize(BssCache::kMaxInfoElementSize + 1);
+  cache->Update({scan_result});
+  EXPECT_EQ(0u, cache->size());
+}
+
+TEST_F(BssCacheTest, DropsCorruptedRecords) {
+  unique_ptr<BssCache> cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  cache->Update({CreateScanResult(kFakeBssid, kFakeBootTimeMs * 1000)});
+  cache.reset();
+
+  // Flip a byte of the first record.
+  off_t size = lseek(file_.fd, 0, SEEK_END);
+  off_t offset = size / kFakeCapacity;
+  uint8_t byte;
+  ASSERT_EQ(1, pread(file_.fd, &byte, 1, offset));
+  byte ^= 0xff;
+  ASSERT_EQ(1, pwrite(file_.fd, &byte, 1, offset));
+
+  cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  EXPECT_EQ(0u, cache->size());
+}
+
+TEST_F(BssCacheTest, ResetsFileOfAnotherCapacity) {
+  unique_ptr<BssCache> cache = CreateCache(kFakeCapacity);
+  ASSERT_TRUE(cache->Open());
+  cache->Update({CreateScanResult(kFakeBssid, kFakeBootTimeMs * 1000)});
+  cache.reset();
+
+  cache = CreateCache(kFakeCapacity + 1);
+  ASSERT_TRUE(cache->Open());
+  EXPECT_EQ(0u, cache->size());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -17,6 +17,8 @@
 #include <memory>
 #include <vector>
 
+#include <linux/nl80211.h>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <wifi_system/supplicant_manager.h>
@@ -24,11 +26,20 @@
 #include <wifi_system_test/mock_supplicant_manager.h>
 
 #include "wificond/client_interface_impl.h"
+#include "wificond/regulatory_model.h"
+#include "wificond/scanning/single_scan_settings.h"
+#include "wificond/tests/fake_event_loop.h"
+#include "wificond/tests/fake_kernel.h"
+#include "wificond/tests/mock_event_loop.h"
+#include "wificond/tests/mock_link_quality_event.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
+#include "wificond/tests/mock_scan_event.h"
 #include "wificond/tests/mock_scan_utils.h"
 
+using android::net::wifi::ILinkQualityEvent;
 using android::wifi_system::MockInterfaceTool;
+using com::android::server::wifi::wificond::SingleScanSettings;
 using android::wifi_system::MockSupplicantManager;
 using android::wifi_system::SupplicantManager;
 using std::unique_ptr;
@@ -44,6 +55,13 @@ namespace {
 const uint32_t kTestWiphyIndex = 2;
 const char kTestInterfaceName[] = "testwifi0";
 const uint32_t kTestInterfaceIndex = 42;
+const MacAddress kTestBssid({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+const Ssid kTestSsid = Ssid::FromString("Google");
+const uint32_t kTestFrequency = 5180;
+const uint32_t kTestFrequency1 = 5200;
+const int32_t kTestRssiThreshold = -70;
+const uint32_t kTestRssiHysteresis = 2;
+const int32_t kTestScanDeadlineMs = 3000;
 
 class ClientInterfaceImplTest : public ::testing::Test {
  protected:
@@ -57,11 +75,14 @@ class ClientInterfaceImplTest : public ::testing::Test {
         kTestWiphyIndex,
         kTestInterfaceName,
         kTestInterfaceIndex,
-        vector<uint8_t>{0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        MacAddress(),
         if_tool_.get(),
         supplicant_manager_.get(),
         netlink_utils_.get(),
-        scan_utils_.get()});
+        scan_utils_.get(),
+        regulatory_model_.get(),
+        nullptr /* bss_cache */,
+        &event_loop_});
   }
 
   void TearDown() override {
@@ -81,9 +102,46 @@ class ClientInterfaceImplTest : public ::testing::Test {
       new NiceMock<MockNetlinkUtils>(netlink_manager_.get())};
   unique_ptr<NiceMock<MockScanUtils>> scan_utils_{
       new NiceMock<MockScanUtils>(netlink_manager_.get())};
+  unique_ptr<RegulatoryModel> regulatory_model_{
+      new RegulatoryModel(kTestWiphyIndex, netlink_utils_.get(), nullptr)};
+  NiceMock<MockEventLoop> event_loop_;
   unique_ptr<ClientInterfaceImpl> client_interface_;
 };  // class ClientInterfaceImplTest
 
+// Runs ClientInterfaceImpl on top of the real netlink utilities, with a fake
+// kernel behind the netlink manager, and an event loop on virtual time.
+class ClientInterfaceImplFakeKernelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    fake_kernel_.AddBss(kTestInterfaceIndex, kTestBssid, kTestSsid,
+                        kTestFrequency);
+    client_interface_.reset(new ClientInterfaceImpl{
+        kTestWiphyIndex,
+        kTestInterfaceName,
+        kTestInterfaceIndex,
+        MacAddress(),
+        if_tool_.get(),
+        supplicant_manager_.get(),
+        &netlink_utils_,
+        &scan_utils_,
+        &regulatory_model_,
+        nullptr /* bss_cache */,
+        &event_loop_});
+  }
+
+  unique_ptr<NiceMock<MockInterfaceTool>> if_tool_{
+      new NiceMock<MockInterfaceTool>};
+  unique_ptr<NiceMock<MockSupplicantManager>> supplicant_manager_{
+      new NiceMock<MockSupplicantManager>};
+  NiceMock<MockNetlinkManager> netlink_manager_;
+  FakeEventLoop event_loop_;
+  FakeKernel fake_kernel_{&netlink_manager_, &event_loop_};
+  NetlinkUtils netlink_utils_{&netlink_manager_};
+  ScanUtils scan_utils_{&netlink_manager_};
+  RegulatoryModel regulatory_model_{kTestWiphyIndex, &netlink_utils_, nullptr};
+  unique_ptr<ClientInterfaceImpl> client_interface_;
+};  // class ClientInterfaceImplFakeKernelTest
+
 }  // namespace
 
 TEST_F(ClientInterfaceImplTest, ShouldReportEnableFailure) {
@@ -110,5 +168,172 @@ TEST_F(ClientInterfaceImplTest, ShouldReportDisableSuccess) {
   EXPECT_TRUE(client_interface_->DisableSupplicant());
 }
 
+TEST_F(ClientInterfaceImplFakeKernelTest, ResyncsDroppedConnectionEvents) {
+  fake_kernel_.Connect(kTestInterfaceIndex, kTestBssid);
+  fake_kernel_.DropEventsWithOverrun();
+  EXPECT_TRUE(client_interface_->IsAssociated());
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(3u, signal_poll_results.size());
+  EXPECT_EQ(static_cast<int32_t>(kTestFrequency), signal_poll_results[2]);
+
+  fake_kernel_.Disconnect(kTestInterfaceIndex);
+  fake_kernel_.DropEventsWithOverrun();
+  EXPECT_FALSE(client_interface_->IsAssociated());
+  EXPECT_EQ(2u, netlink_manager_.GetEventOverrunCount());
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, ResyncKeepsStateOfDeliveredEvents) {
+  fake_kernel_.Connect(kTestInterfaceIndex, kTestBssid);
+  fake_kernel_.DeliverEvents();
+  EXPECT_TRUE(client_interface_->IsAssociated());
+  fake_kernel_.DropEventsWithOverrun();
+  EXPECT_TRUE(client_interface_->IsAssociated());
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, ResyncsDroppedScanResultEvent) {
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  sp<ScannerImpl> scanner = client_interface_->GetScanner();
+  scanner->subscribeScanEvents(scan_event);
+  bool success = false;
+  EXPECT_TRUE(scanner->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+
+  // Scan is still running: its notification is yet to come.
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(0);
+  fake_kernel_.DropEventsWithOverrun();
+  testing::Mock::VerifyAndClearExpectations(scan_event.get());
+
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(1);
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  fake_kernel_.CompleteScan(kTestInterfaceIndex);
+  fake_kernel_.DeliverEvents();
+  event_loop_.AdvanceTimeMs(ScannerImpl::kScanResyncTimeoutMs);
+  testing::Mock::VerifyAndClearExpectations(scan_event.get());
+  EXPECT_EQ(0, fake_kernel_.GetNumRequests(NL80211_CMD_ABORT_SCAN));
+
+  // The notification of a completed scan is dropped. It is not known whether
+  // the scan succeeded, so it fails once the resync timeout expires.
+  EXPECT_TRUE(scanner->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  fake_kernel_.CompleteScan(kTestInterfaceIndex);
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(0);
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  fake_kernel_.DropEventsWithOverrun();
+  event_loop_.AdvanceTimeMs(ScannerImpl::kScanResyncTimeoutMs / 2);
+  testing::Mock::VerifyAndClearExpectations(scan_event.get());
+
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(1);
+  event_loop_.AdvanceTimeMs(ScannerImpl::kScanResyncTimeoutMs);
+  testing::Mock::VerifyAndClearExpectations(scan_event.get());
+
+  // A new scan can be started and completes normally.
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(1);
+  EXPECT_TRUE(scanner->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  fake_kernel_.CompleteScan(kTestInterfaceIndex);
+  fake_kernel_.DeliverEvents();
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, AbortsStuckScanAfterResync) {
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  sp<ScannerImpl> scanner = client_interface_->GetScanner();
+  scanner->subscribeScanEvents(scan_event);
+  bool success = false;
+  EXPECT_TRUE(scanner->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  fake_kernel_.DropEventsWithOverrun();
+
+  // The abort event ends the scan like any other.
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(1);
+  event_loop_.AdvanceTimeMs(ScannerImpl::kScanResyncTimeoutMs);
+  EXPECT_FALSE(fake_kernel_.IsScanRunning(kTestInterfaceIndex));
+  EXPECT_EQ(1, fake_kernel_.GetNumRequests(NL80211_CMD_ABORT_SCAN));
+  EXPECT_EQ(0u, fake_kernel_.GetNumPendingEvents());
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, AbortsScanAtItsDeadline) {
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  sp<ScannerImpl> scanner = client_interface_->GetScanner();
+  scanner->subscribeScanEvents(scan_event);
+  SingleScanSettings scan_settings;
+  scan_settings.deadline_ms_ = kTestScanDeadlineMs;
+  bool success = false;
+  EXPECT_TRUE(scanner->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+
+  EXPECT_CALL(*scan_event, OnPartialScanResultReady(_)).Times(0);
+  event_loop_.AdvanceTimeMs(kTestScanDeadlineMs / 2);
+  EXPECT_TRUE(fake_kernel_.IsScanRunning(kTestInterfaceIndex));
+  testing::Mock::VerifyAndClearExpectations(scan_event.get());
+
+  // The abort event is delivered by the event loop, like the socket would.
+  EXPECT_CALL(*scan_event, OnPartialScanResultReady(_)).Times(1);
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  event_loop_.AdvanceTimeMs(kTestScanDeadlineMs);
+  EXPECT_FALSE(fake_kernel_.IsScanRunning(kTestInterfaceIndex));
+  EXPECT_EQ(1, fake_kernel_.GetNumRequests(NL80211_CMD_ABORT_SCAN));
+  EXPECT_EQ(0u, fake_kernel_.GetNumPendingEvents());
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, NotifiesLinkQualityEvents) {
+  sp<NiceMock<MockLinkQualityEvent>> handler(
+      new NiceMock<MockLinkQualityEvent>());
+  EXPECT_TRUE(client_interface_->SubscribeLinkQualityEvents(
+      kTestRssiThreshold, kTestRssiHysteresis, handler));
+  EXPECT_EQ(kTestRssiThreshold,
+            fake_kernel_.GetCqmRssiThreshold(kTestInterfaceIndex));
+  fake_kernel_.Connect(kTestInterfaceIndex, kTestBssid);
+  fake_kernel_.DeliverEvents();
+
+  {
+    testing::InSequence s;
+    EXPECT_CALL(*handler, OnRssiThresholdCrossed(
+        ILinkQualityEvent::RSSI_THRESHOLD_LOW));
+    EXPECT_CALL(*handler, OnRssiThresholdCrossed(
+        ILinkQualityEvent::RSSI_THRESHOLD_HIGH));
+    EXPECT_CALL(*handler, OnBeaconLoss());
+  }
+  fake_kernel_.SetRssi(kTestInterfaceIndex, kTestRssiThreshold - 5);
+  // Still below the threshold: no new event.
+  fake_kernel_.SetRssi(kTestInterfaceIndex, kTestRssiThreshold - 10);
+  // Within the hysteresis: no new event.
+  fake_kernel_.SetRssi(kTestInterfaceIndex, kTestRssiThreshold + 1);
+  fake_kernel_.SetRssi(kTestInterfaceIndex, kTestRssiThreshold + 5);
+  fake_kernel_.LoseBeacons(kTestInterfaceIndex);
+  fake_kernel_.DeliverEvents();
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, TracksChannelSwitch) {
+  sp<NiceMock<MockLinkQualityEvent>> handler(
+      new NiceMock<MockLinkQualityEvent>());
+  EXPECT_TRUE(client_interface_->SubscribeLinkQualityEvents(
+      kTestRssiThreshold, kTestRssiHysteresis, handler));
+  fake_kernel_.Connect(kTestInterfaceIndex, kTestBssid);
+  fake_kernel_.DeliverEvents();
+
+  EXPECT_CALL(*handler, OnChannelSwitch(static_cast<int32_t>(kTestFrequency1),
+                                        NL80211_CHAN_WIDTH_20));
+  fake_kernel_.SwitchChannel(kTestInterfaceIndex, kTestFrequency1);
+  fake_kernel_.DeliverEvents();
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(3u, signal_poll_results.size());
+  EXPECT_EQ(static_cast<int32_t>(kTestFrequency1), signal_poll_results[2]);
+}
+
+TEST_F(ClientInterfaceImplFakeKernelTest, UnsubscribeDisablesRssiMonitoring) {
+  sp<NiceMock<MockLinkQualityEvent>> handler(
+      new NiceMock<MockLinkQualityEvent>());
+  EXPECT_TRUE(client_interface_->SubscribeLinkQualityEvents(
+      kTestRssiThreshold, kTestRssiHysteresis, handler));
+  client_interface_->UnsubscribeLinkQualityEvents();
+  EXPECT_EQ(0, fake_kernel_.GetCqmRssiThreshold(kTestInterfaceIndex));
+
+  EXPECT_CALL(*handler, OnBeaconLoss()).Times(0);
+  fake_kernel_.LoseBeacons(kTestInterfaceIndex);
+  fake_kernel_.DeliverEvents();
+}
+
 }  // namespace wificond
 }  // namespace android
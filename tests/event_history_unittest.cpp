@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <linux/nl80211.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "wificond/event_history.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint64_t kFakeWallTimeMs = 1500000000000;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeFrequency = 2412;
+constexpr int32_t kFakeSignalMbm = -5000;
+// Room for the header and 4 records.
+constexpr size_t kFakeSizeBytes = 5 * sizeof(EventHistory::Record);
+
+const Ssid kFakeSsid = Ssid::FromString("Google");
+const MacAddress kFakeBssid({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+
+}  // namespace
+
+class EventHistoryTest : public ::testing::Test {
+ protected:
+  unique_ptr<EventHistory> CreateHistory() {
+    return unique_ptr<EventHistory>(new EventHistory(
+        file_.path, kFakeSizeBytes, [this] { return wall_time_ms_++; }));
+  }
+
+  vector<EventHistory::Record> ReadRecords() {
+    vector<EventHistory::Record> records;
+    EXPECT_TRUE(EventHistory::ReadFile(file_.path, &records));
+    return records;
+  }
+
+  TemporaryFile file_;
+  uint64_t wall_time_ms_ = kFakeWallTimeMs;
+};
+
+TEST_F(EventHistoryTest, RecordsSurviveRestarts) {
+  unique_ptr<EventHistory> history = CreateHistory();
+  ASSERT_TRUE(history->Open());
+  history->RecordScanTriggered(kFakeInterfaceIndex, 3);
+  history->RecordScanDone(kFakeInterfaceIndex, EventHistory::kScanResults);
+  history.reset();
+
+  history = CreateHistory();
+  ASSERT_TRUE(history->Open());
+  history->RecordBss(kFakeInterfaceIndex, kFakeBssid, kFakeSsid,
+                     kFakeFrequency, kFakeSignalMbm);
+  history.reset();
+
+  vector<EventHistory::Record> records = ReadRecords();
+  ASSERT_EQ(3u, records.size());
+  EXPECT_EQ(1u, records[0].sequence);
+  EXPECT_EQ(EventHistory::kScanTriggered, records[0].type);
+  EXPECT_EQ(3u, records[0].frequency);
+  EXPECT_EQ(kFakeWallTimeMs, records[0].wall_time_ms);
+  EXPECT_EQ(EventHistory::kScanResults, records[1].type);
+  EXPECT_EQ(3u, records[2].sequence);
+  EXPECT_EQ(EventHistory::kBss, records[2].type);
+  EXPECT_EQ(kFakeInterfaceIndex, records[2].interface_index);
+  EXPECT_EQ(kFakeFrequency, records[2].frequency);
+  EXPECT_EQ(kFakeSignalMbm, records[2].value);
+}
+
+TEST_F(EventHistoryTest, OverwritesOldestRecordsWhenFull) {
+  unique_ptr<EventHistory> history = CreateHistory();
+  ASSERT_TRUE(history->Open());
+  for (uint32_t i = 0; i < 6; i++) {
+    history->RecordScanTriggered(kFakeInterfaceIndex, i);
+  }
+  history.reset();
+
+  vector<EventHistory::Record> records = ReadRecords();
+  ASSERT_EQ(4u, records.size());
+  for (uint32_t i = 0; i < records.size(); i++) {
+    EXPECT_EQ(i + 3, records[i].sequence);
+    EXPECT_EQ(i + 2, records[i].frequency);
+  }
+}
+
+TEST_F(EventHistoryTest, SkipsTornRecords) {
+  unique_ptr<EventHistory> history = CreateHistory();
+  ASSERT_TRUE(history->Open());
+  history->RecordRegChange("US");
+  history->RecordNetlinkError(NL80211_CMD_TRIGGER_SCAN, EBUSY, 0);
+  history.reset();
+
+  // Flip a byte of the second record, as if the write was cut short.
+  off_t offset = 3 * sizeof(EventHistory::Record) - 1;
+  uint8_t byte;
+  ASSERT_EQ(1, pread(file_.fd, &byte, 1, offset));
+  byte ^= 0xff;
+  ASSERT_EQ(1, pwrite(file_.fd, &byte, 1, offset));
+
+  vector<EventHistory::Record> records = ReadRecords();
+  ASSERT_EQ(1u, records.size());
+  EXPECT_EQ(EventHistory::kRegChange, records[0].type);
+
+  // Writing carries on after the last valid record.
+  history = CreateHistory();
+  ASSERT_TRUE(history->Open());
+  history->RecordScanDone(kFakeInterfaceIndex, EventHistory::kScanAborted);
+  history.reset();
+  records = ReadRecords();
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ(2u, records[1].sequence);
+  EXPECT_EQ(EventHistory::kScanAborted, records[1].type);
+}
+
+TEST_F(EventHistoryTest, RejectsOtherFiles) {
+  ASSERT_TRUE(android::base::WriteStringToFd("not a history", file_.fd));
+  vector<EventHistory::Record> records;
+  EXPECT_FALSE(EventHistory::ReadFile(file_.path, &records));
+}
+
+TEST_F(EventHistoryTest, CanConvertRecordsToCsv) {
+  unique_ptr<EventHistory> history = CreateHistory();
+  ASSERT_TRUE(history->Open());
+  history->RecordBss(kFakeInterfaceIndex, kFakeBssid,
+                     Ssid::FromString("Guest \"1\"\n"), kFakeFrequency,
+                     kFakeSignalMbm);
+  history->RecordMlmeEvent(kFakeInterfaceIndex, NL80211_CMD_CONNECT,
+                           kFakeBssid, 17);
+  history.reset();
+
+  vector<EventHistory::Record> records = ReadRecords();
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ("1,1500000000000,bss,12,0,0,2412,-5000,12:ef:a1:2c:97:8b,"
+            "\"Guest \"\"1\"\"\\x0a\"",
+            EventHistory::ToCsv(records[0]));
+  EXPECT_EQ("2,1500000000001,mlme_event,12,46,17,0,0,12:ef:a1:2c:97:8b,\"\"",
+            EventHistory::ToCsv(records[1]));
+}
+
+}  // namespace wificond
+}  // namespace android
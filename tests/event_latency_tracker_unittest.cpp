@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <linux/nl80211.h>
+
+#include <sstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/event_latency_tracker.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr int64_t kFakeSlowEventThresholdNs = 10000000;
+
+}  // namespace
+
+TEST(EventLatencyTrackerTest, CountsLatenciesInBuckets) {
+  EventLatencyTracker tracker(kFakeSlowEventThresholdNs);
+  // 50 us wait, 700 us handling.
+  tracker.OnEventHandled(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex,
+                         50000, 700000);
+  // 2 ms wait, 700 us handling.
+  tracker.OnEventHandled(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex,
+                         2000000, 700000);
+
+  EventLatencyTracker::Histogram queue_wait =
+      tracker.GetQueueWaitHistogram(NL80211_CMD_NEW_SCAN_RESULTS);
+  EXPECT_EQ(2u, queue_wait.num_events);
+  EXPECT_EQ(1u, queue_wait.counts[0]);
+  EXPECT_EQ(1u, queue_wait.counts[3]);
+  EXPECT_EQ(2000000, queue_wait.max_ns);
+  EventLatencyTracker::Histogram handling =
+      tracker.GetHandlingHistogram(NL80211_CMD_NEW_SCAN_RESULTS);
+  EXPECT_EQ(2u, handling.counts[2]);
+  EXPECT_EQ(1400000, handling.total_ns);
+
+  EXPECT_EQ(0u, tracker.GetHandlingHistogram(NL80211_CMD_ROAM).num_events);
+  EXPECT_TRUE(tracker.GetSlowEvents().empty());
+}
+
+TEST(EventLatencyTrackerTest, SkipsUnknownQueueWaits) {
+  EventLatencyTracker tracker(kFakeSlowEventThresholdNs);
+  tracker.OnEventHandled(NL80211_CMD_CONNECT, kFakeInterfaceIndex,
+                         EventLatencyTracker::kUnknownQueueWait, 1000);
+
+  EXPECT_EQ(0u,
+            tracker.GetQueueWaitHistogram(NL80211_CMD_CONNECT).num_events);
+  EXPECT_EQ(1u, tracker.GetHandlingHistogram(NL80211_CMD_CONNECT).num_events);
+  EXPECT_TRUE(tracker.GetSlowEvents().empty());
+}
+
+TEST(EventLatencyTrackerTest, KeepsLatestSlowEvents) {
+  EventLatencyTracker tracker(kFakeSlowEventThresholdNs);
+  tracker.OnEventHandled(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex,
+                         kFakeSlowEventThresholdNs, 0);
+  tracker.OnEventHandled(NL80211_CMD_ROAM, kFakeInterfaceIndex,
+                         EventLatencyTracker::kUnknownQueueWait,
+                         kFakeSlowEventThresholdNs);
+  vector<EventLatencyTracker::SlowEvent> slow_events =
+      tracker.GetSlowEvents();
+  ASSERT_EQ(2u, slow_events.size());
+  EXPECT_EQ(NL80211_CMD_DISCONNECT, slow_events[0].command);
+  EXPECT_EQ(kFakeInterfaceIndex, slow_events[0].interface_index);
+  EXPECT_EQ(kFakeSlowEventThresholdNs, slow_events[0].queue_wait_ns);
+  EXPECT_EQ(NL80211_CMD_ROAM, slow_events[1].command);
+  EXPECT_EQ(kFakeSlowEventThresholdNs, slow_events[1].handling_ns);
+
+  for (size_t i = 0; i < EventLatencyTracker::kMaxSlowEvents; i++) {
+    tracker.OnEventHandled(NL80211_CMD_CONNECT, kFakeInterfaceIndex,
+                           kFakeSlowEventThresholdNs, 0);
+  }
+  slow_events = tracker.GetSlowEvents();
+  ASSERT_EQ(EventLatencyTracker::kMaxSlowEvents, slow_events.size());
+  EXPECT_EQ(NL80211_CMD_CONNECT, slow_events.front().command);
+
+  std::stringstream ss;
+  tracker.Dump(&ss);
+  EXPECT_NE(std::string::npos, ss.str().find("Slow NL80211 events"));
+}
+
+}  // namespace wificond
+}  // namespace android
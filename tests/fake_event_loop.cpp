@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/tests/fake_event_loop.h"
+
+#include <android-base/logging.h>
+
+using std::function;
+
+namespace android {
+namespace wificond {
+
+FakeEventLoop::FakeEventLoop()
+    : time_ms_(0),
+      next_task_id_(0) {
+}
+
+void FakeEventLoop::PostTask(const function<void()>& callback) {
+  PostDelayedTask(callback, 0);
+}
+
+void FakeEventLoop::PostDelayedTask(const function<void()>& callback,
+                                    int64_t delay_ms) {
+  CHECK(delay_ms >= 0) << "Negative delay: " << delay_ms;
+  std::lock_guard<std::mutex> lock(lock_);
+  tasks_[std::make_pair(time_ms_ + delay_ms, next_task_id_++)] = callback;
+}
+
+bool FakeEventLoop::WatchFileDescriptor(int fd,
+                                        ReadyMode mode,
+                                        const function<void(int)>& callback) {
+  std::lock_guard<std::mutex> lock(lock_);
+  watchers_[fd] = {mode, callback};
+  return true;
+}
+
+bool FakeEventLoop::StopWatchFileDescriptor(int fd) {
+  std::lock_guard<std::mutex> lock(lock_);
+  return watchers_.erase(fd) == 1;
+}
+
+int64_t FakeEventLoop::GetTimeMs() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return time_ms_;
+}
+
+bool FakeEventLoop::SetFileDescriptorReady(int fd, ReadyMode mode) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    const auto it = watchers_.find(fd);
+    if (it == watchers_.end() || it->second.mode != mode) {
+      return false;
+    }
+  }
+  PostTask([this, fd, mode]() { RunReadyCallback(fd, mode); });
+  return true;
+}
+
+void FakeEventLoop::RunUntilIdle() {
+  while (RunNextTask(GetTimeMs())) {
+  }
+}
+
+void FakeEventLoop::AdvanceTimeMs(int64_t delay_ms) {
+  CHECK(delay_ms >= 0) << "Time can't go backwards: " << delay_ms;
+  int64_t end_time_ms = GetTimeMs() + delay_ms;
+  while (RunNextTask(end_time_ms)) {
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  time_ms_ = end_time_ms;
+}
+
+size_t FakeEventLoop::GetNumPendingTasks() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return tasks_.size();
+}
+
+bool FakeEventLoop::RunNextTask(int64_t time_ms) {
+  function<void()> task;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    const auto it = tasks_.begin();
+    if (it == tasks_.end() || it->first.first > time_ms) {
+      return false;
+    }
+    time_ms_ = it->first.first;
+    task = std::move(it->second);
+    tasks_.erase(it);
+  }
+  // Tasks may post tasks, so they run without the lock held.
+  task();
+  return true;
+}
+
+void FakeEventLoop::RunReadyCallback(int fd, ReadyMode mode) {
+  function<void(int)> callback;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    const auto it = watchers_.find(fd);
+    if (it == watchers_.end() || it->second.mode != mode) {
+      return;
+    }
+    callback = it->second.callback;
+  }
+  callback(fd);
+}
+
+}  // namespace wificond
+}  // namespace android
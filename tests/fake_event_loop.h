@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_TEST_FAKE_EVENT_LOOP_H_
+#define WIFICOND_TEST_FAKE_EVENT_LOOP_H_
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <android-base/macros.h>
+
+#include "wificond/event_loop.h"
+
+namespace android {
+namespace wificond {
+
+// An event loop on a virtual clock, so that timers can be tested without
+// waiting for them.
+// Time only moves when the test advances it. Tasks which are due by then
+// run in the order of their due time, and tasks due at the same time run in
+// the order they were posted. File descriptors are never polled: the test
+// tells the loop which watched file descriptor is ready.
+// Tasks can be posted from any thread, but they all run on the thread which
+// runs the loop.
+class FakeEventLoop : public EventLoop {
+ public:
+  FakeEventLoop();
+  ~FakeEventLoop() override = default;
+
+  // See event_loop.h
+  void PostTask(const std::function<void()>& callback) override;
+  // See event_loop.h
+  void PostDelayedTask(const std::function<void()>& callback,
+                       int64_t delay_ms) override;
+  // See event_loop.h
+  bool WatchFileDescriptor(
+      int fd,
+      ReadyMode mode,
+      const std::function<void(int)>& callback) override;
+  // See event_loop.h
+  bool StopWatchFileDescriptor(int fd) override;
+
+  // Returns the virtual time in milliseconds since the loop was created.
+  int64_t GetTimeMs() const;
+  // Makes watched file descriptor |fd| ready for |mode|. Its callback runs
+  // once, the next time the loop runs, unless |fd| is unwatched before.
+  // Returns false if |fd| is not watched for |mode|.
+  bool SetFileDescriptorReady(int fd, ReadyMode mode);
+  // Runs the tasks which are due now, including the ones they post without
+  // delay, until none is left.
+  void RunUntilIdle();
+  // Moves the clock |delay_ms| milliseconds forward. Each task which becomes
+  // due runs with the clock set to its due time.
+  void AdvanceTimeMs(int64_t delay_ms);
+  // Returns the number of tasks which haven't run yet, delayed or not.
+  size_t GetNumPendingTasks() const;
+
+ private:
+  struct Watcher {
+    ReadyMode mode;
+    std::function<void(int)> callback;
+  };
+
+  // Runs the first task if it is due by |time_ms|.
+  // Returns false if there is no such task.
+  bool RunNextTask(int64_t time_ms);
+  void RunReadyCallback(int fd, ReadyMode mode);
+
+  mutable std::mutex lock_;
+  int64_t time_ms_;
+  // Tasks ordered by due time, then by the order they were posted.
+  std::map<std::pair<int64_t, uint64_t>, std::function<void()>> tasks_;
+  uint64_t next_task_id_;
+  // A mapping from file descriptor to its watcher.
+  std::map<int, Watcher> watchers_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeEventLoop);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TEST_FAKE_EVENT_LOOP_H_
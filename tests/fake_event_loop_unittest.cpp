@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/tests/fake_event_loop.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int kFakeFd = 7;
+
+}  // namespace
+
+TEST(FakeEventLoopTest, RunsDelayedTasksInTimeOrder) {
+  FakeEventLoop event_loop;
+  vector<int64_t> run_times_ms;
+  auto record_time = [&event_loop, &run_times_ms]() {
+    run_times_ms.push_back(event_loop.GetTimeMs());
+  };
+  event_loop.PostDelayedTask(record_time, 300);
+  event_loop.PostDelayedTask(record_time, 100);
+  event_loop.PostDelayedTask([&event_loop, record_time]() {
+    record_time();
+    // Delays count from the time of the task which posts them.
+    event_loop.PostDelayedTask(record_time, 50);
+  }, 200);
+
+  event_loop.RunUntilIdle();
+  EXPECT_TRUE(run_times_ms.empty());
+  event_loop.AdvanceTimeMs(1000);
+  EXPECT_EQ(vector<int64_t>({100, 200, 250, 300}), run_times_ms);
+  EXPECT_EQ(1000, event_loop.GetTimeMs());
+  EXPECT_EQ(0u, event_loop.GetNumPendingTasks());
+}
+
+TEST(FakeEventLoopTest, RunsTasksDueAtTheSameTimeInPostOrder) {
+  FakeEventLoop event_loop;
+  vector<int> order;
+  event_loop.PostDelayedTask([&order]() { order.push_back(1); }, 10);
+  event_loop.PostDelayedTask([&order]() { order.push_back(2); }, 10);
+  event_loop.PostTask([&order]() { order.push_back(0); });
+
+  event_loop.RunUntilIdle();
+  EXPECT_EQ(vector<int>({0}), order);
+  event_loop.AdvanceTimeMs(9);
+  EXPECT_EQ(vector<int>({0}), order);
+  event_loop.AdvanceTimeMs(1);
+  EXPECT_EQ(vector<int>({0, 1, 2}), order);
+}
+
+TEST(FakeEventLoopTest, RunsCallbacksOfReadyFileDescriptors) {
+  FakeEventLoop event_loop;
+  int num_reads = 0;
+  EXPECT_FALSE(event_loop.SetFileDescriptorReady(kFakeFd,
+                                                 EventLoop::kModeInput));
+  EXPECT_TRUE(event_loop.WatchFileDescriptor(
+      kFakeFd, EventLoop::kModeInput, [&num_reads](int fd) {
+        EXPECT_EQ(kFakeFd, fd);
+        num_reads++;
+      }));
+  EXPECT_FALSE(event_loop.SetFileDescriptorReady(kFakeFd,
+                                                 EventLoop::kModeOutput));
+  EXPECT_TRUE(event_loop.SetFileDescriptorReady(kFakeFd,
+                                                EventLoop::kModeInput));
+  EXPECT_EQ(0, num_reads);
+  event_loop.RunUntilIdle();
+  EXPECT_EQ(1, num_reads);
+
+  // Readiness is dropped when the file descriptor is unwatched.
+  EXPECT_TRUE(event_loop.SetFileDescriptorReady(kFakeFd,
+                                                EventLoop::kModeInput));
+  EXPECT_TRUE(event_loop.StopWatchFileDescriptor(kFakeFd));
+  EXPECT_FALSE(event_loop.StopWatchFileDescriptor(kFakeFd));
+  event_loop.RunUntilIdle();
+  EXPECT_EQ(1, num_reads);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,563 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/tests/fake_kernel.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+
+#include <utils/Timers.h>
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using testing::Invoke;
+using testing::Return;
+using testing::_;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int32_t kFakeSignalMbm = -5000;
+constexpr uint16_t kFakeCapability = 0x0411;
+constexpr uint32_t kFakeTxPackets = 35;
+constexpr int8_t kFakeRssi = -50;
+constexpr uint32_t kFakeTxBitrate = 540;
+
+}  // namespace
+
+constexpr uint16_t FakeKernel::kFamilyId;
+constexpr int FakeKernel::kEventSocketFd;
+
+FakeKernel::FakeKernel(MockNetlinkManager* netlink_manager)
+    : FakeKernel(netlink_manager, nullptr) {
+}
+
+FakeKernel::FakeKernel(MockNetlinkManager* netlink_manager,
+                       FakeEventLoop* event_loop)
+    : netlink_manager_(netlink_manager),
+      event_loop_(event_loop),
+      sequence_number_(0) {
+  ON_CALL(*netlink_manager_, GetFamilyId()).WillByDefault(Return(kFamilyId));
+  ON_CALL(*netlink_manager_, GetSequenceNumber()).WillByDefault(Invoke(
+      [this]() { return ++sequence_number_; }));
+  ON_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _))
+      .WillByDefault(Invoke(this, &FakeKernel::HandleRequest));
+  if (event_loop_ != nullptr) {
+    event_loop_->WatchFileDescriptor(kEventSocketFd,
+                                     EventLoop::kModeInput,
+                                     [this](int fd) { DeliverEvents(); });
+  }
+}
+
+FakeKernel::~FakeKernel() {
+  if (event_loop_ != nullptr) {
+    event_loop_->StopWatchFileDescriptor(kEventSocketFd);
+  }
+}
+
+void FakeKernel::AddBss(uint32_t interface_index,
+                        const MacAddress& bssid,
+                        const Ssid& ssid,
+                        uint32_t frequency) {
+  bss_cache_[interface_index].push_back(
+      {bssid, ssid, frequency,
+       static_cast<uint64_t>(systemTime(SYSTEM_TIME_BOOTTIME)), false, true});
+}
+
+void FakeKernel::Connect(uint32_t interface_index,
+                         const MacAddress& bssid) {
+  for (auto& bss : bss_cache_[interface_index]) {
+    bss.associated = (bss.bssid == bssid);
+  }
+  QueueEvent(NL80211_CMD_CONNECT, interface_index, bssid);
+}
+
+void FakeKernel::Disconnect(uint32_t interface_index) {
+  MacAddress bssid;
+  for (auto& bss : bss_cache_[interface_index]) {
+    if (bss.associated) {
+      bssid = bss.bssid;
+    }
+    bss.associated = false;
+  }
+  QueueEvent(NL80211_CMD_DISCONNECT, interface_index, bssid);
+}
+
+void FakeKernel::MoveOutOfRange(uint32_t interface_index,
+                                const MacAddress& bssid) {
+  for (auto& bss : bss_cache_[interface_index]) {
+    if (bss.bssid == bssid) {
+      bss.in_range = false;
+    }
+  }
+}
+
+void FakeKernel::CompleteScan(uint32_t interface_index) {
+  scan_running_[interface_index] = false;
+  vector<Bss>& bss_cache = bss_cache_[interface_index];
+  if (GetLastScanFlags(interface_index) & NL80211_SCAN_FLAG_FLUSH) {
+    bss_cache.erase(
+        std::remove_if(bss_cache.begin(), bss_cache.end(),
+                       [](const Bss& bss) { return !bss.in_range; }),
+        bss_cache.end());
+  }
+  RefreshBssCache(interface_index);
+  QueueEvent(NL80211_CMD_NEW_SCAN_RESULTS, interface_index, {});
+}
+
+void FakeKernel::RefreshBssCache(uint32_t interface_index) {
+  uint64_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+  for (auto& bss : bss_cache_[interface_index]) {
+    if (bss.in_range) {
+      bss.last_seen_boottime_ns = now;
+    }
+  }
+}
+
+void FakeKernel::CompleteSchedScan(uint32_t interface_index) {
+  SchedScan& sched_scan = sched_scans_[interface_index];
+  sched_scan.num_cycles++;
+  RefreshBssCache(interface_index);
+  QueueEvent(NL80211_CMD_SCHED_SCAN_RESULTS, interface_index, {});
+}
+
+bool FakeKernel::IsSchedScanRunning(uint32_t interface_index) const {
+  const auto it = sched_scans_.find(interface_index);
+  return it != sched_scans_.end() && it->second.running;
+}
+
+int FakeKernel::GetNumSchedScanCycles(uint32_t interface_index) const {
+  const auto it = sched_scans_.find(interface_index);
+  return it == sched_scans_.end() ? 0 : it->second.num_cycles;
+}
+
+void FakeKernel::SetRssi(uint32_t interface_index, int32_t rssi_dbm) {
+  const auto it = cqm_config_.find(interface_index);
+  if (it == cqm_config_.end() || it->second.rssi_threshold_dbm == 0) {
+    return;
+  }
+  CqmConfig& config = it->second;
+  int64_t hysteresis = config.rssi_hysteresis_db;
+  uint32_t rssi_event;
+  if (rssi_dbm < config.rssi_threshold_dbm - hysteresis) {
+    rssi_event = NL80211_CQM_RSSI_THRESHOLD_EVENT_LOW;
+  } else if (rssi_dbm > config.rssi_threshold_dbm + hysteresis) {
+    rssi_event = NL80211_CQM_RSSI_THRESHOLD_EVENT_HIGH;
+  } else {
+    return;
+  }
+  if (config.last_rssi_event == rssi_event) {
+    return;
+  }
+  config.last_rssi_event = rssi_event;
+  NL80211NestedAttr cqm_attr(NL80211_ATTR_CQM);
+  cqm_attr.AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_CQM_RSSI_THRESHOLD_EVENT, rssi_event));
+  QueueEvent(NL80211_CMD_NOTIFY_CQM, interface_index, {})
+      ->AddAttribute(cqm_attr);
+}
+
+void FakeKernel::LoseBeacons(uint32_t interface_index) {
+  NL80211NestedAttr cqm_attr(NL80211_ATTR_CQM);
+  // A flag attribute.
+  cqm_attr.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_ATTR_CQM_BEACON_LOSS_EVENT, {}));
+  QueueEvent(NL80211_CMD_NOTIFY_CQM, interface_index, {})
+      ->AddAttribute(cqm_attr);
+}
+
+void FakeKernel::SwitchChannel(uint32_t interface_index, uint32_t frequency) {
+  for (auto& bss : bss_cache_[interface_index]) {
+    if (bss.associated) {
+      bss.frequency = frequency;
+    }
+  }
+  NL80211Packet* event =
+      QueueEvent(NL80211_CMD_CH_SWITCH_NOTIFY, interface_index, {});
+  event->AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY_FREQ,
+                                            frequency));
+  event->AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_CHANNEL_WIDTH,
+                                            NL80211_CHAN_WIDTH_20));
+}
+
+int32_t FakeKernel::GetCqmRssiThreshold(uint32_t interface_index) const {
+  const auto it = cqm_config_.find(interface_index);
+  return it == cqm_config_.end() ? 0 : it->second.rssi_threshold_dbm;
+}
+
+bool FakeKernel::IsScanRunning(uint32_t interface_index) const {
+  const auto it = scan_running_.find(interface_index);
+  return it != scan_running_.end() && it->second;
+}
+
+uint32_t FakeKernel::GetLastScanFlags(uint32_t interface_index) const {
+  const auto it = scan_flags_.find(interface_index);
+  return it == scan_flags_.end() ? 0 : it->second;
+}
+
+void FakeKernel::DeliverEvents() {
+  if (pending_events_.empty()) {
+    return;
+  }
+  vector<uint8_t> datagram;
+  for (const auto& event : pending_events_) {
+    const vector<uint8_t>& data = event->GetConstData();
+    datagram.insert(datagram.end(), data.begin(), data.end());
+  }
+  pending_events_.clear();
+  netlink_manager_->HandleReceivedMessages(datagram.data(), datagram.size());
+}
+
+void FakeKernel::DropEventsWithOverrun() {
+  pending_events_.clear();
+  netlink_manager_->OnEventOverrun();
+}
+
+int FakeKernel::GetNumRequests(uint8_t command) const {
+  const auto it = num_requests_.find(command);
+  return it == num_requests_.end() ? 0 : it->second;
+}
+
+bool FakeKernel::HandleRequest(
+    const NL80211Packet& request,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  uint8_t command = request.GetCommand();
+  num_requests_[command]++;
+  uint32_t interface_index = 0;
+  request.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index);
+
+  switch (command) {
+    case NL80211_CMD_GET_SCAN:
+      HandleGetScan(request, response);
+      break;
+    case NL80211_CMD_GET_STATION:
+      HandleGetStation(request, response);
+      break;
+    case NL80211_CMD_SET_CQM:
+      HandleSetCqm(request, response);
+      break;
+    case NL80211_CMD_TRIGGER_SCAN:
+      if (IsScanRunning(interface_index)) {
+        response->push_back(CreateError(request, EBUSY));
+        break;
+      }
+      scan_running_[interface_index] = true;
+      scan_flags_[interface_index] = 0;
+      request.GetAttributeValue(NL80211_ATTR_SCAN_FLAGS,
+                                &scan_flags_[interface_index]);
+      response->push_back(CreateError(request, 0));
+      break;
+    case NL80211_CMD_START_SCHED_SCAN:
+      HandleStartSchedScan(request, response);
+      break;
+    case NL80211_CMD_STOP_SCHED_SCAN:
+      if (!IsSchedScanRunning(interface_index)) {
+        response->push_back(CreateError(request, ENOENT));
+        break;
+      }
+      sched_scans_[interface_index].running = false;
+      QueueEvent(NL80211_CMD_SCHED_SCAN_STOPPED, interface_index, {});
+      response->push_back(CreateError(request, 0));
+      break;
+    case NL80211_CMD_ABORT_SCAN:
+      if (!IsScanRunning(interface_index)) {
+        response->push_back(CreateError(request, ENOENT));
+        break;
+      }
+      scan_running_[interface_index] = false;
+      QueueEvent(NL80211_CMD_SCAN_ABORTED, interface_index, {});
+      response->push_back(CreateError(request, 0));
+      break;
+    default:
+      response->push_back(CreateError(request, EOPNOTSUPP,
+                                      "Command not supported"));
+      break;
+  }
+  return true;
+}
+
+void FakeKernel::HandleGetScan(
+    const NL80211Packet& request,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  uint32_t interface_index;
+  if (!request.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index)) {
+    response->push_back(CreateError(request, EINVAL));
+    return;
+  }
+  for (const auto& bss : bss_cache_[interface_index]) {
+    unique_ptr<NL80211Packet> packet(new NL80211Packet(
+        kFamilyId,
+        NL80211_CMD_NEW_SCAN_RESULTS,
+        request.GetMessageSequence(),
+        request.GetPortId()));
+    packet->AddFlag(NLM_F_MULTI);
+    packet->AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
+                                               interface_index));
+    // A single SSID information element is enough for our parser.
+    vector<uint8_t> ie = {0, static_cast<uint8_t>(bss.ssid.size())};
+    ie.insert(ie.end(), bss.ssid.data(), bss.ssid.data() + bss.ssid.size());
+    NL80211NestedAttr bss_attr(NL80211_ATTR_BSS);
+    bss_attr.AddAttribute(NL80211Attr<MacAddress>(NL80211_BSS_BSSID,
+                                                  bss.bssid));
+    bss_attr.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_FREQUENCY,
+                                                bss.frequency));
+    bss_attr.AddAttribute(NL80211Attr<vector<uint8_t>>(
+        NL80211_BSS_INFORMATION_ELEMENTS, ie));
+    bss_attr.AddAttribute(NL80211Attr<uint64_t>(
+        NL80211_BSS_LAST_SEEN_BOOTTIME, bss.last_seen_boottime_ns));
+    bss_attr.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_SIGNAL_MBM,
+                                                kFakeSignalMbm));
+    bss_attr.AddAttribute(NL80211Attr<uint16_t>(NL80211_BSS_CAPABILITY,
+                                                kFakeCapability));
+    if (bss.associated) {
+      bss_attr.AddAttribute(NL80211Attr<uint32_t>(
+          NL80211_BSS_STATUS, NL80211_BSS_STATUS_ASSOCIATED));
+    }
+    packet->AddAttribute(bss_attr);
+    response->push_back(std::move(packet));
+  }
+}
+
+void FakeKernel::HandleGetStation(
+    const NL80211Packet& request,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  uint32_t interface_index;
+  MacAddress mac_address;
+  if (!request.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index) ||
+      !request.GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
+    response->push_back(CreateError(request, EINVAL));
+    return;
+  }
+  for (const auto& bss : bss_cache_[interface_index]) {
+    if (!bss.associated || bss.bssid != mac_address) {
+      continue;
+    }
+    unique_ptr<NL80211Packet> packet(new NL80211Packet(
+        kFamilyId,
+        NL80211_CMD_NEW_STATION,
+        request.GetMessageSequence(),
+        request.GetPortId()));
+    NL80211NestedAttr rate_info(NL80211_STA_INFO_TX_BITRATE);
+    rate_info.AddAttribute(NL80211Attr<uint32_t>(NL80211_RATE_INFO_BITRATE32,
+                                                 kFakeTxBitrate));
+    NL80211NestedAttr sta_info(NL80211_ATTR_STA_INFO);
+    sta_info.AddAttribute(NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_PACKETS,
+                                                kFakeTxPackets));
+    sta_info.AddAttribute(NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_FAILED,
+                                                0));
+    sta_info.AddAttribute(NL80211Attr<int8_t>(NL80211_STA_INFO_SIGNAL,
+                                              kFakeRssi));
+    sta_info.AddAttribute(rate_info);
+    packet->AddAttribute(sta_info);
+    response->push_back(std::move(packet));
+    return;
+  }
+  response->push_back(CreateError(request, ENOENT, "Station not found",
+                                  NL80211_ATTR_MAC));
+}
+
+void FakeKernel::HandleSetCqm(
+    const NL80211Packet& request,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  uint32_t interface_index;
+  NL80211NestedAttr cqm_attr(0);
+  uint32_t rssi_threshold;
+  uint32_t rssi_hysteresis;
+  if (!request.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index) ||
+      !request.GetAttribute(NL80211_ATTR_CQM, &cqm_attr) ||
+      !cqm_attr.GetAttributeValue(NL80211_ATTR_CQM_RSSI_THOLD,
+                                  &rssi_threshold) ||
+      !cqm_attr.GetAttributeValue(NL80211_ATTR_CQM_RSSI_HYST,
+                                  &rssi_hysteresis)) {
+    response->push_back(CreateError(request, EINVAL));
+    return;
+  }
+  cqm_config_[interface_index] = {static_cast<int32_t>(rssi_threshold),
+                                  rssi_hysteresis, -1};
+  response->push_back(CreateError(request, 0));
+}
+
+void FakeKernel::HandleStartSchedScan(
+    const NL80211Packet& request,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  uint32_t interface_index;
+  if (!request.GetAttributeValue(NL80211_ATTR_IFINDEX, &interface_index)) {
+    response->push_back(CreateError(request, EINVAL));
+    return;
+  }
+  if (IsSchedScanRunning(interface_index)) {
+    response->push_back(CreateError(request, EINPROGRESS));
+    return;
+  }
+  vector<SchedScan::Plan> plans;
+  NL80211NestedAttr plans_attr(0);
+  uint32_t interval_ms;
+  if (request.GetAttribute(NL80211_ATTR_SCHED_SCAN_PLANS, &plans_attr)) {
+    vector<NL80211NestedAttr> plan_attrs;
+    plans_attr.GetListOfNestedAttributes(&plan_attrs);
+    for (const auto& plan_attr : plan_attrs) {
+      // Scan plan intervals are in seconds.
+      uint32_t interval_s = 0;
+      uint32_t iterations = 0;
+      plan_attr.GetAttributeValue(NL80211_SCHED_SCAN_PLAN_INTERVAL,
+                                  &interval_s);
+      plan_attr.GetAttributeValue(NL80211_SCHED_SCAN_PLAN_ITERATIONS,
+                                  &iterations);
+      plans.push_back({interval_s * 1000, iterations});
+    }
+  } else if (request.GetAttributeValue(NL80211_ATTR_SCHED_SCAN_INTERVAL,
+                                       &interval_ms)) {
+    plans.push_back({interval_ms, 0});
+  }
+  if (plans.empty() || plans.back().iterations != 0) {
+    response->push_back(CreateError(request, EINVAL,
+                                    "Missing infinite scan plan"));
+    return;
+  }
+  for (const auto& plan : plans) {
+    if (plan.interval_ms == 0) {
+      response->push_back(CreateError(request, EINVAL,
+                                      "Zero scan plan interval"));
+      return;
+    }
+  }
+  SchedScan& sched_scan = sched_scans_[interface_index];
+  sched_scan.plans = plans;
+  sched_scan.plan_index = 0;
+  sched_scan.iterations_done = 0;
+  sched_scan.running = true;
+  sched_scan.generation++;
+  response->push_back(CreateError(request, 0));
+  // The first cycle starts right away.
+  PostSchedScanCycle(interface_index, 0);
+}
+
+void FakeKernel::PostSchedScanCycle(uint32_t interface_index,
+                                    int64_t delay_ms) {
+  if (event_loop_ == nullptr) {
+    return;
+  }
+  uint32_t generation = sched_scans_[interface_index].generation;
+  event_loop_->PostDelayedTask(
+      [this, interface_index, generation]() {
+        OnSchedScanCycle(interface_index, generation);
+      },
+      delay_ms);
+}
+
+void FakeKernel::OnSchedScanCycle(uint32_t interface_index,
+                                  uint32_t generation) {
+  SchedScan& sched_scan = sched_scans_[interface_index];
+  if (!sched_scan.running || sched_scan.generation != generation) {
+    return;
+  }
+  CompleteSchedScan(interface_index);
+  // Each iteration of a plan is a scan followed by the plan interval.
+  const SchedScan::Plan& plan = sched_scan.plans[sched_scan.plan_index];
+  uint32_t interval_ms = plan.interval_ms;
+  sched_scan.iterations_done++;
+  if (plan.iterations != 0 && sched_scan.iterations_done >= plan.iterations) {
+    sched_scan.plan_index++;
+    sched_scan.iterations_done = 0;
+  }
+  PostSchedScanCycle(interface_index, interval_ms);
+}
+
+NL80211Packet* FakeKernel::QueueEvent(uint8_t command,
+                                      uint32_t interface_index,
+                                      const MacAddress& mac_address) {
+  // Multicast events always come with sequence number and port id 0.
+  unique_ptr<NL80211Packet> event(
+      new NL80211Packet(kFamilyId, command, 0, 0));
+  event->AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
+                                            interface_index));
+  if (!mac_address.IsZero()) {
+    event->AddAttribute(NL80211Attr<MacAddress>(NL80211_ATTR_MAC,
+                                                mac_address));
+  }
+  if (command == NL80211_CMD_CONNECT) {
+    event->AddAttribute(NL80211Attr<uint16_t>(NL80211_ATTR_STATUS_CODE, 0));
+  }
+  pending_events_.push_back(std::move(event));
+  if (event_loop_ != nullptr && pending_events_.size() == 1) {
+    event_loop_->SetFileDescriptorReady(kEventSocketFd, EventLoop::kModeInput);
+  }
+  return pending_events_.back().get();
+}
+
+unique_ptr<NL80211Packet> FakeKernel::CreateError(const NL80211Packet& request,
+                                                  int error_code,
+                                                  const string& message,
+                                                  int attribute_id) const {
+  // Look up the offset of |attribute_id| among top level attributes.
+  const vector<uint8_t>& request_data = request.GetConstData();
+  uint32_t attribute_offset = 0;
+  size_t offset = NLMSG_HDRLEN + GENL_HDRLEN;
+  while (attribute_id != 0 && offset + NLA_HDRLEN <= request_data.size()) {
+    const nlattr* attribute =
+        reinterpret_cast<const nlattr*>(request_data.data() + offset);
+    if (attribute->nla_len < NLA_HDRLEN) {
+      break;
+    }
+    if (attribute->nla_type == attribute_id) {
+      attribute_offset = offset;
+      break;
+    }
+    offset += NLA_ALIGN(attribute->nla_len);
+  }
+
+  // The original request is never echoed back because the message is capped.
+  vector<uint8_t> data(NLMSG_HDRLEN + sizeof(nlmsgerr), 0);
+  nlmsgerr* error = reinterpret_cast<nlmsgerr*>(data.data() + NLMSG_HDRLEN);
+  error->error = -error_code;
+  memcpy(&error->msg, request_data.data(), sizeof(nlmsghdr));
+  uint16_t flags = kNetlinkFlagCapped;
+  if (!message.empty()) {
+    nlattr header;
+    header.nla_len = NLA_HDRLEN + message.size() + 1;
+    header.nla_type = kNetlinkErrorAttrMsg;
+    const uint8_t* header_bytes = reinterpret_cast<const uint8_t*>(&header);
+    data.insert(data.end(), header_bytes, header_bytes + NLA_HDRLEN);
+    data.insert(data.end(), message.begin(), message.end());
+    data.resize(NLA_ALIGN(data.size() + 1), 0);
+    flags |= kNetlinkFlagAckTlvs;
+  }
+  if (attribute_offset != 0) {
+    NL80211Attr<uint32_t> offset_attr(kNetlinkErrorAttrOffset,
+                                      attribute_offset);
+    const vector<uint8_t>& offset_data = offset_attr.GetConstData();
+    data.insert(data.end(), offset_data.begin(), offset_data.end());
+    flags |= kNetlinkFlagAckTlvs;
+  }
+
+  nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data.data());
+  nl_header->nlmsg_len = data.size();
+  nl_header->nlmsg_type = NLMSG_ERROR;
+  nl_header->nlmsg_flags = flags;
+  nl_header->nlmsg_seq = request.GetMessageSequence();
+  nl_header->nlmsg_pid = request.GetPortId();
+  return unique_ptr<NL80211Packet>(new NL80211Packet(data));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef WIFICOND_TEST_FAKE_KERNEL_H_
+#define WIFICOND_TEST_FAKE_KERNEL_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/mac_address.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/ssid.h"
+#include "wificond/tests/fake_event_loop.h"
+#include "wificond/tests/mock_netlink_manager.h"
+
+namespace android {
+namespace wificond {
+
+// A scripted stand-in for the nl80211 side of the kernel.
+// FakeKernel answers the requests sent through a MockNetlinkManager from a
+// small model of kernel state, and queues multicast events the way the event
+// socket would. Tests decide whether queued events are delivered, or dropped
+// with an overrun like a full socket receive buffer does.
+// Attached to a FakeEventLoop, FakeKernel runs scheduled scans on the
+// virtual clock of the loop, and delivers queued events the next time the
+// loop runs, the way the event socket becomes readable.
+class FakeKernel {
+ public:
+  static constexpr uint16_t kFamilyId = 14;
+  // The file descriptor of the event socket, as watched on the event loop.
+  static constexpr int kEventSocketFd = 1000;
+
+  explicit FakeKernel(MockNetlinkManager* netlink_manager);
+  FakeKernel(MockNetlinkManager* netlink_manager, FakeEventLoop* event_loop);
+  ~FakeKernel();
+
+  // Adds a BSS to the scan result cache of |interface_index|.
+  void AddBss(uint32_t interface_index,
+              const MacAddress& bssid,
+              const Ssid& ssid,
+              uint32_t frequency);
+  // Associates |interface_index| with a BSS previously added by |AddBss|,
+  // and queues a NL80211_CMD_CONNECT event.
+  void Connect(uint32_t interface_index, const MacAddress& bssid);
+  // Drops the association of |interface_index|, and queues a
+  // NL80211_CMD_DISCONNECT event.
+  void Disconnect(uint32_t interface_index);
+  // Stops refreshing a BSS previously added by |AddBss|. Like the kernel, the
+  // BSS stays in the scan result cache until a scan with
+  // NL80211_SCAN_FLAG_FLUSH completes.
+  void MoveOutOfRange(uint32_t interface_index, const MacAddress& bssid);
+  // Finishes the scan triggered on |interface_index|: refreshes the scan
+  // result cache, and queues a NL80211_CMD_NEW_SCAN_RESULTS event.
+  void CompleteScan(uint32_t interface_index);
+  bool IsScanRunning(uint32_t interface_index) const;
+  // Returns the NL80211_ATTR_SCAN_FLAGS of the last scan triggered on
+  // |interface_index|.
+  uint32_t GetLastScanFlags(uint32_t interface_index) const;
+
+  // Runs a cycle of the scheduled scan of |interface_index|: refreshes the
+  // scan result cache, and queues a NL80211_CMD_SCHED_SCAN_RESULTS event.
+  // With an event loop, cycles run on their own as time advances.
+  void CompleteSchedScan(uint32_t interface_index);
+  bool IsSchedScanRunning(uint32_t interface_index) const;
+  // Returns the number of scheduled scan cycles which ran on
+  // |interface_index|.
+  int GetNumSchedScanCycles(uint32_t interface_index) const;
+
+  // Reports a new RSSI for the connection of |interface_index|. Like
+  // mac80211, queues a NL80211_CMD_NOTIFY_CQM event when the RSSI crosses the
+  // threshold set by NL80211_CMD_SET_CQM by more than its hysteresis.
+  void SetRssi(uint32_t interface_index, int32_t rssi_dbm);
+  // Queues a NL80211_CMD_NOTIFY_CQM beacon loss event.
+  void LoseBeacons(uint32_t interface_index);
+  // Moves the associated BSS of |interface_index| to |frequency|, and queues
+  // a NL80211_CMD_CH_SWITCH_NOTIFY event.
+  void SwitchChannel(uint32_t interface_index, uint32_t frequency);
+  // Returns the RSSI threshold set by NL80211_CMD_SET_CQM, or 0 if RSSI
+  // monitoring is disabled.
+  int32_t GetCqmRssiThreshold(uint32_t interface_index) const;
+
+  size_t GetNumPendingEvents() const { return pending_events_.size(); }
+  // Delivers all queued events to the netlink manager in one datagram.
+  void DeliverEvents();
+  // Discards all queued events and reports ENOBUFS on the event socket.
+  void DropEventsWithOverrun();
+
+  // Returns the number of requests received with nl80211 |command|.
+  int GetNumRequests(uint8_t command) const;
+
+ private:
+  struct CqmConfig {
+    int32_t rssi_threshold_dbm;
+    uint32_t rssi_hysteresis_db;
+    // Last reported NL80211_ATTR_CQM_RSSI_THRESHOLD_EVENT, or -1.
+    int64_t last_rssi_event;
+  };
+
+  struct SchedScan {
+    struct Plan {
+      uint32_t interval_ms;
+      // 0 for the last plan, which runs until the scan is stopped.
+      uint32_t iterations;
+    };
+    std::vector<Plan> plans;
+    size_t plan_index;
+    uint32_t iterations_done;
+    int num_cycles;
+    bool running;
+    // Changes whenever a scheduled scan starts, so that the cycles of a
+    // stopped scan don't run.
+    uint32_t generation;
+  };
+
+  struct Bss {
+    MacAddress bssid;
+    Ssid ssid;
+    uint32_t frequency;
+    uint64_t last_seen_boottime_ns;
+    bool associated;
+    bool in_range;
+  };
+
+  bool HandleRequest(
+      const NL80211Packet& request,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  void HandleGetScan(
+      const NL80211Packet& request,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  void HandleGetStation(
+      const NL80211Packet& request,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  void HandleSetCqm(
+      const NL80211Packet& request,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  void HandleStartSchedScan(
+      const NL80211Packet& request,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  // Posts the next cycle of the scheduled scan of |interface_index| on the
+  // event loop, |delay_ms| from now.
+  void PostSchedScanCycle(uint32_t interface_index, int64_t delay_ms);
+  void OnSchedScanCycle(uint32_t interface_index, uint32_t generation);
+  // Marks the BSSs in range of |interface_index| as seen now.
+  void RefreshBssCache(uint32_t interface_index);
+  // Returns the queued event, so that callers can add attributes to it.
+  NL80211Packet* QueueEvent(uint8_t command,
+                            uint32_t interface_index,
+                            const MacAddress& mac_address);
+  // Creates a NLMSG_ERROR message the way kernel does for a socket with
+  // NETLINK_CAP_ACK and NETLINK_EXT_ACK enabled.
+  // |message| and the offset of attribute |attribute_id| in |request| are
+  // reported as extended ACK attributes if they are set.
+  std::unique_ptr<NL80211Packet> CreateError(const NL80211Packet& request,
+                                             int error_code,
+                                             const std::string& message = "",
+                                             int attribute_id = 0) const;
+
+  MockNetlinkManager* netlink_manager_;
+  FakeEventLoop* event_loop_;
+  uint32_t sequence_number_;
+  std::map<uint32_t, std::vector<Bss>> bss_cache_;
+  std::map<uint32_t, bool> scan_running_;
+  std::map<uint32_t, uint32_t> scan_flags_;
+  std::map<uint32_t, CqmConfig> cqm_config_;
+  std::map<uint32_t, SchedScan> sched_scans_;
+  std::map<uint8_t, int> num_requests_;
+  std::vector<std::unique_ptr<NL80211Packet>> pending_events_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeKernel);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TEST_FAKE_KERNEL_H_
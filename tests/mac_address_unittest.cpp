@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unordered_set>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/mac_address.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+const MacAddress kFakeMacAddress({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+const MacAddress kFakeMacAddress1({0x45, 0x54, 0xad, 0x67, 0x98, 0xf6});
+
+}  // namespace
+
+TEST(MacAddressTest, CanConvertFromAndToBytes) {
+  vector<uint8_t> bytes = {0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b};
+  MacAddress mac_address;
+  EXPECT_TRUE(mac_address.IsZero());
+  EXPECT_TRUE(MacAddress::FromBytes(bytes, &mac_address));
+  EXPECT_FALSE(mac_address.IsZero());
+  EXPECT_EQ(kFakeMacAddress, mac_address);
+  EXPECT_EQ(bytes, mac_address.ToBytes());
+}
+
+TEST(MacAddressTest, RejectsBytesOfWrongSize) {
+  MacAddress mac_address;
+  EXPECT_FALSE(MacAddress::FromBytes(vector<uint8_t>(), &mac_address));
+  EXPECT_FALSE(MacAddress::FromBytes(vector<uint8_t>(7, 0xff), &mac_address));
+  EXPECT_TRUE(mac_address.IsZero());
+}
+
+TEST(MacAddressTest, CanFormatAsString) {
+  EXPECT_EQ("12:ef:a1:2c:97:8b", kFakeMacAddress.ToString());
+  EXPECT_EQ("00:00:00:00:00:00", MacAddress().ToString());
+}
+
+TEST(MacAddressTest, CanBeUsedAsHashKey) {
+  std::unordered_set<MacAddress> addresses;
+  addresses.insert(kFakeMacAddress);
+  addresses.insert(kFakeMacAddress1);
+  addresses.insert(kFakeMacAddress);
+  EXPECT_EQ(2u, addresses.size());
+  EXPECT_EQ(1u, addresses.count(kFakeMacAddress1));
+  EXPECT_NE(kFakeMacAddress.Hash(), kFakeMacAddress1.Hash());
+}
+
+TEST(MacAddressTest, CanBeReadFromAttributes) {
+  NL80211Packet packet(kFakeFamilyId, NL80211_CMD_NEW_STATION, 1, 0);
+  packet.AddAttribute(NL80211Attr<MacAddress>(NL80211_ATTR_MAC,
+                                              kFakeMacAddress));
+  NL80211NestedAttr bss(NL80211_ATTR_BSS);
+  bss.AddAttribute(NL80211Attr<vector<uint8_t>>(NL80211_BSS_BSSID,
+                                                kFakeMacAddress1.ToBytes()));
+  packet.AddAttribute(bss);
+
+  MacAddress mac_address;
+  EXPECT_TRUE(packet.GetAttributeValue(NL80211_ATTR_MAC, &mac_address));
+  EXPECT_EQ(kFakeMacAddress, mac_address);
+  NL80211NestedAttr bss_copy(0);
+  ASSERT_TRUE(packet.GetAttribute(NL80211_ATTR_BSS, &bss_copy));
+  EXPECT_TRUE(bss_copy.GetAttributeValue(NL80211_BSS_BSSID, &mac_address));
+  EXPECT_EQ(kFakeMacAddress1, mac_address);
+}
+
+TEST(MacAddressTest, RejectsAttributesOfWrongSize) {
+  NL80211Packet packet(kFakeFamilyId, NL80211_CMD_NEW_STATION, 1, 0);
+  packet.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_ATTR_MAC, vector<uint8_t>({0x12, 0xef, 0xa1, 0x2c})));
+  MacAddress mac_address;
+  EXPECT_FALSE(packet.GetAttributeValue(NL80211_ATTR_MAC, &mac_address));
+  EXPECT_FALSE(packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &mac_address));
+  EXPECT_TRUE(mac_address.IsZero());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/metrics_registry.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int kNumThreads = 4;
+constexpr int kNumIncrementsPerThread = 10000;
+
+}  // namespace
+
+TEST(MetricsRegistryTest, SnapshotsRegisteredMetrics) {
+  MetricsRegistry registry;
+  CounterMetric counter("test.counter", &registry);
+  GaugeMetric gauge("test.gauge", &registry);
+  HistogramMetric histogram("test.histogram", &registry);
+
+  counter.Add(3);
+  counter.Increment();
+  gauge.Set(10);
+  gauge.Add(-3);
+  histogram.Record(1);
+  histogram.Record(100);
+
+  MetricsRegistry::Snapshot snapshot = registry.GetSnapshot();
+  EXPECT_EQ(4u, snapshot.counters["test.counter"]);
+  EXPECT_EQ(7, snapshot.gauges["test.gauge"]);
+  const auto& histogram_value = snapshot.histograms["test.histogram"];
+  EXPECT_EQ(2u, histogram_value.count);
+  EXPECT_EQ(101, histogram_value.sum);
+  EXPECT_EQ(1u, histogram_value.buckets.at(1));
+  EXPECT_EQ(1u, histogram_value.buckets.at(96));
+
+  std::stringstream ss;
+  registry.Dump(&ss);
+  EXPECT_NE(std::string::npos, ss.str().find("counter test.counter: 4"));
+  EXPECT_NE(std::string::npos, ss.str().find("gauge test.gauge: 7"));
+}
+
+TEST(MetricsRegistryTest, AddsUpMetricsOfTheSameName) {
+  MetricsRegistry registry;
+  GaugeMetric client_interfaces("test.interfaces", &registry);
+  GaugeMetric ap_interfaces("test.interfaces", &registry);
+  client_interfaces.Add(2);
+  ap_interfaces.Add(1);
+  EXPECT_EQ(3, registry.GetSnapshot().gauges["test.interfaces"]);
+}
+
+TEST(MetricsRegistryTest, CountsIncrementsOfAllThreads) {
+  MetricsRegistry registry;
+  CounterMetric counter("test.counter", &registry);
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&counter] {
+      for (int j = 0; j < kNumIncrementsPerThread; j++) {
+        counter.Increment();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(static_cast<uint64_t>(kNumThreads * kNumIncrementsPerThread),
+            counter.GetValue());
+}
+
+TEST(MetricsRegistryTest, UsesLogLinearBuckets) {
+  // Small values have a bucket each.
+  for (int64_t value = 0; value < HistogramMetric::kNumSubBuckets; value++) {
+    EXPECT_EQ(static_cast<size_t>(value),
+              HistogramMetric::GetBucketIndex(value));
+  }
+  EXPECT_EQ(0u, HistogramMetric::GetBucketIndex(-5));
+  // Every bucket starts at its lower bound, and ends right before the next
+  // one.
+  for (size_t i = 0; i < HistogramMetric::kNumBuckets; i++) {
+    int64_t lower_bound = HistogramMetric::GetBucketLowerBound(i);
+    EXPECT_EQ(i, HistogramMetric::GetBucketIndex(lower_bound));
+    if (i > 0) {
+      EXPECT_EQ(i - 1, HistogramMetric::GetBucketIndex(lower_bound - 1));
+    }
+  }
+  EXPECT_EQ(HistogramMetric::kNumBuckets - 1,
+            HistogramMetric::GetBucketIndex(
+                std::numeric_limits<int64_t>::max()));
+  // Buckets of 896 to 1023 and 1024 to 1279.
+  EXPECT_EQ(896, HistogramMetric::GetBucketLowerBound(
+      HistogramMetric::GetBucketIndex(1000)));
+  EXPECT_EQ(1024, HistogramMetric::GetBucketLowerBound(
+      HistogramMetric::GetBucketIndex(1100)));
+}
+
+TEST(MetricsRegistryTest, ComputesPercentilesOfHistograms) {
+  MetricsRegistry registry;
+  HistogramMetric histogram("test.latency", &registry);
+  for (int i = 0; i < 99; i++) {
+    histogram.Record(10);
+  }
+  histogram.Record(5000);
+
+  MetricsRegistry::Snapshot snapshot = registry.GetSnapshot();
+  EXPECT_EQ(10, snapshot.GetHistogramPercentile("test.latency", 50));
+  EXPECT_EQ(10, snapshot.GetHistogramPercentile("test.latency", 99));
+  EXPECT_EQ(4096, snapshot.GetHistogramPercentile("test.latency", 100));
+  EXPECT_EQ(0, snapshot.GetHistogramPercentile("test.unknown", 50));
+}
+
+}  // namespace wificond
+}  // namespace android
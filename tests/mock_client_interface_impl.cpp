@@ -28,7 +28,7 @@ namespace android {
 namespace wificond {
 
 const char kTestInterfaceName[] = "testwifi0";
-const uint8_t kTestInterfaceMacAddress[] = {0x10, 0x20, 0xfe, 0xae, 0x2d, 0xc2};
+const MacAddress kTestInterfaceMacAddress({0x10, 0x20, 0xfe, 0xae, 0x2d, 0xc2});
 const uint32_t kTestInterfaceIndex = 42;
 const uint32_t kTestWiphyIndex = 2;
 
@@ -36,18 +36,21 @@ MockClientInterfaceImpl::MockClientInterfaceImpl(
       android::wifi_system::InterfaceTool* interface_tool,
       android::wifi_system::SupplicantManager* supplicant_manager,
       NetlinkUtils* netlink_utils,
-      ScanUtils* scan_utils)
+      ScanUtils* scan_utils,
+      RegulatoryModel* regulatory_model,
+      EventLoop* event_loop)
     : ClientInterfaceImpl(
         kTestWiphyIndex,
         kTestInterfaceName,
         kTestInterfaceIndex,
-        std::vector<uint8_t>(
-            kTestInterfaceMacAddress,
-            kTestInterfaceMacAddress + arraysize(kTestInterfaceMacAddress)),
+        kTestInterfaceMacAddress,
         interface_tool,
         supplicant_manager,
         netlink_utils,
-        scan_utils) {}
+        scan_utils,
+        regulatory_model,
+        nullptr /* bss_cache */,
+        event_loop) {}
 
 }  // namespace wificond
 }  // namespace android
@@ -31,7 +31,9 @@ class MockClientInterfaceImpl : public ClientInterfaceImpl {
       android::wifi_system::InterfaceTool*,
       android::wifi_system::SupplicantManager*,
       NetlinkUtils*,
-      ScanUtils*);
+      ScanUtils*,
+      RegulatoryModel*,
+      EventLoop*);
   ~MockClientInterfaceImpl() override = default;
 
   MOCK_CONST_METHOD0(IsAssociated, bool());
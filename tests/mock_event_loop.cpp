@@ -14,30 +14,12 @@
  * limitations under the License.
  */
 
-#include "wificond/logging_utils.h"
-
-#include <iomanip>
-#include <vector>
-
-#include <android-base/macros.h>
-
-using std::string;
-using std::stringstream;
-using std::vector;
+#include "wificond/tests/mock_event_loop.h"
 
 namespace android {
 namespace wificond {
 
-string LoggingUtils::GetMacString(const vector<uint8_t>& mac_address) {
-  stringstream ss;
-  for (const uint8_t& b : mac_address) {
-    ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
-    if (&b != &mac_address.back()) {
-      ss << ":";
-    }
-  }
-  return ss.str();
-}
+MockEventLoop::MockEventLoop() {}
 
 }  // namespace wificond
 }  // namespace android
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef WIFICOND_TEST_MOCK_LINK_QUALITY_EVENT_H_
+#define WIFICOND_TEST_MOCK_LINK_QUALITY_EVENT_H_
+
+#include <gmock/gmock.h>
+
+#include "android/net/wifi/BnLinkQualityEvent.h"
+
+namespace android {
+namespace wificond {
+
+class MockLinkQualityEvent : public android::net::wifi::BnLinkQualityEvent {
+ public:
+  MockLinkQualityEvent();
+  ~MockLinkQualityEvent() override = default;
+
+  MOCK_METHOD1(OnRssiThresholdCrossed,
+               ::android::binder::Status(int32_t threshold_event));
+  MOCK_METHOD2(OnPacketLoss,
+               ::android::binder::Status(const std::vector<uint8_t>& bssid,
+                                         int32_t num_packets));
+  MOCK_METHOD0(OnBeaconLoss, ::android::binder::Status());
+  MOCK_METHOD2(OnChannelSwitch,
+               ::android::binder::Status(int32_t frequency,
+                                         int32_t channel_width));
+};  // class MockLinkQualityEvent
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TEST_MOCK_LINK_QUALITY_EVENT_H_
@@ -40,6 +40,11 @@ class MockNetlinkManager : public NetlinkManager {
       bool(const NL80211Packet&, std::vector<std::unique_ptr<const NL80211Packet>>*));
   MOCK_METHOD2(RegisterHandlerAndSendMessage,
       bool(const NL80211Packet&, std::function<void(std::unique_ptr<const NL80211Packet>)>));
+
+  // Let tests feed messages into the receive path as if they were read from
+  // the event socket.
+  using NetlinkManager::HandleReceivedMessages;
+  using NetlinkManager::OnEventOverrun;
 };  // class MockNetlinkManager
 
 }  // namespace wificond
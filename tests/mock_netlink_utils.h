@@ -35,6 +35,10 @@ class MockNetlinkUtils : public NetlinkUtils {
   MOCK_METHOD1(UnsubscribeStationEvent, void(uint32_t interface_index));
   MOCK_METHOD2(SetInterfaceMode,
                bool(uint32_t interface_index, InterfaceMode mode));
+  MOCK_METHOD3(SetCqmRssiConfig,
+               bool(uint32_t interface_index,
+                    int32_t rssi_threshold_dbm,
+                    uint32_t rssi_hysteresis_db));
   MOCK_METHOD2(SubscribeMlmeEvent,
                void(uint32_t interface_index,
                     MlmeEventHandler* handler));
@@ -44,6 +48,10 @@ class MockNetlinkUtils : public NetlinkUtils {
   MOCK_METHOD2(SubscribeStationEvent,
                void(uint32_t interface_index,
                     OnStationEventHandler handler));
+  MOCK_METHOD2(SubscribeEventOverrun,
+               void(uint32_t interface_index,
+                    OnEventOverrunHandler handler));
+  MOCK_METHOD1(UnsubscribeEventOverrun, void(uint32_t interface_index));
 
   MOCK_METHOD2(GetInterfaces,
                bool(uint32_t wiphy_index,
@@ -53,6 +61,21 @@ class MockNetlinkUtils : public NetlinkUtils {
                     BandInfo* band_info,
                     ScanCapabilities* scan_capabilities,
                     WiphyFeatures* wiphy_features));
+  MOCK_METHOD2(GetChannels,
+               bool(uint32_t wiphy_index,
+                    std::vector<ChannelInfo>* channels));
+  MOCK_METHOD4(CreateInterface,
+               bool(uint32_t wiphy_index,
+                    const std::string& name,
+                    uint32_t iftype,
+                    InterfaceInfo* out_interface));
+  MOCK_METHOD1(DeleteInterface, bool(uint32_t interface_index));
+  MOCK_METHOD2(GetInterfaceCombinations,
+               bool(uint32_t wiphy_index,
+                    std::vector<InterfaceCombination>* out_combinations));
+  MOCK_METHOD2(GetRegulatoryDomain,
+               bool(uint32_t wiphy_index,
+                    RegulatoryDomain* regulatory_domain));
 
 };  // class MockNetlinkUtils
 
@@ -33,6 +33,7 @@ class MockOffloadScanCallbackInterface : public OffloadScanCallbackInterface {
   MOCK_METHOD0(OnOffloadScanResult, void());
   MOCK_METHOD1(OnOffloadError,
                void(OffloadScanCallbackInterface::AsyncErrorReason));
+  MOCK_METHOD0(OnOffloadServiceAvailable, void());
 };
 
 }  // namespace wificond
@@ -36,6 +36,7 @@ class MockOffloadScanCallbackInterfaceImpl
   MOCK_METHOD0(OnOffloadScanResult, void());
   MOCK_METHOD1(OnOffloadError,
                void(OffloadScanCallbackInterface::AsyncErrorReason));
+  MOCK_METHOD0(OnOffloadServiceAvailable, void());
 };
 
 }  // namespace wificond
@@ -21,8 +21,9 @@ namespace wificond {
 
 MockOffloadScanManager::MockOffloadScanManager(
     std::weak_ptr<OffloadServiceUtils> service_utils,
-    std::shared_ptr<OffloadScanCallbackInterface> callback_interface)
-    : OffloadScanManager(service_utils, callback_interface) {}
+    std::shared_ptr<OffloadScanCallbackInterface> callback_interface,
+    EventLoop* event_loop)
+    : OffloadScanManager(service_utils, callback_interface, event_loop) {}
 
 }  // namespace wificond
 }  // namespace android
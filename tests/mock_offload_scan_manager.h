@@ -29,13 +29,14 @@ class MockOffloadScanManager : public OffloadScanManager {
  public:
   MockOffloadScanManager(
       std::weak_ptr<OffloadServiceUtils> service_utils,
-      std::shared_ptr<OffloadScanCallbackInterface> callback_interface);
+      std::shared_ptr<OffloadScanCallbackInterface> callback_interface,
+      EventLoop* event_loop);
   ~MockOffloadScanManager() override = default;
 
   MOCK_METHOD7(startScan,
                bool(uint32_t interval_ms, int32_t rssi_threshold,
-                    const std::vector<std::vector<uint8_t>>& scan_ssids,
-                    const std::vector<std::vector<uint8_t>>& match_ssids,
+                    const std::vector<Ssid>& scan_ssids,
+                    const std::vector<Ssid>& match_ssids,
                     const std::vector<uint8_t>& match_security,
                     const std::vector<uint32_t>& frequencies,
                     OffloadScanManager::ReasonCode* reason_code));
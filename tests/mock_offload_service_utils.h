@@ -44,11 +44,12 @@ class MockOffloadServiceUtils : public OffloadServiceUtils {
   MOCK_METHOD1(
       GetOffloadScanCallbackInterface,
       std::shared_ptr<OffloadScanCallbackInterfaceImpl>(ScannerImpl* scanner));
-  MOCK_METHOD2(GetOffloadScanManager,
+  MOCK_METHOD3(GetOffloadScanManager,
                std::shared_ptr<OffloadScanManager>(
                    std::weak_ptr<OffloadServiceUtils> service_utils,
                    std::shared_ptr<OffloadScanCallbackInterfaceImpl>
-                       callback_interface));
+                       callback_interface,
+                   EventLoop* event_loop));
 };
 
 }  // namespace wificond
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef WIFICOND_TEST_MOCK_PNO_SCAN_EVENT_H_
+#define WIFICOND_TEST_MOCK_PNO_SCAN_EVENT_H_
+
+#include <gmock/gmock.h>
+
+#include "android/net/wifi/BnPnoScanEvent.h"
+
+namespace android {
+namespace wificond {
+
+class MockPnoScanEvent : public android::net::wifi::BnPnoScanEvent {
+ public:
+  MockPnoScanEvent();
+  ~MockPnoScanEvent() override = default;
+
+  MOCK_METHOD0(OnPnoNetworkFound, ::android::binder::Status());
+  MOCK_METHOD0(OnPnoScanFailed, ::android::binder::Status());
+  MOCK_METHOD0(OnPnoScanOverOffloadStarted, ::android::binder::Status());
+  MOCK_METHOD1(OnPnoScanOverOffloadFailed,
+               ::android::binder::Status(int32_t reason));
+  MOCK_METHOD1(OnPnoNetworkFoundWithResults, ::android::binder::Status(
+      const std::vector<
+          ::com::android::server::wifi::wificond::NativeScanResult>&
+              scan_results));
+};  // class MockPnoScanEvent
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TEST_MOCK_PNO_SCAN_EVENT_H_
@@ -37,14 +37,17 @@ class MockScanUtils : public ScanUtils {
   MOCK_METHOD2(SubscribeScanResultNotification,void(
       uint32_t interface_index,
       OnScanResultsReadyHandler handler));
+  MOCK_METHOD2(SubscribeSchedScanResultNotification, void(
+      uint32_t interface_index,
+      OnSchedScanResultsReadyHandler handler));
   MOCK_METHOD2(GetScanResult, bool(
       uint32_t interface_index,
       std::vector<::com::android::server::wifi::wificond::NativeScanResult>* out_scan_results));
 
   MOCK_METHOD5(Scan, bool(
       uint32_t interface_index,
-      bool random_mac,
-      const std::vector<std::vector<uint8_t>>& ssids,
+      const SingleScanFlags& flags,
+      const std::vector<Ssid>& ssids,
       const std::vector<uint32_t>& freqs,
       int* error_code));
 
@@ -53,8 +56,8 @@ class MockScanUtils : public ScanUtils {
       const SchedScanIntervalSetting& interval_setting,
       int32_t rssi_threshold,
       bool request_random_mac,
-      const std::vector<std::vector<uint8_t>>& scan_ssids,
-      const std::vector<std::vector<uint8_t>>& match_ssids,
+      const std::vector<Ssid>& scan_ssids,
+      const std::vector<Ssid>& match_ssids,
       const std::vector<uint32_t>& freqs,
       int* error_code));
 
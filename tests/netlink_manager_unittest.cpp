@@ -15,11 +15,30 @@
  */
 
 #include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
 #include "wificond/looper_backed_event_loop.h"
 #include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/tests/fake_kernel.h"
+#include "wificond/tests/mock_netlink_manager.h"
+
+using testing::NiceMock;
+
+namespace {
+
+constexpr uint32_t kFakeInterfaceIndex = 12;
+const uint8_t kFakeMacAddress[] = {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+
+}  // namespace
 
 namespace android {
 namespace wificond {
@@ -41,5 +60,185 @@ TEST_F(NetlinkManagerTest, CanSetupNetlinkManagerInARowTest) {
   EXPECT_TRUE(netlink_manager.Start());
 }
 
+TEST_F(NetlinkManagerTest, SequenceNumbersAreUniqueAcrossThreads) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  constexpr int kNumThreads = 4;
+  constexpr int kNumPerThread = 1000;
+  std::vector<std::vector<uint32_t>> sequence_numbers(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&netlink_manager, &sequence_numbers, i]() {
+      for (int j = 0; j < kNumPerThread; j++) {
+        sequence_numbers[i].push_back(netlink_manager.GetSequenceNumber());
+      }
+    });
+  }
+  std::set<uint32_t> unique_sequence_numbers;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads[i].join();
+    unique_sequence_numbers.insert(sequence_numbers[i].begin(),
+                                   sequence_numbers[i].end());
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumThreads * kNumPerThread),
+            unique_sequence_numbers.size());
+  // 0 is the sequence number of kernel events.
+  EXPECT_EQ(0u, unique_sequence_numbers.count(0));
+}
+
+TEST_F(NetlinkManagerTest, InterfacesDoNotShareLocks) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  EXPECT_EQ(&netlink_manager.GetInterfaceLock(kFakeInterfaceIndex),
+            &netlink_manager.GetInterfaceLock(kFakeInterfaceIndex));
+  EXPECT_NE(&netlink_manager.GetInterfaceLock(kFakeInterfaceIndex),
+            &netlink_manager.GetInterfaceLock(kFakeInterfaceIndex + 1));
+}
+
+TEST(NetlinkManagerEventOverrunTest, NotifiesSubscribersOfDroppedEvents) {
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeKernel fake_kernel(&netlink_manager);
+  int num_overruns_if1 = 0;
+  int num_overruns_if2 = 0;
+  netlink_manager.SubscribeEventOverrun(
+      1, [&num_overruns_if1]() { num_overruns_if1++; });
+  netlink_manager.SubscribeEventOverrun(
+      2, [&num_overruns_if2]() { num_overruns_if2++; });
+
+  fake_kernel.CompleteScan(1);
+  fake_kernel.DeliverEvents();
+  EXPECT_EQ(0u, netlink_manager.GetEventOverrunCount());
+  EXPECT_EQ(0, num_overruns_if1);
+
+  fake_kernel.CompleteScan(1);
+  fake_kernel.DropEventsWithOverrun();
+  EXPECT_EQ(1u, netlink_manager.GetEventOverrunCount());
+  EXPECT_EQ(1, num_overruns_if1);
+  EXPECT_EQ(1, num_overruns_if2);
+
+  netlink_manager.UnsubscribeEventOverrun(2);
+  fake_kernel.DropEventsWithOverrun();
+  EXPECT_EQ(2u, netlink_manager.GetEventOverrunCount());
+  EXPECT_EQ(2, num_overruns_if1);
+  EXPECT_EQ(1, num_overruns_if2);
+}
+
+TEST(NetlinkManagerEventDispatchTest, NotifiesObserversAlongWithHandler) {
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeKernel fake_kernel(&netlink_manager);
+  int num_scan_results = 0;
+  netlink_manager.SubscribeScanResultNotification(
+      kFakeInterfaceIndex,
+      [&num_scan_results](uint32_t, bool, std::vector<Ssid>&,
+                          std::vector<uint32_t>&) {
+        num_scan_results++;
+      });
+
+  class CountingObserver : public NL80211EventObserver {
+   public:
+    void OnNL80211Event(const NL80211Event& event) override {
+      EXPECT_EQ(NL80211_CMD_NEW_SCAN_RESULTS, event.command);
+      EXPECT_EQ(kFakeInterfaceIndex, event.interface_index);
+      num_events++;
+    }
+    int num_events = 0;
+  };
+  CountingObserver metrics;
+  CountingObserver other_metrics;
+  NL80211EventSubscription metrics_subscription;
+  NL80211EventSubscription other_metrics_subscription;
+  netlink_manager.SubscribeEvent(NL80211_CMD_NEW_SCAN_RESULTS,
+                                 kFakeInterfaceIndex,
+                                 &metrics,
+                                 &metrics_subscription);
+  netlink_manager.SubscribeEvent(NL80211_CMD_NEW_SCAN_RESULTS,
+                                 NL80211EventDispatcher::kAnyInterface,
+                                 &other_metrics,
+                                 &other_metrics_subscription);
+
+  fake_kernel.CompleteScan(kFakeInterfaceIndex);
+  fake_kernel.DeliverEvents();
+  EXPECT_EQ(1, num_scan_results);
+  EXPECT_EQ(1, metrics.num_events);
+  EXPECT_EQ(1, other_metrics.num_events);
+
+  metrics_subscription.Unsubscribe();
+  fake_kernel.CompleteScan(kFakeInterfaceIndex);
+  fake_kernel.DeliverEvents();
+  EXPECT_EQ(2, num_scan_results);
+  EXPECT_EQ(1, metrics.num_events);
+  EXPECT_EQ(2, other_metrics.num_events);
+}
+
+TEST(NetlinkManagerEventDispatchTest, TracksEventLatency) {
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeKernel fake_kernel(&netlink_manager);
+  fake_kernel.CompleteScan(kFakeInterfaceIndex);
+  fake_kernel.DeliverEvents();
+
+  const EventLatencyTracker& tracker =
+      netlink_manager.GetEventLatencyTracker();
+  EXPECT_EQ(1u, tracker.GetHandlingHistogram(
+      NL80211_CMD_NEW_SCAN_RESULTS).num_events);
+  // Events fed without a kernel timestamp have no known queue wait.
+  EXPECT_EQ(0u, tracker.GetQueueWaitHistogram(
+      NL80211_CMD_NEW_SCAN_RESULTS).num_events);
+}
+
+TEST(NetlinkManagerExtendedAckTest, ReportsStructuredErrors) {
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeKernel fake_kernel(&netlink_manager);
+  NL80211Packet get_station(
+      netlink_manager.GetFamilyId(),
+      NL80211_CMD_GET_STATION,
+      netlink_manager.GetSequenceNumber(),
+      getpid());
+  get_station.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
+                                                 kFakeInterfaceIndex));
+  get_station.AddAttribute(NL80211Attr<std::vector<uint8_t>>(
+      NL80211_ATTR_MAC,
+      std::vector<uint8_t>(kFakeMacAddress,
+                           kFakeMacAddress + sizeof(kFakeMacAddress))));
+
+  NetlinkError error;
+  EXPECT_TRUE(netlink_manager.SendMessageAndGetAckOrError(get_station,
+                                                          &error));
+  EXPECT_EQ(ENOENT, error.error_code);
+  EXPECT_FALSE(error.message.empty());
+  EXPECT_NE(0u, error.attribute_offset);
+  EXPECT_EQ(NL80211_ATTR_MAC, error.attribute_type);
+  EXPECT_NE(std::string::npos, error.ToString().find(error.message));
+  // Kernel didn't echo our request back.
+  uint64_t request_payload_size =
+      get_station.GetConstData().size() - NLMSG_HDRLEN;
+  EXPECT_EQ(request_payload_size, netlink_manager.GetAckBytesSaved());
+
+  // The error code only version of the API keeps working.
+  int error_code;
+  EXPECT_TRUE(netlink_manager.SendMessageAndGetAckOrError(get_station,
+                                                          &error_code));
+  EXPECT_EQ(ENOENT, error_code);
+  EXPECT_EQ(2 * request_payload_size, netlink_manager.GetAckBytesSaved());
+}
+
+TEST(NetlinkManagerExtendedAckTest, AcksDoNotCountSavedBytes) {
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeKernel fake_kernel(&netlink_manager);
+  NL80211Packet trigger_scan(
+      netlink_manager.GetFamilyId(),
+      NL80211_CMD_TRIGGER_SCAN,
+      netlink_manager.GetSequenceNumber(),
+      getpid());
+  trigger_scan.AddFlag(NLM_F_ACK);
+  trigger_scan.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
+                                                  kFakeInterfaceIndex));
+
+  NetlinkError error;
+  EXPECT_TRUE(netlink_manager.SendMessageAndGetAckOrError(trigger_scan,
+                                                          &error));
+  EXPECT_EQ(0, error.error_code);
+  EXPECT_TRUE(error.message.empty());
+  EXPECT_EQ(0u, error.attribute_offset);
+  EXPECT_EQ(0u, netlink_manager.GetAckBytesSaved());
+}
+
 }  // namespace wificond
 }  // namespace android
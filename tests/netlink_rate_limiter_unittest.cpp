@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/netlink_rate_limiter.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakePortId = 12345;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeInterfaceIndex1 = 13;
+constexpr int64_t kNanoSecondsPerMilliSecond = 1000000;
+
+const NetlinkRateLimiter::Budget kTestBudget = {2, 100, 1000};
+
+}  // namespace
+
+class NetlinkRateLimiterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    rate_limiter_.SetBudget(NetlinkRateLimiter::kStationQuery, kTestBudget);
+    rate_limiter_.SetBudget(NetlinkRateLimiter::kScanTrigger,
+                            {1, 1000, 0});
+  }
+
+  NL80211Packet CreateRequest(uint8_t command, uint32_t interface_index) {
+    NL80211Packet request(kFakeFamilyId, command, sequence_number_++,
+                          kFakePortId);
+    request.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+    return request;
+  }
+
+  // Admits |request| and answers it with a single message.
+  void AdmitAndRespond(const NL80211Packet& request) {
+    vector<unique_ptr<const NL80211Packet>> response;
+    ASSERT_EQ(NetlinkRateLimiter::kAdmitted,
+              rate_limiter_.Admit(request, &response));
+    unique_ptr<NL80211Packet> packet(new NL80211Packet(
+        kFakeFamilyId, request.GetCommand(), request.GetMessageSequence(), 0));
+    packet->AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_GENERATION, generation_));
+    response.push_back(std::move(packet));
+    rate_limiter_.OnResponse(request, response);
+  }
+
+  void AdvanceTimeMs(int64_t ms) {
+    now_ns_ += ms * kNanoSecondsPerMilliSecond;
+  }
+
+  NL80211Packet CreateEvent(uint8_t command, uint32_t interface_index) {
+    NL80211Packet event(kFakeFamilyId, command, 0, 0);
+    if (interface_index != 0) {
+      event.AddAttribute(
+          NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+    }
+    return event;
+  }
+
+  int64_t now_ns_ = 0;
+  uint32_t sequence_number_ = 1;
+  uint32_t generation_ = 7;
+  NetlinkRateLimiter rate_limiter_{[this]() { return now_ns_; }};
+  // Requests are sent on behalf of a binder caller, unless a test says
+  // otherwise.
+  NetlinkRateLimiter::ScopedLimit limit_;
+};
+
+TEST_F(NetlinkRateLimiterTest, ClassifiesRequests) {
+  EXPECT_EQ(NetlinkRateLimiter::kScanTrigger,
+            NetlinkRateLimiter::GetRequestClass(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex)));
+  EXPECT_EQ(NetlinkRateLimiter::kStationQuery,
+            NetlinkRateLimiter::GetRequestClass(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex)));
+  EXPECT_EQ(NetlinkRateLimiter::kScanResultQuery,
+            NetlinkRateLimiter::GetRequestClass(
+                CreateRequest(NL80211_CMD_GET_SCAN, kFakeInterfaceIndex)));
+  EXPECT_EQ(NetlinkRateLimiter::kDeviceQuery,
+            NetlinkRateLimiter::GetRequestClass(
+                CreateRequest(NL80211_CMD_GET_WIPHY, kFakeInterfaceIndex)));
+  EXPECT_EQ(NetlinkRateLimiter::kUnlimited,
+            NetlinkRateLimiter::GetRequestClass(
+                CreateRequest(NL80211_CMD_ABORT_SCAN, kFakeInterfaceIndex)));
+  EXPECT_EQ(NetlinkRateLimiter::kUnlimited,
+            NetlinkRateLimiter::GetRequestClass(CreateRequest(
+                NL80211_CMD_START_SCHED_SCAN, kFakeInterfaceIndex)));
+  NL80211Packet get_family(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1, kFakePortId);
+  EXPECT_EQ(NetlinkRateLimiter::kUnlimited,
+            NetlinkRateLimiter::GetRequestClass(get_family));
+}
+
+TEST_F(NetlinkRateLimiterTest, RejectsScanTriggersOverBudget) {
+  vector<unique_ptr<const NL80211Packet>> response;
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                &response));
+  // Scan triggers are never coalesced.
+  NL80211Packet request =
+      CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex);
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(request, &response));
+  // The request is refused as if kernel was busy.
+  ASSERT_EQ(1u, response.size());
+  EXPECT_EQ(NLMSG_ERROR, response[0]->GetMessageType());
+  EXPECT_EQ(EBUSY, response[0]->GetErrorCode());
+  EXPECT_EQ(request.GetMessageSequence(), response[0]->GetMessageSequence());
+
+  AdvanceTimeMs(1000);
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                &response));
+
+  const NetlinkRateLimiter::Stats& stats =
+      rate_limiter_.GetStats(NetlinkRateLimiter::kScanTrigger);
+  EXPECT_EQ(2u, stats.admitted);
+  EXPECT_EQ(0u, stats.coalesced);
+  EXPECT_EQ(1u, stats.rejected);
+}
+
+TEST_F(NetlinkRateLimiterTest, AdmitsScheduledScansAfterBurstOfScans) {
+  vector<unique_ptr<const NL80211Packet>> response;
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                &response));
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                &response));
+  // PNO must start when the screen turns off, whatever the single scans.
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_START_SCHED_SCAN,
+                              kFakeInterfaceIndex),
+                &response));
+}
+
+TEST_F(NetlinkRateLimiterTest, CoalescesIdenticalQueriesOverBudget) {
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+
+  NL80211Packet request =
+      CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex);
+  vector<unique_ptr<const NL80211Packet>> response;
+  EXPECT_EQ(NetlinkRateLimiter::kCoalesced,
+            rate_limiter_.Admit(request, &response));
+  ASSERT_EQ(1u, response.size());
+  EXPECT_EQ(NL80211_CMD_GET_STATION, response[0]->GetCommand());
+  EXPECT_EQ(request.GetMessageSequence(), response[0]->GetMessageSequence());
+  uint32_t generation;
+  EXPECT_TRUE(response[0]->GetAttributeValue(NL80211_ATTR_GENERATION,
+                                             &generation));
+  EXPECT_EQ(generation_, generation);
+
+  // A query with different attributes can't be coalesced.
+  response.clear();
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex1),
+                &response));
+  ASSERT_EQ(1u, response.size());
+  EXPECT_EQ(NLMSG_ERROR, response[0]->GetMessageType());
+
+  const NetlinkRateLimiter::Stats& stats =
+      rate_limiter_.GetStats(NetlinkRateLimiter::kStationQuery);
+  EXPECT_EQ(2u, stats.admitted);
+  EXPECT_EQ(1u, stats.coalesced);
+  EXPECT_EQ(1u, stats.rejected);
+}
+
+TEST_F(NetlinkRateLimiterTest, DoesNotCoalesceStaleResponses) {
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  // Keep the bucket empty, but let the cached response expire.
+  vector<unique_ptr<const NL80211Packet>> response;
+  for (int i = 0; i < 11; i++) {
+    AdvanceTimeMs(kTestBudget.refill_interval_ms);
+    ASSERT_NE(NetlinkRateLimiter::kRejected,
+              rate_limiter_.Admit(
+                  CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex1),
+                  &response));
+  }
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+}
+
+TEST_F(NetlinkRateLimiterTest, DoesNotLimitInternalRequests) {
+  NetlinkRateLimiter::ScopedLimit no_limit(false);
+  vector<unique_ptr<const NL80211Packet>> response;
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+              rate_limiter_.Admit(
+                  CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                  &response));
+  }
+  const NetlinkRateLimiter::Stats& stats =
+      rate_limiter_.GetStats(NetlinkRateLimiter::kScanTrigger);
+  EXPECT_EQ(0u, stats.admitted);
+  EXPECT_EQ(5u, stats.bypassed);
+}
+
+TEST_F(NetlinkRateLimiterTest, LimitsRequestsOnlyInsideScopedLimit) {
+  vector<unique_ptr<const NL80211Packet>> response;
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                &response));
+  {
+    NetlinkRateLimiter::ScopedLimit no_limit(false);
+    // Internal requests don't take tokens either.
+    EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+              rate_limiter_.Admit(
+                  CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                  &response));
+  }
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex),
+                &response));
+}
+
+TEST_F(NetlinkRateLimiterTest, CoalescesOntoResponsesToInternalRequests) {
+  {
+    NetlinkRateLimiter::ScopedLimit no_limit(false);
+    AdmitAndRespond(
+        CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  }
+  vector<unique_ptr<const NL80211Packet>> response;
+  for (uint32_t i = 0; i < kTestBudget.burst; i++) {
+    ASSERT_EQ(NetlinkRateLimiter::kAdmitted,
+              rate_limiter_.Admit(
+                  CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex1),
+                  &response));
+  }
+  response.clear();
+  EXPECT_EQ(NetlinkRateLimiter::kCoalesced,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+  ASSERT_EQ(1u, response.size());
+  EXPECT_EQ(NL80211_CMD_GET_STATION, response[0]->GetCommand());
+}
+
+TEST_F(NetlinkRateLimiterTest, KeepsResponsesAcrossOtherCommands) {
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+
+  vector<unique_ptr<const NL80211Packet>> response;
+  // Kernel reports what this changes with events.
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_SET_CQM, kFakeInterfaceIndex),
+                &response));
+  EXPECT_EQ(NetlinkRateLimiter::kCoalesced,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+}
+
+TEST_F(NetlinkRateLimiterTest, InvalidatesResponsesAffectedByEvents) {
+  rate_limiter_.SetBudget(NetlinkRateLimiter::kScanResultQuery, kTestBudget);
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  AdmitAndRespond(
+      CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex1));
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_SCAN, kFakeInterfaceIndex));
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_SCAN, kFakeInterfaceIndex1));
+
+  // New scan results don't change the station, and only concern one
+  // interface.
+  rate_limiter_.OnEvent(
+      CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex));
+  vector<unique_ptr<const NL80211Packet>> response;
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_SCAN, kFakeInterfaceIndex),
+                &response));
+  EXPECT_EQ(NetlinkRateLimiter::kCoalesced,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_SCAN, kFakeInterfaceIndex1),
+                &response));
+  EXPECT_EQ(NetlinkRateLimiter::kCoalesced,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+
+  rate_limiter_.OnEvent(
+      CreateEvent(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex1));
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex1),
+                &response));
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_SCAN, kFakeInterfaceIndex1),
+                &response));
+  EXPECT_EQ(NetlinkRateLimiter::kCoalesced,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+}
+
+TEST_F(NetlinkRateLimiterTest, InvalidatesAllInterfacesOnEventsWithoutOne) {
+  rate_limiter_.SetBudget(NetlinkRateLimiter::kDeviceQuery, kTestBudget);
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_WIPHY, kFakeInterfaceIndex));
+  AdmitAndRespond(CreateRequest(NL80211_CMD_GET_WIPHY, kFakeInterfaceIndex));
+
+  rate_limiter_.OnEvent(CreateEvent(NL80211_CMD_REG_CHANGE, 0));
+  vector<unique_ptr<const NL80211Packet>> response;
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_WIPHY, kFakeInterfaceIndex),
+                &response));
+}
+
+TEST_F(NetlinkRateLimiterTest, RefillsUpToBurst) {
+  vector<unique_ptr<const NL80211Packet>> response;
+  AdvanceTimeMs(10 * kTestBudget.refill_interval_ms);
+  for (uint32_t i = 0; i < kTestBudget.burst; i++) {
+    EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+              rate_limiter_.Admit(
+                  CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                  &response));
+  }
+  EXPECT_EQ(NetlinkRateLimiter::kRejected,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+  AdvanceTimeMs(kTestBudget.refill_interval_ms);
+  EXPECT_EQ(NetlinkRateLimiter::kAdmitted,
+            rate_limiter_.Admit(
+                CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex),
+                &response));
+}
+
+}  // namespace wificond
+}  // namespace android
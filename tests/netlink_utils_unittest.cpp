@@ -54,12 +54,14 @@ constexpr uint32_t kFakeFrequency5 = 5400;
 constexpr uint32_t kFakeFrequency6 = 5600;
 constexpr uint32_t kFakeSequenceNumber = 162;
 constexpr uint16_t kFakeWiphyIndex = 8;
+constexpr uint16_t kFakeWiphyIndex1 = 9;
 constexpr int kFakeErrorCode = EIO;
 const char kFakeInterfaceName[] = "testif0";
 const uint32_t kFakeInterfaceIndex = 34;
 const uint32_t kFakeInterfaceIndex1 = 36;
 const uint8_t kFakeInterfaceMacAddress[] = {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
 const uint8_t kFakeInterfaceMacAddress1[] = {0x05, 0x04, 0xef, 0x27, 0x12, 0xff};
+const char kFakeVirtualInterfaceName[] = "wlan1";
 
 // Currently, control messages are only created by the kernel and sent to us.
 // Therefore NL80211Packet doesn't have corresponding constructor.
@@ -154,6 +156,115 @@ void AppendWiphyFeaturesAttributes(NL80211Packet* packet) {
   packet->AddAttribute(NL80211Attr<uint32_t>(
       NL80211_ATTR_FEATURE_FLAGS,
       NL80211_FEATURE_SCAN_RANDOM_MAC_ADDR));
+  vector<uint8_t> ext_feature_flags(NUM_NL80211_EXT_FEATURES / 8 + 1, 0);
+  ext_feature_flags[kExtFeatureLowSpanScan / 8] |=
+      1 << (kExtFeatureLowSpanScan % 8);
+  packet->AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_ATTR_EXT_FEATURES, ext_feature_flags));
+}
+
+// Creates a NL80211_ATTR_INTERFACE_COMBINATIONS attribute with a single
+// combination, which allows one client and one AP interface on one channel.
+NL80211NestedAttr CreateInterfaceCombinationsAttribute() {
+  NL80211NestedAttr station_types(NL80211_IFACE_LIMIT_TYPES);
+  station_types.AddAttribute(NL80211NestedAttr(NL80211_IFTYPE_STATION));
+  NL80211NestedAttr station_limit(1);
+  station_limit.AddAttribute(NL80211Attr<uint32_t>(NL80211_IFACE_LIMIT_MAX, 1));
+  station_limit.AddAttribute(station_types);
+
+  NL80211NestedAttr ap_types(NL80211_IFACE_LIMIT_TYPES);
+  ap_types.AddAttribute(NL80211NestedAttr(NL80211_IFTYPE_AP));
+  ap_types.AddAttribute(NL80211NestedAttr(NL80211_IFTYPE_P2P_GO));
+  NL80211NestedAttr ap_limit(2);
+  ap_limit.AddAttribute(NL80211Attr<uint32_t>(NL80211_IFACE_LIMIT_MAX, 1));
+  ap_limit.AddAttribute(ap_types);
+
+  NL80211NestedAttr limits(NL80211_IFACE_COMB_LIMITS);
+  limits.AddAttribute(station_limit);
+  limits.AddAttribute(ap_limit);
+  NL80211NestedAttr combination(1);
+  combination.AddAttribute(limits);
+  combination.AddAttribute(NL80211Attr<uint32_t>(NL80211_IFACE_COMB_MAXNUM, 2));
+  combination.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_IFACE_COMB_NUM_CHANNELS, 1));
+  NL80211NestedAttr combinations(NL80211_ATTR_INTERFACE_COMBINATIONS);
+  combinations.AddAttribute(combination);
+  return combinations;
+}
+
+// Creates a NL80211_ATTR_WIPHY_BANDS attribute with a single band, carrying
+// a part of the frequencies of this band, like a split wiphy dump does.
+NL80211NestedAttr CreateSplitBandsAttribute(
+    uint16_t band_index,
+    const vector<uint32_t>& frequencies,
+    const vector<uint32_t>& dfs_frequencies) {
+  NL80211NestedAttr freqs_attr(NL80211_BAND_ATTR_FREQS);
+  uint16_t freq_index = 0;
+  for (uint32_t frequency : frequencies) {
+    NL80211NestedAttr freq(freq_index++);
+    freq.AddAttribute(NL80211Attr<uint32_t>(NL80211_FREQUENCY_ATTR_FREQ,
+                                            frequency));
+    freqs_attr.AddAttribute(freq);
+  }
+  for (uint32_t frequency : dfs_frequencies) {
+    NL80211NestedAttr freq(freq_index++);
+    freq.AddAttribute(NL80211Attr<uint32_t>(NL80211_FREQUENCY_ATTR_FREQ,
+                                            frequency));
+    freq.AddAttribute(NL80211Attr<uint32_t>(NL80211_FREQUENCY_ATTR_DFS_STATE,
+                                            NL80211_DFS_USABLE));
+    freqs_attr.AddAttribute(freq);
+  }
+  NL80211NestedAttr band_attr(band_index);
+  band_attr.AddAttribute(freqs_attr);
+  NL80211NestedAttr bands_attr(NL80211_ATTR_WIPHY_BANDS);
+  bands_attr.AddAttribute(band_attr);
+  return bands_attr;
+}
+
+// Creates the multipart response of a split wiphy dump for |wiphy_index|.
+// Scan capabilities, bands and feature flags are spread over the messages,
+// and the frequencies of the 5GHz band are split into two messages.
+vector<NL80211Packet> CreateSplitWiphyDump(uint32_t wiphy_index,
+                                           uint16_t family_id,
+                                           uint32_t sequence_number) {
+  vector<NL80211Packet> messages;
+  for (int i = 0; i < 5; i++) {
+    NL80211Packet new_wiphy(
+        family_id,
+        NL80211_CMD_NEW_WIPHY,
+        sequence_number,
+        getpid());
+    new_wiphy.AddFlag(NLM_F_MULTI);
+    new_wiphy.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                                 wiphy_index));
+    messages.push_back(new_wiphy);
+  }
+  AppendScanCapabilitiesAttributes(&messages[0], false);
+  messages[1].AddAttribute(CreateSplitBandsAttribute(
+      NL80211_BAND_2GHZ,
+      {kFakeFrequency1, kFakeFrequency2, kFakeFrequency3}, {}));
+  messages[2].AddAttribute(CreateSplitBandsAttribute(
+      NL80211_BAND_5GHZ, {kFakeFrequency4}, {}));
+  messages[3].AddAttribute(CreateSplitBandsAttribute(
+      NL80211_BAND_5GHZ, {kFakeFrequency5}, {kFakeFrequency6}));
+  messages[4].AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS,
+      kFakeMaxNumScanPlans));
+  messages[4].AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL,
+      kFakeMaxScanPlanIntervals));
+  messages[4].AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_MAX_SCAN_PLAN_ITERATIONS,
+      kFakeMaxScanPlanIterations));
+  AppendWiphyFeaturesAttributes(&messages[4]);
+  return messages;
+}
+
+MATCHER(IsSplitWiphyDumpRequest,
+        "Check if the request is a split NL80211_CMD_GET_WIPHY dump") {
+  return arg.GetCommand() == NL80211_CMD_GET_WIPHY &&
+         arg.IsDump() &&
+         arg.HasAttribute(NL80211_ATTR_SPLIT_WIPHY_DUMP);
 }
 
 void VerifyScanCapabilities(const ScanCapabilities& scan_capabilities,
@@ -191,6 +302,10 @@ void VerifyBandInfo(const BandInfo& band_info) {
 void VerifyWiphyFeatures(const WiphyFeatures& wiphy_features) {
   EXPECT_TRUE(wiphy_features.supports_random_mac_oneshot_scan);
   EXPECT_FALSE(wiphy_features.supports_random_mac_sched_scan);
+  EXPECT_FALSE(wiphy_features.supports_low_priority_oneshot_scan);
+  EXPECT_TRUE(wiphy_features.supports_low_span_oneshot_scan);
+  EXPECT_FALSE(wiphy_features.supports_low_power_oneshot_scan);
+  EXPECT_FALSE(wiphy_features.supports_high_accuracy_oneshot_scan);
 }
 
 }  // namespace
@@ -273,6 +388,26 @@ TEST_F(NetlinkUtilsTest, CanHandleSetIntrerfaceModeError) {
                                                 NetlinkUtils::STATION_MODE));
 }
 
+TEST_F(NetlinkUtilsTest, CanSetCqmRssiConfig) {
+  // Mock a ACK response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageAck()};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  EXPECT_TRUE(netlink_utils_->SetCqmRssiConfig(kFakeInterfaceIndex, -70, 2));
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleSetCqmRssiConfigError) {
+  // Mock an error response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageError(kFakeErrorCode)};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  EXPECT_FALSE(netlink_utils_->SetCqmRssiConfig(kFakeInterfaceIndex, -70, 2));
+}
+
 TEST_F(NetlinkUtilsTest, CanGetInterfaces) {
   NL80211Packet new_interface(
       netlink_manager_->GetFamilyId(),
@@ -304,7 +439,7 @@ TEST_F(NetlinkUtilsTest, CanGetInterfaces) {
   EXPECT_TRUE(interfaces.size() == 1);
   EXPECT_EQ(kFakeInterfaceIndex, interfaces[0].index);
   EXPECT_EQ(string(kFakeInterfaceName), interfaces[0].name);
-  EXPECT_EQ(if_mac_addr, interfaces[0].mac_address);
+  EXPECT_EQ(if_mac_addr, interfaces[0].mac_address.ToBytes());
 }
 
 TEST_F(NetlinkUtilsTest, SkipsPseudoDevicesWhenGetInterfaces) {
@@ -346,7 +481,7 @@ TEST_F(NetlinkUtilsTest, SkipsPseudoDevicesWhenGetInterfaces) {
   EXPECT_TRUE(interfaces.size() == 1);
   EXPECT_EQ(kFakeInterfaceIndex, interfaces[0].index);
   EXPECT_EQ(string(kFakeInterfaceName), interfaces[0].name);
-  EXPECT_EQ(if_mac_addr, interfaces[0].mac_address);
+  EXPECT_EQ(if_mac_addr, interfaces[0].mac_address.ToBytes());
 }
 
 TEST_F(NetlinkUtilsTest, HandleP2p0WhenGetInterfaces) {
@@ -400,11 +535,11 @@ TEST_F(NetlinkUtilsTest, HandleP2p0WhenGetInterfaces) {
 
   EXPECT_EQ(kFakeInterfaceIndex1, interfaces[0].index);
   EXPECT_EQ(string("p2p0"), interfaces[0].name);
-  EXPECT_EQ(if_mac_addr_p2p, interfaces[0].mac_address);
+  EXPECT_EQ(if_mac_addr_p2p, interfaces[0].mac_address.ToBytes());
 
   EXPECT_EQ(kFakeInterfaceIndex, interfaces[1].index);
   EXPECT_EQ(string(kFakeInterfaceName), interfaces[1].name);
-  EXPECT_EQ(if_mac_addr, interfaces[1].mac_address);
+  EXPECT_EQ(if_mac_addr, interfaces[1].mac_address.ToBytes());
 }
 
 TEST_F(NetlinkUtilsTest, CanHandleGetInterfacesError) {
@@ -478,6 +613,128 @@ TEST_F(NetlinkUtilsTest, CanGetWiphyInfoScanPlanNotSupported) {
   VerifyWiphyFeatures(wiphy_features);
 }
 
+TEST_F(NetlinkUtilsTest, CanGetWiphyInfoFromSplitDump) {
+  vector<NL80211Packet> response = CreateSplitWiphyDump(
+      kFakeWiphyIndex,
+      netlink_manager_->GetFamilyId(),
+      netlink_manager_->GetSequenceNumber());
+
+  EXPECT_CALL(*netlink_manager_,
+              SendMessageAndGetResponses(IsSplitWiphyDumpRequest(), _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  BandInfo band_info;
+  ScanCapabilities scan_capabilities;
+  WiphyFeatures wiphy_features;
+  EXPECT_TRUE(netlink_utils_->GetWiphyInfo(kFakeWiphyIndex,
+                                           &band_info,
+                                           &scan_capabilities,
+                                           &wiphy_features));
+  VerifyBandInfo(band_info);
+  VerifyScanCapabilities(scan_capabilities, true);
+  VerifyWiphyFeatures(wiphy_features);
+}
+
+TEST_F(NetlinkUtilsTest, IgnoresOtherWiphysInSplitDump) {
+  // Kernels which don't filter the dump by wiphy index report all wiphys.
+  vector<NL80211Packet> response = CreateSplitWiphyDump(
+      kFakeWiphyIndex1,
+      netlink_manager_->GetFamilyId(),
+      netlink_manager_->GetSequenceNumber());
+  vector<NL80211Packet> response_wiphy = CreateSplitWiphyDump(
+      kFakeWiphyIndex,
+      netlink_manager_->GetFamilyId(),
+      netlink_manager_->GetSequenceNumber());
+  response.insert(response.end(), response_wiphy.begin(), response_wiphy.end());
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  BandInfo band_info;
+  ScanCapabilities scan_capabilities;
+  WiphyFeatures wiphy_features;
+  EXPECT_TRUE(netlink_utils_->GetWiphyInfo(kFakeWiphyIndex,
+                                           &band_info,
+                                           &scan_capabilities,
+                                           &wiphy_features));
+  // Frequencies are not reported twice.
+  VerifyBandInfo(band_info);
+  VerifyScanCapabilities(scan_capabilities, true);
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleIncompleteSplitWiphyDump) {
+  vector<NL80211Packet> response = CreateSplitWiphyDump(
+      kFakeWiphyIndex,
+      netlink_manager_->GetFamilyId(),
+      netlink_manager_->GetSequenceNumber());
+  // Drop the message with feature flags.
+  response.pop_back();
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  BandInfo band_info;
+  ScanCapabilities scan_capabilities;
+  WiphyFeatures wiphy_features;
+  EXPECT_FALSE(netlink_utils_->GetWiphyInfo(kFakeWiphyIndex,
+                                            &band_info,
+                                            &scan_capabilities,
+                                            &wiphy_features));
+}
+
+TEST_F(NetlinkUtilsTest, CanGetRegulatoryDomain) {
+  NL80211Packet get_reg(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_REG,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  get_reg.AddAttribute(NL80211Attr<std::string>(NL80211_ATTR_REG_ALPHA2, "US"));
+  get_reg.AddAttribute(NL80211Attr<uint8_t>(NL80211_ATTR_DFS_REGION,
+                                            NL80211_DFS_FCC));
+  NL80211NestedAttr rule(1);
+  rule.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_START,
+                                          5250000));
+  rule.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_END,
+                                          5330000));
+  rule.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_MAX_BW,
+                                          80000));
+  rule.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_POWER_RULE_MAX_EIRP,
+                                          2300));
+  rule.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_REG_RULE_FLAGS,
+                                          NL80211_RRF_DFS));
+  NL80211NestedAttr rules(NL80211_ATTR_REG_RULES);
+  rules.AddAttribute(rule);
+  get_reg.AddAttribute(rules);
+  vector<NL80211Packet> response = {get_reg};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  RegulatoryDomain regulatory_domain;
+  EXPECT_TRUE(netlink_utils_->GetRegulatoryDomain(kFakeWiphyIndex,
+                                                  &regulatory_domain));
+  EXPECT_EQ("US", regulatory_domain.country_code);
+  EXPECT_EQ(NL80211_DFS_FCC, regulatory_domain.dfs_region);
+  ASSERT_EQ(1u, regulatory_domain.rules.size());
+  EXPECT_EQ(5250000u, regulatory_domain.rules[0].start_frequency_khz);
+  EXPECT_EQ(5330000u, regulatory_domain.rules[0].end_frequency_khz);
+  EXPECT_EQ(80000u, regulatory_domain.rules[0].max_bandwidth_khz);
+  EXPECT_EQ(2300u, regulatory_domain.rules[0].max_eirp_mbm);
+  EXPECT_EQ(static_cast<uint32_t>(NL80211_RRF_DFS),
+            regulatory_domain.rules[0].flags);
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleGetRegulatoryDomainError) {
+  // Mock an error response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageError(kFakeErrorCode)};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  RegulatoryDomain regulatory_domain;
+  EXPECT_FALSE(netlink_utils_->GetRegulatoryDomain(kFakeWiphyIndex,
+                                                   &regulatory_domain));
+}
 
 TEST_F(NetlinkUtilsTest, CanHandleGetWiphyInfoError) {
   // Mock an error response from kernel.
@@ -495,5 +752,105 @@ TEST_F(NetlinkUtilsTest, CanHandleGetWiphyInfoError) {
                                            &wiphy_features));
 }
 
+TEST_F(NetlinkUtilsTest, CanCreateInterface) {
+  NL80211Packet new_interface(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_INTERFACE,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_interface.AddAttribute(NL80211Attr<string>(
+      NL80211_ATTR_IFNAME, string(kFakeVirtualInterfaceName)));
+  new_interface.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
+                                                   kFakeInterfaceIndex1));
+  vector<uint8_t> if_mac_addr(
+      kFakeInterfaceMacAddress1,
+      kFakeInterfaceMacAddress1 + sizeof(kFakeInterfaceMacAddress1));
+  new_interface.AddAttribute(
+      NL80211Attr<vector<uint8_t>>(NL80211_ATTR_MAC, if_mac_addr));
+  vector<NL80211Packet> response = {new_interface};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  InterfaceInfo interface;
+  EXPECT_TRUE(netlink_utils_->CreateInterface(kFakeWiphyIndex,
+                                              kFakeVirtualInterfaceName,
+                                              NL80211_IFTYPE_AP,
+                                              &interface));
+  EXPECT_EQ(kFakeInterfaceIndex1, interface.index);
+  EXPECT_EQ(string(kFakeVirtualInterfaceName), interface.name);
+  EXPECT_EQ(if_mac_addr, interface.mac_address.ToBytes());
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleCreateInterfaceError) {
+  // Mock an error response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageError(kFakeErrorCode)};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  InterfaceInfo interface;
+  EXPECT_FALSE(netlink_utils_->CreateInterface(kFakeWiphyIndex,
+                                               kFakeVirtualInterfaceName,
+                                               NL80211_IFTYPE_AP,
+                                               &interface));
+}
+
+TEST_F(NetlinkUtilsTest, CanDeleteInterface) {
+  // Mock a ACK response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageAck()};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  EXPECT_TRUE(netlink_utils_->DeleteInterface(kFakeInterfaceIndex1));
+}
+
+TEST_F(NetlinkUtilsTest, CanGetInterfaceCombinations) {
+  vector<NL80211Packet> response = CreateSplitWiphyDump(
+      kFakeWiphyIndex,
+      netlink_manager_->GetFamilyId(),
+      netlink_manager_->GetSequenceNumber());
+  response[4].AddAttribute(CreateInterfaceCombinationsAttribute());
+
+  EXPECT_CALL(*netlink_manager_,
+              SendMessageAndGetResponses(IsSplitWiphyDumpRequest(), _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  vector<InterfaceCombination> combinations;
+  EXPECT_TRUE(netlink_utils_->GetInterfaceCombinations(kFakeWiphyIndex,
+                                                       &combinations));
+  ASSERT_EQ(1u, combinations.size());
+  EXPECT_EQ(2u, combinations[0].max_interfaces);
+  EXPECT_EQ(1u, combinations[0].num_channels);
+  ASSERT_EQ(2u, combinations[0].limits.size());
+  EXPECT_EQ(1u, combinations[0].limits[0].max);
+  EXPECT_EQ(1u << NL80211_IFTYPE_STATION, combinations[0].limits[0].types);
+  EXPECT_EQ(1u, combinations[0].limits[1].max);
+  EXPECT_EQ((1u << NL80211_IFTYPE_AP) | (1u << NL80211_IFTYPE_P2P_GO),
+            combinations[0].limits[1].types);
+}
+
+TEST(InterfaceCombinationTest, AllowsInterfacesWithinLimits) {
+  InterfaceCombination combination;
+  combination.limits.emplace_back(1, 1 << NL80211_IFTYPE_STATION);
+  combination.limits.emplace_back(
+      1, (1 << NL80211_IFTYPE_AP) | (1 << NL80211_IFTYPE_STATION));
+  combination.max_interfaces = 2;
+
+  EXPECT_TRUE(combination.Allows({NL80211_IFTYPE_STATION}));
+  EXPECT_TRUE(combination.Allows({NL80211_IFTYPE_STATION,
+                                  NL80211_IFTYPE_AP}));
+  // The second client interface takes a slot from the first limit which
+  // includes it, which is full.
+  EXPECT_FALSE(combination.Allows({NL80211_IFTYPE_STATION,
+                                   NL80211_IFTYPE_STATION}));
+  EXPECT_FALSE(combination.Allows({NL80211_IFTYPE_AP, NL80211_IFTYPE_AP}));
+  EXPECT_FALSE(combination.Allows({NL80211_IFTYPE_MESH_POINT}));
+  combination.max_interfaces = 1;
+  EXPECT_FALSE(combination.Allows({NL80211_IFTYPE_STATION,
+                                   NL80211_IFTYPE_AP}));
+}
+
 }  // namespace wificond
 }  // namespace android
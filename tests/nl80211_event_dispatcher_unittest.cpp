@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <functional>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_event_dispatcher.h"
+#include "wificond/net/nl80211_packet.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeInterfaceIndex1 = 13;
+constexpr uint32_t kFakeWiphyIndex = 5;
+
+NL80211Packet CreateEvent(uint8_t command, uint32_t interface_index) {
+  NL80211Packet event(kFakeFamilyId, command, 0, 0);
+  if (interface_index != NL80211EventDispatcher::kAnyInterface) {
+    event.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  }
+  event.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                           kFakeWiphyIndex));
+  return event;
+}
+
+class RecordingObserver : public NL80211EventObserver {
+ public:
+  void OnNL80211Event(const NL80211Event& event) override {
+    commands.push_back(event.command);
+    interface_indices.push_back(event.interface_index);
+    EXPECT_TRUE(event.has_wiphy_index);
+    EXPECT_EQ(kFakeWiphyIndex, event.wiphy_index);
+    if (on_event) {
+      on_event();
+    }
+  }
+
+  vector<uint8_t> commands;
+  vector<uint32_t> interface_indices;
+  std::function<void()> on_event;
+};
+
+}  // namespace
+
+TEST(NL80211EventDispatcherTest, NotifiesAllSubscribers) {
+  NL80211EventDispatcher dispatcher;
+  RecordingObserver scanner;
+  RecordingObserver metrics;
+  NL80211EventSubscription scanner_subscription;
+  NL80211EventSubscription metrics_subscription;
+  dispatcher.Subscribe(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex,
+                       &scanner, &scanner_subscription);
+  dispatcher.Subscribe(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex,
+                       &metrics, &metrics_subscription);
+  EXPECT_EQ(2u, dispatcher.GetNumSubscriptions(NL80211_CMD_NEW_SCAN_RESULTS));
+
+  EXPECT_EQ(2u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex)));
+  EXPECT_EQ(vector<uint8_t>({NL80211_CMD_NEW_SCAN_RESULTS}), scanner.commands);
+  EXPECT_EQ(vector<uint8_t>({NL80211_CMD_NEW_SCAN_RESULTS}), metrics.commands);
+}
+
+TEST(NL80211EventDispatcherTest, FiltersByCommandAndInterface) {
+  NL80211EventDispatcher dispatcher;
+  RecordingObserver observer;
+  RecordingObserver any_interface_observer;
+  NL80211EventSubscription subscription;
+  NL80211EventSubscription any_interface_subscription;
+  dispatcher.Subscribe(NL80211_CMD_CONNECT, kFakeInterfaceIndex,
+                       &observer, &subscription);
+  dispatcher.Subscribe(NL80211_CMD_CONNECT,
+                       NL80211EventDispatcher::kAnyInterface,
+                       &any_interface_observer, &any_interface_subscription);
+
+  EXPECT_EQ(0u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex)));
+  EXPECT_EQ(1u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_CONNECT, kFakeInterfaceIndex1)));
+  EXPECT_EQ(2u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_CONNECT, kFakeInterfaceIndex)));
+  EXPECT_EQ(1u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_CONNECT, NL80211EventDispatcher::kAnyInterface)));
+
+  EXPECT_EQ(vector<uint32_t>({kFakeInterfaceIndex}),
+            observer.interface_indices);
+  EXPECT_EQ(vector<uint32_t>({kFakeInterfaceIndex1,
+                              kFakeInterfaceIndex,
+                              NL80211EventDispatcher::kAnyInterface}),
+            any_interface_observer.interface_indices);
+}
+
+TEST(NL80211EventDispatcherTest, StopsNotifyingAfterUnsubscribe) {
+  NL80211EventDispatcher dispatcher;
+  RecordingObserver observer;
+  {
+    NL80211EventSubscription subscription;
+    dispatcher.Subscribe(NL80211_CMD_ROAM, kFakeInterfaceIndex,
+                         &observer, &subscription);
+    EXPECT_TRUE(subscription.IsActive());
+    EXPECT_EQ(1u, dispatcher.Dispatch(
+        CreateEvent(NL80211_CMD_ROAM, kFakeInterfaceIndex)));
+    subscription.Unsubscribe();
+    EXPECT_FALSE(subscription.IsActive());
+    EXPECT_EQ(0u, dispatcher.Dispatch(
+        CreateEvent(NL80211_CMD_ROAM, kFakeInterfaceIndex)));
+
+    dispatcher.Subscribe(NL80211_CMD_ROAM, kFakeInterfaceIndex,
+                         &observer, &subscription);
+  }
+  // The subscription was destroyed.
+  EXPECT_EQ(0u, dispatcher.GetNumSubscriptions(NL80211_CMD_ROAM));
+  EXPECT_EQ(0u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_ROAM, kFakeInterfaceIndex)));
+  EXPECT_EQ(1u, observer.commands.size());
+}
+
+TEST(NL80211EventDispatcherTest, CanUnsubscribeWhileDispatching) {
+  NL80211EventDispatcher dispatcher;
+  RecordingObserver first;
+  RecordingObserver second;
+  RecordingObserver third;
+  NL80211EventSubscription first_subscription;
+  NL80211EventSubscription second_subscription;
+  NL80211EventSubscription third_subscription;
+  dispatcher.Subscribe(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex,
+                       &first, &first_subscription);
+  dispatcher.Subscribe(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex,
+                       &second, &second_subscription);
+  dispatcher.Subscribe(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex,
+                       &third, &third_subscription);
+  // The first observer removes itself and the next observer.
+  first.on_event = [&]() {
+    first_subscription.Unsubscribe();
+    second_subscription.Unsubscribe();
+  };
+
+  EXPECT_EQ(2u, dispatcher.Dispatch(
+      CreateEvent(NL80211_CMD_DISCONNECT, kFakeInterfaceIndex)));
+  EXPECT_EQ(1u, first.commands.size());
+  EXPECT_TRUE(second.commands.empty());
+  EXPECT_EQ(1u, third.commands.size());
+  EXPECT_EQ(1u, dispatcher.GetNumSubscriptions(NL80211_CMD_DISCONNECT));
+}
+
+TEST(NL80211EventDispatcherTest, DeactivatesSubscriptionsWhenDestroyed) {
+  RecordingObserver observer;
+  NL80211EventSubscription subscription;
+  {
+    NL80211EventDispatcher dispatcher;
+    dispatcher.Subscribe(NL80211_CMD_CONNECT, kFakeInterfaceIndex,
+                         &observer, &subscription);
+  }
+  EXPECT_FALSE(subscription.IsActive());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -87,6 +87,23 @@ const unsigned char kNL80211_CMD_NEW_STATION[] = {
     0x04, 0x00, 0x15, 0x00,
 };
 
+// Error message in reply to a NL80211_CMD_GET_INTERFACE request, with the
+// original request echoed back and extended ACK attributes appended.
+const char kExpectedExtendedAckMessage[] = "bad ifindex";
+const uint32_t kExpectedExtendedAckOffset = 20;
+
+const unsigned char kNetlinkErrorWithExtendedAck[] = {
+    0x48, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x02,
+    0x70, 0x11, 0x01, 0x00, 0x7b, 0x00, 0x00, 0x00,
+    0xea, 0xff, 0xff, 0xff, 0x1c, 0x00, 0x00, 0x00,
+    0x13, 0x00, 0x05, 0x00, 0x70, 0x11, 0x01, 0x00,
+    0x7b, 0x00, 0x00, 0x00, 0x05, 0x01, 0x00, 0x00,
+    0x08, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x00,
+    0x10, 0x00, 0x01, 0x00, 0x62, 0x61, 0x64, 0x20,
+    0x69, 0x66, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x00,
+    0x08, 0x00, 0x02, 0x00, 0x14, 0x00, 0x00, 0x00,
+};
+
 }  // namespace
 
 TEST(NL80211PacketTest, CanConstructValidNL80211Packet) {
@@ -249,5 +266,45 @@ TEST(NL80211PacketTest, ParseCMDNewStation) {
   EXPECT_EQ(kNewStationExpectedGeneration, value);
 }
 
+TEST(NL80211PacketTest, ParseErrorWithExtendedAck) {
+  NL80211Packet netlink_packet(std::vector<uint8_t>(
+      kNetlinkErrorWithExtendedAck,
+      kNetlinkErrorWithExtendedAck + sizeof(kNetlinkErrorWithExtendedAck)));
+  EXPECT_TRUE(netlink_packet.IsValid());
+  EXPECT_EQ(NLMSG_ERROR, netlink_packet.GetMessageType());
+  EXPECT_EQ(EINVAL, netlink_packet.GetErrorCode());
+  EXPECT_FALSE(netlink_packet.IsCapped());
+  string message;
+  uint32_t attribute_offset;
+  EXPECT_TRUE(netlink_packet.GetExtendedAck(&message, &attribute_offset));
+  EXPECT_EQ(kExpectedExtendedAckMessage, message);
+  EXPECT_EQ(kExpectedExtendedAckOffset, attribute_offset);
+}
+
+TEST(NL80211PacketTest, ParseErrorWithoutExtendedAck) {
+  std::vector<uint8_t> data(
+      kNetlinkErrorWithExtendedAck,
+      kNetlinkErrorWithExtendedAck + sizeof(kNetlinkErrorWithExtendedAck));
+  NL80211Packet netlink_packet(data);
+  netlink_packet.SetFlags(0);
+  string message = "stale";
+  uint32_t attribute_offset = 1;
+  EXPECT_TRUE(netlink_packet.GetExtendedAck(&message, &attribute_offset));
+  EXPECT_TRUE(message.empty());
+  EXPECT_EQ(0u, attribute_offset);
+}
+
+TEST(NL80211PacketTest, CannotParseBrokenExtendedAck) {
+  std::vector<uint8_t> data(
+      kNetlinkErrorWithExtendedAck,
+      kNetlinkErrorWithExtendedAck + sizeof(kNetlinkErrorWithExtendedAck));
+  // Make the message attribute run past the end of the packet.
+  data[sizeof(kNetlinkErrorWithExtendedAck) - 24] = 0x40;
+  NL80211Packet netlink_packet(data);
+  string message;
+  uint32_t attribute_offset;
+  EXPECT_FALSE(netlink_packet.GetExtendedAck(&message, &attribute_offset));
+}
+
 }  // namespace wificond
 }  // namespace android
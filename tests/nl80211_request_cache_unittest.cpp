@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include <linux/nl80211.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_request_cache.h"
+
+using std::unique_ptr;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakePortId = 12345;
+constexpr uint32_t kFakePortId1 = 54321;
+constexpr uint32_t kFakeSequenceNumber = 1984;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeInterfaceIndex1 = 13;
+constexpr uint64_t kFakeVariant = 0x12efa12c978b;
+constexpr uint64_t kFakeVariant1 = 0x12efa12c978c;
+
+unique_ptr<NL80211Packet> CreateRequest(uint8_t command,
+                                        uint32_t interface_index) {
+  unique_ptr<NL80211Packet> request(new NL80211Packet(
+      kFakeFamilyId, command, kFakeSequenceNumber, kFakePortId));
+  request->AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  return request;
+}
+
+}  // namespace
+
+TEST(NL80211RequestCacheTest, GetPatchesSequenceAndPortId) {
+  NL80211RequestCache cache;
+  NL80211Packet* request = cache.Put(
+      kFakeInterfaceIndex, kFakeVariant,
+      CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  ASSERT_NE(nullptr, request);
+  NL80211Packet* cached = cache.Get(NL80211_CMD_GET_STATION,
+                                    kFakeInterfaceIndex, kFakeVariant,
+                                    kFakeSequenceNumber + 1, kFakePortId1);
+  ASSERT_EQ(request, cached);
+  EXPECT_EQ(kFakeSequenceNumber + 1, cached->GetMessageSequence());
+  EXPECT_EQ(kFakePortId1, cached->GetPortId());
+  EXPECT_EQ(NL80211_CMD_GET_STATION, cached->GetCommand());
+  uint32_t interface_index;
+  EXPECT_TRUE(cached->GetAttributeValue(NL80211_ATTR_IFINDEX,
+                                        &interface_index));
+  EXPECT_EQ(kFakeInterfaceIndex, interface_index);
+}
+
+TEST(NL80211RequestCacheTest, KeepsOneTemplatePerCommandAndInterface) {
+  NL80211RequestCache cache;
+  cache.Put(kFakeInterfaceIndex, kFakeVariant,
+            CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  cache.Put(kFakeInterfaceIndex, 0,
+            CreateRequest(NL80211_CMD_ABORT_SCAN, kFakeInterfaceIndex));
+  cache.Put(kFakeInterfaceIndex1, kFakeVariant,
+            CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex1));
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(nullptr, cache.Get(NL80211_CMD_TRIGGER_SCAN, kFakeInterfaceIndex,
+                               0, kFakeSequenceNumber, kFakePortId));
+
+  // A template of another variant replaces the previous one.
+  cache.Put(kFakeInterfaceIndex, kFakeVariant1,
+            CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(nullptr, cache.Get(NL80211_CMD_GET_STATION, kFakeInterfaceIndex,
+                               kFakeVariant, kFakeSequenceNumber,
+                               kFakePortId));
+  EXPECT_NE(nullptr, cache.Get(NL80211_CMD_GET_STATION, kFakeInterfaceIndex,
+                               kFakeVariant1, kFakeSequenceNumber,
+                               kFakePortId));
+}
+
+TEST(NL80211RequestCacheTest, CanRemoveInterface) {
+  NL80211RequestCache cache;
+  cache.Put(kFakeInterfaceIndex, kFakeVariant,
+            CreateRequest(NL80211_CMD_GET_STATION, kFakeInterfaceIndex));
+  cache.Put(kFakeInterfaceIndex, 0,
+            CreateRequest(NL80211_CMD_ABORT_SCAN, kFakeInterfaceIndex));
+  cache.Put(kFakeInterfaceIndex1, 0,
+            CreateRequest(NL80211_CMD_ABORT_SCAN, kFakeInterfaceIndex1));
+  cache.RemoveInterface(kFakeInterfaceIndex);
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(nullptr, cache.Get(NL80211_CMD_ABORT_SCAN, kFakeInterfaceIndex,
+                               0, kFakeSequenceNumber, kFakePortId));
+  EXPECT_NE(nullptr, cache.Get(NL80211_CMD_ABORT_SCAN, kFakeInterfaceIndex1,
+                               0, kFakeSequenceNumber, kFakePortId));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -16,12 +16,14 @@
 
 #include <functional>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include <android/hardware/wifi/offload/1.0/IOffload.h>
 #include <gtest/gtest.h>
 
+#include "wificond/tests/mock_event_loop.h"
 #include "wificond/tests/mock_offload.h"
 #include "wificond/tests/mock_offload_scan_callback_interface.h"
 #include "wificond/tests/mock_offload_service_utils.h"
@@ -48,10 +50,13 @@ using com::android::server::wifi::wificond::NativeScanStats;
 using testing::NiceMock;
 using testing::_;
 using testing::Invoke;
+using testing::Return;
+using testing::SaveArg;
 using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
 using std::bind;
+using std::function;
 
 using namespace std::placeholders;
 using namespace android::wificond::offload_hal_test_constants;
@@ -108,6 +113,7 @@ class OffloadScanManagerTest : public ::testing::Test {
     death_recipient_.clear();
   }
 
+  NiceMock<MockEventLoop> event_loop_;
   sp<NiceMock<MockOffload>> mock_offload_{new NiceMock<MockOffload>()};
   sp<OffloadCallback> offload_callback_;
   sp<OffloadDeathRecipient> death_recipient_;
@@ -118,8 +124,10 @@ class OffloadScanManagerTest : public ::testing::Test {
           new NiceMock<MockOffloadScanCallbackInterface>()};
   unique_ptr<OffloadScanManager> offload_scan_manager_;
   OffloadStatus status;
-  vector<vector<uint8_t>> scan_ssids{kSsid1, kSsid2};
-  vector<vector<uint8_t>> match_ssids{kSsid1, kSsid2};
+  vector<Ssid> scan_ssids{Ssid::FromString("Google"),
+                          Ssid::FromString("Xfinity")};
+  vector<Ssid> match_ssids{Ssid::FromString("Google"),
+                           Ssid::FromString("Xfinity")};
   vector<uint8_t> security_flags{kNetworkFlags, kNetworkFlags};
   vector<uint32_t> frequencies{kFrequency1, kFrequency2};
   uint64_t cookie_ = reinterpret_cast<uint64_t>(mock_offload_.get());
@@ -135,7 +143,8 @@ TEST_F(OffloadScanManagerTest, BinderDeathRegisteredCookieAndService) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_scan_callback_interface_, OnOffloadError(_));
   death_recipient_->serviceDied(cookie_, mock_offload_);
   EXPECT_EQ(OffloadScanManager::kNoService,
@@ -151,7 +160,8 @@ TEST_F(OffloadScanManagerTest, BinderDeathUnregisteredCookie) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   death_recipient_->serviceDied(kDeathCode, mock_offload_);
   EXPECT_FALSE(OffloadScanManager::kNoService ==
                offload_scan_manager_->getOffloadStatus());
@@ -166,7 +176,8 @@ TEST_F(OffloadScanManagerTest, ServiceNotAvailableTest) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(nullptr));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_EQ(OffloadScanManager::kNoService,
             offload_scan_manager_->getOffloadStatus());
 }
@@ -182,7 +193,8 @@ TEST_F(OffloadScanManagerTest, ServiceAvailableTest) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_EQ(OffloadScanManager::kNoError,
             offload_scan_manager_->getOffloadStatus());
 }
@@ -200,7 +212,8 @@ TEST_F(OffloadScanManagerTest, CallbackInvokedTest) {
       .WillByDefault(testing::Return(mock_offload_));
   EXPECT_CALL(*mock_offload_scan_callback_interface_, OnOffloadScanResult());
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   vector<ScanResult> dummy_scan_results_ =
       OffloadTestUtils::createOffloadScanResults();
   offload_callback_->onScanResult(dummy_scan_results_);
@@ -217,7 +230,8 @@ TEST_F(OffloadScanManagerTest, ErrorCallbackInvokedTest) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   OffloadStatus status =
       OffloadTestUtils::createOffloadStatus(OffloadStatusCode::ERROR);
   EXPECT_CALL(*mock_offload_scan_callback_interface_, OnOffloadError(_));
@@ -237,7 +251,8 @@ TEST_F(OffloadScanManagerTest, StartScanTestWhenServiceIsOk) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_, subscribeScanResults(_, _));
   EXPECT_CALL(*mock_offload_, configureScans(_, _, _));
   OffloadScanManager::ReasonCode reason_code = OffloadScanManager::kNone;
@@ -252,11 +267,14 @@ TEST_F(OffloadScanManagerTest, StartScanTestWhenServiceIsOk) {
  * Offload HAL when service is not available
  */
 TEST_F(OffloadScanManagerTest, StartScanTestWhenServiceIsNotAvailable) {
-  EXPECT_CALL(*mock_offload_service_utils_, GetOffloadService()).Times(2);
+  EXPECT_CALL(*mock_offload_service_utils_, GetOffloadService());
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(nullptr));
+  // The service is looked up again in the background, not by startScan().
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, _));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   OffloadScanManager::ReasonCode reason_code = OffloadScanManager::kNone;
   bool result = offload_scan_manager_->startScan(
       kDisconnectedModeScanIntervalMs, kRssiThreshold, scan_ssids, match_ssids,
@@ -276,7 +294,8 @@ TEST_F(OffloadScanManagerTest, StartScanTestWhenServiceIsNotConnected) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   OffloadStatus status =
       OffloadTestUtils::createOffloadStatus(OffloadStatusCode::NO_CONNECTION);
   offload_callback_->onError(status);
@@ -299,7 +318,8 @@ TEST_F(OffloadScanManagerTest, StartScanTwiceTestWhenServiceIsOk) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_, subscribeScanResults(_, _)).Times(2);
   EXPECT_CALL(*mock_offload_, configureScans(_, _, _)).Times(2);
   OffloadScanManager::ReasonCode reason_code = OffloadScanManager::kNone;
@@ -324,7 +344,8 @@ TEST_F(OffloadScanManagerTest, StopScanTestWhenServiceIsOk) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_, subscribeScanResults(_, _));
   EXPECT_CALL(*mock_offload_, configureScans(_, _, _));
   EXPECT_CALL(*mock_offload_, unsubscribeScanResults());
@@ -347,7 +368,8 @@ TEST_F(OffloadScanManagerTest, StopScanTestWhenServiceIsNotConnectedAnymore) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_, subscribeScanResults(_, _));
   EXPECT_CALL(*mock_offload_, configureScans(_, _, _));
   OffloadScanManager::ReasonCode reason_code = OffloadScanManager::kNone;
@@ -373,7 +395,8 @@ TEST_F(OffloadScanManagerTest, getScanStatsTestWhenServiceIsOk) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_, getScanStats(_));
   NativeScanStats stats;
   bool result = offload_scan_manager_->getScanStats(&stats);
@@ -391,7 +414,8 @@ TEST_F(OffloadScanManagerTest, getScanStatsTestWhenServiceIsNotOk) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   OffloadStatus status =
       OffloadTestUtils::createOffloadStatus(OffloadStatusCode::NO_CONNECTION);
   offload_callback_->onError(status);
@@ -412,7 +436,8 @@ TEST_F(OffloadScanManagerTest, StartScanFailedTest) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   EXPECT_CALL(*mock_offload_, subscribeScanResults(_, _)).Times(0);
   EXPECT_CALL(*mock_offload_, configureScans(_, _, _)).Times(1);
   status = OffloadTestUtils::createOffloadStatus(OffloadStatusCode::ERROR);
@@ -435,7 +460,8 @@ TEST_F(OffloadScanManagerTest, getScanStatsFailedTest) {
   ON_CALL(*mock_offload_service_utils_, GetOffloadService())
       .WillByDefault(testing::Return(mock_offload_));
   offload_scan_manager_.reset(new OffloadScanManager(
-      mock_offload_service_utils_, mock_offload_scan_callback_interface_));
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
   status = OffloadTestUtils::createOffloadStatus(OffloadStatusCode::TIMEOUT);
   EXPECT_CALL(*mock_offload_, getScanStats(_));
   NativeScanStats stats;
@@ -443,5 +469,98 @@ TEST_F(OffloadScanManagerTest, getScanStatsFailedTest) {
   EXPECT_EQ(result, false);
 }
 
+/**
+ * Testing OffloadScanManager looks up the service again with backoff after
+ * binder death, and reports the service once it is back
+ */
+TEST_F(OffloadScanManagerTest, RediscoversServiceAfterBinderDeath) {
+  EXPECT_CALL(*mock_offload_service_utils_, GetOffloadService())
+      .WillOnce(Return(mock_offload_))
+      .WillOnce(Return(nullptr))
+      .WillOnce(Return(mock_offload_));
+  offload_scan_manager_.reset(new OffloadScanManager(
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
+  function<void()> discovery_task;
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, 1000))
+      .WillOnce(SaveArg<0>(&discovery_task));
+  death_recipient_->serviceDied(cookie_, mock_offload_);
+  EXPECT_EQ(OffloadScanManager::kNoService,
+            offload_scan_manager_->getOffloadStatus());
+
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, 2000))
+      .WillOnce(SaveArg<0>(&discovery_task));
+  discovery_task();
+  EXPECT_EQ(OffloadScanManager::kNoService,
+            offload_scan_manager_->getOffloadStatus());
+
+  EXPECT_CALL(*mock_offload_scan_callback_interface_,
+              OnOffloadServiceAvailable());
+  discovery_task();
+  EXPECT_EQ(OffloadScanManager::kNoError,
+            offload_scan_manager_->getOffloadStatus());
+  std::stringstream ss;
+  offload_scan_manager_->Dump(&ss);
+  EXPECT_NE(std::string::npos, ss.str().find("recoveries 1"));
+}
+
+/**
+ * Testing OffloadScanManager stops looking up the service after too many
+ * attempts, until a new scan is requested
+ */
+TEST_F(OffloadScanManagerTest, StopsDiscoveryAfterMaxAttempts) {
+  ON_CALL(*mock_offload_service_utils_, IsOffloadScanSupported())
+      .WillByDefault(Return(true));
+  ON_CALL(*mock_offload_service_utils_, GetOffloadService())
+      .WillByDefault(Return(nullptr));
+  function<void()> discovery_task;
+  vector<int64_t> delays_ms;
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, _))
+      .WillRepeatedly(Invoke([&discovery_task, &delays_ms](
+          const function<void()>& task, int64_t delay_ms) {
+        discovery_task = task;
+        delays_ms.push_back(delay_ms);
+      }));
+  offload_scan_manager_.reset(new OffloadScanManager(
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
+  while (delays_ms.size() < 20) {
+    size_t num_tasks = delays_ms.size();
+    discovery_task();
+    if (delays_ms.size() == num_tasks) {
+      break;
+    }
+  }
+  vector<int64_t> expected_delays_ms{1000, 2000, 4000, 8000, 16000,
+                                     32000, 64000, 64000, 64000, 64000};
+  EXPECT_EQ(expected_delays_ms, delays_ms);
+
+  OffloadScanManager::ReasonCode reason_code = OffloadScanManager::kNone;
+  EXPECT_FALSE(offload_scan_manager_->startScan(
+      kDisconnectedModeScanIntervalMs, kRssiThreshold, scan_ssids, match_ssids,
+      security_flags, frequencies, &reason_code));
+  EXPECT_EQ(OffloadScanManager::kNotAvailable, reason_code);
+  EXPECT_EQ(11u, delays_ms.size());
+  EXPECT_EQ(1000, delays_ms.back());
+}
+
+/**
+ * Testing a pending lookup does nothing once OffloadScanManager is destroyed
+ */
+TEST_F(OffloadScanManagerTest, DiscoveryIgnoredAfterDestruction) {
+  ON_CALL(*mock_offload_service_utils_, IsOffloadScanSupported())
+      .WillByDefault(Return(true));
+  EXPECT_CALL(*mock_offload_service_utils_, GetOffloadService())
+      .WillOnce(Return(nullptr));
+  function<void()> discovery_task;
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, _))
+      .WillOnce(SaveArg<0>(&discovery_task));
+  offload_scan_manager_.reset(new OffloadScanManager(
+      mock_offload_service_utils_, mock_offload_scan_callback_interface_,
+      &event_loop_));
+  offload_scan_manager_.reset();
+  discovery_task();
+}
+
 }  // namespace wificond
 }  // namespace android
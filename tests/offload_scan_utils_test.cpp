@@ -68,7 +68,9 @@ TEST_F(OffloadScanUtilsTest, verifyConversion) {
 }
 
 TEST_F(OffloadScanUtilsTest, verifyScanParam) {
-  vector<vector<uint8_t>> scan_ssids{kSsid1, kSsid2};
+  vector<Ssid> scan_ssids(2);
+  ASSERT_TRUE(Ssid::FromBytes(kSsid1, kSsid1_size, &scan_ssids[0]));
+  ASSERT_TRUE(Ssid::FromBytes(kSsid2, kSsid2_size, &scan_ssids[1]));
   vector<uint32_t> frequencies{kFrequency1, kFrequency2};
   ScanParam scanParam = OffloadScanUtils::createScanParam(
       scan_ssids, frequencies, kDisconnectedModeScanIntervalMs);
@@ -79,15 +81,14 @@ TEST_F(OffloadScanUtilsTest, verifyScanParam) {
   }
   for (size_t j = 0; j < scan_ssids.size(); j++) {
     vector<uint8_t> ssid_result = scanParam.ssidList[j];
-    vector<uint8_t> ssid_input = scan_ssids[j];
-    for (size_t k = 0; k < ssid_result.size(); k++) {
-      EXPECT_EQ(ssid_result[k], ssid_input[k]);
-    }
+    EXPECT_EQ(scan_ssids[j].ToBytes(), ssid_result);
   }
 }
 
 TEST_F(OffloadScanUtilsTest, verifyScanFilter) {
-  vector<vector<uint8_t>> match_ssids{kSsid1, kSsid2};
+  vector<Ssid> match_ssids(2);
+  ASSERT_TRUE(Ssid::FromBytes(kSsid1, kSsid1_size, &match_ssids[0]));
+  ASSERT_TRUE(Ssid::FromBytes(kSsid2, kSsid2_size, &match_ssids[1]));
   vector<uint8_t> security_flags{kNetworkFlags, kNetworkFlags};
   ScanFilter scanFilter = OffloadScanUtils::createScanFilter(
       match_ssids, security_flags, kRssiThreshold);
@@ -96,11 +97,8 @@ TEST_F(OffloadScanUtilsTest, verifyScanFilter) {
   for (size_t i = 0; i < security_flags.size(); ++i) {
     NetworkInfo nwInfo = scanFilter.preferredNetworkInfoList[i];
     vector<uint8_t> ssid = nwInfo.ssid;
-    vector<uint8_t> match_ssid = match_ssids[i];
     EXPECT_EQ(nwInfo.flags, security_flags[i]);
-    for (size_t j = 0; j < ssid.size(); j++) {
-      EXPECT_EQ(ssid[j], match_ssid[j]);
-    }
+    EXPECT_EQ(match_ssids[i].ToBytes(), ssid);
   }
 }
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/pno_network_matcher.h"
+
+using com::android::server::wifi::wificond::NativeScanResult;
+using com::android::server::wifi::wificond::PnoNetwork;
+using com::android::server::wifi::wificond::PnoSettings;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const Ssid kFakeSsid = Ssid::FromString("Google");
+const Ssid kFakeSsid1 = Ssid::FromString("GoogleGuest");
+const Ssid kFakeSsid2 = Ssid::FromString("AndroidAPTest");
+
+PnoSettings CreatePnoSettings(const vector<Ssid>& ssids) {
+  PnoSettings pno_settings;
+  for (const auto& ssid : ssids) {
+    PnoNetwork pno_network;
+    pno_network.ssid_ = ssid;
+    pno_settings.pno_networks_.push_back(pno_network);
+  }
+  return pno_settings;
+}
+
+NativeScanResult CreateScanResult(const Ssid& ssid) {
+  NativeScanResult scan_result;
+  scan_result.ssid = ssid;
+  return scan_result;
+}
+
+}  // namespace
+
+TEST(PnoNetworkMatcherTest, MatchReturnsNetworkIndex) {
+  PnoNetworkMatcher matcher(CreatePnoSettings({kFakeSsid, kFakeSsid1}));
+  EXPECT_EQ(2u, matcher.size());
+  EXPECT_EQ(0, matcher.Match(CreateScanResult(kFakeSsid)));
+  EXPECT_EQ(1, matcher.Match(CreateScanResult(kFakeSsid1)));
+  EXPECT_EQ(PnoNetworkMatcher::kNoMatch,
+            matcher.Match(CreateScanResult(kFakeSsid2)));
+}
+
+TEST(PnoNetworkMatcherTest, EmptyMatcherMatchesNothing) {
+  PnoNetworkMatcher matcher;
+  EXPECT_EQ(0u, matcher.size());
+  EXPECT_EQ(PnoNetworkMatcher::kNoMatch,
+            matcher.Match(CreateScanResult(kFakeSsid)));
+}
+
+TEST(PnoNetworkMatcherTest, DuplicateSsidMatchesFirstNetwork) {
+  PnoNetworkMatcher matcher(
+      CreatePnoSettings({kFakeSsid1, kFakeSsid, kFakeSsid}));
+  EXPECT_EQ(1, matcher.Match(CreateScanResult(kFakeSsid)));
+}
+
+TEST(PnoNetworkMatcherTest, FilterKeepsMatchedResultsInOrder) {
+  PnoNetworkMatcher matcher(CreatePnoSettings({kFakeSsid, kFakeSsid1}));
+  vector<NativeScanResult> scan_results = {
+      CreateScanResult(kFakeSsid2),
+      CreateScanResult(kFakeSsid1),
+      CreateScanResult(kFakeSsid2),
+      CreateScanResult(kFakeSsid)};
+  vector<int> network_indices;
+  matcher.Filter(&scan_results, &network_indices);
+  ASSERT_EQ(2u, scan_results.size());
+  EXPECT_EQ(kFakeSsid1, scan_results[0].ssid);
+  EXPECT_EQ(kFakeSsid, scan_results[1].ssid);
+  EXPECT_EQ(vector<int>({1, 0}), network_indices);
+}
+
+}  // namespace wificond
+}  // namespace android
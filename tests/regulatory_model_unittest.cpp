@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "wificond/regulatory_model.h"
+#include "wificond/tests/mock_netlink_manager.h"
+#include "wificond/tests/mock_netlink_utils.h"
+
+using std::string;
+using std::vector;
+using testing::DoAll;
+using testing::NiceMock;
+using testing::Return;
+using testing::SetArgPointee;
+using testing::_;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t kFakeWiphyIndex = 5;
+constexpr uint32_t kFake2gFrequency = 2412;
+constexpr uint32_t kFake5gFrequency = 5180;
+constexpr uint32_t kFakeDfsFrequency = 5260;
+constexpr uint32_t kFake5gDisabledFrequency = 5865;
+const char kFakeCountryCode[] = "US";
+const char kFakeCountryCode1[] = "JP";
+
+ChannelInfo CreateChannel(uint32_t frequency) {
+  ChannelInfo channel;
+  channel.frequency = frequency;
+  channel.max_tx_power_mbm = 2000;
+  return channel;
+}
+
+RegulatoryDomain CreateRegulatoryDomain(const string& country_code) {
+  RegulatoryDomain regulatory_domain;
+  regulatory_domain.country_code = country_code;
+  regulatory_domain.dfs_region = NL80211_DFS_FCC;
+  return regulatory_domain;
+}
+
+}  // namespace
+
+class RegulatoryModelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ChannelInfo dfs_channel = CreateChannel(kFakeDfsFrequency);
+    dfs_channel.radar = true;
+    dfs_channel.dfs_state = NL80211_DFS_USABLE;
+    ChannelInfo disabled_channel = CreateChannel(kFake5gDisabledFrequency);
+    disabled_channel.disabled = true;
+    channels_ = {CreateChannel(kFake2gFrequency),
+                 CreateChannel(kFake5gFrequency),
+                 dfs_channel,
+                 disabled_channel};
+    ON_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _))
+        .WillByDefault(DoAll(SetArgPointee<1>(channels_), Return(true)));
+    ON_CALL(netlink_utils_, GetRegulatoryDomain(kFakeWiphyIndex, _))
+        .WillByDefault(DoAll(
+            SetArgPointee<1>(CreateRegulatoryDomain(kFakeCountryCode)),
+            Return(true)));
+  }
+
+  void SetChannels(const vector<ChannelInfo>& channels) {
+    ON_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _))
+        .WillByDefault(DoAll(SetArgPointee<1>(channels), Return(true)));
+  }
+
+  void OnChannelsChanged(const string& country_code,
+                         const vector<uint32_t>& changed_frequencies) {
+    num_notifications_++;
+    country_code_ = country_code;
+    changed_frequencies_ = changed_frequencies;
+  }
+
+  NiceMock<MockNetlinkManager> netlink_manager_;
+  NiceMock<MockNetlinkUtils> netlink_utils_{&netlink_manager_};
+  vector<ChannelInfo> channels_;
+  uint32_t num_notifications_ = 0;
+  string country_code_;
+  vector<uint32_t> changed_frequencies_;
+  RegulatoryModel regulatory_model_{
+      kFakeWiphyIndex,
+      &netlink_utils_,
+      std::bind(&RegulatoryModelTest::OnChannelsChanged, this,
+                std::placeholders::_1, std::placeholders::_2)};
+};
+
+TEST_F(RegulatoryModelTest, CanLoadBandInfo) {
+  EXPECT_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _));
+  BandInfo band_info;
+  EXPECT_TRUE(regulatory_model_.GetBandInfo(&band_info));
+  EXPECT_TRUE(regulatory_model_.IsLoaded());
+  EXPECT_EQ(vector<uint32_t>({kFake2gFrequency}), band_info.band_2g);
+  EXPECT_EQ(vector<uint32_t>({kFake5gFrequency}), band_info.band_5g);
+  EXPECT_EQ(vector<uint32_t>({kFakeDfsFrequency}), band_info.band_dfs);
+  EXPECT_EQ(kFakeCountryCode, regulatory_model_.GetCountryCode());
+
+  // Following queries are served from the model.
+  EXPECT_TRUE(regulatory_model_.GetBandInfo(&band_info));
+  ChannelInfo channel;
+  EXPECT_TRUE(regulatory_model_.GetChannel(kFakeDfsFrequency, &channel));
+  EXPECT_EQ(channels_[2], channel);
+  EXPECT_EQ(0u, num_notifications_);
+}
+
+TEST_F(RegulatoryModelTest, CanCheckChannelUsable) {
+  EXPECT_TRUE(regulatory_model_.IsChannelUsable(kFake2gFrequency));
+  EXPECT_TRUE(regulatory_model_.IsChannelUsable(kFakeDfsFrequency));
+  EXPECT_FALSE(regulatory_model_.IsChannelUsable(kFake5gDisabledFrequency));
+  // Unknown channel.
+  EXPECT_FALSE(regulatory_model_.IsChannelUsable(5000));
+}
+
+TEST_F(RegulatoryModelTest, LeavesChannelCheckToKernelWithoutModel) {
+  ON_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _))
+      .WillByDefault(Return(false));
+  EXPECT_TRUE(regulatory_model_.IsChannelUsable(kFake5gDisabledFrequency));
+  BandInfo band_info;
+  EXPECT_FALSE(regulatory_model_.GetBandInfo(&band_info));
+  EXPECT_FALSE(regulatory_model_.IsLoaded());
+}
+
+TEST_F(RegulatoryModelTest, ToleratesRegulatoryDomainFailure) {
+  ON_CALL(netlink_utils_, GetRegulatoryDomain(kFakeWiphyIndex, _))
+      .WillByDefault(Return(false));
+  EXPECT_TRUE(regulatory_model_.Load());
+  EXPECT_TRUE(regulatory_model_.GetCountryCode().empty());
+  EXPECT_TRUE(regulatory_model_.IsChannelUsable(kFake5gFrequency));
+}
+
+TEST_F(RegulatoryModelTest, NotifiesOnlyChangedChannels) {
+  ASSERT_TRUE(regulatory_model_.Load());
+
+  // Radar detection finished on the DFS channel, and the disabled channel
+  // was enabled.
+  vector<ChannelInfo> channels = channels_;
+  channels[2].dfs_state = NL80211_DFS_AVAILABLE;
+  channels[3].disabled = false;
+  SetChannels(channels);
+
+  regulatory_model_.OnRegDomainChanged(kFakeCountryCode);
+  EXPECT_EQ(1u, num_notifications_);
+  EXPECT_EQ(kFakeCountryCode, country_code_);
+  EXPECT_EQ(vector<uint32_t>({kFakeDfsFrequency, kFake5gDisabledFrequency}),
+            changed_frequencies_);
+  EXPECT_TRUE(regulatory_model_.IsChannelUsable(kFake5gDisabledFrequency));
+  ChannelInfo channel;
+  EXPECT_TRUE(regulatory_model_.GetChannel(kFakeDfsFrequency, &channel));
+  EXPECT_EQ(static_cast<uint32_t>(NL80211_DFS_AVAILABLE), channel.dfs_state);
+}
+
+TEST_F(RegulatoryModelTest, NotifiesRemovedChannels) {
+  ASSERT_TRUE(regulatory_model_.Load());
+
+  vector<ChannelInfo> channels = channels_;
+  channels.erase(channels.begin() + 1);
+  SetChannels(channels);
+
+  regulatory_model_.OnRegDomainChanged(kFakeCountryCode);
+  EXPECT_EQ(1u, num_notifications_);
+  EXPECT_EQ(vector<uint32_t>({kFake5gFrequency}), changed_frequencies_);
+  EXPECT_FALSE(regulatory_model_.IsChannelUsable(kFake5gFrequency));
+}
+
+TEST_F(RegulatoryModelTest, DoesNotNotifyWithoutChange) {
+  ASSERT_TRUE(regulatory_model_.Load());
+  regulatory_model_.OnRegDomainChanged(kFakeCountryCode);
+  EXPECT_EQ(0u, num_notifications_);
+}
+
+TEST_F(RegulatoryModelTest, NotifiesCountryChange) {
+  ASSERT_TRUE(regulatory_model_.Load());
+  regulatory_model_.OnRegDomainChanged(kFakeCountryCode1);
+  EXPECT_EQ(1u, num_notifications_);
+  EXPECT_EQ(kFakeCountryCode1, country_code_);
+  EXPECT_TRUE(changed_frequencies_.empty());
+  EXPECT_EQ(kFakeCountryCode1, regulatory_model_.GetCountryCode());
+}
+
+TEST_F(RegulatoryModelTest, DoesNotNotifyWhenUpdateFails) {
+  ASSERT_TRUE(regulatory_model_.Load());
+  ON_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _))
+      .WillByDefault(Return(false));
+  regulatory_model_.OnRegDomainChanged(kFakeCountryCode1);
+  EXPECT_EQ(0u, num_notifications_);
+  // The model keeps serving the last known channels.
+  EXPECT_TRUE(regulatory_model_.IsChannelUsable(kFake5gFrequency));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -29,9 +29,8 @@ namespace wificond {
 namespace {
 
 
-const uint8_t kFakeSsid[] =
-    {'G', 'o', 'o', 'g', 'l', 'e', 'G', 'u', 'e', 's', 't'};
-const uint8_t kFakeBssid[] = {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+const Ssid kFakeSsid = Ssid::FromString("GoogleGuest");
+const MacAddress kFakeBssid({0x45, 0x54, 0xad, 0x67, 0x98, 0xf6});
 const uint8_t kFakeIE[] = {0x05, 0x11, 0x32, 0x11};
 constexpr uint32_t kFakeFrequency = 5240;
 constexpr int32_t kFakeSignalMbm= -32;
@@ -45,11 +44,9 @@ class ScanResultTest : public ::testing::Test {
 };
 
 TEST_F(ScanResultTest, ParcelableTest) {
-  std::vector<uint8_t> ssid(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
-  std::vector<uint8_t> bssid(kFakeBssid, kFakeBssid + sizeof(kFakeBssid));
   std::vector<uint8_t> ie(kFakeIE, kFakeIE + sizeof(kFakeIE));
 
-  NativeScanResult scan_result(ssid, bssid, ie, kFakeFrequency,
+  NativeScanResult scan_result(kFakeSsid, kFakeBssid, ie, kFakeFrequency,
       kFakeSignalMbm, kFakeTsf, kFakeCapability, kFakeAssociated);
   Parcel parcel;
   EXPECT_EQ(::android::OK, scan_result.writeToParcel(&parcel));
@@ -58,8 +55,8 @@ TEST_F(ScanResultTest, ParcelableTest) {
   parcel.setDataPosition(0);
   EXPECT_EQ(::android::OK, scan_result_copy.readFromParcel(&parcel));
 
-  EXPECT_EQ(ssid, scan_result_copy.ssid);
-  EXPECT_EQ(bssid, scan_result_copy.bssid);
+  EXPECT_EQ(kFakeSsid, scan_result_copy.ssid);
+  EXPECT_EQ(kFakeBssid, scan_result_copy.bssid);
   EXPECT_EQ(ie, scan_result_copy.info_element);
   EXPECT_EQ(kFakeFrequency, scan_result_copy.frequency);
   EXPECT_EQ(kFakeSignalMbm, scan_result_copy.signal_mbm);
@@ -68,5 +65,28 @@ TEST_F(ScanResultTest, ParcelableTest) {
   EXPECT_EQ(kFakeAssociated, scan_result_copy.associated);
 }
 
+TEST_F(ScanResultTest, RejectsParcelWithInvalidBssid) {
+  std::vector<uint8_t> truncated_bssid(kFakeBssid.data(),
+                                       kFakeBssid.data() + 4);
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, parcel.writeByteVector(kFakeSsid.ToBytes()));
+  EXPECT_EQ(::android::OK, parcel.writeByteVector(truncated_bssid));
+
+  NativeScanResult scan_result;
+  parcel.setDataPosition(0);
+  EXPECT_NE(::android::OK, scan_result.readFromParcel(&parcel));
+}
+
+TEST_F(ScanResultTest, RejectsParcelWithOversizedSsid) {
+  std::vector<uint8_t> oversized_ssid(Ssid::kMaxSize + 1, 'a');
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, parcel.writeByteVector(oversized_ssid));
+  EXPECT_EQ(::android::OK, parcel.writeByteVector(kFakeBssid.ToBytes()));
+
+  NativeScanResult scan_result;
+  parcel.setDataPosition(0);
+  EXPECT_NE(::android::OK, scan_result.readFromParcel(&parcel));
+}
+
 }  // namespace wificond
 }  // namespace android
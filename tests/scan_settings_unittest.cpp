@@ -18,12 +18,14 @@
 
 #include <gtest/gtest.h>
 
+#include "android/net/wifi/IWifiScannerImpl.h"
 #include "wificond/scanning/channel_settings.h"
 #include "wificond/scanning/hidden_network.h"
 #include "wificond/scanning/pno_network.h"
 #include "wificond/scanning/pno_settings.h"
 #include "wificond/scanning/single_scan_settings.h"
 
+using ::android::net::wifi::IWifiScannerImpl;
 using ::com::android::server::wifi::wificond::ChannelSettings;
 using ::com::android::server::wifi::wificond::HiddenNetwork;
 using ::com::android::server::wifi::wificond::PnoNetwork;
@@ -36,15 +38,15 @@ namespace wificond {
 
 namespace {
 
-const uint8_t kFakeSsid[] =
-    {'G', 'o', 'o', 'g', 'l', 'e', 'G', 'u', 'e', 's', 't'};
-const uint8_t kFakeSsid1[] =
-    {'A', 'n', 'd', 'r', 'o', 'i', 'd', 'A', 'P', 'T', 'e', 's', 't'};
+const Ssid kFakeSsid = Ssid::FromString("GoogleGuest");
+const Ssid kFakeSsid1 = Ssid::FromString("AndroidAPTest");
 
 constexpr int32_t kFakePnoIntervalMs = 20000;
 constexpr int32_t kFakePnoMin2gRssi = -80;
 constexpr int32_t kFakePnoMin5gRssi = -85;
 
+constexpr int32_t kFakeScanDeadlineMs = 800;
+
 constexpr uint32_t kFakeFrequency = 5260;
 constexpr uint32_t kFakeFrequency1 = 2460;
 constexpr uint32_t kFakeFrequency2 = 2500;
@@ -70,8 +72,7 @@ TEST_F(ScanSettingsTest, ChannelSettingsParcelableTest) {
 
 TEST_F(ScanSettingsTest, HiddenNetworkParcelableTest) {
   HiddenNetwork hidden_network;
-  hidden_network.ssid_ =
-      vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  hidden_network.ssid_ = kFakeSsid;
 
   Parcel parcel;
   EXPECT_EQ(::android::OK, hidden_network.writeToParcel(&parcel));
@@ -92,11 +93,15 @@ TEST_F(ScanSettingsTest, SingleScanSettingsParcelableTest) {
   channel2.frequency_ = kFakeFrequency2;
 
   HiddenNetwork network;
-  network.ssid_ =
-      vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  network.ssid_ = kFakeSsid;
 
   scan_settings.channel_settings_ = {channel, channel1, channel2};
   scan_settings.hidden_networks_ = {network};
+  scan_settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
+  scan_settings.flush_ = true;
+  scan_settings.low_priority_ = true;
+  scan_settings.priority_ = IWifiScannerImpl::SCAN_PRIORITY_USER;
+  scan_settings.deadline_ms_ = kFakeScanDeadlineMs;
 
   Parcel parcel;
   EXPECT_EQ(::android::OK, scan_settings.writeToParcel(&parcel));
@@ -108,10 +113,58 @@ TEST_F(ScanSettingsTest, SingleScanSettingsParcelableTest) {
   EXPECT_EQ(scan_settings, scan_settings_copy);
 }
 
+TEST_F(ScanSettingsTest, SingleScanSettingsReadsParcelOfOlderFramework) {
+  ChannelSettings channel;
+  channel.frequency_ = kFakeFrequency;
+  HiddenNetwork network;
+  network.ssid_ = kFakeSsid;
+
+  // The parcel ends after the hidden networks.
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, parcel.writeInt32(1));
+  EXPECT_EQ(::android::OK, parcel.writeInt32(1));
+  EXPECT_EQ(::android::OK, channel.writeToParcel(&parcel));
+  EXPECT_EQ(::android::OK, parcel.writeInt32(1));
+  EXPECT_EQ(::android::OK, parcel.writeInt32(1));
+  EXPECT_EQ(::android::OK, network.writeToParcel(&parcel));
+
+  SingleScanSettings scan_settings;
+  parcel.setDataPosition(0);
+  EXPECT_EQ(::android::OK, scan_settings.readFromParcel(&parcel));
+
+  SingleScanSettings expected_scan_settings;
+  expected_scan_settings.channel_settings_ = {channel};
+  expected_scan_settings.hidden_networks_ = {network};
+  EXPECT_EQ(expected_scan_settings, scan_settings);
+}
+
+TEST_F(ScanSettingsTest, SingleScanSettingsRejectsInvalidScanType) {
+  SingleScanSettings scan_settings;
+  scan_settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY + 1;
+
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, scan_settings.writeToParcel(&parcel));
+
+  SingleScanSettings scan_settings_copy;
+  parcel.setDataPosition(0);
+  EXPECT_EQ(::android::BAD_VALUE, scan_settings_copy.readFromParcel(&parcel));
+}
+
+TEST_F(ScanSettingsTest, SingleScanSettingsRejectsInvalidPriority) {
+  SingleScanSettings scan_settings;
+  scan_settings.priority_ = IWifiScannerImpl::SCAN_PRIORITY_USER + 1;
+
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, scan_settings.writeToParcel(&parcel));
+
+  SingleScanSettings scan_settings_copy;
+  parcel.setDataPosition(0);
+  EXPECT_EQ(::android::BAD_VALUE, scan_settings_copy.readFromParcel(&parcel));
+}
+
 TEST_F(ScanSettingsTest, PnoNetworkParcelableTest) {
   PnoNetwork pno_network;
-  pno_network.ssid_ =
-      vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  pno_network.ssid_ = kFakeSsid;
   pno_network.is_hidden_ = true;
 
   Parcel parcel;
@@ -128,11 +181,9 @@ TEST_F(ScanSettingsTest, PnoSettingsParcelableTest) {
   PnoSettings pno_settings;
 
   PnoNetwork network, network1;
-  network.ssid_ =
-      vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  network.ssid_ = kFakeSsid;
   network.is_hidden_ = true;
-  network1.ssid_ =
-      vector<uint8_t>(kFakeSsid1, kFakeSsid1 + sizeof(kFakeSsid1));
+  network1.ssid_ = kFakeSsid1;
   network1.is_hidden_ = false;
 
   pno_settings.interval_ms_ = kFakePnoIntervalMs;
@@ -23,8 +23,11 @@
 
 #include <gtest/gtest.h>
 
+#include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/scan_result.h"
 #include "wificond/scanning/scan_utils.h"
+#include "wificond/tests/fake_event_loop.h"
+#include "wificond/tests/fake_kernel.h"
 #include "wificond/tests/mock_netlink_manager.h"
 
 using std::bind;
@@ -113,6 +116,13 @@ MATCHER_P(DoesNL80211PacketHaveAttribute, attr,
   return arg.HasAttribute(attr);
 }
 
+MATCHER_P(DoesNL80211PacketHaveScanFlags, scan_flags,
+          "Check if the netlink packet requests |scan_flags|") {
+  uint32_t value;
+  return arg.GetAttributeValue(NL80211_ATTR_SCAN_FLAGS, &value) &&
+         value == static_cast<uint32_t>(scan_flags);
+}
+
 TEST_F(ScanUtilsTest, CanGetScanResult) {
   vector<NativeScanResult> scan_results;
   EXPECT_CALL(
@@ -137,8 +147,10 @@ TEST_F(ScanUtilsTest, CanSendScanRequest) {
               WillOnce(Invoke(bind(
                   AppendMessageAndReturn, response, true, _1, _2)));
 
+  SingleScanFlags flags;
+  flags.request_random_mac = kFakeUseRandomMAC;
   int errno_ignored;
-  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, kFakeUseRandomMAC, {}, {},
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {}, {},
                                &errno_ignored));
   // TODO(b/34231420): Add validation of requested scan ssids, threshold,
   // and frequencies.
@@ -152,12 +164,189 @@ TEST_F(ScanUtilsTest, CanHandleScanRequestFailure) {
           DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN), _)).
               WillOnce(Invoke(bind(
                   AppendMessageAndReturn, response, true, _1, _2)));
+  SingleScanFlags flags;
+  flags.request_random_mac = kFakeUseRandomMAC;
   int error_code;
-  EXPECT_FALSE(scan_utils_.Scan(kFakeInterfaceIndex, kFakeUseRandomMAC, {}, {},
+  EXPECT_FALSE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {}, {},
                                 &error_code));
   EXPECT_EQ(kFakeErrorCode, error_code);
 }
 
+TEST_F(ScanUtilsTest, CanSendScanRequestWithFlags) {
+  NL80211Packet response = CreateControlMessageAck();
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndGetResponses(
+          AllOf(DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN),
+                DoesNL80211PacketHaveScanFlags(
+                    NL80211_SCAN_FLAG_RANDOM_ADDR | NL80211_SCAN_FLAG_FLUSH |
+                    NL80211_SCAN_FLAG_LOW_PRIORITY |
+                    kScanFlagLowSpan)), _)).
+              WillOnce(Invoke(bind(
+                  AppendMessageAndReturn, response, true, _1, _2)));
+
+  SingleScanFlags flags;
+  flags.request_random_mac = true;
+  flags.flush = true;
+  flags.low_priority = true;
+  flags.scan_type = SingleScanFlags::ScanType::kLowSpan;
+  int errno_ignored;
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {}, {},
+                               &errno_ignored));
+}
+
+TEST(ScanUtilsFakeKernelTest, FlushDropsOutOfRangeScanResults) {
+  const MacAddress kBssid({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+  const MacAddress kBssid1({0x45, 0x54, 0xad, 0x67, 0x98, 0xf6});
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeKernel fake_kernel(&netlink_manager);
+  ScanUtils scan_utils(&netlink_manager);
+  fake_kernel.AddBss(kFakeInterfaceIndex, kBssid,
+                     Ssid::FromString("GoogleGuest"), 2412);
+  fake_kernel.AddBss(kFakeInterfaceIndex, kBssid1,
+                     Ssid::FromString("AndroidAPTest"), 5180);
+  fake_kernel.MoveOutOfRange(kFakeInterfaceIndex, kBssid1);
+
+  // Without flush the kernel keeps reporting the BSS which went away.
+  int error_code;
+  vector<NativeScanResult> scan_results;
+  ASSERT_TRUE(scan_utils.Scan(kFakeInterfaceIndex, SingleScanFlags(), {}, {},
+                              &error_code));
+  fake_kernel.CompleteScan(kFakeInterfaceIndex);
+  ASSERT_TRUE(scan_utils.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  EXPECT_EQ(2u, scan_results.size());
+
+  SingleScanFlags flags;
+  flags.flush = true;
+  ASSERT_TRUE(scan_utils.Scan(kFakeInterfaceIndex, flags, {}, {},
+                              &error_code));
+  EXPECT_EQ(static_cast<uint32_t>(NL80211_SCAN_FLAG_FLUSH),
+            fake_kernel.GetLastScanFlags(kFakeInterfaceIndex));
+  fake_kernel.CompleteScan(kFakeInterfaceIndex);
+  scan_results.clear();
+  ASSERT_TRUE(scan_utils.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kBssid, scan_results[0].bssid);
+}
+
+TEST(ScanUtilsFakeKernelTest, FollowsScanPlansOfScheduledScans) {
+  constexpr int64_t kOneHourMs = 60 * 60 * 1000;
+  NiceMock<MockNetlinkManager> netlink_manager;
+  FakeEventLoop event_loop;
+  FakeKernel fake_kernel(&netlink_manager, &event_loop);
+  ScanUtils scan_utils(&netlink_manager);
+  int num_results = 0;
+  int num_stops = 0;
+  scan_utils.SubscribeSchedScanResultNotification(
+      kFakeInterfaceIndex,
+      [&num_results, &num_stops](uint32_t interface_index, bool stopped) {
+        EXPECT_EQ(kFakeInterfaceIndex, interface_index);
+        (stopped ? num_stops : num_results)++;
+      });
+
+  // 3 scans 20 seconds apart, then a scan every minute.
+  SchedScanIntervalSetting interval_setting{
+      {{kFakeScheduledScanIntervalMs, 3}}, kFakeScheduledScanIntervalMs * 3};
+  int error_code;
+  ASSERT_TRUE(scan_utils.StartScheduledScan(
+      kFakeInterfaceIndex, interval_setting, kFakeRssiThreshold,
+      kFakeUseRandomMAC, {}, {}, {}, &error_code));
+  event_loop.RunUntilIdle();
+  EXPECT_EQ(1, num_results);
+  event_loop.AdvanceTimeMs(kFakeScheduledScanIntervalMs * 2);
+  EXPECT_EQ(3, num_results);
+  // The slow plan starts one fast interval after the last fast scan.
+  event_loop.AdvanceTimeMs(kFakeScheduledScanIntervalMs - 1);
+  EXPECT_EQ(3, num_results);
+  event_loop.AdvanceTimeMs(1);
+  EXPECT_EQ(4, num_results);
+
+  // Scans of the following hour run every minute.
+  event_loop.AdvanceTimeMs(kOneHourMs);
+  EXPECT_EQ(4 + 60, num_results);
+  EXPECT_EQ(num_results,
+            fake_kernel.GetNumSchedScanCycles(kFakeInterfaceIndex));
+
+  ASSERT_TRUE(scan_utils.StopScheduledScan(kFakeInterfaceIndex));
+  EXPECT_FALSE(fake_kernel.IsSchedScanRunning(kFakeInterfaceIndex));
+  event_loop.AdvanceTimeMs(kOneHourMs);
+  EXPECT_EQ(4 + 60, num_results);
+  EXPECT_EQ(1, num_stops);
+}
+
+TEST_F(ScanUtilsTest, DoesNotSendEmptyScanFlags) {
+  NL80211Packet response = CreateControlMessageAck();
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndGetResponses(
+          AllOf(DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN),
+                Not(DoesNL80211PacketHaveAttribute(NL80211_ATTR_SCAN_FLAGS))),
+          _)).
+              WillOnce(Invoke(bind(
+                  AppendMessageAndReturn, response, true, _1, _2)));
+
+  int errno_ignored;
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, SingleScanFlags(), {}, {},
+                               &errno_ignored));
+}
+
+TEST_F(ScanUtilsTest, ReusesFullBandWildcardScanRequest) {
+  NL80211Packet response = CreateControlMessageAck();
+  vector<NL80211Packet> requests;
+  EXPECT_CALL(netlink_manager_, GetSequenceNumber())
+      .WillOnce(Return(kFakeSequenceNumber))
+      .WillOnce(Return(kFakeSequenceNumber + 1));
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndGetResponses(
+          DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN), _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&requests, &response](
+          const NL80211Packet& request,
+          vector<unique_ptr<const NL80211Packet>>* responses) {
+        requests.push_back(request);
+        return AppendMessageAndReturn(response, true, request, responses);
+      }));
+
+  SingleScanFlags flags;
+  int errno_ignored;
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {Ssid()}, {},
+                               &errno_ignored));
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {Ssid()}, {},
+                               &errno_ignored));
+  ASSERT_EQ(2u, requests.size());
+  EXPECT_EQ(kFakeSequenceNumber, requests[0].GetMessageSequence());
+  EXPECT_EQ(kFakeSequenceNumber + 1, requests[1].GetMessageSequence());
+  // Only the sequence number differs.
+  requests[1].SetMessageSequence(kFakeSequenceNumber);
+  EXPECT_EQ(requests[0].GetConstData(), requests[1].GetConstData());
+}
+
+TEST_F(ScanUtilsTest, DoesNotReuseRequestOfOtherScanFlags) {
+  NL80211Packet response = CreateControlMessageAck();
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndGetResponses(
+          DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN), _))
+      .WillOnce(Invoke(bind(
+          AppendMessageAndReturn, response, true, _1, _2)));
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndGetResponses(
+          AllOf(DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN),
+                DoesNL80211PacketHaveScanFlags(NL80211_SCAN_FLAG_FLUSH)), _))
+      .WillOnce(Invoke(bind(
+          AppendMessageAndReturn, response, true, _1, _2)));
+
+  SingleScanFlags flags;
+  int errno_ignored;
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {Ssid()}, {},
+                               &errno_ignored));
+  flags.flush = true;
+  EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, flags, {Ssid()}, {},
+                               &errno_ignored));
+}
+
 TEST_F(ScanUtilsTest, CanSendSchedScanRequest) {
   NL80211Packet response = CreateControlMessageAck();
   EXPECT_CALL(
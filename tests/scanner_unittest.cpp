@@ -14,40 +14,63 @@
  * limitations under the License.
  */
 
+#include <functional>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include <android-base/test_utils.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <wifi_system_test/mock_interface_tool.h>
 #include <wifi_system_test/mock_supplicant_manager.h>
 
+#include "wificond/metrics_registry.h"
+#include "wificond/regulatory_model.h"
+#include "wificond/scanning/bss_cache.h"
 #include "wificond/scanning/offload/offload_scan_utils.h"
 #include "wificond/scanning/scanner_impl.h"
 #include "wificond/tests/mock_client_interface_impl.h"
+#include "wificond/tests/mock_event_loop.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
+#include "wificond/tests/mock_offload.h"
 #include "wificond/tests/mock_offload_scan_callback_interface_impl.h"
 #include "wificond/tests/mock_offload_scan_manager.h"
 #include "wificond/tests/mock_offload_service_utils.h"
+#include "wificond/tests/mock_pno_scan_event.h"
+#include "wificond/tests/mock_scan_event.h"
 #include "wificond/tests/mock_scan_utils.h"
+#include "wificond/tests/offload_hal_test_constants.h"
 #include "wificond/tests/offload_test_utils.h"
 
 using ::android::binder::Status;
+using ::android::net::wifi::IWifiScannerImpl;
 using ::android::wifi_system::MockInterfaceTool;
 using ::android::wifi_system::MockSupplicantManager;
 using ::com::android::server::wifi::wificond::SingleScanSettings;
+using ::com::android::server::wifi::wificond::PnoNetwork;
 using ::com::android::server::wifi::wificond::PnoSettings;
 using ::com::android::server::wifi::wificond::NativeScanResult;
+using android::hardware::wifi::offload::V1_0::OffloadStatusCode;
 using android::hardware::wifi::offload::V1_0::ScanResult;
+using ::testing::DoAll;
 using ::testing::Invoke;
 using ::testing::NiceMock;
 using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::SizeIs;
+using ::testing::SetArgPointee;
+using ::testing::WithArg;
 using ::testing::_;
+using std::function;
 using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
 using std::vector;
 
 using namespace std::placeholders;
+using namespace android::wificond::offload_hal_test_constants;
 
 namespace android {
 namespace wificond {
@@ -57,17 +80,18 @@ namespace {
 constexpr uint32_t kFakeInterfaceIndex = 12;
 constexpr uint32_t kFakeWiphyIndex = 5;
 constexpr uint32_t kFakeScanIntervalMs = 10000;
+constexpr int32_t kFakeScanDeadlineMs = 800;
 
 // This is a helper function to mock the behavior of ScanUtils::Scan()
 // when we expect a error code.
-// |interface_index_ignored|, |request_random_mac_ignored|, |ssids_ignored|,
+// |interface_index_ignored|, |flags_ignored|, |ssids_ignored|,
 // |freqs_ignored|, |error_code| are mapped to existing parameters of ScanUtils::Scan().
 // |mock_error_code| is a additional parameter used for specifying expected error code.
 bool ReturnErrorCodeForScanRequest(
     int mock_error_code,
     uint32_t interface_index_ignored,
-    bool request_random_mac_ignored,
-    const std::vector<std::vector<uint8_t>>& ssids_ignored,
+    const SingleScanFlags& flags_ignored,
+    const std::vector<Ssid>& ssids_ignored,
     const std::vector<uint32_t>& freqs_ignored,
     int* error_code) {
   *error_code = mock_error_code;
@@ -75,13 +99,19 @@ bool ReturnErrorCodeForScanRequest(
   return false;
 }
 
+MATCHER_P3(HasSingleScanFlags, flush, low_priority, scan_type,
+           "Check if the single scan request carries the given flags") {
+  return arg.flush == flush && arg.low_priority == low_priority &&
+         arg.scan_type == scan_type;
+}
+
 bool CaptureSchedScanIntervalSetting(
     uint32_t /* interface_index */,
     const SchedScanIntervalSetting&  interval_setting,
     int32_t /* rssi_threshold */,
     bool /* request_random_mac */,
-    const  std::vector<std::vector<uint8_t>>& /* scan_ssids */,
-    const std::vector<std::vector<uint8_t>>& /* match_ssids */,
+    const  std::vector<Ssid>& /* scan_ssids */,
+    const std::vector<Ssid>& /* match_ssids */,
     const  std::vector<uint32_t>& /* freqs */,
     int* /* error_code */,
     SchedScanIntervalSetting* out_interval_setting) {
@@ -89,6 +119,35 @@ bool CaptureSchedScanIntervalSetting(
   return true;
 }
 
+// Creates settings of a single scan of |priority|. The priority is also
+// told apart by the flush flag, which is only set for user scans.
+SingleScanSettings CreateScanSettings(int32_t priority) {
+  SingleScanSettings scan_settings;
+  scan_settings.priority_ = priority;
+  scan_settings.flush_ = (priority == IWifiScannerImpl::SCAN_PRIORITY_USER);
+  return scan_settings;
+}
+
+MATCHER_P(IsScanOfPriority, priority,
+          "Check if the single scan request is the one of |priority|") {
+  return arg.flush == (priority == IWifiScannerImpl::SCAN_PRIORITY_USER);
+}
+
+// Creates pno settings for the network of the results created by
+// OffloadTestUtils::createOffloadScanResults().
+PnoSettings CreatePnoSettings() {
+  PnoSettings pno_settings;
+  PnoNetwork pno_network;
+  Ssid::FromBytes(kSsid1, kSsid1_size, &pno_network.ssid_);
+  pno_settings.pno_networks_.push_back(pno_network);
+  return pno_settings;
+}
+
+NativeScanResult CreateScanResult(const Ssid& ssid, size_t ie_size) {
+  vector<uint8_t> ie(ie_size, 0);
+  return NativeScanResult(ssid, MacAddress(), ie, 2412, -5000, 0, 0, false);
+}
+
 bool ReturnOffloadScanResults(
     std::vector<NativeScanResult>* native_scan_results_,
     const std::vector<ScanResult>& offload_scan_results) {
@@ -104,12 +163,18 @@ bool ReturnNetlinkScanResults(
                                                       native_scan_results_);
 }
 
+// Answers a request to the Offload HAL with a success status.
+android::hardware::Return<void> ReturnOffloadStatusOk(StatusCallback cb) {
+  cb(OffloadTestUtils::createOffloadStatus(OffloadStatusCode::OK));
+  return android::hardware::Void();
+}
+
 }  // namespace
 
 class ScannerTest : public ::testing::Test {
  protected:
   void SetUp() override {
-    ON_CALL(*offload_service_utils_, GetOffloadScanManager(_, _))
+    ON_CALL(*offload_service_utils_, GetOffloadScanManager(_, _, _))
         .WillByDefault(Return(offload_scan_manager_));
     ON_CALL(*offload_service_utils_, GetOffloadScanCallbackInterface(_))
         .WillByDefault(Return(offload_scan_callback_interface_));
@@ -122,10 +187,13 @@ class ScannerTest : public ::testing::Test {
   NiceMock<MockNetlinkManager> netlink_manager_;
   NiceMock<MockNetlinkUtils> netlink_utils_{&netlink_manager_};
   NiceMock<MockScanUtils> scan_utils_{&netlink_manager_};
+  RegulatoryModel regulatory_model_{kFakeWiphyIndex, &netlink_utils_, nullptr};
+  NiceMock<MockEventLoop> event_loop_;
   NiceMock<MockInterfaceTool> if_tool_;
   NiceMock<MockSupplicantManager> supplicant_manager_;
   NiceMock<MockClientInterfaceImpl> client_interface_impl_{
-      &if_tool_, &supplicant_manager_, &netlink_utils_, &scan_utils_};
+      &if_tool_, &supplicant_manager_, &netlink_utils_, &scan_utils_,
+      &regulatory_model_, &event_loop_};
   shared_ptr<NiceMock<MockOffloadServiceUtils>> offload_service_utils_{
       new NiceMock<MockOffloadServiceUtils>()};
   shared_ptr<NiceMock<MockOffloadScanCallbackInterfaceImpl>>
@@ -134,7 +202,8 @@ class ScannerTest : public ::testing::Test {
               scanner_impl_.get())};
   std::shared_ptr<NiceMock<MockOffloadScanManager>> offload_scan_manager_{
       new NiceMock<MockOffloadScanManager>(offload_service_utils_,
-                                           offload_scan_callback_interface_)};
+                                           offload_scan_callback_interface_,
+                                           &event_loop_)};
   ScanCapabilities scan_capabilities_;
   WiphyFeatures wiphy_features_;
   std::vector<ScanResult> dummy_scan_results_;
@@ -146,7 +215,9 @@ TEST_F(ScannerTest, TestSingleScan) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_TRUE(scanner_impl_->scan(SingleScanSettings(), &success).isOk());
   EXPECT_TRUE(success);
 }
@@ -155,7 +226,9 @@ TEST_F(ScannerTest, TestSingleScanFailure) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(
       scan_utils_,
       Scan(_, _, _, _, _)).
@@ -167,11 +240,113 @@ TEST_F(ScannerTest, TestSingleScanFailure) {
   EXPECT_FALSE(success);
 }
 
+TEST_F(ScannerTest, TestSingleScanPassesSupportedScanFlags) {
+  wiphy_features_.supports_low_priority_oneshot_scan = true;
+  wiphy_features_.supports_low_span_oneshot_scan = true;
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  EXPECT_CALL(
+      scan_utils_,
+      Scan(_, HasSingleScanFlags(true, true,
+                                 SingleScanFlags::ScanType::kLowSpan),
+           _, _, _)).
+          WillOnce(Return(true));
+
+  SingleScanSettings scan_settings;
+  scan_settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
+  scan_settings.flush_ = true;
+  scan_settings.low_priority_ = true;
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
+TEST_F(ScannerTest, TestSingleScanDropsUnsupportedScanFlags) {
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  // Flush does not depend on any driver feature.
+  EXPECT_CALL(
+      scan_utils_,
+      Scan(_, HasSingleScanFlags(true, false,
+                                 SingleScanFlags::ScanType::kDefault),
+           _, _, _)).
+          WillOnce(Return(true));
+
+  SingleScanSettings scan_settings;
+  scan_settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
+  scan_settings.flush_ = true;
+  scan_settings.low_priority_ = true;
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
+TEST_F(ScannerTest, TestSingleScanSkipsDisabledChannels) {
+  ChannelInfo usable_channel;
+  usable_channel.frequency = 5180;
+  ChannelInfo disabled_channel;
+  disabled_channel.frequency = 5865;
+  disabled_channel.disabled = true;
+  ON_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _))
+      .WillByDefault(DoAll(
+          SetArgPointee<1>(vector<ChannelInfo>{usable_channel,
+                                               disabled_channel}),
+          Return(true)));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  SingleScanSettings scan_settings;
+  scan_settings.channel_settings_.resize(2);
+  scan_settings.channel_settings_[0].frequency_ = 5180;
+  scan_settings.channel_settings_[1].frequency_ = 5865;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, vector<uint32_t>{5180}, _))
+      .WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
+TEST_F(ScannerTest, TestSingleScanFailsWithoutUsableChannels) {
+  ChannelInfo disabled_channel;
+  disabled_channel.frequency = 5865;
+  disabled_channel.disabled = true;
+  ON_CALL(netlink_utils_, GetChannels(kFakeWiphyIndex, _))
+      .WillByDefault(DoAll(
+          SetArgPointee<1>(vector<ChannelInfo>{disabled_channel}),
+          Return(true)));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  SingleScanSettings scan_settings;
+  scan_settings.channel_settings_.resize(1);
+  scan_settings.channel_settings_[0].frequency_ = 5865;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).Times(0);
+  bool success = true;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_FALSE(success);
+}
+
 TEST_F(ScannerTest, TestProcessAbortsOnScanReturningNoDeviceError) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   ON_CALL(
       scan_utils_,
       Scan(_, _, _, _, _)).
@@ -188,7 +363,9 @@ TEST_F(ScannerTest, TestAbortScan) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
   EXPECT_TRUE(
       scanner_impl_->scan(SingleScanSettings(), &single_scan_success).isOk());
@@ -202,9 +379,261 @@ TEST_F(ScannerTest, TestAbortScanNotIssuedIfNoOngoingScan) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  EXPECT_CALL(scan_utils_, AbortScan(_)).Times(0);
+  EXPECT_TRUE(scanner_impl_->abortScan().isOk());
+}
+
+TEST_F(ScannerTest, TestHigherPriorityScanPreemptsOngoingScan) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  bool success = false;
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND),
+      &success).isOk());
+  EXPECT_TRUE(success);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The user scan has to wait for the background scan to be aborted.
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).Times(0);
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_USER),
+      &success).isOk());
+  EXPECT_TRUE(success);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The abort is not reported as a failure.
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  EXPECT_CALL(
+      scan_utils_,
+      Scan(_, IsScanOfPriority(IWifiScannerImpl::SCAN_PRIORITY_USER), _, _, _))
+          .WillOnce(Return(true));
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The background scan is resumed once the user scan is done.
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(2);
+  EXPECT_CALL(
+      scan_utils_,
+      Scan(_,
+           IsScanOfPriority(IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND),
+           _, _, _))
+          .WillOnce(Return(true));
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+
+  std::stringstream ss;
+  scanner_impl_->Dump(&ss);
+  EXPECT_NE(string::npos, ss.str().find(
+      "background priority: requested 1, completed 1, failed 0, preempted 1"));
+  EXPECT_NE(string::npos, ss.str().find(
+      "user priority: requested 1, completed 1, failed 0, preempted 0"));
+}
+
+TEST_F(ScannerTest, TestLowerPriorityScanWaitsForOngoingScan) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  bool success = false;
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_USER),
+      &success).isOk());
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
   EXPECT_CALL(scan_utils_, AbortScan(_)).Times(0);
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).Times(0);
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND),
+      &success).isOk());
+  EXPECT_TRUE(success);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(
+      scan_utils_,
+      Scan(_,
+           IsScanOfPriority(IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND),
+           _, _, _))
+          .WillOnce(Return(true));
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestScanDeadlineReportsPartialResults) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  // The deadline task holds a strong reference to the scanner.
+  sp<ScannerImpl> scanner_impl(
+      new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                      scan_capabilities_, wiphy_features_,
+                      &client_interface_impl_, &netlink_utils_,
+                      &scan_utils_, &regulatory_model_,
+                      nullptr /* bss_cache */, &event_loop_,
+                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl->subscribeScanEvents(scan_event).isOk());
+
+  std::function<void()> deadline_task;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, kFakeScanDeadlineMs))
+      .WillOnce(SaveArg<0>(&deadline_task));
+  SingleScanSettings scan_settings;
+  scan_settings.deadline_ms_ = kFakeScanDeadlineMs;
+  bool success = false;
+  EXPECT_TRUE(scanner_impl->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  ASSERT_TRUE(deadline_task);
+
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  deadline_task();
+
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(
+          Invoke(bind(ReturnNetlinkScanResults, _1, _2, dummy_scan_results_)));
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  EXPECT_CALL(*scan_event, OnPartialScanResultReady(
+      SizeIs(dummy_scan_results_.size())));
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestScanDeadlineIgnoredAfterScanCompletes) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  sp<ScannerImpl> scanner_impl(
+      new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                      scan_capabilities_, wiphy_features_,
+                      &client_interface_impl_, &netlink_utils_,
+                      &scan_utils_, &regulatory_model_,
+                      nullptr /* bss_cache */, &event_loop_,
+                      offload_service_utils_));
+
+  std::function<void()> deadline_task;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, kFakeScanDeadlineMs))
+      .WillOnce(SaveArg<0>(&deadline_task));
+  SingleScanSettings scan_settings;
+  scan_settings.deadline_ms_ = kFakeScanDeadlineMs;
+  bool success = false;
+  EXPECT_TRUE(scanner_impl->scan(scan_settings, &success).isOk());
+  ASSERT_TRUE(deadline_task);
+
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+
+  EXPECT_CALL(scan_utils_, AbortScan(_)).Times(0);
+  deadline_task();
+}
+
+TEST_F(ScannerTest, TestAbortScanDropsPendingScans) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  bool success = false;
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND),
+      &success).isOk());
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_USER),
+      &success).isOk());
+  // The preemption abort is already on its way.
   EXPECT_TRUE(scanner_impl_->abortScan().isOk());
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(*scan_event, OnScanFailed());
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestAbortScanDuringPreemptionFailsEachScanOnce) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  bool success = false;
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_BACKGROUND),
+      &success).isOk());
+  EXPECT_TRUE(scanner_impl_->scan(
+      CreateScanSettings(IWifiScannerImpl::SCAN_PRIORITY_USER),
+      &success).isOk());
+  uint64_t num_failed_scans = MetricsRegistry::GetDefault()->GetSnapshot()
+      .counters["scanning.single_scans_failed"];
+  EXPECT_TRUE(scanner_impl_->abortScan().isOk());
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+
+  // Each scan fails once, the preempted one included.
+  EXPECT_EQ(num_failed_scans + 2,
+            MetricsRegistry::GetDefault()->GetSnapshot()
+                .counters["scanning.single_scans_failed"]);
+  std::stringstream ss;
+  scanner_impl_->Dump(&ss);
+  EXPECT_NE(string::npos, ss.str().find(
+      "background priority: requested 1, completed 0, failed 1, preempted 1"));
+  EXPECT_NE(string::npos, ss.str().find(
+      "user priority: requested 1, completed 0, failed 1, preempted 0"));
 }
 
 TEST_F(ScannerTest, TestGetScanResults) {
@@ -212,11 +641,375 @@ TEST_F(ScannerTest, TestGetScanResults) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(scan_utils_, GetScanResult(_, _)).WillOnce(Return(true));
   EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
 }
 
+TEST_F(ScannerTest, TestGetScanResultsAddsCachedBssUntilScanCompletes) {
+  TemporaryFile file;
+  BssCache bss_cache(file.path, BssCache::kDefaultCapacity,
+                     [] { return 1500000000000; },
+                     [] { return 60 * 1000; });
+  ASSERT_TRUE(bss_cache.Open());
+  NativeScanResult cached_scan_result;
+  cached_scan_result.bssid = MacAddress({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+  cached_scan_result.tsf = 60 * 1000 * 1000;
+  bss_cache.Update({cached_scan_result});
+
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      &bss_cache, &event_loop_,
+                                      offload_service_utils_));
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillRepeatedly(Return(true));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(cached_scan_result.bssid, scan_results[0].bssid);
+
+  // Kernel results of a completed scan are handed out as they are.
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  scan_results.clear();
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  EXPECT_TRUE(scan_results.empty());
+}
+
+TEST_F(ScannerTest, TestGetScanResultsServedFromPrefetch) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+
+  // The dump runs when kernel announces the results, not on the binder call.
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(
+          Invoke(bind(ReturnNetlinkScanResults, _1, _2, dummy_scan_results_)));
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, GetScanResult(_, _)).Times(0);
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  EXPECT_EQ(dummy_scan_results_.size(), scan_results.size());
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The snapshot is only handed out once.
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(Return(true));
+  scan_results.clear();
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  EXPECT_TRUE(scan_results.empty());
+}
+
+TEST_F(ScannerTest, TestScanEventCarriesResults) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(
+      scanner_impl_->subscribeScanEventsWithResults(scan_event).isOk());
+
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(
+          Invoke(bind(ReturnNetlinkScanResults, _1, _2, dummy_scan_results_)));
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(0);
+  EXPECT_CALL(*scan_event, OnScanResultReadyWithResults(
+      SizeIs(dummy_scan_results_.size())));
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // Results sent with the event are not kept around.
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(Return(true));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+}
+
+TEST_F(ScannerTest, TestScanEventWithoutResultsWhenResultsAreTooLarge) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(
+      scanner_impl_->subscribeScanEventsWithResults(scan_event).isOk());
+
+  vector<NativeScanResult> large_scan_results(
+      256, CreateScanResult(Ssid::FromString("Google"), 2048));
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(large_scan_results), Return(true)));
+  EXPECT_CALL(*scan_event, OnScanResultReadyWithResults(_)).Times(0);
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The subscriber fetches them from the snapshot instead.
+  EXPECT_CALL(scan_utils_, GetScanResult(_, _)).Times(0);
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  EXPECT_EQ(large_scan_results.size(), scan_results.size());
+}
+
+TEST_F(ScannerTest, TestPnoEventCarriesMatchedResults) {
+  OnSchedScanResultsReadyHandler sched_scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeSchedScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&sched_scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockPnoScanEvent>> pno_scan_event(
+      new NiceMock<MockPnoScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribePnoScanEventsWithResults(
+      pno_scan_event).isOk());
+
+  PnoSettings pno_settings;
+  PnoNetwork pno_network;
+  pno_network.ssid_ = Ssid::FromString("Google");
+  pno_settings.pno_networks_.push_back(pno_network);
+  EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _))
+      .WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+
+  vector<NativeScanResult> scan_results = {
+      CreateScanResult(Ssid::FromString("Google"), 32),
+      CreateScanResult(Ssid::FromString("GoogleGuest"), 32),
+      CreateScanResult(Ssid::FromString("Google"), 64)};
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(scan_results), Return(true)));
+  EXPECT_CALL(*pno_scan_event, OnPnoNetworkFound()).Times(0);
+  vector<NativeScanResult> sent_scan_results;
+  EXPECT_CALL(*pno_scan_event, OnPnoNetworkFoundWithResults(_))
+      .WillOnce(DoAll(SaveArg<0>(&sent_scan_results), Return(Status::ok())));
+  sched_scan_results_handler(kFakeInterfaceIndex, false);
+  ASSERT_EQ(2u, sent_scan_results.size());
+  for (const auto& scan_result : sent_scan_results) {
+    EXPECT_EQ(pno_network.ssid_, scan_result.ssid);
+  }
+}
+
+TEST_F(ScannerTest, TestPnoScanResultsAreOnlyFilteredDuringPnoScan) {
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  PnoSettings pno_settings;
+  PnoNetwork pno_network;
+  pno_network.ssid_ = Ssid::FromString("Google");
+  pno_settings.pno_networks_.push_back(pno_network);
+  vector<NativeScanResult> kernel_scan_results = {
+      CreateScanResult(Ssid::FromString("Google"), 32),
+      CreateScanResult(Ssid::FromString("GoogleGuest"), 32)};
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<1>(kernel_scan_results), Return(true)));
+  EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getPnoScanResults(&scan_results).isOk());
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(pno_network.ssid_, scan_results[0].ssid);
+
+  // Once pno scans are stopped, results are no longer matched against the
+  // networks they looked for.
+  EXPECT_TRUE(scanner_impl_->stopPnoScan(&success).isOk());
+  EXPECT_TRUE(success);
+  scan_results.clear();
+  EXPECT_TRUE(scanner_impl_->getPnoScanResults(&scan_results).isOk());
+  EXPECT_EQ(2u, scan_results.size());
+}
+
+TEST_F(ScannerTest, TestAbortedScanResultsAreNotPrefetched) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+
+  EXPECT_CALL(*scan_event, OnScanFailed());
+  EXPECT_CALL(scan_utils_, GetScanResult(_, _)).Times(0);
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestExternalScanResultsAreNotPrefetched) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+
+  // A scan of wpa_supplicant completes.
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  EXPECT_CALL(scan_utils_, GetScanResult(_, _)).Times(0);
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(
+          Invoke(bind(ReturnNetlinkScanResults, _1, _2, dummy_scan_results_)));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  EXPECT_EQ(dummy_scan_results_.size(), scan_results.size());
+}
+
+TEST_F(ScannerTest, TestPrefetchedPartialResultsAddCachedBss) {
+  TemporaryFile file;
+  BssCache bss_cache(file.path, BssCache::kDefaultCapacity,
+                     [] { return 1500000000000; },
+                     [] { return 60 * 1000; });
+  ASSERT_TRUE(bss_cache.Open());
+  NativeScanResult cached_scan_result;
+  cached_scan_result.bssid = MacAddress({0x12, 0xef, 0xa1, 0x2c, 0x97, 0x8b});
+  cached_scan_result.tsf = 60 * 1000 * 1000;
+  bss_cache.Update({cached_scan_result});
+
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  // The deadline task holds a strong reference to the scanner.
+  sp<ScannerImpl> scanner_impl(
+      new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                      scan_capabilities_, wiphy_features_,
+                      &client_interface_impl_, &netlink_utils_,
+                      &scan_utils_, &regulatory_model_,
+                      &bss_cache, &event_loop_,
+                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl->subscribeScanEvents(scan_event).isOk());
+
+  std::function<void()> deadline_task;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, kFakeScanDeadlineMs))
+      .WillOnce(SaveArg<0>(&deadline_task));
+  SingleScanSettings scan_settings;
+  scan_settings.deadline_ms_ = kFakeScanDeadlineMs;
+  bool success = false;
+  EXPECT_TRUE(scanner_impl->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  ASSERT_TRUE(deadline_task);
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  deadline_task();
+
+  // Partial results don't make the cache redundant.
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(
+          Invoke(bind(ReturnNetlinkScanResults, _1, _2, dummy_scan_results_)));
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, GetScanResult(_, _)).Times(0);
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl->getScanResults(&scan_results).isOk());
+  ASSERT_EQ(dummy_scan_results_.size() + 1, scan_results.size());
+  EXPECT_EQ(cached_scan_result.bssid, scan_results.back().bssid);
+}
+
+TEST_F(ScannerTest, TestNewScanDropsPrefetchedScanResults) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_, SubscribeScanResultNotification(_, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  sp<NiceMock<MockScanEvent>> scan_event(new NiceMock<MockScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(
+          Invoke(bind(ReturnNetlinkScanResults, _1, _2, dummy_scan_results_)));
+  vector<Ssid> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(SingleScanSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  testing::Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(Return(true));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
+  EXPECT_TRUE(scan_results.empty());
+}
+
 TEST_F(ScannerTest, TestStartPnoScanViaNetlink) {
   bool success = false;
   EXPECT_CALL(*offload_service_utils_, IsOffloadScanSupported())
@@ -225,7 +1018,9 @@ TEST_F(ScannerTest, TestStartPnoScanViaNetlink) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _)).
               WillOnce(Return(true));
   EXPECT_TRUE(scanner_impl_->startPnoScan(PnoSettings(), &success).isOk());
@@ -240,7 +1035,9 @@ TEST_F(ScannerTest, TestStopPnoScanViaNetlink) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   // StopScheduledScan() will be called no matter if there is an ongoing
   // scheduled scan or not. This is for making the system more robust.
   EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
@@ -262,7 +1059,9 @@ TEST_F(ScannerTest, TestStartScanOverOffload) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   scanner_impl_->startPnoScan(PnoSettings(), &success);
   EXPECT_TRUE(success);
   scanner_impl_->stopPnoScan(&success);
@@ -276,7 +1075,9 @@ TEST_F(ScannerTest, TestStartScanOverNetlinkFallback) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(*offload_scan_manager_, startScan(_, _, _, _, _, _, _))
       .WillOnce(Return(false));
   EXPECT_CALL(*offload_scan_manager_, stopScan(_)).Times(0);
@@ -303,7 +1104,9 @@ TEST_F(ScannerTest, TestAsyncErrorOverOffload) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _))
       .WillOnce(Return(true));
   EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
@@ -333,8 +1136,10 @@ TEST_F(ScannerTest, TestGetScanResultsFromOffload) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
-  scanner_impl_->startPnoScan(PnoSettings(), &success);
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  scanner_impl_->startPnoScan(CreatePnoSettings(), &success);
   EXPECT_TRUE(success);
   scanner_impl_->OnOffloadScanResult();
   std::vector<NativeScanResult> scan_results;
@@ -363,11 +1168,14 @@ TEST_F(ScannerTest, TestGetScanResultsWhenOffloadFails) {
   scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_, &netlink_utils_,
-                                      &scan_utils_, offload_service_utils_));
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
   EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _))
       .WillOnce(Return(true));
   EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
-  EXPECT_TRUE(scanner_impl_->startPnoScan(PnoSettings(), &success).isOk());
+  EXPECT_TRUE(
+      scanner_impl_->startPnoScan(CreatePnoSettings(), &success).isOk());
   EXPECT_TRUE(success);
   scanner_impl_->OnOffloadError(
       OffloadScanCallbackInterface::AsyncErrorReason::REMOTE_FAILURE);
@@ -378,6 +1186,97 @@ TEST_F(ScannerTest, TestGetScanResultsWhenOffloadFails) {
   EXPECT_TRUE(success);
 }
 
+TEST_F(ScannerTest, TestPnoScanReturnsToOffloadWhenServiceIsAvailable) {
+  bool success = false;
+  EXPECT_CALL(*offload_service_utils_, IsOffloadScanSupported())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*offload_scan_manager_, startScan(_, _, _, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*offload_scan_manager_, stopScan(_))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+  EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->startPnoScan(PnoSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  // Pno scans fall back to netlink and return to Offload HAL once the
+  // service is back.
+  scanner_impl_->OnOffloadError(
+      OffloadScanCallbackInterface::AsyncErrorReason::BINDER_DEATH);
+  scanner_impl_->OnOffloadServiceAvailable();
+  scanner_impl_->stopPnoScan(&success);
+  EXPECT_TRUE(success);
+  // Nothing to replay once pno scans are stopped.
+  scanner_impl_->OnOffloadServiceAvailable();
+}
+
+TEST_F(ScannerTest, TestPnoScanMovesToOffloadWhenServiceComesUp) {
+  bool success = false;
+  sp<NiceMock<MockOffload>> mock_offload(new NiceMock<MockOffload>());
+  ON_CALL(*mock_offload, configureScans(_, _, _))
+      .WillByDefault(WithArg<2>(Invoke(ReturnOffloadStatusOk)));
+  ON_CALL(*mock_offload, subscribeScanResults(_, _))
+      .WillByDefault(WithArg<1>(Invoke(ReturnOffloadStatusOk)));
+  // A real OffloadScanManager, whose service is not up yet.
+  EXPECT_CALL(*offload_service_utils_, IsOffloadScanSupported())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*offload_service_utils_, GetOffloadService())
+      .WillOnce(Return(nullptr))
+      .WillRepeatedly(Return(mock_offload));
+  ON_CALL(*offload_service_utils_, GetOffloadCallback(_))
+      .WillByDefault(Invoke([](OffloadCallbackHandlers* handlers) {
+        return sp<OffloadCallback>(new OffloadCallback(handlers));
+      }));
+  ON_CALL(*offload_service_utils_, GetOffloadDeathRecipient(_))
+      .WillByDefault(Invoke([](OffloadDeathRecipientHandler handler) {
+        return new OffloadDeathRecipient(handler);
+      }));
+  ON_CALL(*offload_service_utils_, GetOffloadScanCallbackInterface(_))
+      .WillByDefault(Invoke([](ScannerImpl* scanner) {
+        return std::make_shared<OffloadScanCallbackInterfaceImpl>(scanner);
+      }));
+  ON_CALL(*offload_service_utils_, GetOffloadScanManager(_, _, _))
+      .WillByDefault(Invoke(
+          [](std::weak_ptr<OffloadServiceUtils> service_utils,
+             shared_ptr<OffloadScanCallbackInterfaceImpl> callback_interface,
+             EventLoop* event_loop) {
+            return std::make_shared<OffloadScanManager>(
+                service_utils, callback_interface, event_loop);
+          }));
+  function<void()> discovery_task;
+  EXPECT_CALL(event_loop_, PostDelayedTask(_, _))
+      .WillRepeatedly(SaveArg<0>(&discovery_task));
+  scanner_impl_.reset(new ScannerImpl(kFakeWiphyIndex, kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_, &netlink_utils_,
+                                      &scan_utils_, &regulatory_model_,
+                                      nullptr /* bss_cache */, &event_loop_,
+                                      offload_service_utils_));
+
+  EXPECT_CALL(*mock_offload, configureScans(_, _, _)).Times(0);
+  EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(
+      scanner_impl_->startPnoScan(CreatePnoSettings(), &success).isOk());
+  EXPECT_TRUE(success);
+  testing::Mock::VerifyAndClearExpectations(mock_offload.get());
+
+  // Pno scans move to Offload HAL once its service is found.
+  EXPECT_CALL(*mock_offload, configureScans(_, _, _))
+      .WillOnce(WithArg<2>(Invoke(ReturnOffloadStatusOk)));
+  EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
+  ASSERT_TRUE(discovery_task != nullptr);
+  discovery_task();
+}
+
 TEST_F(ScannerTest, TestGenerateScanPlansIfDeviceSupports) {
   ScanCapabilities scan_capabilities_scan_plan_supported(
       0 /* max_num_scan_ssids */,
@@ -391,7 +1290,8 @@ TEST_F(ScannerTest, TestGenerateScanPlansIfDeviceSupports) {
       kFakeWiphyIndex, kFakeInterfaceIndex,
       scan_capabilities_scan_plan_supported, wiphy_features_,
       &client_interface_impl_,
-      &netlink_utils_, &scan_utils_, offload_service_utils_);
+      &netlink_utils_, &scan_utils_, &regulatory_model_,
+      nullptr /* bss_cache */, &event_loop_, offload_service_utils_);
 
   PnoSettings pno_settings;
   pno_settings.interval_ms_ = kFakeScanIntervalMs;
@@ -425,7 +1325,8 @@ TEST_F(ScannerTest, TestGenerateSingleIntervalIfDeviceDoesNotSupportScanPlan) {
       kFakeWiphyIndex, kFakeInterfaceIndex,
       scan_capabilities_no_scan_plan_support, wiphy_features_,
       &client_interface_impl_,
-      &netlink_utils_, &scan_utils_, offload_service_utils_);
+      &netlink_utils_, &scan_utils_, &regulatory_model_,
+      nullptr /* bss_cache */, &event_loop_, offload_service_utils_);
   PnoSettings pno_settings;
   pno_settings.interval_ms_ = kFakeScanIntervalMs;
 
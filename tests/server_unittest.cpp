@@ -14,8 +14,20 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
 
+#include <linux/nl80211.h>
+
+#include <android-base/test_utils.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <wifi_system_test/mock_hostapd_manager.h>
@@ -23,24 +35,38 @@
 #include <wifi_system_test/mock_supplicant_manager.h>
 
 #include "android/net/wifi/IApInterface.h"
+#include "android/net/wifi/IClientInterface.h"
+#include "android/net/wifi/IWifiScannerImpl.h"
+#include "wificond/metrics_registry.h"
+#include "wificond/scanning/single_scan_settings.h"
+#include "wificond/tests/mock_event_loop.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
 #include "wificond/tests/mock_scan_utils.h"
 #include "wificond/server.h"
 
 using android::net::wifi::IApInterface;
+using android::net::wifi::IClientInterface;
+using android::net::wifi::IWifiScannerImpl;
 using android::wifi_system::HostapdManager;
 using android::wifi_system::InterfaceTool;
 using android::wifi_system::MockHostapdManager;
 using android::wifi_system::MockInterfaceTool;
 using android::wifi_system::MockSupplicantManager;
 using android::wifi_system::SupplicantManager;
+using com::android::server::wifi::wificond::SingleScanSettings;
+using std::function;
 using std::unique_ptr;
 using std::vector;
+using testing::DoAll;
 using testing::Invoke;
+using testing::InvokeWithoutArgs;
+using testing::Mock;
 using testing::NiceMock;
 using testing::Return;
+using testing::SetArgPointee;
 using testing::Sequence;
+using testing::StrEq;
 using testing::_;
 
 using namespace std::placeholders;
@@ -52,8 +78,23 @@ namespace {
 const char kFakeInterfaceName[] = "testif0";
 const uint32_t kFakeInterfaceIndex = 34;
 const uint32_t kFakeInterfaceIndex1 = 36;
-const uint8_t kFakeInterfaceMacAddress[] = {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
-const uint8_t kFakeInterfaceMacAddress1[] = {0x05, 0x04, 0xef, 0x27, 0x12, 0xff};
+const uint32_t kFakeVirtualInterfaceIndex = 38;
+const MacAddress kFakeInterfaceMacAddress({0x45, 0x54, 0xad, 0x67, 0x98, 0xf6});
+const MacAddress kFakeInterfaceMacAddress1({0x05, 0x04, 0xef, 0x27, 0x12, 0xff});
+const MacAddress kFakeVirtualInterfaceMacAddress(
+    {0x06, 0x04, 0xef, 0x27, 0x12, 0xff});
+// Long enough for a call racing with a scan request to show up in it.
+constexpr std::chrono::milliseconds kFakeScanRequestDuration(100);
+
+// A wiphy which can run one client and one AP interface at the same time.
+InterfaceCombination CreateClientAndApCombination() {
+  InterfaceCombination combination;
+  combination.limits.emplace_back(1, 1 << NL80211_IFTYPE_STATION);
+  combination.limits.emplace_back(1, 1 << NL80211_IFTYPE_AP);
+  combination.max_interfaces = 2;
+  combination.num_channels = 1;
+  return combination;
+}
 
 // This is a helper function to mock the behavior of
 // NetlinkUtils::GetInterfaces().
@@ -95,28 +136,27 @@ class ServerTest : public ::testing::Test {
       new NiceMock<MockNetlinkUtils>(netlink_manager_.get())};
   unique_ptr<NiceMock<MockScanUtils>> scan_utils_{
       new NiceMock<MockScanUtils>(netlink_manager_.get())};
+  NiceMock<MockEventLoop> event_loop_;
   const vector<InterfaceInfo> mock_interfaces = {
       // Client interface
       InterfaceInfo(
           kFakeInterfaceIndex,
           std::string(kFakeInterfaceName),
-          vector<uint8_t>(
-              kFakeInterfaceMacAddress,
-              kFakeInterfaceMacAddress + sizeof(kFakeInterfaceMacAddress))),
+          kFakeInterfaceMacAddress),
       // p2p interface
       InterfaceInfo(
           kFakeInterfaceIndex1,
           "p2p0",
-           vector<uint8_t>(
-               kFakeInterfaceMacAddress1,
-               kFakeInterfaceMacAddress1 + sizeof(kFakeInterfaceMacAddress1)))
+          kFakeInterfaceMacAddress1)
   };
 
   Server server_{unique_ptr<InterfaceTool>(if_tool_),
                  unique_ptr<SupplicantManager>(supplicant_manager_),
                  unique_ptr<HostapdManager>(hostapd_manager_),
                  netlink_utils_.get(),
-                 scan_utils_.get()};
+                 scan_utils_.get(),
+                 nullptr /* bss_cache */,
+                 &event_loop_};
 };  // class ServerTest
 
 }  // namespace
@@ -154,5 +194,185 @@ TEST_F(ServerTest, CanDestroyInterfaces) {
   EXPECT_TRUE(server_.createApInterface(&ap_if).isOk());
 }
 
+TEST_F(ServerTest, CleansUpSystemStateBeforeSettingUpInterfaces) {
+  // Both daemons are stopped before any interface is marked down.
+  Sequence supplicant_sequence, hostapd_sequence;
+  EXPECT_CALL(*supplicant_manager_, StopSupplicant())
+      .InSequence(supplicant_sequence)
+      .WillOnce(Return(true));
+  EXPECT_CALL(*hostapd_manager_, StopHostapd())
+      .InSequence(hostapd_sequence)
+      .WillOnce(Return(true));
+  EXPECT_CALL(*if_tool_, SetUpState(_, false))
+      .Times(mock_interfaces.size())
+      .InSequence(supplicant_sequence, hostapd_sequence)
+      .WillRepeatedly(Return(true));
+  server_.CleanUpSystemState();
+
+  // Setting up an interface waits for the clean up.
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(&client_if).isOk());
+  EXPECT_NE(nullptr, client_if.get());
+  // Destroying the client interface stops wpa_supplicant again.
+  Mock::VerifyAndClearExpectations(supplicant_manager_);
+  Mock::VerifyAndClearExpectations(hostapd_manager_);
+  Mock::VerifyAndClearExpectations(if_tool_);
+}
+
+TEST_F(ServerTest, CanSetUpClientAndApInterfacesConcurrently) {
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(&client_if).isOk());
+  EXPECT_NE(nullptr, client_if.get());
+
+  // The only usable interface is taken by the client, so a virtual interface
+  // is created for the AP.
+  const InterfaceInfo virtual_interface(kFakeVirtualInterfaceIndex,
+                                        "wlan0",
+                                        kFakeVirtualInterfaceMacAddress);
+  EXPECT_CALL(*netlink_utils_, GetInterfaceCombinations(_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(vector<InterfaceCombination>(
+                          {CreateClientAndApCombination()})),
+                      Return(true)));
+  EXPECT_CALL(*netlink_utils_,
+              CreateInterface(_, "wlan0", NL80211_IFTYPE_AP, _))
+      .WillOnce(DoAll(SetArgPointee<3>(virtual_interface), Return(true)));
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(&ap_if).isOk());
+  EXPECT_NE(nullptr, ap_if.get());
+
+  // The virtual interface is deleted on teardown.
+  EXPECT_CALL(*netlink_utils_, DeleteInterface(kFakeVirtualInterfaceIndex))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(server_.tearDownInterfaces().isOk());
+}
+
+TEST_F(ServerTest, TearsDownInterfacesBeforeReturning) {
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(&client_if).isOk());
+  const InterfaceInfo virtual_interface(kFakeVirtualInterfaceIndex,
+                                        "wlan0",
+                                        kFakeVirtualInterfaceMacAddress);
+  EXPECT_CALL(*netlink_utils_, GetInterfaceCombinations(_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(vector<InterfaceCombination>(
+                          {CreateClientAndApCombination()})),
+                      Return(true)));
+  EXPECT_CALL(*netlink_utils_,
+              CreateInterface(_, "wlan0", NL80211_IFTYPE_AP, _))
+      .WillOnce(DoAll(SetArgPointee<3>(virtual_interface), Return(true)));
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(&ap_if).isOk());
+
+  EXPECT_CALL(*netlink_utils_, DeleteInterface(kFakeVirtualInterfaceIndex))
+      .WillOnce(Return(true));
+  // The interface objects mark their own interfaces down, and the last
+  // stage marks down all interfaces, p2p0 included.
+  EXPECT_CALL(*if_tool_, SetUpState(_, false)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*if_tool_, SetUpState(StrEq("p2p0"), false))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(server_.tearDownInterfaces().isOk());
+  // Nothing is left for the teardown sequence to do in the background.
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(netlink_utils_.get()));
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(if_tool_));
+}
+
+TEST_F(ServerTest, ReportsInterfacesInMetrics) {
+  // Interfaces of other tests may not be destroyed yet.
+  int64_t num_ap_interfaces =
+      MetricsRegistry::GetDefault()->GetSnapshot().gauges["interfaces.ap"];
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(&ap_if).isOk());
+
+  String16 metrics;
+  EXPECT_TRUE(server_.getMetrics(&metrics).isOk());
+  std::stringstream expected_line;
+  expected_line << "gauge interfaces.ap: " << num_ap_interfaces + 1 << "\n";
+  EXPECT_NE(std::string::npos,
+            std::string(String8(metrics).string()).find(expected_line.str()));
+}
+
+TEST_F(ServerTest, SerializesBinderScansWithEventLoopTasks) {
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(&client_if).isOk());
+  sp<IWifiScannerImpl> scanner;
+  EXPECT_TRUE(client_if->getWifiScannerImpl(&scanner).isOk());
+  ASSERT_NE(nullptr, scanner.get());
+
+  // This thread plays the event loop thread, and runs the calls that binder
+  // threads forward to it.
+  std::mutex tasks_lock;
+  std::condition_variable tasks_changed;
+  std::deque<function<void()>> tasks;
+  ON_CALL(event_loop_, PostTask(_))
+      .WillByDefault(Invoke([&](const function<void()>& task) {
+        std::lock_guard<std::mutex> lock(tasks_lock);
+        tasks.push_back(task);
+        tasks_changed.notify_all();
+      }));
+
+  // Kernel runs one scan at a time, so the second request is queued.
+  std::atomic<bool> scan_requested(false);
+  std::atomic<bool> scan_request_done(false);
+  EXPECT_CALL(*scan_utils_, Scan(_, _, _, _, _))
+      .WillOnce(InvokeWithoutArgs([&] {
+        scan_requested = true;
+        std::this_thread::sleep_for(kFakeScanRequestDuration);
+        scan_request_done = true;
+        return true;
+      }));
+  bool first_success = false;
+  std::thread first_caller([&] {
+    EXPECT_TRUE(scanner->scan(SingleScanSettings(), &first_success).isOk());
+  });
+  while (!scan_requested) {
+    std::this_thread::yield();
+  }
+  bool second_success = false;
+  std::thread second_caller([&] {
+    EXPECT_TRUE(scanner->scan(SingleScanSettings(), &second_success).isOk());
+  });
+  TemporaryFile file;
+  std::thread dump_caller([&] {
+    EXPECT_EQ(OK, server_.dump(file.fd, Vector<String16>()));
+  });
+
+  // The forwarded dump reads the scanner, so it waits for the scan request.
+  function<void()> task;
+  {
+    std::unique_lock<std::mutex> lock(tasks_lock);
+    tasks_changed.wait(lock, [&] { return !tasks.empty(); });
+    task = tasks.front();
+    tasks.pop_front();
+  }
+  task();
+  EXPECT_TRUE(scan_request_done);
+
+  first_caller.join();
+  second_caller.join();
+  dump_caller.join();
+  EXPECT_TRUE(first_success);
+  EXPECT_TRUE(second_success);
+  // The handler refers to the tasks of this test.
+  Mock::VerifyAndClear(&event_loop_);
+}
+
+TEST_F(ServerTest, DoesNotSetUpUnsupportedInterfaceCombination) {
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(&client_if).isOk());
+  EXPECT_NE(nullptr, client_if.get());
+
+  // This wiphy can only run client interfaces concurrently.
+  InterfaceCombination combination;
+  combination.limits.emplace_back(2, 1 << NL80211_IFTYPE_STATION);
+  combination.max_interfaces = 2;
+  EXPECT_CALL(*netlink_utils_, GetInterfaceCombinations(_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(vector<InterfaceCombination>(
+                          {combination})),
+                      Return(true)));
+  EXPECT_CALL(*netlink_utils_, CreateInterface(_, _, _, _)).Times(0);
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(&ap_if).isOk());
+  EXPECT_EQ(nullptr, ap_if.get());
+}
+
 }  // namespace wificond
 }  // namespace android
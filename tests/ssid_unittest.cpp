@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <linux/nl80211.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/ssid.h"
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const Ssid kFakeSsid = Ssid::FromString("GoogleGuest");
+const Ssid kFakeSsid1 = Ssid::FromString("AndroidAPTest");
+
+}  // namespace
+
+TEST(SsidTest, CanConvertFromAndToBytes) {
+  vector<uint8_t> bytes = {'G', 'o', 'o', 'g', 'l', 'e', 'G', 'u', 'e', 's',
+                           't'};
+  Ssid ssid;
+  EXPECT_TRUE(ssid.empty());
+  EXPECT_TRUE(Ssid::FromBytes(bytes, &ssid));
+  EXPECT_FALSE(ssid.empty());
+  EXPECT_EQ(bytes.size(), ssid.size());
+  EXPECT_EQ(kFakeSsid, ssid);
+  EXPECT_EQ(bytes, ssid.ToBytes());
+  EXPECT_EQ("GoogleGuest", ssid.ToString());
+}
+
+TEST(SsidTest, AcceptsSsidOfMaxSize) {
+  vector<uint8_t> bytes(Ssid::kMaxSize, 0xff);
+  Ssid ssid;
+  EXPECT_TRUE(Ssid::FromBytes(bytes, &ssid));
+  EXPECT_EQ(bytes, ssid.ToBytes());
+}
+
+TEST(SsidTest, RejectsOversizedBytes) {
+  Ssid ssid = kFakeSsid;
+  EXPECT_FALSE(Ssid::FromBytes(vector<uint8_t>(Ssid::kMaxSize + 1, 0xff),
+                               &ssid));
+  // A failed conversion leaves the output untouched.
+  EXPECT_EQ(kFakeSsid, ssid);
+}
+
+TEST(SsidTest, TruncatesOversizedString) {
+  Ssid ssid = Ssid::FromString(string(Ssid::kMaxSize + 8, 'a'));
+  EXPECT_EQ(Ssid::kMaxSize, ssid.size());
+}
+
+TEST(SsidTest, OverwritingWithShorterSsidClearsTail) {
+  Ssid ssid = kFakeSsid1;
+  ASSERT_TRUE(Ssid::FromBytes(kFakeSsid.data(), kFakeSsid.size(), &ssid));
+  EXPECT_EQ(kFakeSsid, ssid);
+  EXPECT_EQ(kFakeSsid.Hash(), ssid.Hash());
+}
+
+TEST(SsidTest, ComparesByContent) {
+  EXPECT_NE(kFakeSsid, kFakeSsid1);
+  EXPECT_NE(Ssid(), kFakeSsid);
+  EXPECT_TRUE(Ssid() < kFakeSsid);
+  EXPECT_TRUE(kFakeSsid1 < kFakeSsid);
+  EXPECT_FALSE(kFakeSsid < kFakeSsid);
+  // A prefix is ordered before the longer SSID.
+  EXPECT_TRUE(Ssid::FromString("Google") < kFakeSsid);
+}
+
+TEST(SsidTest, CanBeUsedAsHashKey) {
+  std::unordered_set<Ssid> ssids;
+  ssids.insert(kFakeSsid);
+  ssids.insert(kFakeSsid1);
+  ssids.insert(Ssid::FromString("GoogleGuest"));
+  EXPECT_EQ(2u, ssids.size());
+  EXPECT_EQ(1u, ssids.count(kFakeSsid1));
+  EXPECT_NE(kFakeSsid.Hash(), kFakeSsid1.Hash());
+}
+
+TEST(SsidTest, CanBeReadFromAttributes) {
+  NL80211NestedAttr ssids(NL80211_ATTR_SCAN_SSIDS);
+  ssids.AddAttribute(NL80211Attr<Ssid>(0, kFakeSsid));
+  ssids.AddAttribute(NL80211Attr<Ssid>(1, Ssid()));
+  ssids.AddAttribute(NL80211Attr<Ssid>(2, kFakeSsid1));
+
+  vector<Ssid> ssid_list;
+  EXPECT_TRUE(ssids.GetListOfAttributeValues(&ssid_list));
+  EXPECT_EQ(vector<Ssid>({kFakeSsid, Ssid(), kFakeSsid1}), ssid_list);
+}
+
+TEST(SsidTest, RejectsOversizedAttributes) {
+  NL80211NestedAttr ssids(NL80211_ATTR_SCAN_SSIDS);
+  ssids.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      0, vector<uint8_t>(Ssid::kMaxSize + 1, 0xff)));
+  Ssid ssid;
+  EXPECT_FALSE(ssids.GetAttributeValue(0, &ssid));
+  vector<Ssid> ssid_list;
+  EXPECT_FALSE(ssids.GetListOfAttributeValues(&ssid_list));
+}
+
+}  // namespace wificond
+}  // namespace android
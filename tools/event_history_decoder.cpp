@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Prints the records of a wificond event history file as CSV, oldest first.
+//
+// Usage:
+//   adb pull /data/misc/wifi/wificond_event_history
+//   wificond_event_history_decoder wificond_event_history > history.csv
+
+#include <stdio.h>
+
+#include <vector>
+
+#include <android-base/logging.h>
+
+#include "wificond/event_history.h"
+
+using android::wificond::EventHistory;
+using std::vector;
+
+int main(int argc, char** argv) {
+  android::base::InitLogging(argv, android::base::StderrLogger);
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <event history file>\n", argv[0]);
+    return 1;
+  }
+  vector<EventHistory::Record> records;
+  if (!EventHistory::ReadFile(argv[1], &records)) {
+    return 1;
+  }
+  printf("%s\n", EventHistory::kCsvHeader);
+  for (const auto& record : records) {
+    printf("%s\n", EventHistory::ToCsv(record).c_str());
+  }
+  return 0;
+}